@@ -0,0 +1,23 @@
+#ifndef BPFFILTER_H_INCLUDED
+#define BPFFILTER_H_INCLUDED
+
+#include <stdint.h>
+#include <netinet/in.h>
+
+// Maximum number of classic BPF instructions in the generated program
+#define BPF_FILTER_MAX_LEN 64
+
+// Value returned by the filter for accepted frames (i.e. maximum number of bytes to be kept for each frame)
+#define BPF_FILTER_ACCEPT 0x40000
+
+// bpfFilterAttach() errors
+#define BPFFILTER_ETOOLONG -1 // Generated program longer than BPF_FILTER_MAX_LEN
+#define BPFFILTER_ESETSOCKOPT -2 // setsockopt() error (SO_ATTACH_FILTER)
+
+// Do not match the LaMP session id (to be used, in the server, before the INIT packet is received)
+#define BPF_FILTER_ANY_ID 0
+#define BPF_FILTER_SESSION_ID 1
+
+int bpfFilterAttach(int sFd, struct in_addr dstIP, uint16_t port, int match_id, uint16_t session_id);
+
+#endif
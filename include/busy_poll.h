@@ -0,0 +1,48 @@
+#ifndef BUSYPOLL_H_INCLUDED
+#define BUSYPOLL_H_INCLUDED
+
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <sys/types.h>
+#include <sched.h> // cpu_set_t: the including files must define _GNU_SOURCE
+#include <sys/socket.h>
+
+// busyPollCreate() errors
+#define BUSYPOLL_ESETSOCKOPT -1 // SO_BUSY_POLL could not be set (CAP_NET_ADMIN is required to go beyond net.core.busy_read)
+
+// busyPollPinThread() errors
+#define BUSYPOLL_EAFFINITY -1 // pthread_setaffinity_np() error (e.g. non existing CPU)
+
+// Busy-polling receive state, for a non raw (UDP) socket
+// Instead of sleeping inside recvfrom()/recvmsg(), the receiving thread spins on non-blocking receives: the kernel, when
+// SO_BUSY_POLL is set, polls the NIC queue directly from each receive call, and no interrupt and wakeup latency is paid
+// when a datagram arrives. The receive timeout (SO_RCVTIMEO) becomes a deadline, checked inside the spin loop.
+typedef struct busyPoll {
+	int descriptor; // Socket descriptor
+	uint64_t timeout_ns; // Receive timeout (read from SO_RCVTIMEO) - 0 means: no timeout
+} busyPoll;
+
+// Host receive delay statistics: time elapsed between the kernel software receive timestamp (SO_TIMESTAMPNS) of each datagram
+// and the instant in which the datagram is returned to user space, i.e. the part of any user-to-user measurement due
+// to the interrupt handling and to the wakeup of the receiving thread, instead of to the network
+typedef struct hostRxDelay {
+	uint64_t min_ns;
+	uint64_t max_ns;
+	uint64_t sum_ns;
+	uint64_t count;
+	uint64_t errors; // Number of datagrams without any kernel timestamp, or with a kernel timestamp later than the user space one
+} hostRxDelay;
+
+int busyPollCreate(busyPoll *bp, int sFd, unsigned int budget_us);
+ssize_t busyPollRecvmsg(busyPoll *bp, struct msghdr *mhdr);
+ssize_t busyPollRecvfrom(busyPoll *bp, void *buf, size_t len, struct sockaddr *addr, socklen_t *addrlen);
+int busyPollPinThread(int cpu, cpu_set_t *oldAffinity);
+void busyPollRestoreAffinity(const cpu_set_t *oldAffinity);
+
+int hostRxDelayEnable(int sFd);
+void hostRxDelayInit(hostRxDelay *delay);
+void hostRxDelayUpdate(hostRxDelay *delay, struct msghdr *mhdr, struct timespec *user_ts);
+void hostRxDelayPrint(FILE *stream, hostRxDelay *delay, uint8_t busy_poll);
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef CLOCKSOURCE_H_INCLUDED
+#define CLOCKSOURCE_H_INCLUDED
+
+#include <stdint.h>
+#include "options.h"
+
+// Duration of the TSC calibration against CLOCK_MONOTONIC_RAW (in ms)
+#define CLOCK_TSC_CALIBRATION_MS 50
+// Number of attempts for each TSC/CLOCK_MONOTONIC_RAW sample: the one with the shortest TSC window is kept
+#define CLOCK_TSC_SAMPLE_ATTEMPTS 8
+
+// A wall clock step is detected when the offset between CLOCK_REALTIME and CLOCK_MONOTONIC_RAW changes, between two checks, by more
+// than CLOCK_STEP_THRESHOLD_NS plus the largest possible NTP frequency correction and slew over the elapsed time (CLOCK_STEP_MAX_PPM)
+#define CLOCK_STEP_THRESHOLD_NS 100000
+#define CLOCK_STEP_MAX_PPM 1000
+// Checks in which the two CLOCK_REALTIME reads surrounding the CLOCK_MONOTONIC_RAW one are farther than this value are discarded,
+// as the thread was probably preempted in the middle (in ns)
+#define CLOCK_STEP_MAX_READ_WINDOW_NS 20000
+
+// clockSourceInit() errors
+#define CLOCKSOURCE_ENOTSC -1 // No invariant TSC on this CPU (or not an x86-64 CPU)
+#define CLOCKSOURCE_ECALIB -2 // TSC calibration error (the TSC or CLOCK_MONOTONIC_RAW did not advance)
+
+// Wall clock step detector state (see clockStepDetect())
+typedef struct clockStepDetector {
+	int64_t offset_ns; // CLOCK_REALTIME - CLOCK_MONOTONIC_RAW at the last valid check
+	uint64_t monoraw_ns; // CLOCK_MONOTONIC_RAW at the last valid check
+	uint8_t init; // = 1 after the first valid check
+} clockStepDetector;
+
+int clockSourceInit(clocksource_t source);
+uint64_t clockSourceNs(void);
+
+void clockStepDetectorInit(clockStepDetector *detector);
+int clockStepDetect(clockStepDetector *detector);
+
+#endif
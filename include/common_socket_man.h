@@ -29,6 +29,7 @@ struct lampsock_data {
 
 int socketCreator(protocol_t protocol);
 int socketSetTimestamping(struct lampsock_data sData, int mode);
+int socketSetTimestampingTxID(int sFd, int mode);
 int pollErrqueueWait(int sFd,uint64_t timeout_ms);
 
 #endif
\ No newline at end of file
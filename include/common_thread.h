@@ -66,9 +66,14 @@ typedef enum {
 	ERR_INVALID_ARG_FOLLOWUPREQTYPE,
 	ERR_MALLOC,
 	ERR_RECVFROM_GENERIC,
-	ERR_TXSTAMP
+	ERR_TXSTAMP,
+	ERR_TXSCHED,
+	ERR_TXRING,
+	ERR_XDPSOCK
 } t_error_types;
 
 void thread_error_print(const char *name, t_error_types err);
+void testStopInit(void);
+int testStopRequested(void);
 
 #endif
\ No newline at end of file
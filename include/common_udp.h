@@ -26,7 +26,8 @@ int controlSenderUDP(arg_struct_udp *args, uint16_t session_id, int max_attempts
 int controlSenderUDP_RAW(arg_struct *args, controlRCVdata *rcvData, uint16_t session_id, int max_attempts, lamptype_t type, uint16_t followup_type, time_t interval_ms, uint8_t *termination_flag, pthread_mutex_t *termination_flag_mutex);
 int controlReceiverUDP(int sFd, controlRCVdata *rcvData, lamptype_t type, uint8_t *termination_flag, pthread_mutex_t *termination_flag_mutex);
 int controlReceiverUDP_RAW(int sFd, in_port_t port, in_addr_t ip, controlRCVdata *rcvData, lamptype_t type, uint8_t *termination_flag, pthread_mutex_t *termination_flag_mutex);
-int sendFollowUpData(struct lampsock_data sData,uint16_t id,uint16_t seq,struct timeval tDiff);
-int sendFollowUpData_RAW(arg_struct *args,controlRCVdata *rcvData,uint16_t id,uint16_t ip_id,uint16_t seq,struct timeval tDiff);
+int sendFollowUpData(struct lampsock_data sData,uint16_t id,uint16_t seq,uint64_t tDiff_ns);
+int sendFollowUpData_RAW(arg_struct *args,controlRCVdata *rcvData,uint16_t id,uint16_t ip_id,uint16_t seq,uint64_t tDiff_ns);
+uint64_t getFollowUpDataNs(struct timeval *tDiff,byte_t *payload,uint16_t payloadlen);
 
 #endif
\ No newline at end of file
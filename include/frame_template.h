@@ -0,0 +1,31 @@
+#ifndef FRAMETEMPLATE_H_INCLUDED
+#define FRAMETEMPLATE_H_INCLUDED
+
+#include <sys/time.h>
+#include "rawsock.h"
+#include "rawsock_lamp.h"
+#include "packet_structs.h"
+
+// Pre-built Ethernet/IP/UDP/LaMP frame, used by the raw client to avoid re-encapsulating each packet
+// The frame is built once per session; then, only the IP id and the LaMP ctrl, seq and timestamp fields are patched in place,
+// updating the IP and UDP checksums incrementally (RFC 1624), without recomputing them over the whole packet
+typedef struct frameTemplate {
+	byte_t *frame; // Full frame, ready to be sent on an AF_PACKET socket
+	size_t frame_size; // Frame size (in bytes)
+
+	// "In frame" header pointers
+	struct iphdr *ipHeader;
+	struct udphdr *udpHeader;
+	struct lamphdr *lampHeader;
+} frameTemplate;
+
+int frameTemplateInit(frameTemplate *tmpl, struct pktheaders_udp *headers, struct ipaddrs ipaddrs, byte_t *payload, uint16_t payloadlen);
+void frameTemplateSetIPid(frameTemplate *tmpl, uint16_t id);
+void frameTemplateSetEnd(frameTemplate *tmpl);
+void frameTemplateSetTimestamp(frameTemplate *tmpl, struct timeval *tv);
+void frameTemplateIncreaseSeq(frameTemplate *tmpl);
+void frameTemplateFree(frameTemplate *tmpl);
+
+void udpCsumIncrementalUpdate(struct udphdr *udpHeader, const byte_t *oldData, const byte_t *newData, size_t len);
+
+#endif
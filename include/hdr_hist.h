@@ -0,0 +1,28 @@
+#ifndef HDRHIST_H_INCLUDED
+#define HDRHIST_H_INCLUDED
+
+#include <stdint.h>
+
+// Log-linear (HDR-style) histogram of latency values, in ns
+// Values below HDR_HIST_SUB_BUCKETS ns are counted exactly; above, each power of two range is split into HDR_HIST_SUB_BUCKETS/2
+// linear sub-buckets, so that any value is known with a relative error below 1/HDR_HIST_SUB_BUCKETS (i.e. < 0.8%)
+#define HDR_HIST_SUB_BUCKET_BITS 7
+#define HDR_HIST_SUB_BUCKETS (1U<<HDR_HIST_SUB_BUCKET_BITS)
+// Largest trackable value: 2^HDR_HIST_MAX_BITS ns (~1100 s) - larger values are counted inside the last bucket
+#define HDR_HIST_MAX_BITS 40
+#define HDR_HIST_BUCKETS (HDR_HIST_SUB_BUCKETS+(HDR_HIST_MAX_BITS-HDR_HIST_SUB_BUCKET_BITS)*(HDR_HIST_SUB_BUCKETS/2))
+
+// Fixed memory (HDR_HIST_BUCKETS 64-bit counters), no allocation: each value is recorded in O(1)
+// As the bucket boundaries are fixed, two histograms can be merged without any loss of accuracy (see hdrHistMerge())
+typedef struct hdrHist {
+	uint64_t counts[HDR_HIST_BUCKETS];
+	uint64_t total; // Number of recorded values
+} hdrHist;
+
+void hdrHistInit(hdrHist *hist);
+void hdrHistRecord(hdrHist *hist, uint64_t value);
+void hdrHistMerge(hdrHist *dst, const hdrHist *src);
+uint64_t hdrHistValueAtPercentile(hdrHist *hist, double percentile);
+uint64_t hdrHistValueAtRank(hdrHist *hist, uint64_t rank);
+
+#endif
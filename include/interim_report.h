@@ -0,0 +1,46 @@
+#ifndef LATENCYTEST_INTERIMREPORT_H_INCLUDED
+#define LATENCYTEST_INTERIMREPORT_H_INCLUDED
+
+#include <stdint.h>
+#include "options.h"
+#include "report_manager.h"
+
+// Periodic (interim) reports, computed over time or packet windows (--interim): each window has its own report structure,
+// which is printed and reset when the window is closed, while the report of the whole test is updated as usual
+typedef struct interimReporter {
+	reportStructure window; // Statistics of the current window only
+
+	uint64_t interval_ns; // Window duration (0 = no time based windows)
+	uint64_t interval_packets; // Number of received packets per window (0 = no packet based windows)
+
+	uint64_t start_ns; // Start of the test (CLOCK_MONOTONIC)
+	uint64_t window_start_ns; // Start of the current window (CLOCK_MONOTONIC)
+	uint64_t next_deadline_ns; // End of the current (time based) window (CLOCK_MONOTONIC)
+	uint64_t window_index;
+
+	// The packets expected in the current window are the ones with a sequence number in [nextExpectedSeq,highestSeq]
+	uint64_t nextExpectedSeq; // First sequence number not covered by the previous windows
+	uint64_t highestSeq; // Highest extended sequence number received in the current window
+	uint8_t highestSeqValid; // = 1 when at least one packet has been received in the current window
+
+	// With time based windows, the receive timeout of the socket is shortened to the window duration, so that the windows
+	// are closed on time even when no reply is received (see interimReporterSetRxTimeout())
+	int rx_descriptor; // Socket with the shortened receive timeout (< 0 = timeout not shortened)
+	uint64_t rx_timeout_ns; // Original receive timeout (0 = no timeout)
+	uint64_t last_rx_ns; // Time at which the last packet was received (CLOCK_MONOTONIC)
+
+	latencytypes_t latencyType;
+	modefollowup_t followupMode;
+
+	int csvfd; // --interim-csv file descriptor (< 0 = stdout only)
+	const char *csvFilename;
+} interimReporter;
+
+void interimReporterInit(interimReporter *ir, struct options *opts);
+void interimReporterSetRxTimeout(interimReporter *ir, int sFd);
+void interimReporterUpdate(interimReporter *ir, uint64_t tripTime, uint64_t seqNumber);
+int interimReporterRxTimeout(interimReporter *ir);
+void interimReporterFlush(interimReporter *ir);
+void interimReporterClose(interimReporter *ir);
+
+#endif
@@ -6,6 +6,27 @@
 #include "rawsock_lamp.h" // In order to import the definition of protocol_t
 
 #define VALID_OPTS "hut:n:c:df:svlmop:reA:BC:FM:P:UL:I:W:0"
+// Long options without any short option equivalent (values start from 256, not to overlap with any short option character)
+#define LONGOPT_PPS 256
+#define LONGOPT_TX_SPIN 257
+#define LONGOPT_BURST 258
+#define LONGOPT_TX_RING 259
+#define LONGOPT_QDISC_BYPASS 260
+#define LONGOPT_RX_RING 261
+#define LONGOPT_XDP 262
+#define LONGOPT_XDP_QUEUE 263
+#define LONGOPT_XDP_REFLECT 264
+#define LONGOPT_RX_BATCH 265
+#define LONGOPT_BUSY_POLL 266
+#define LONGOPT_BUSY_POLL_CPU 267
+#define LONGOPT_HOST_RX_DELAY 268
+#define LONGOPT_CLOCK 269
+#define LONGOPT_INTERIM 270
+#define LONGOPT_INTERIM_CSV 271
+#define LONGOPT_W_SYNC 272
+#define LONGOPT_TRACE 273
+#define LONGOPT_PCAPNG 274
+#define LONGOPT_SHM_STATS 275
 #define SUPPORTED_PROTOCOLS "[-u]"
 #define INIT_CODE 0xAB
 
@@ -21,17 +42,21 @@
 #define RAW_RX_PACKET_BUF_SIZE (ETHERMTU+14) // Ethernet MTU (1500 B) + 14 B of struct ether_header
 #define MIN_TIMEOUT_VAL_S 1000 // Minimum timeout value for the server (in ms)
 #define MIN_TIMEOUT_VAL_C 3000 // Minimum timeout value for the client (in ms)
-#define POLL_ERRQUEUE_WAIT_TIMEOUT 100 // Timeout for pollErrqueueWait() in common_socket_man.h/.c (in ms)
+#define POLL_ERRQUEUE_WAIT_TIMEOUT 100 // Timeout for pollErrqueueWait() in common_socket_man.h/.c, and for txReaperGather() in tx_reaper.h/.c (in ms)
 
 // Default client interval/server timeout values
 #define CLIENT_DEF_INTERVAL 100 // [ms]
+#define MAX_TX_SPIN_US 1000 // Maximum busy-wait window before each transmission deadline (--tx-spin) [us]
+#define MAX_BURST_SIZE 1024 // Maximum number of packets sent for each deadline (--burst), equal to the sendmmsg() limit (UIO_MAXIOV) [#]
+#define MAX_RX_BATCH_SIZE 1024 // Maximum number of datagrams received with a single recvmmsg() call (--rx-batch), equal to the recvmmsg() limit (UIO_MAXIOV) [#]
+#define MAX_BUSY_POLL_US 10000 // Maximum kernel busy polling budget for each receive call (--busy-poll) [us]
 #define SERVER_DEF_TIMEOUT 4000 // [ms]
 
 // Default number of packets
 #define CLIENT_DEF_NUMBER 600 // [#]
 
 // Number of decimal digits to be reported in the CSV file when in "-W" mode
-#define W_DECIMAL_DIGITS 3 // [#]
+#define W_DECIMAL_DIGITS 6 // [#] (the values are written in ms: 6 digits keep the ns resolution)
 
 // Default confidence interval mask
 #define DEF_CONFIDENCE_INTERVAL_MASK 2
@@ -67,9 +92,17 @@ typedef enum {
 	FOLLOWUP_ON_HW		 // Hardware timestamps
 } modefollowup_t;
 
+// Clock sources for the user-to-user ping-like timestamps and for the application level follow-up intervals
+typedef enum {
+	CLOCKSRC_REALTIME,	// CLOCK_REALTIME (same clock as gettimeofday()) - default
+	CLOCKSRC_MONORAW,	// CLOCK_MONOTONIC_RAW: not affected by NTP slews and steps
+	CLOCKSRC_TSC		// Invariant TSC, calibrated against CLOCK_MONOTONIC_RAW at startup (x86-64 only)
+} clocksource_t;
+
 typedef enum {
 	NON_RAW,
-	RAW
+	RAW,
+	XDP // AF_XDP data path: the AF_PACKET (RAW) socket is still used for the control packets
 } moderaw_t;
 
 struct options {
@@ -78,7 +111,23 @@ struct options {
 	modecs_t mode_cs;
 	modeub_t mode_ub;
 	moderaw_t mode_raw;
-	uint64_t interval;
+	uint64_t interval; // Client: periodicity (rounded down to ms) - Server: timeout [ms]
+	uint64_t interval_ns; // Client only: periodicity, in ns, as set with -t (with or without a unit) or --pps
+	uint64_t tx_spin_ns; // Client only: busy-wait window before each transmission deadline, in ns (default: 0, i.e. sleep only)
+	unsigned int burst_size; // Client only: number of back-to-back packets sent for each deadline, with a single sendmmsg() (default: 1)
+	uint8_t tx_ring; // Raw client only: = 1 if the frames are sent through a PACKET_MMAP TX ring (--tx-ring), otherwise = 0 (default: 0)
+	uint8_t qdisc_bypass; // Raw client only: = 1 if the TX ring bypasses the kernel qdisc layer (--qdisc-bypass), otherwise = 0 (default: 0)
+	uint8_t rx_ring; // Raw client and server only: = 1 if the frames are received through a PACKET_MMAP RX ring (--rx-ring), otherwise = 0 (default: 0)
+	unsigned int xdp_queue; // AF_XDP mode (--xdp) only: index of the interface receive queue the AF_XDP socket is bound to (--xdp-queue) (default: 0)
+	unsigned int rx_batch; // Non raw client and server only: maximum number of datagrams received with a single recvmmsg() call (--rx-batch) (default: 1, i.e. recvfrom()/recvmsg())
+	unsigned int busy_poll_us; // Non raw client and server only: kernel busy polling budget, in us, for each non-blocking receive of the spinning Rx loop (--busy-poll) (default: 0, i.e. blocking receive)
+	int busy_poll_cpu; // Non raw client and server only: CPU the busy polling Rx loop is pinned to (--busy-poll-cpu) (default: -1, i.e. no pinning)
+	uint8_t host_rx_delay; // Non raw client only: = 1 if the delay between the kernel receive timestamp and user space is measured (--host-rx-delay, implied by --busy-poll with '-L u'), otherwise = 0 (default: 0)
+	clocksource_t clock_source; // Clock used for the ping-like user-to-user timestamps (client) and for the application level follow-up intervals (server) (--clock) (default: CLOCKSRC_REALTIME)
+	uint64_t interim_ns; // Client only: period of the interim reports, in ns (--interim with a time unit) (default: 0, i.e. no time based interim reports)
+	uint64_t interim_packets; // Client only: number of received replies covered by each interim report (--interim with 'p') (default: 0, i.e. no packet based interim reports)
+	char *interim_filename; // Client only: CSV file to which the interim reports are appended (--interim-csv) (default: NULL, i.e. stdout only)
+	uint8_t xdp_reflect; // Raw server only: = 1 if the ping-like requests are replied by an XDP program (--xdp-reflect), otherwise = 0 (default: 0)
 	uint64_t number;
 	uint16_t payloadlen; // uint16_t because the LaMP len field is 16 bits long
 	int macUP;
@@ -92,6 +141,10 @@ struct options {
 	modefollowup_t followup_mode; // = FOLLOWUP_OFF if no follow-up mechanism should be used, = FOLLOWUP_ON_* otherwise (default: 0)
 	uint8_t refuseFollowup; // Server only. =1 if the server should deny any follow-up request coming the client, =0 otherwise (default: 0)
 	char *Wfilename; // Filename for the -W mode
+	char *trace_filename; // Client only: binary per-packet trace file (--trace) (default: NULL, i.e. no trace)
+	char *pcapng_filename; // pcapng file to which all the LaMP packets sent and received during the test are written (--pcapng) (default: NULL)
+	char *shm_stats_name; // Name of the shared memory segment in which the live statistics are published (--shm-stats) (default: NULL)
+	uint8_t w_sync; // Client only: fdatasync() policy of the -W file (--w-sync), see TFILE_WRITER_SYNC_* in tfile_writer.h (default: TFILE_WRITER_SYNC_NONE)
 
 	// Consider adding a union here when other protocols will be added...
 	struct in_addr destIPaddr;
@@ -104,5 +157,6 @@ unsigned int parse_options(int argc, char **argv, struct options *options);
 void options_free(struct options *options);
 void options_set_destIPaddr(struct options *options, struct in_addr destIPaddr);
 const char * latencyTypePrinter(latencytypes_t latencyType);
+const char * clockSourcePrinter(clocksource_t clockSource);
 
 #endif
\ No newline at end of file
@@ -7,6 +7,10 @@
 #define START_ID 11349
 #define INCR_ID 0
 
+// Size of the FOLLOWUP_DATA payload: the processing delta as a 64-bit ns value, in network byte order
+// The same delta is also written, truncated to us, inside the LaMP header timestamp, for older clients
+#define FOLLOWUP_DATA_PAYLOAD_SIZE 8
+
 struct pktheaders_udp {
 	struct ether_header etherHeader;
 	struct iphdr ipHeader;
@@ -35,4 +39,12 @@ struct pktbuffers_udp_nopayload_fixed {
 	byte_t lamppacket[LAMP_HDR_SIZE()];
 };
 
+// FOLLOWUP_DATA message: LaMP header + processing delta in ns (see sendFollowUpData())
+struct pktbuffers_udp_followup_fixed {
+	byte_t ethernetpacket[ETH_IP_UDP_PACKET_SIZE_S(LAMP_HDR_PAYLOAD_SIZE(FOLLOWUP_DATA_PAYLOAD_SIZE))];
+	byte_t ippacket[IP_UDP_PACKET_SIZE_S(LAMP_HDR_PAYLOAD_SIZE(FOLLOWUP_DATA_PAYLOAD_SIZE))];
+	byte_t udppacket[UDP_PACKET_SIZE_S(LAMP_HDR_PAYLOAD_SIZE(FOLLOWUP_DATA_PAYLOAD_SIZE))];
+	byte_t lamppacket[LAMP_HDR_PAYLOAD_SIZE(FOLLOWUP_DATA_PAYLOAD_SIZE)];
+};
+
 #endif
\ No newline at end of file
@@ -0,0 +1,56 @@
+#ifndef PCAPNGWRITER_H_INCLUDED
+#define PCAPNGWRITER_H_INCLUDED
+
+/* ----------------- pcapng export of the LaMP packets (--pcapng) ----------------- */
+// This module does not depend on the Rawsock library: the IPv4/UDP headers of the packets sent and received through
+// non-raw sockets are rebuilt here, so that Wireshark can dissect them as if they were captured on the wire.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <netinet/in.h>
+
+// Link types (http://www.tcpdump.org/linktypes.html)
+#define PCAPNG_LINKTYPE_ETHERNET 1 // Raw sockets: the whole Ethernet frame is written
+#define PCAPNG_LINKTYPE_RAW 101 // Non-raw sockets: IPv4 packets, with no link layer header
+
+// Packet direction (stored inside the epb_flags option)
+#define PCAPNG_DIR_INBOUND 0x01
+#define PCAPNG_DIR_OUTBOUND 0x02
+
+// Size of the stdio buffer of the file: packets are written to disk in blocks of this size, not one by one
+#define PCAPNG_BUFFER_SIZE (1024*1024)
+
+// pcapngOpen() errors
+#define PCAPNG_EOPEN -1 // fopen() error
+#define PCAPNG_EWRITE -2 // The file header could not be written
+#define PCAPNG_EMUTEX -3 // The mutex could not be initialized
+
+// Timestamps of a packet, written as a comment of its Enhanced Packet Block (0 = not available)
+typedef struct pcapngStamps {
+	uint64_t user_ns; // Application level timestamp (selected clock source, see --clock)
+	uint64_t kernel_ns; // Kernel (software) timestamp, CLOCK_REALTIME
+	uint64_t hw_ns; // Hardware timestamp (NIC clock)
+	uint64_t req_tx_ns; // Client replies only: kernel or hardware tx timestamp of the corresponding request (from the error queue)
+} pcapngStamps;
+
+// A single section (one per test), with a single interface
+// The tx and rx loops of the client run in different threads: each block is written while holding 'mut'
+typedef struct pcapngWriter {
+	FILE *file;
+	char *buffer; // stdio buffer (PCAPNG_BUFFER_SIZE bytes)
+	pthread_mutex_t mut;
+	uint16_t linktype; // PCAPNG_LINKTYPE_*
+	uint16_t ip_id; // IP identification of the rebuilt IPv4 headers (PCAPNG_LINKTYPE_RAW only)
+
+	uint64_t packets; // Number of packets written so far
+	uint64_t writeErrors; // Number of packets which could not be written
+} pcapngWriter;
+
+int pcapngOpen(pcapngWriter *pw, const char *filename, uint8_t append, uint16_t linktype, const char *ifname, const char *comment);
+int pcapngWriteFrame(pcapngWriter *pw, uint32_t direction, const uint8_t *frame, size_t len, const pcapngStamps *stamps);
+int pcapngWriteUDP(pcapngWriter *pw, uint32_t direction, const struct sockaddr_in *src, const struct sockaddr_in *dst, const uint8_t *payload, size_t len, const pcapngStamps *stamps);
+void pcapngClose(pcapngWriter *pw);
+
+#endif
@@ -8,53 +8,133 @@
 #include <stdint.h>
 #include <stdio.h>
 #include "options.h"
+#include "hdr_hist.h"
+#include "seq_window.h"
+#include "trace_file.h"
 
-// Taking into account 20 characters to represent each 64 bit number + 20 characters and 5 decimal digits for each double (forced inside sprintf) + 1 character for layency type + 7 '-' chacaters=20*5+25*2+1+7=158 + some margin = 170
-#define REPORT_BUFF_SIZE 170
+// Taking into account the format tag + 20 characters to represent each 64 bit number (+ 1 for the sign, if signed) + 20 characters and 5 decimal digits for each double (forced inside sprintf) + 1 character for layency type + 44 '-' chacaters=3+20*31+21*7+25*6+1+44=965 + some margin = 1000
+#define REPORT_BUFF_SIZE 1000
+
+// Tag starting the reports in the current format, with all the values in ns
+// Older servers send the reports without it, and in us (see reportStructureParse()), while older clients cannot parse the reports starting with it
+#define REPORT_NS_TAG "ns:"
 
 #define CONFINT_NUMBER 3
 
+// Latency percentiles computed from the latency histogram (p50, p90, p99, p99.9 and p99.99)
+#define REPORT_PERCENTILES_NUMBER 5
+
+// IPDV percentiles computed from the IPDV histograms (p0.1, p1, p50, p99 and p99.9): as the IPDV is signed, both tails are reported
+#define REPORT_IPDV_PERCENTILES_NUMBER 5
+
 // Macro to write the report into a string
-#define repprintf(str1,rep1)	sprintf(str1,"%" PRIu64 "-%.5lf-%" PRIu64 "-%" PRIu64 "-%" PRIu64 "-%" PRIu64 "-%d-%.5lf", \
+#define repprintf(str1,rep1)	sprintf(str1,REPORT_NS_TAG "%" PRIu64 "-%.5lf-%" PRIu64 "-%" PRIu64 "-%" PRIu64 "-%" PRIu64 "-%d-%.5lf" \
+									"-%" PRIu64 "-%" PRIu64 "-%" PRIu64 "-%" PRIu64 "-%" PRIu64 \
+									"-%.5lf-%" PRId64 "-%" PRId64 "-%.5lf" \
+									"-%" PRIu64 "-%" PRIu64 "-%" PRIu64 "-%" PRIu64 "-%" PRIu64 "-%.5lf-%.5lf" \
+									"-%" PRId64 "-%" PRId64 "-%" PRId64 "-%" PRId64 "-%" PRId64 \
+									"-%" PRIu64 "-%" PRIu64 "-%" PRIu64 "-%" PRIu64 "-%" PRIu64 "-%" PRIu64 "-%" PRIu64 "-%" PRIu64 \
+									"-%" PRIu64 "-%" PRIu64 "-%" PRIu64 "-%" PRIu64 "-%" PRIu64 "-%" PRIu64 "-%" PRIu64 "-%" PRIu64, \
 									rep1.minLatency,rep1.averageLatency,rep1.maxLatency,rep1.packetCount, \
-									rep1.outOfOrderCount,rep1.errorsCount,(int) (rep1.latencyType),rep1.variance);
+									rep1.outOfOrderCount,rep1.errorsCount,(int) (rep1.latencyType),rep1.variance, \
+									rep1.percentiles[0],rep1.percentiles[1],rep1.percentiles[2],rep1.percentiles[3],rep1.percentiles[4], \
+									rep1.jitter,rep1.ipdvMin,rep1.ipdvMax,rep1.ipdvAbsAverage, \
+									rep1.reorderedCount,rep1.maxReorderExtent,rep1.duplicateCount,rep1.lossBurstCount,rep1.maxLossBurstLength, \
+									rep1.gilbertP,rep1.gilbertR, \
+									rep1.ipdvPercentiles[0],rep1.ipdvPercentiles[1],rep1.ipdvPercentiles[2],rep1.ipdvPercentiles[3],rep1.ipdvPercentiles[4], \
+									rep1.lossBurstLengths[0],rep1.lossBurstLengths[1],rep1.lossBurstLengths[2],rep1.lossBurstLengths[3], \
+									rep1.lossBurstLengths[4],rep1.lossBurstLengths[5],rep1.lossBurstLengths[6],rep1.lossBurstLengths[7], \
+									rep1.lossBurstLengths[8],rep1.lossBurstLengths[9],rep1.lossBurstLengths[10],rep1.lossBurstLengths[11], \
+									rep1.lossBurstLengths[12],rep1.lossBurstLengths[13],rep1.lossBurstLengths[14],rep1.lossBurstLengths[15])
 
 // Macro to read from a report stored in a string
-#define repscanf(str1,rep1ptr)		sscanf(str1,"%" SCNu64 "-%lf-%" SCNu64 "-%" SCNu64 "-%" SCNu64 "-%" SCNu64 "-%d-%lf", \
+// It returns 0 when the report does not start with REPORT_NS_TAG: use reportStructureParse(), which also handles the reports of older servers
+// Negative IPDV values are simply preceded by the '-' separator (e.g. "...--1500-..."), which sscanf() reads back correctly
+#define repscanf(str1,rep1ptr)		sscanf(str1,REPORT_NS_TAG "%" SCNu64 "-%lf-%" SCNu64 "-%" SCNu64 "-%" SCNu64 "-%" SCNu64 "-%d-%lf" \
+									"-%" SCNu64 "-%" SCNu64 "-%" SCNu64 "-%" SCNu64 "-%" SCNu64 \
+									"-%lf-%" SCNd64 "-%" SCNd64 "-%lf" \
+									"-%" SCNu64 "-%" SCNu64 "-%" SCNu64 "-%" SCNu64 "-%" SCNu64 "-%lf-%lf" \
+									"-%" SCNd64 "-%" SCNd64 "-%" SCNd64 "-%" SCNd64 "-%" SCNd64 \
+									"-%" SCNu64 "-%" SCNu64 "-%" SCNu64 "-%" SCNu64 "-%" SCNu64 "-%" SCNu64 "-%" SCNu64 "-%" SCNu64 \
+									"-%" SCNu64 "-%" SCNu64 "-%" SCNu64 "-%" SCNu64 "-%" SCNu64 "-%" SCNu64 "-%" SCNu64 "-%" SCNu64, \
 									rep1ptr.minLatency,rep1ptr.averageLatency,rep1ptr.maxLatency,rep1ptr.packetCount, \
-									rep1ptr.outOfOrderCount,rep1ptr.errorsCount,(int *) (rep1ptr.latencyType),rep1ptr.variance);
+									rep1ptr.outOfOrderCount,rep1ptr.errorsCount,(int *) (rep1ptr.latencyType),rep1ptr.variance, \
+									rep1ptr.percentiles[0],rep1ptr.percentiles[1],rep1ptr.percentiles[2],rep1ptr.percentiles[3],rep1ptr.percentiles[4], \
+									rep1ptr.jitter,rep1ptr.ipdvMin,rep1ptr.ipdvMax,rep1ptr.ipdvAbsAverage, \
+									rep1ptr.reorderedCount,rep1ptr.maxReorderExtent,rep1ptr.duplicateCount,rep1ptr.lossBurstCount,rep1ptr.maxLossBurstLength, \
+									rep1ptr.gilbertP,rep1ptr.gilbertR, \
+									rep1ptr.ipdvPercentiles[0],rep1ptr.ipdvPercentiles[1],rep1ptr.ipdvPercentiles[2],rep1ptr.ipdvPercentiles[3],rep1ptr.ipdvPercentiles[4], \
+									rep1ptr.lossBurstLengths[0],rep1ptr.lossBurstLengths[1],rep1ptr.lossBurstLengths[2],rep1ptr.lossBurstLengths[3], \
+									rep1ptr.lossBurstLengths[4],rep1ptr.lossBurstLengths[5],rep1ptr.lossBurstLengths[6],rep1ptr.lossBurstLengths[7], \
+									rep1ptr.lossBurstLengths[8],rep1ptr.lossBurstLengths[9],rep1ptr.lossBurstLengths[10],rep1ptr.lossBurstLengths[11], \
+									rep1ptr.lossBurstLengths[12],rep1ptr.lossBurstLengths[13],rep1ptr.lossBurstLengths[14],rep1ptr.lossBurstLengths[15])
 
 typedef struct reportStructure {
-	uint64_t minLatency;		// us
-	double averageLatency;		// us
-	uint64_t maxLatency;		// us
+	uint64_t minLatency;		// ns
+	double averageLatency;		// ns
+	uint64_t maxLatency;		// ns
 
 	uint64_t packetCount;		// #
 	uint64_t outOfOrderCount;	// #
 	uint64_t totalPackets;		// #
 	uint64_t errorsCount;		// #
+	uint64_t clockStepsCount;	// # - not transmitted (wall clock steps detected while the measurement clock could be affected by them)
+
+	double variance;			// ns^2
+
+	uint64_t percentiles[REPORT_PERCENTILES_NUMBER]; // ns - set by reportStructureFinalize() (0 = not available)
+
+	double jitter;				// ns - RFC 3550 interarrival jitter (< 0 = not available)
+	int64_t ipdvMin;			// ns - RFC 5481 IPDV, minimum (most negative) value (> ipdvMax = not available)
+	int64_t ipdvMax;			// ns - RFC 5481 IPDV, maximum value
+	double ipdvAbsAverage;		// ns - RFC 5481 IPDV, average of the absolute values
+	int64_t ipdvPercentiles[REPORT_IPDV_PERCENTILES_NUMBER]; // ns - RFC 5481 IPDV percentiles, set by reportStructureFinalize() (available with ipdvMin/ipdvMax)
 
-	double variance;			// us
+	// Reordering and loss burst statistics - set by reportStructureFinalize(), from the sliding receive window
+	uint64_t reorderedCount;	// # - RFC 4737 reordered packets
+	uint64_t maxReorderExtent;	// # - RFC 4737 reordering extent (maximum value, in packets)
+	uint64_t duplicateCount;	// #
+	uint64_t lossBurstCount;	// #
+	uint64_t maxLossBurstLength; // #
+	uint64_t lossBurstLengths[SEQ_WINDOW_LOSS_BURST_BINS]; // # - loss burst length distribution (see seq_window.h)
+	double gilbertP;			// Simple Gilbert model, good->bad transition probability (< 0 = not available)
+	double gilbertR;			// Simple Gilbert model, bad->good transition probability (< 0 = not available, e.g. no loss)
 
 	latencytypes_t latencyType; // enum (defined in options.h)
 	modefollowup_t followupMode; // enum (defined in options.h)
 
 	// Internal members
 	// Don't touch these variables, as they are managed internally by reportStructureUpdate()
-	uint16_t _lastSeqNumber;			// # - not transmitted/not printed
+	uint64_t _lastSeqNumber;			// # - not transmitted/not printed (extended sequence number)
 	uint8_t _isFirstUpdate; 			// [0,1] - not transmitted/not printed
-	double _welfordM2;					// us - not transmitted/not printed
-	double _welfordAverageLatencyOld;	// us - not transmitted/not printed
+	double _welfordM2;					// ns^2 - not transmitted/not printed
+	double _welfordAverageLatencyOld;	// ns - not transmitted/not printed
+	hdrHist _latencyHist;				// ns - not transmitted/not printed (the percentiles are computed from it)
+	uint64_t _lastTripTime;				// ns - not transmitted/not printed (0 = no valid packet received yet)
+	uint64_t _ipdvCount;				// # - not transmitted/not printed (number of IPDV samples)
+	hdrHist _ipdvPosHist;				// ns - not transmitted/not printed (IPDV values >= 0)
+	hdrHist _ipdvNegHist;				// ns - not transmitted/not printed (absolute values of the negative IPDV values)
+	seqWindow _seqWindow;				// not transmitted/not printed (its statistics are copied by reportStructureFinalize())
+	uint64_t _initialSeqNumber;			// # - not transmitted/not printed (first expected sequence number)
+	uint8_t _seqWindowEnabled;			// [0,1] - not transmitted/not printed (= 0 when the sequence numbers of a report are not contiguous)
 
 	// Finalize-only member: they are used to print statistics, but they are not transmitted
-	double confidenceIntervalDev[3];  // us - not transmitted (confidence interval deviation from mean value)
+	double confidenceIntervalDev[3];  // ns - not transmitted (confidence interval deviation from mean value)
 } reportStructure;
 
 void reportStructureInit(reportStructure *report, uint16_t initialSeqNumber, uint64_t totalPackets, latencytypes_t latencyType, modefollowup_t followupMode);
-void reportStructureUpdate(reportStructure *report, uint64_t tripTime, uint16_t seqNumber);
+void reportStructureUpdate(reportStructure *report, uint64_t tripTime, uint64_t seqNumber);
+void reportStructureMerge(reportStructure *dst, const reportStructure *src);
 void reportStructureFinalize(reportStructure *report);
+void reportStructurePublish(const reportStructure *report, uint64_t tripTime);
+void reportStructureParse(reportStructure *report, const char *str);
 void printStats(reportStructure *report, FILE *stream, uint8_t confidenceIntervalsMask);
+void reportSessionsAdd(const reportStructure *report);
+void printSessionsStats(FILE *stream, uint8_t confidenceIntervalsMask);
 int printStatsCSV(struct options *opts, reportStructure *report, const char *filename);
+reportStructure *burstReportsInit(unsigned int burst_size, uint64_t totalPackets, latencytypes_t latencyType, modefollowup_t followupMode);
+void burstReportsSetTotalPackets(reportStructure *reports, unsigned int burst_size, uint64_t totalPackets);
+void printBurstStats(reportStructure *reports, unsigned int burst_size, FILE *stream);
 int openTfile(const char *Tfilename, int followup_on_flag);
 int writeToTFile(int Tfiledescriptor,int followup_on_flag,int decimal_digits,uint64_t seqNo,uint64_t tripTime,uint64_t tripTimeProc);
 void closeTfile(int Tfilepointer);
@@ -0,0 +1,38 @@
+#ifndef RXBATCH_H_INCLUDED
+#define RXBATCH_H_INCLUDED
+
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <linux/errqueue.h>
+#include "rawsock.h"
+
+// Per-message ancillary data buffer size: large enough for both a SO_TIMESTAMPNS and a SO_TIMESTAMPING control message
+#define RX_BATCH_CTRL_SIZE (CMSG_SPACE(sizeof(struct timespec))+CMSG_SPACE(sizeof(struct scm_timestamping)))
+
+// rxBatchCreate() errors
+#define RXBATCH_EMALLOC -1 // Memory allocation error
+
+// struct mmsghdr is declared only when _GNU_SOURCE is defined (before including any header) by the source file including this header
+// Batch of datagrams received with a single recvmmsg() call, and then returned one at a time by rxBatchRecv()
+// Each message has its own data buffer, source address and ancillary data buffer, so that the kernel timestamps are kept for each datagram
+typedef struct rxBatch {
+	unsigned int size; // Maximum number of datagrams for each recvmmsg() call
+	size_t buf_size; // Size of each data buffer (in bytes)
+
+	byte_t *bufs; // Data buffers ('size' buffers of 'buf_size' bytes each, stored contiguously)
+	char *ctrl_bufs; // Ancillary data buffers ('size' buffers of RX_BATCH_CTRL_SIZE bytes each, stored contiguously)
+	struct sockaddr_in *addrs; // Source addresses
+	struct iovec *iovs;
+	struct mmsghdr *msgs;
+
+	unsigned int msgs_nr; // Number of datagrams returned by the last recvmmsg() call
+	unsigned int msgs_idx; // Index of the next datagram to be returned by rxBatchRecv()
+} rxBatch;
+
+int rxBatchCreate(rxBatch *batch, unsigned int size, size_t buf_size);
+ssize_t rxBatchRecv(rxBatch *batch, int sFd, byte_t **data, struct msghdr **mhdr);
+void rxBatchDestroy(rxBatch *batch);
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef RXRING_H_INCLUDED
+#define RXRING_H_INCLUDED
+
+#include <stddef.h>
+#include <sys/types.h>
+#include <time.h>
+#include <linux/if_packet.h>
+#include "rawsock.h"
+
+// RX ring geometry: RX_RING_BLOCK_NR blocks of RX_RING_BLOCK_SIZE bytes each (4 MiB in total)
+#define RX_RING_BLOCK_SIZE (1<<16)
+#define RX_RING_BLOCK_NR 64
+#define RX_RING_FRAME_SIZE (1<<11) // Used only to compute tp_frame_nr, as TPACKET_V3 frames are variable-length
+// Maximum time after which a block is handed to user space even if it is not full (in ms)
+#define RX_RING_BLOCK_TIMEOUT 1
+
+// rxRingCreate() errors
+#define RXRING_ESETSOCKOPT -1 // setsockopt() error (PACKET_VERSION, PACKET_RX_RING or PACKET_TIMESTAMP)
+#define RXRING_EMMAP -2 // mmap() error
+
+// Received frame, as returned by rxRingRecv()
+// 'data' points directly inside the ring and it is valid until the next call to rxRingRecv() or rxRingDestroy()
+typedef struct rxRingFrame {
+	byte_t *data; // Ethernet frame
+	unsigned char pkttype; // Same as sll_pkttype (e.g. PACKET_OUTGOING)
+	struct timespec ts; // Kernel receive timestamp (software, or hardware if ts_hw is = 1)
+	uint8_t ts_hw; // =1 if 'ts' is a raw hardware timestamp
+} rxRingFrame;
+
+// PACKET_MMAP (TPACKET_V3) receive ring, set up on an already bound AF_PACKET socket
+// While the ring is active, no frame can be received with recvfrom()/recvmsg() on the same socket
+typedef struct rxRing {
+	int descriptor; // Socket descriptor the ring is attached to
+	int timeout_ms; // Receive timeout (read from SO_RCVTIMEO) - -1 means: no timeout
+
+	byte_t *map; // mmap()'ed ring
+	size_t map_size; // Total ring size (in bytes)
+
+	unsigned int block_idx; // Current block index
+	struct tpacket_block_desc *block; // Block currently owned by user space (NULL if no block is owned)
+	struct tpacket3_hdr *frame; // Next frame to be returned, inside 'block'
+	unsigned int frames_left; // Number of frames not yet returned, inside 'block'
+} rxRing;
+
+int rxRingCreate(rxRing *ring, int sFd, int hw_timestamps);
+int rxRingSetHwTimestamps(rxRing *ring, int enable);
+ssize_t rxRingRecv(rxRing *ring, rxRingFrame *frame);
+void rxRingDestroy(rxRing *ring);
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef SEQEXTEND_H_INCLUDED
+#define SEQEXTEND_H_INCLUDED
+
+#include <stdint.h>
+
+// Reconstruction of 64-bit sequence numbers from the 16 bit LaMP ones, as done for the RTP extended sequence numbers:
+// each received sequence number is taken as the nearest one (within +-32768) to the highest extended sequence number received so far,
+// so that wrap-arounds are counted correctly, even in presence of reordering or of long loss bursts (up to 32767 packets)
+typedef struct seqExtender {
+	uint64_t highest; // Highest extended sequence number received so far
+	uint8_t init; // = 1 after the first sequence number has been received
+} seqExtender;
+
+// "__attribute__((unused))" is added just to tell the clang compiler not to issue a warning
+// for an unused 'static inline' (which is actually used in multiple modules)
+static inline void seqExtenderInit(seqExtender *ext) __attribute__((unused));
+static inline uint64_t seqExtend(seqExtender *ext, uint16_t seqNumber) __attribute__((unused));
+
+static inline void seqExtenderInit(seqExtender *ext) {
+	ext->highest=0;
+	ext->init=0;
+}
+
+static inline uint64_t seqExtend(seqExtender *ext, uint16_t seqNumber) {
+	int64_t extended;
+
+	if(!ext->init) {
+		ext->highest=seqNumber;
+		ext->init=1;
+
+		return seqNumber;
+	}
+
+	extended=(int64_t) ext->highest+(int16_t) (seqNumber-(uint16_t) ext->highest);
+
+	// A packet sent before the first received one, in the first cycle: it cannot be earlier than sequence number 0
+	if(extended<0) {
+		return seqNumber;
+	}
+
+	if((uint64_t) extended>ext->highest) {
+		ext->highest=extended;
+	}
+
+	return extended;
+}
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef SEQWINDOW_H_INCLUDED
+#define SEQWINDOW_H_INCLUDED
+
+#include <stdint.h>
+
+// Number of sequence numbers tracked by the receive window (it must be a power of 2 and a multiple of 64)
+// A sequence number is declared lost when the window moves past it before it is received
+#define SEQ_WINDOW_SIZE 1024
+#define SEQ_WINDOW_MASK (SEQ_WINDOW_SIZE-1)
+// Loss burst length distribution bins: bursts of 1, 2, ..., SEQ_WINDOW_LOSS_BURST_BINS-1 and >= SEQ_WINDOW_LOSS_BURST_BINS packets
+#define SEQ_WINDOW_LOSS_BURST_BINS 16 // repprintf()/repscanf() in report_manager.h list each bin: update them together
+
+// Sliding receive window, used to compute the RFC 4737 reordering metrics, the duplicates and the loss burst statistics
+// in bounded memory (it works on extended 64-bit sequence numbers, see seq_extend.h)
+typedef struct seqWindow {
+	uint64_t bitmap[SEQ_WINDOW_SIZE/64]; // Received sequence numbers inside the window
+	uint32_t firstGreaterArrival[SEQ_WINDOW_SIZE]; // Arrival index of the first packet with a larger sequence number (RFC 4737 'j')
+	int64_t highest; // Highest extended sequence number received so far (-1 = nothing received yet)
+	int64_t evicted; // All the sequence numbers below this one have already been classified as received or lost
+	uint32_t arrivals; // Arrival index (it can wrap around, as only differences are used)
+
+	// Statistics
+	uint64_t reorderedCount; // RFC 4737 reordered packets (including the ones arriving after the window moved past them)
+	uint64_t maxReorderExtent; // RFC 4737 reordering extent (maximum value)
+	uint64_t duplicateCount;
+	uint64_t lossCount; // Packets declared lost when leaving the window
+	uint64_t lossBurstCount;
+	uint64_t maxLossBurstLength;
+	uint64_t lossBurstLengths[SEQ_WINDOW_LOSS_BURST_BINS];
+	uint64_t currentBurstLength;
+
+	// Received/lost transitions between consecutive sequence numbers (used to estimate the simple Gilbert model parameters)
+	uint64_t transRecvLost, transRecvRecv, transLostRecv, transLostLost;
+	int8_t lastLost; // State of the last classified sequence number (-1 = none yet, 0 = received, 1 = lost)
+} seqWindow;
+
+void seqWindowInit(seqWindow *win, uint64_t firstSeqNumber);
+void seqWindowUpdate(seqWindow *win, uint64_t seqNumber);
+void seqWindowFlush(seqWindow *win, int64_t lastSeqNumber);
+void seqWindowMerge(seqWindow *dst, const seqWindow *src);
+void seqWindowGilbert(const seqWindow *win, double *p, double *r);
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef STATSPAGE_H_INCLUDED
+#define STATSPAGE_H_INCLUDED
+
+/* ----------------- Live statistics page (--shm-stats) ----------------- */
+// The statistics of the current session are published inside a POSIX shared memory segment, protected by a seqlock:
+// any number of readers (see tools/lampstats.c) can poll them at any rate, without any system call or lock on the writer side.
+// This module does not depend on the Rawsock library, so that it can also be used by the offline tools.
+
+#include <stdint.h>
+#include <sys/types.h>
+#include "hdr_hist.h"
+
+#define STATSPAGE_MAGIC "LaMPshm" // 8 bytes, including the terminating '\0'
+#define STATSPAGE_VERSION 1
+
+// Maximum length of the shared memory segment name, including the leading '/' and the terminating '\0'
+#define STATSPAGE_NAME_MAX_LEN 255
+
+// Number of percentiles stored inside the page (the same as REPORT_PERCENTILES_NUMBER: p50, p90, p99, p99.9 and p99.99)
+#define STATSPAGE_PERCENTILES_NUMBER 5
+
+// Role of the publishing process
+#define STATSPAGE_ROLE_CLIENT 0
+#define STATSPAGE_ROLE_SERVER 1
+
+// Session states
+#define STATSPAGE_STATE_IDLE 0 // No session started yet (e.g. a daemon server waiting for its first client)
+#define STATSPAGE_STATE_RUNNING 1
+#define STATSPAGE_STATE_FINISHED 2 // The statistics are final (including the percentiles computed by the program)
+#define STATSPAGE_STATE_ERROR 3 // The session has been terminated by an error
+
+// Number of attempts of statsPageSnapshot() before giving up, if the page is always being written
+#define STATSPAGE_READ_ATTEMPTS 10000
+
+// statsPageOpen()/statsPageAttach()/statsPageSnapshot() errors
+#define STATSPAGE_EOPEN -1 // shm_open() error
+#define STATSPAGE_EEXIST -2 // The segment is already used by another running process
+#define STATSPAGE_EMMAP -3 // ftruncate()/mmap() error
+#define STATSPAGE_EFORMAT -4 // Not a (supported) statistics page
+#define STATSPAGE_EBUSY -5 // No consistent snapshot could be taken in STATSPAGE_READ_ATTEMPTS attempts
+#define STATSPAGE_ENAME -6 // Invalid segment name
+
+// Statistics of a session, as last published by the program (the fields have the same meaning of the ones of reportStructure)
+typedef struct statsPageSession {
+	uint64_t session_index; // Number of sessions started by the process, including this one (0 = no session started yet)
+	uint64_t start_realtime_ns; // Wall clock time (CLOCK_REALTIME) at which the session started
+	uint64_t end_realtime_ns; // Wall clock time at which the session finished (0 = still running)
+	uint64_t updates; // Number of times the statistics have been published during this session
+
+	uint16_t lamp_id; // LaMP session id
+	uint8_t state; // STATSPAGE_STATE_*
+	uint8_t latency_type; // latencytypes_t (see options.h)
+	uint8_t followup; // = 1 when the follow-up mode is active
+	uint8_t reserved[3];
+
+	uint64_t total_packets; // Packets requested (client) or announced (server, if known)
+	uint64_t packet_count; // Packets received so far (including the ones with timestamping errors)
+	uint64_t errors_count;
+	uint64_t out_of_order_count;
+
+	// Receive window statistics: a packet is counted as lost only when the receive window moves past it (see seq_window.h)
+	uint64_t reordered_count;
+	uint64_t duplicate_count;
+	uint64_t loss_count;
+	uint64_t loss_burst_count;
+	uint64_t max_loss_burst_length;
+
+	uint64_t min_latency; // ns (meaningful only when packet_count>errors_count)
+	uint64_t max_latency; // ns
+	double average_latency; // ns
+	double variance; // ns^2
+	double jitter; // ns - RFC 3550 interarrival jitter (< 0 = not available)
+	uint64_t percentiles[STATSPAGE_PERCENTILES_NUMBER]; // ns - set only at the end of the session (0 = compute them from 'hist')
+
+	hdrHist hist; // Latency histogram of the session, updated with each packet
+} statsPageSession;
+
+typedef struct statsPage {
+	char magic[8]; // STATSPAGE_MAGIC
+	uint16_t version; // STATSPAGE_VERSION
+	uint8_t role; // STATSPAGE_ROLE_*
+	uint8_t reserved1;
+	uint32_t page_size; // sizeof(statsPage)
+	int32_t pid; // Publishing process
+	uint32_t reserved2;
+
+	uint64_t seqlock; // Odd while 'session' is being written (accessed only with the __atomic builtins)
+	statsPageSession session;
+} statsPage;
+
+// Read-only mapping of a page published by another process
+typedef struct statsPageReader {
+	const statsPage *page;
+} statsPageReader;
+
+// Writer side: a single page for the whole process, shared by all the sessions of a daemon server
+int statsPageOpen(const char *name, uint8_t role);
+void statsPageSessionStart(uint16_t lamp_id, uint64_t totalPackets, uint8_t latencyType, uint8_t followup);
+statsPageSession *statsPageWriteBegin(void);
+void statsPageWriteEnd(void);
+void statsPageSessionEnd(uint8_t state);
+void statsPageClose(void);
+
+// Reader side
+int statsPageAttach(statsPageReader *reader, const char *name);
+int statsPageSnapshot(const statsPageReader *reader, statsPageSession *session);
+void statsPageDetach(statsPageReader *reader);
+
+#endif
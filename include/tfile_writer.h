@@ -0,0 +1,66 @@
+#ifndef TFILEWRITER_H_INCLUDED
+#define TFILEWRITER_H_INCLUDED
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+// Default number of records which can be waiting to be written (it must be a power of two)
+// It should absorb the longest stall of the storage device: 65536 records take 1.5 MB
+#define TFILE_WRITER_DEFAULT_SIZE 65536
+// Size of the blocks written to the file with a single write()
+#define TFILE_WRITER_BLOCK_SIZE 65536
+// Sleep time of the writer thread when no record is waiting to be written (in us)
+#define TFILE_WRITER_IDLE_US 1000
+
+// fdatasync() policies (--w-sync)
+#define TFILE_WRITER_SYNC_NONE 0x00 // Leave the data in the page cache (as the synchronous writes do)
+#define TFILE_WRITER_SYNC_CLOSE 0x01 // fdatasync() once, when the writer is stopped
+#define TFILE_WRITER_SYNC_BLOCK 0x02 // fdatasync() after each block (from the writer thread only)
+
+// tFileWriterStart() errors
+#define TFILEWRITER_EINVAL -1 // The size is not a power of two
+#define TFILEWRITER_EMALLOC -2 // Memory allocation error
+#define TFILEWRITER_ETHREAD -3 // pthread_create() error
+
+// tFileWriterPush() errors
+#define TFILEWRITER_EFULL -1 // No free slot: the record has been dropped (and counted in 'dropped')
+
+typedef struct tFileRecord {
+	uint64_t seqNo;
+	uint64_t tripTime;
+	uint64_t tripTimeProc;
+} tFileRecord;
+
+// Asynchronous writer of the per-packet "-W" CSV file
+// The Rx loop only stores each record inside a lock-free single producer/single consumer ring, while a dedicated thread formats
+// the records and writes them in large blocks, so that no system call (and no disk stall) is added to the measurement path.
+// When the ring is full, the new records are dropped (never blocking the Rx loop), and counted.
+typedef struct tFileWriter {
+	tFileRecord *records;
+	uint32_t mask; // Number of records - 1
+
+	// Free running indices: 'head' is written by the producer only, 'tail' by the writer thread only (both atomic)
+	uint64_t head;
+	uint64_t tail;
+
+	int descriptor;
+	uint8_t followup_on_flag;
+	int decimal_digits;
+	uint8_t sync_policy; // TFILE_WRITER_SYNC_*
+
+	char *block; // Formatting buffer (TFILE_WRITER_BLOCK_SIZE bytes)
+
+	uint64_t dropped; // Records dropped because the ring was full (producer only)
+	uint64_t writeErrors; // Failed write() or fdatasync() calls (writer thread only, read after tFileWriterStop())
+
+	pthread_t tid;
+	uint8_t running; // 1 when the thread has been started and not stopped yet
+	int stop; // Set by tFileWriterStop() (atomic)
+} tFileWriter;
+
+int tFileWriterStart(tFileWriter *writer, int fd, uint8_t followup_on_flag, int decimal_digits, unsigned int size, uint8_t sync_policy);
+int tFileWriterPush(tFileWriter *writer, uint64_t seqNo, uint64_t tripTime, uint64_t tripTimeProc);
+void tFileWriterStop(tFileWriter *writer);
+
+#endif
@@ -3,6 +3,7 @@
 
 #include <poll.h>
 #include <inttypes.h>
+#include <time.h>
 #include <sys/timerfd.h>
 
 #define NO_FLAGS_TIMER 0
@@ -18,5 +19,15 @@
 #define MICROSEC_TO_NANOSEC 1000
 #define MICROSEC_TO_MILLISEC 1000
 
+// Absolute deadline transmission scheduler, used by the client Tx loops
+// Each deadline is computed as 'first deadline + k * interval_ns', thus a slow iteration never shifts the following ones
+typedef struct txScheduler {
+	struct timespec next_deadline; // Next absolute deadline (CLOCK_MONOTONIC)
+	uint64_t interval_ns; // Scheduling period (in ns)
+	uint64_t spin_ns; // Busy-wait window before each deadline (in ns - 0 means: sleep only)
+} txScheduler;
+
 int timerCreateAndSet(struct pollfd *timerMon, int *clockFd, uint64_t time_ms);
-#endif
\ No newline at end of file
+int txSchedulerInit(txScheduler *sched, uint64_t interval_ns, uint64_t spin_ns);
+int txSchedulerWaitNext(txScheduler *sched);
+#endif
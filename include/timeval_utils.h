@@ -2,24 +2,16 @@
 #define LATENCYTEST_TIMEVALUTILS_H_INCLUDED
 
 #include <sys/time.h>
+#include <stdint.h>
+#include <time.h>
 
 // "__attribute__((unused))" is added just to tell the clang compiler not to issue a warning
 // for an unused 'static inline' (which is actually used in multiple modules)
 static inline int timevalSub(struct timeval *in, struct timeval *out) __attribute__((unused));
-
-// timevalStoreList errors
-#define SL_NOTFOUND	3
-#define SL_EMPTY 	2
-#define SL_NOMEM 	1
-#define SL_NOERR 	0
-
-#define CHECK_SL_NULL(SL) (SL==NULL)
-
-typedef struct _timevalStoreList *timevalStoreList;
-timevalStoreList timevalSL_init();
-int timevalSL_insert(timevalStoreList SL, unsigned int seqNo, struct timeval stamp);
-int timevalSL_gather(timevalStoreList SL, unsigned int seqNo, struct timeval *stamp);
-void timevalSL_free(timevalStoreList SL);
+static inline uint64_t timevalToNs(const struct timeval *tv) __attribute__((unused));
+static inline uint64_t timespecToNs(const struct timespec *ts) __attribute__((unused));
+static inline struct timeval nsToTimeval(uint64_t ns) __attribute__((unused));
+static inline uint64_t realtimeNs(void) __attribute__((unused));
 
 // Calling the timeval structres in and out, as in iputils-ping code
 // This inline function will perform out = out - in
@@ -49,4 +41,33 @@ static inline int timevalSub(struct timeval *in, struct timeval *out) {
 	return original_out_tv_sec < in->tv_sec;
 }
 
-#endif
\ No newline at end of file
+// All the timestamps are handled, inside the program, as 64-bit nanosecond values: the conversion from struct timeval (e.g. the
+// timestamps carried inside the LaMP header) and struct timespec (kernel and hardware timestamps, clock_gettime()) is lossless
+static inline uint64_t timevalToNs(const struct timeval *tv) {
+	return (uint64_t) tv->tv_sec*1000000000ULL+(uint64_t) tv->tv_usec*1000ULL;
+}
+
+static inline uint64_t timespecToNs(const struct timespec *ts) {
+	return (uint64_t) ts->tv_sec*1000000000ULL+(uint64_t) ts->tv_nsec;
+}
+
+// Conversion to struct timeval, for the values which have to be written inside the LaMP header (rounded down to us)
+static inline struct timeval nsToTimeval(uint64_t ns) {
+	struct timeval tv;
+
+	tv.tv_sec=(time_t) (ns/1000000000ULL);
+	tv.tv_usec=(suseconds_t) ((ns%1000000000ULL)/1000ULL);
+
+	return tv;
+}
+
+// User space timestamp, with ns resolution (same clock as gettimeofday())
+static inline uint64_t realtimeNs(void) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_REALTIME,&now);
+
+	return timespecToNs(&now);
+}
+
+#endif
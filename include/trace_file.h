@@ -0,0 +1,98 @@
+#ifndef TRACEFILE_H_INCLUDED
+#define TRACEFILE_H_INCLUDED
+
+/* ----------------- Per-packet trace files ----------------- */
+// This module does not depend on the Rawsock library, so that it can also be used by the offline tools (see the 'tools' directory)
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Maximum length of a single packet line of the "-W" CSV file: 20 characters for the sequence number, up to 2 latency values
+// (doubles in ms, with W_DECIMAL_DIGITS decimal digits), the error flag and the separators (+ some margin)
+#define TFILE_RECORD_MAX_LEN 96
+
+// Binary trace format (--trace): a fixed size header, followed by fixed size records, all in host byte order
+#define TRACE_MAGIC "LaMPtrc" // 8 bytes, including the terminating '\0'
+#define TRACE_VERSION 1
+#define TRACE_BYTE_ORDER_MARK 0x01020304 // Read back as 0x04030201 when the trace has been written on a host with a different byte order
+
+// Test modes (header 'mode_ub' field), with the same values of modeub_t (see options.h)
+#define TRACE_MODE_UNSET 0 // Traces written before the mode was stored inside the header (they are all ping-like ones)
+#define TRACE_MODE_PINGLIKE 1
+#define TRACE_MODE_UNIDIR 2
+
+// Record flags
+#define TRACE_FLAG_ERROR 0x01 // Timestamping error: no latency can be computed for this packet
+#define TRACE_FLAG_FOLLOWUP 0x02 // 'proc_ns' carries the server processing time, reported by a follow-up message
+#define TRACE_FLAG_RELATIVE 0x04 // 'tx_ns' is 0 and 'rx_ns' is the difference between the rx and tx timestamps (follow-up mode)
+
+// traceFileCreate()/traceFileMap() errors
+#define TRACEFILE_EOPEN -1 // open() error
+#define TRACEFILE_EALLOC -2 // The file space cannot be allocated
+#define TRACEFILE_EMMAP -3 // mmap() error
+#define TRACEFILE_EFORMAT -4 // Not a (supported) trace file
+
+// traceFileAppend() errors
+#define TRACEFILE_EFULL -1 // The file cannot be extended: the record has been dropped (and counted in 'dropped')
+
+typedef struct traceHeader {
+	char magic[8]; // TRACE_MAGIC
+	uint16_t version; // TRACE_VERSION
+	uint16_t header_size; // sizeof(traceHeader)
+	uint16_t record_size; // sizeof(traceRecord)
+	uint8_t latency_type; // latencytypes_t (see options.h)
+	uint8_t clock_source; // clocksource_t (see options.h)
+	uint16_t lamp_id; // LaMP session id
+	uint16_t payload_len; // LaMP payload length (B)
+	uint8_t followup; // = 1 when the follow-up mode was active
+	uint8_t mode_ub; // TRACE_MODE_*
+	uint8_t reserved1[2];
+	uint32_t byte_order_mark; // TRACE_BYTE_ORDER_MARK
+	uint64_t total_packets; // Number of packets requested (-n)
+	uint64_t interval_ns; // Interval between packets (-t)
+	uint64_t start_realtime_ns; // Wall clock time (CLOCK_REALTIME) when the trace was created
+	uint64_t record_count; // Number of valid records, written when the trace is closed (0 = the trace was not closed properly)
+	uint32_t burst_size; // Packets sent for each interval (--burst) - 0 in the traces written before it was stored inside the header
+	uint8_t reserved2[4];
+} traceHeader;
+
+// 32 bytes per packet, i.e. about half of a CSV line carrying the same timestamps with ns resolution
+typedef struct traceRecord {
+	uint64_t seq; // Extended (64-bit) sequence number
+	uint64_t tx_ns; // Tx timestamp
+	uint64_t rx_ns; // Rx timestamp (or rx-tx difference, with TRACE_FLAG_RELATIVE)
+	uint32_t proc_ns; // Server processing time (TRACE_FLAG_FOLLOWUP only, otherwise 0), saturated to UINT32_MAX (about 4.3 s)
+	uint32_t flags; // TRACE_FLAG_*
+} traceRecord;
+
+// Trace being written: the file is preallocated and mapped in memory, so that each record is a plain store, with no system call
+typedef struct traceFile {
+	int descriptor;
+	traceHeader *header; // Start of the mapping
+	traceRecord *records;
+	uint64_t capacity; // Number of records which fit inside the current mapping
+	uint64_t count; // Number of records written so far
+	uint64_t dropped; // Records which could not be written, as the file could not be extended
+} traceFile;
+
+// Trace being read (read-only mapping)
+typedef struct traceFileReader {
+	const traceHeader *header;
+	const traceRecord *records;
+	uint64_t count; // Number of valid records
+	size_t map_size;
+} traceFileReader;
+
+int sprintTRecord(char *buf,size_t size,int followup_on_flag,int decimal_digits,uint64_t seqNo,uint64_t tripTime,uint64_t tripTimeProc);
+const char *tFileHeaderLine(int followup_on_flag);
+
+void traceHeaderInit(traceHeader *header);
+int traceFileCreate(traceFile *trace, const char *filename, const traceHeader *header, uint64_t capacity);
+int traceFileAppend(traceFile *trace, uint64_t seq, uint64_t tx_ns, uint64_t rx_ns, uint64_t proc_ns, uint32_t flags);
+void traceFileClose(traceFile *trace);
+
+int traceFileMap(traceFileReader *reader, const char *filename);
+uint64_t traceRecordTripTime(const traceRecord *record);
+void traceFileUnmap(traceFileReader *reader);
+
+#endif
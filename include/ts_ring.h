@@ -0,0 +1,42 @@
+#ifndef TSRING_H_INCLUDED
+#define TSRING_H_INCLUDED
+
+#include <stdint.h>
+
+// Default number of slots: it bounds the number of timestamps which can be waiting for their reply (or follow-up) at the same time
+// It must be a power of two, not larger than TS_RING_MAX_SIZE
+#define TS_RING_DEFAULT_SIZE 4096
+// Maximum number of slots, equal to the number of different (16 bit) LaMP sequence numbers
+#define TS_RING_MAX_SIZE 65536
+
+// tsRingInit() errors
+#define TSRING_EINVAL -1 // The size is not a power of two, or it is larger than TS_RING_MAX_SIZE
+#define TSRING_EMALLOC -2 // Memory allocation error
+
+// tsRingGather() errors
+#define TSRING_ENOTFOUND -1 // No timestamp stored for the requested sequence number (never inserted, already gathered or overwritten)
+
+// Slot tag: the full sequence number of the stored timestamp, plus a "valid" bit (0 means: empty slot)
+// As the slot index is given only by the lower bits of the sequence number, the higher ones act as a generation tag, allowing
+// stale entries (e.g. the ones of lost replies, overwritten after the sequence numbers wrap around the ring) to be detected
+#define TS_RING_TAG_VALID (1U<<16)
+
+typedef struct tsRingSlot {
+	uint32_t tag;
+	uint64_t stamp_ns;
+} tsRingSlot;
+
+// Preallocated ring of 64-bit (ns) timestamps, indexed by LaMP sequence number
+// Insertions and lookups are constant-time and allocation-free, and the memory is bounded even when many replies are lost
+// A single thread can insert while another one gathers, without any lock: each slot is published with a release store of its tag
+typedef struct tsRing {
+	tsRingSlot *slots;
+	uint32_t mask; // Number of slots - 1
+} tsRing;
+
+int tsRingInit(tsRing *ring, unsigned int size);
+void tsRingInsert(tsRing *ring, uint16_t seqNo, uint64_t stamp_ns);
+int tsRingGather(tsRing *ring, uint16_t seqNo, uint64_t *stamp_ns);
+void tsRingFree(tsRing *ring);
+
+#endif
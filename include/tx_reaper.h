@@ -0,0 +1,48 @@
+#ifndef TXREAPER_H_INCLUDED
+#define TXREAPER_H_INCLUDED
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include "rawsock.h"
+#include "ts_ring.h"
+
+// How the timestamps read from the error queue are matched to the LaMP sequence numbers
+#define TXREAPER_MATCH_ID 0x00 // SOF_TIMESTAMPING_OPT_ID key (no packet is looped back, thanks to SOF_TIMESTAMPING_OPT_TSONLY)
+#define TXREAPER_MATCH_PAYLOAD 0x01 // Sequence number parsed from the looped-back packet
+
+// Timeout of each poll() on the error queue, bounding the time needed by txReaperStop() to stop the thread (in ms)
+#define TXREAPER_POLL_TIMEOUT 20
+
+// txReaperStart() errors
+#define TXREAPER_EMALLOC -1 // Memory allocation error
+#define TXREAPER_ETHREAD -2 // pthread_create() error
+
+// txReaperGather() errors
+#define TXREAPER_ENOTFOUND -1 // No tx timestamp has been (or will be) reaped for the requested sequence number
+
+// Asynchronous tx timestamp reaper
+// A dedicated thread drains the socket error queue and stores each tx timestamp inside 'ring', indexed by sequence number,
+// so that the Tx loop never waits for the timestamp completion of the packet it has just sent. The Rx loop then gathers
+// the tx timestamps with txReaperGather(), without any lock: the ring is already safe with one inserting thread.
+typedef struct txReaper {
+	int descriptor; // Socket descriptor
+	tsRing *ring; // Ring in which the tx timestamps are stored
+
+	uint8_t match; // TXREAPER_MATCH_ID or TXREAPER_MATCH_PAYLOAD
+	uint8_t ts_idx; // Index inside struct scm_timestamping (0: software, 2: hardware)
+
+	byte_t *buf; // Buffer for the looped-back packets (TXREAPER_MATCH_PAYLOAD only)
+	size_t buf_size;
+
+	pthread_t tid;
+	uint8_t running; // 1 when the thread has been started and not stopped yet
+	int stop; // Set by txReaperStop() (atomic)
+	int32_t last_seq; // Sequence number of the last reaped tx timestamp, -1 if none yet (atomic)
+} txReaper;
+
+int txReaperStart(txReaper *reaper, int sFd, tsRing *ring, uint8_t match, uint8_t hw, size_t buf_size);
+int txReaperGather(txReaper *reaper, uint16_t seqNo, uint64_t *stamp_ns, uint64_t timeout_ms);
+void txReaperStop(txReaper *reaper);
+
+#endif
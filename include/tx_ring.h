@@ -0,0 +1,43 @@
+#ifndef TXRING_H_INCLUDED
+#define TXRING_H_INCLUDED
+
+#include <stddef.h>
+#include <linux/if_packet.h>
+#include "rawsock.h"
+
+// Minimum number of frames inside the TX ring (the ring is made larger when more frames are needed for a single burst)
+#define TX_RING_MIN_FRAMES 256
+// Maximum time to wait for a free TX ring slot before returning an error (in ms)
+#define TX_RING_SLOT_WAIT_TIMEOUT 100
+
+// txRingCreate() errors
+#define TXRING_ESOCKET -1 // socket() error
+#define TXRING_ESETSOCKOPT -2 // setsockopt() error (PACKET_VERSION, PACKET_TX_RING, PACKET_QDISC_BYPASS or SO_PRIORITY)
+#define TXRING_EMMAP -3 // mmap() error
+#define TXRING_EBIND -4 // bind() error
+
+// txRingWrite() errors
+#define TXRING_ETOOBIG -1 // Frame larger than a ring slot
+#define TXRING_EFULL -2 // No slot was released by the kernel within TX_RING_SLOT_WAIT_TIMEOUT
+
+// PACKET_MMAP (TPACKET_V2) transmit ring
+// A dedicated AF_PACKET socket, with protocol = 0, is used, so that it never receives any frame: the
+// reception still takes place on the socket created in LatencyTester.c
+typedef struct txRing {
+	int descriptor; // TX ring socket descriptor
+	struct sockaddr_ll addrll; // Destination address, used when flushing the ring
+
+	byte_t *map; // mmap()'ed ring
+	size_t map_size; // Total ring size (in bytes)
+
+	unsigned int frame_size; // Size of each slot (in bytes, including the struct tpacket2_hdr)
+	unsigned int frame_nr; // Number of slots
+	unsigned int frame_idx; // Next slot to be written
+} txRing;
+
+int txRingCreate(txRing *ring, struct sockaddr_ll addrll, size_t max_frame_len, unsigned int min_frame_nr, int qdisc_bypass, int priority);
+int txRingWrite(txRing *ring, byte_t *frame, size_t len);
+int txRingFlush(txRing *ring);
+void txRingDestroy(txRing *ring);
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef XDPSOCK_H_INCLUDED
+#define XDPSOCK_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <netinet/in.h>
+#include "rawsock.h"
+
+// UMEM geometry: XDP_SOCK_FRAME_NR frames of XDP_SOCK_FRAME_SIZE bytes each (8 MiB in total)
+// The first XDP_SOCK_RX_FRAME_NR frames are used for reception (fill ring), the remaining ones for transmission
+#define XDP_SOCK_FRAME_SIZE 2048
+#define XDP_SOCK_FRAME_NR 4096
+#define XDP_SOCK_RX_FRAME_NR (XDP_SOCK_FRAME_NR/2)
+#define XDP_SOCK_TX_FRAME_NR (XDP_SOCK_FRAME_NR-XDP_SOCK_RX_FRAME_NR)
+// Number of descriptors in each ring (fill, completion, RX and TX): it must be a power of 2, not smaller than the number of RX and TX frames
+#define XDP_SOCK_RING_SIZE 2048
+// Maximum time to wait for a TX frame to be released by the kernel before returning an error (in ms)
+#define XDP_SOCK_TX_WAIT_TIMEOUT 100
+
+// xdpSockCreate() errors
+#define XDPSOCK_ESOCKET -1 // socket() error
+#define XDPSOCK_EUMEM -2 // UMEM allocation (mmap()) or registration (XDP_UMEM_REG) error
+#define XDPSOCK_ESETSOCKOPT -3 // setsockopt()/getsockopt() error (ring sizes or XDP_MMAP_OFFSETS)
+#define XDPSOCK_EMMAP -4 // mmap() error (rings)
+#define XDPSOCK_EBIND -5 // bind() error (interface or queue not supporting AF_XDP)
+#define XDPSOCK_EMAP -6 // XSKMAP creation or update error
+#define XDPSOCK_EPROG -7 // XDP program load error (rejected by the verifier or generated program too long)
+#define XDPSOCK_EATTACH -8 // XDP program attach error (BPF_LINK_CREATE, kernel >= 5.9 required)
+
+// xdpSockSend() errors
+#define XDPSOCK_ETOOBIG -1 // Frame larger than a UMEM frame
+#define XDPSOCK_EFULL -2 // No TX frame was released by the kernel within XDP_SOCK_TX_WAIT_TIMEOUT
+#define XDPSOCK_ESEND -3 // sendto() error, when waking up the kernel to transmit the frame
+
+// Maximum number of sessions which can be stored inside the reflector session map
+#define XDP_REFLECT_MAX_SESSIONS 64
+
+// xdpReflectorCreate() errors
+#define XDPREFLECT_EMAP -1 // Session map creation or update error
+#define XDPREFLECT_EPROG -2 // XDP program load error (rejected by the verifier or generated program too long)
+#define XDPREFLECT_EATTACH -3 // XDP program attach error (BPF_LINK_CREATE, kernel >= 5.9 required)
+
+// Single producer/single consumer ring shared with the kernel
+typedef struct xdpSockRing {
+	uint32_t *producer;
+	uint32_t *consumer;
+	void *desc; // Ring entries: UMEM addresses (uint64_t) for the fill and completion rings, struct xdp_desc for the RX and TX rings
+	uint32_t mask; // Ring size - 1
+
+	void *map; // mmap()'ed ring
+	size_t map_size; // Total ring size (in bytes)
+} xdpSockRing;
+
+// AF_XDP socket, bound to a single queue of an interface, with its own UMEM and a minimal XDP program redirecting to it
+// all the IPv4/UDP frames directed to a given address and port: every other frame keeps going through the kernel network stack,
+// so that the control packets can still be exchanged through the AF_PACKET socket created in LatencyTester.c, until this socket is created.
+// The program is attached in generic (SKB) mode and the socket is bound in copy mode, so that any interface (including veth
+// pairs) can be used, without requiring any native XDP/zero-copy support by the NIC driver.
+// The RX/fill rings and the TX/completion rings can be used by two different threads (one receiving and one transmitting).
+typedef struct xdpSock {
+	int descriptor; // AF_XDP socket descriptor (-1 if the socket is not active)
+	int timeout_ms; // Receive timeout (read from SO_RCVTIMEO) - -1 means: no timeout
+
+	byte_t *umem; // UMEM area, shared with the kernel
+	size_t umem_size; // Total UMEM size (in bytes)
+
+	xdpSockRing fill;
+	xdpSockRing comp;
+	xdpSockRing rx;
+	xdpSockRing tx;
+
+	uint64_t tx_free[XDP_SOCK_TX_FRAME_NR]; // UMEM addresses of the TX frames which can be written by user space
+	unsigned int tx_free_nr; // Number of elements in 'tx_free'
+
+	uint64_t rx_addr; // UMEM address of the received frame currently owned by user space
+	uint8_t rx_held; // =1 if a received frame is currently owned by user space (it is given back to the kernel at the next xdpSockRecv())
+
+	int map_fd; // XSKMAP file descriptor
+	int prog_fd; // XDP program file descriptor
+	int link_fd; // BPF link file descriptor (the program is detached as soon as it is closed)
+} xdpSock;
+
+// In-kernel ping-like reflector: an XDP program, attached in generic (SKB) mode, which replies to the ping-like requests
+// (PINGLIKE_REQ and PINGLIKE_REQ_TLESS) directed to a given address and port, and belonging to one of the sessions stored inside
+// a BPF hash map, by swapping the addresses and ports, rewriting the LaMP control field and sending back the frame (XDP_TX).
+// Every other frame (including INIT, follow-up control and end requests) goes on through the kernel network stack, up to the
+// AF_PACKET socket of the raw server. For each session, the map stores the number of requests which have been reflected.
+typedef struct xdpReflector {
+	int map_fd; // Session map file descriptor (key: session id, as stored inside the LaMP header - value: number of reflected requests)
+	int prog_fd; // XDP program file descriptor
+	int link_fd; // BPF link file descriptor (the program is detached as soon as it is closed)
+} xdpReflector;
+
+int xdpSockCreate(xdpSock *xsk, int sFd, int ifindex, unsigned int queue_id, struct in_addr dstIP, uint16_t port);
+ssize_t xdpSockRecv(xdpSock *xsk, byte_t **frame);
+int xdpSockSend(xdpSock *xsk, byte_t *frame, size_t len);
+void xdpSockDestroy(xdpSock *xsk);
+
+int xdpReflectorCreate(xdpReflector *xrf, int ifindex, struct in_addr dstIP, uint16_t port, uint16_t session_id);
+uint64_t xdpReflectorGetCount(xdpReflector *xrf, uint16_t session_id);
+void xdpReflectorDestroy(xdpReflector *xrf);
+
+#endif
@@ -12,6 +12,9 @@
 #include <linux/wireless.h>
 #include <signal.h>
 #include "common_socket_man.h"
+#include "clock_source.h"
+#include "stats_page.h"
+#include "report_manager.h"
 #include <errno.h>
 
 static volatile sig_atomic_t end_prog_flag=0;
@@ -36,6 +39,9 @@ int main (int argc, char **argv) {
 	int ifindex;
 	struct in_addr srcIPaddr;
 
+	// statsPageOpen() return value (--shm-stats only)
+	int stats_page_ret;
+
 	/* Socket management structure (containing a socket descriptor and a struct sockaddr_ll, see rawsock_lamp.h) */
 	struct lampsock_data sData;
 
@@ -59,8 +65,8 @@ int main (int argc, char **argv) {
 		wlanLookupIdx=opts.if_index;
 	}
 
-	// Allocate memory for the source MAC address (only if 'RAW' is specified)
-	if(opts.mode_raw==RAW) {
+	// Allocate memory for the source MAC address (only if 'RAW' or 'XDP' is specified)
+	if(opts.mode_raw!=NON_RAW) {
 		srcmacaddr=prepareMacAddrT();
 		if(macAddrTypeGet(srcmacaddr)==MAC_NULL) {
 			fprintf(stderr,"Error: could not allocate memory to store the source MAC address.\n");
@@ -78,7 +84,7 @@ int main (int argc, char **argv) {
 		exit(EXIT_FAILURE);
 	}
 
-	if(opts.mode_raw==RAW) {
+	if(opts.mode_raw!=NON_RAW) {
 		if(opts.destIPaddr.s_addr==srcIPaddr.s_addr) {
 		fprintf(stderr,"Error: you cannot test yourself in raw mode.\n"
 			"Use non raw sockets instead.\n");
@@ -100,6 +106,27 @@ int main (int argc, char **argv) {
 		options_set_destIPaddr(&opts,srcIPaddr);
 	}
 
+	// Select the clock source for the user space timestamps (the TSC, if requested, is calibrated now, once for all the sessions)
+	if(opts.clock_source!=CLOCKSRC_REALTIME && clockSourceInit(opts.clock_source)<0) {
+		fprintf(stderr,"Warning: the invariant TSC is not available on this CPU, or it cannot be calibrated.\n\tSwitching back to CLOCK_MONOTONIC_RAW.\n");
+		opts.clock_source=CLOCKSRC_MONORAW;
+		clockSourceInit(CLOCKSRC_MONORAW);
+	}
+
+	// Create the live statistics page, which is kept across all the sessions of a daemon server (--shm-stats only)
+	if(opts.shm_stats_name!=NULL) {
+		stats_page_ret=statsPageOpen(opts.shm_stats_name,(opts.mode_cs==SERVER || opts.mode_cs==LOOPBACK_SERVER) ? STATSPAGE_ROLE_SERVER : STATSPAGE_ROLE_CLIENT);
+
+		if(stats_page_ret==STATSPAGE_ENAME) {
+			fprintf(stderr,"Warning: invalid shared memory segment name: %s.\n\tThe '--shm-stats' option will be disabled.\n",opts.shm_stats_name);
+		} else if(stats_page_ret==STATSPAGE_EEXIST) {
+			fprintf(stderr,"Warning: the shared memory segment %s is already used by another running process.\n\tThe '--shm-stats' option will be disabled.\n",opts.shm_stats_name);
+		} else if(stats_page_ret<0) {
+			perror("statsPageOpen() error");
+			fprintf(stderr,"Warning: cannot create the shared memory segment %s (error code: %d).\n\tThe '--shm-stats' option will be disabled.\n",opts.shm_stats_name,stats_page_ret);
+		}
+	}
+
 	// Print an info message when in continuous daemon mode
 	if(opts.dmode) {
 		fprintf(stdout,"The server will run in continuous mode. You can terminate it by calling 'kill -s USR1 <pid>'\n"
@@ -114,6 +141,7 @@ int main (int argc, char **argv) {
 		// Open socket, discriminating the raw and non raw cases
 		switch(opts.mode_raw) {
 			case RAW:
+			case XDP: // In AF_XDP mode, the raw socket is used for the control packets (the AF_XDP socket is created by the raw client/server)
 				// Workaraound for hardware receive timestamps: ETH_P_ALL does not seem to generate
 				// receive timestamps, as of now. So, as UDP only is currently supported, use ETH_P_IP
 				// instead of ETH_P_ALL. This will hopefully change in the future.
@@ -214,7 +242,7 @@ int main (int argc, char **argv) {
 			// Client is who sends packets
 			case CLIENT:
 			case LOOPBACK_CLIENT:
-				if(opts.mode_raw == RAW ? runUDPclient_raw(sData, srcmacaddr, srcIPaddr, &opts) : runUDPclient(sData, &opts)) {
+				if(opts.mode_raw != NON_RAW ? runUDPclient_raw(sData, srcmacaddr, srcIPaddr, &opts) : runUDPclient(sData, &opts)) {
 					close(sData.descriptor);
 					exit(EXIT_FAILURE);
 				}
@@ -222,7 +250,7 @@ int main (int argc, char **argv) {
 			// Server is who replies to packets
 			case SERVER:
 			case LOOPBACK_SERVER:
-				if(opts.mode_raw == RAW ? runUDPserver_raw(sData, srcmacaddr, srcIPaddr, &opts) : runUDPserver(sData, &opts)) {
+				if(opts.mode_raw != NON_RAW ? runUDPserver_raw(sData, srcmacaddr, srcIPaddr, &opts) : runUDPserver(sData, &opts)) {
 					close(sData.descriptor);
 					exit(EXIT_FAILURE);
 				}
@@ -248,6 +276,13 @@ int main (int argc, char **argv) {
 		close(sData.descriptor);
 	} while(opts.dmode && !end_prog_flag && (opts.mode_cs==SERVER || opts.mode_cs==LOOPBACK_SERVER));  // Continuosly run the server if the 'continuous daemon mode' is selected (a new socket will be created for each new session)
 
+	statsPageClose();
+
+	// In continuous daemon mode, print the statistics of all the unidirectional sessions
+	if(opts.dmode) {
+		printSessionsStats(stdout,opts.confidenceIntervalMask);
+	}
+
 	fprintf(stdout,"\nProgram terminated.\n");
 
 	if(srcmacaddr) freeMacAddrT(srcmacaddr);
@@ -0,0 +1,135 @@
+#include "bpf_filter.h"
+#include <stddef.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <net/ethernet.h>
+#include <linux/filter.h>
+#include <linux/if_packet.h>
+#include <arpa/inet.h>
+#include "rawsock_lamp.h"
+
+// Offsets (from the beginning of the Ethernet frame) of the fields checked by the filter
+#define ETH_TYPE_OFF 12
+#define IP_OFF 14
+#define IP_FRAG_OFF (IP_OFF+6)
+#define IP_PROTO_OFF (IP_OFF+9)
+#define IP_DADDR_OFF (IP_OFF+16)
+// The following offsets are relative to the end of the IP header (whose length is loaded into X)
+#define UDP_DPORT_OFF (IP_OFF+2)
+#define LAMP_OFF (IP_OFF+8)
+
+// IP fragment offset mask: only the first fragment (or an unfragmented datagram) carries the UDP and LaMP headers
+#define IP_FRAG_MASK 0x1FFF
+
+// Placeholder jump offset, replaced with the actual offset to the "drop" instruction once the whole program is generated
+#define JUMP_TO_DROP 0xFF
+
+// All the LaMP packet types which may be received on the raw socket (data and control packets)
+static const lamptype_t lampTypes[]={PINGLIKE_REQ,PINGLIKE_REPLY,PINGLIKE_ENDREQ,PINGLIKE_ENDREPLY,UNIDIR_CONTINUE,UNIDIR_STOP,REPORT,ACK,INIT,
+	PINGLIKE_REQ_TLESS,PINGLIKE_REPLY_TLESS,PINGLIKE_ENDREQ_TLESS,PINGLIKE_ENDREPLY_TLESS,FOLLOWUP_CTRL,FOLLOWUP_DATA};
+
+static inline int bpfEmit(struct sock_filter *prog, unsigned int *len, uint16_t code, uint8_t jt, uint8_t jf, uint32_t k) {
+	if(*len>=BPF_FILTER_MAX_LEN) {
+		return -1;
+	}
+
+	prog[*len].code=code;
+	prog[*len].jt=jt;
+	prog[*len].jf=jf;
+	prog[*len].k=k;
+	(*len)++;
+
+	return 0;
+}
+
+/* Generate and attach (replacing any previously attached one) a classic BPF program accepting only incoming IPv4/UDP LaMP
+frames directed to 'dstIP' and to the UDP port 'port' (in host byte order). If 'match_id' is = BPF_FILTER_SESSION_ID, only the
+LaMP packets with id = 'session_id' are accepted.
+The LaMP signature (reserved field) and the valid ctrl values are read from the Rawsock library itself, through lampHeadPopulate()
+and TYPE_TO_CTRL(), so that the filter always stays consistent with the checks performed in user space (IS_LAMP()).
+Return values:
+0: ok
+<0: error (see the BPFFILTER_E* macros in bpf_filter.h)
+*/
+int bpfFilterAttach(int sFd, struct in_addr dstIP, uint16_t port, int match_id, uint16_t session_id) {
+	struct sock_filter prog[BPF_FILTER_MAX_LEN];
+	struct sock_fprog fprog;
+	unsigned int len=0;
+	unsigned int ctrlNum=sizeof(lampTypes)/sizeof(lampTypes[0]);
+	struct lamphdr lampHeader;
+	byte_t *lampHeaderBytes=(byte_t *) &lampHeader;
+	int err=0;
+
+	// Get the LaMP reserved field and the session id, as they are stored inside the packets
+	lampHeadPopulate(&lampHeader, TYPE_TO_CTRL(INIT), session_id, 0);
+
+	// Drop outgoing frames (i.e. the ones sent by this same host)
+	err|=bpfEmit(prog,&len,BPF_LD | BPF_B | BPF_ABS,0,0,SKF_AD_OFF+SKF_AD_PKTTYPE);
+	err|=bpfEmit(prog,&len,BPF_JMP | BPF_JEQ | BPF_K,JUMP_TO_DROP,0,PACKET_OUTGOING);
+
+	// IPv4, UDP, not a fragment
+	err|=bpfEmit(prog,&len,BPF_LD | BPF_H | BPF_ABS,0,0,ETH_TYPE_OFF);
+	err|=bpfEmit(prog,&len,BPF_JMP | BPF_JEQ | BPF_K,0,JUMP_TO_DROP,ETHERTYPE_IP);
+	err|=bpfEmit(prog,&len,BPF_LD | BPF_B | BPF_ABS,0,0,IP_PROTO_OFF);
+	err|=bpfEmit(prog,&len,BPF_JMP | BPF_JEQ | BPF_K,0,JUMP_TO_DROP,IPPROTO_UDP);
+	err|=bpfEmit(prog,&len,BPF_LD | BPF_H | BPF_ABS,0,0,IP_FRAG_OFF);
+	err|=bpfEmit(prog,&len,BPF_JMP | BPF_JSET | BPF_K,JUMP_TO_DROP,0,IP_FRAG_MASK);
+
+	// Destination IP address (own address)
+	err|=bpfEmit(prog,&len,BPF_LD | BPF_W | BPF_ABS,0,0,IP_DADDR_OFF);
+	err|=bpfEmit(prog,&len,BPF_JMP | BPF_JEQ | BPF_K,0,JUMP_TO_DROP,ntohl(dstIP.s_addr));
+
+	// X = IP header length
+	err|=bpfEmit(prog,&len,BPF_LDX | BPF_B | BPF_MSH,0,0,IP_OFF);
+
+	// UDP destination port
+	err|=bpfEmit(prog,&len,BPF_LD | BPF_H | BPF_IND,0,0,UDP_DPORT_OFF);
+	err|=bpfEmit(prog,&len,BPF_JMP | BPF_JEQ | BPF_K,0,JUMP_TO_DROP,port);
+
+	// LaMP signature: reserved field and any valid ctrl value
+	err|=bpfEmit(prog,&len,BPF_LD | BPF_B | BPF_IND,0,0,LAMP_OFF+offsetof(struct lamphdr,reserved));
+	err|=bpfEmit(prog,&len,BPF_JMP | BPF_JEQ | BPF_K,0,JUMP_TO_DROP,lampHeaderBytes[offsetof(struct lamphdr,reserved)]);
+	err|=bpfEmit(prog,&len,BPF_LD | BPF_B | BPF_IND,0,0,LAMP_OFF+offsetof(struct lamphdr,ctrl));
+	for(unsigned int i=0;i<ctrlNum;i++) {
+		// On match, jump after the last comparison, otherwise go on with the next one (or drop, if this is the last one)
+		err|=bpfEmit(prog,&len,BPF_JMP | BPF_JEQ | BPF_K,ctrlNum-1-i,i==ctrlNum-1 ? JUMP_TO_DROP : 0,(uint8_t) TYPE_TO_CTRL(lampTypes[i]));
+	}
+
+	// LaMP session id (loaded as stored inside the packet, i.e. as a big endian 16 bit value)
+	if(match_id==BPF_FILTER_SESSION_ID) {
+		err|=bpfEmit(prog,&len,BPF_LD | BPF_H | BPF_IND,0,0,LAMP_OFF+offsetof(struct lamphdr,id));
+		err|=bpfEmit(prog,&len,BPF_JMP | BPF_JEQ | BPF_K,0,JUMP_TO_DROP,
+			(uint32_t) lampHeaderBytes[offsetof(struct lamphdr,id)]<<8 | lampHeaderBytes[offsetof(struct lamphdr,id)+1]);
+	}
+
+	err|=bpfEmit(prog,&len,BPF_RET | BPF_K,0,0,BPF_FILTER_ACCEPT);
+	err|=bpfEmit(prog,&len,BPF_RET | BPF_K,0,0,0);
+
+	if(err) {
+		return BPFFILTER_ETOOLONG;
+	}
+
+	// Resolve the jumps to the last ("drop") instruction
+	for(unsigned int i=0;i<len-1;i++) {
+		if(BPF_CLASS(prog[i].code)!=BPF_JMP) {
+			continue;
+		}
+
+		if(prog[i].jt==JUMP_TO_DROP) {
+			prog[i].jt=len-1-(i+1);
+		}
+
+		if(prog[i].jf==JUMP_TO_DROP) {
+			prog[i].jf=len-1-(i+1);
+		}
+	}
+
+	fprog.len=len;
+	fprog.filter=prog;
+
+	if(setsockopt(sFd,SOL_SOCKET,SO_ATTACH_FILTER,&fprog,sizeof(fprog))!=0) {
+		return BPFFILTER_ESETSOCKOPT;
+	}
+
+	return 0;
+}
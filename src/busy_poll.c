@@ -0,0 +1,201 @@
+// pthread_setaffinity_np() is Linux-specific: _GNU_SOURCE is required in order to get its declaration
+#define _GNU_SOURCE
+#include "busy_poll.h"
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/time.h>
+#include "timer_man.h"
+#include "timeval_utils.h"
+
+// SO_PREFER_BUSY_POLL is available only starting from Linux 5.11 (and in the corresponding headers)
+#ifndef SO_PREFER_BUSY_POLL
+#define SO_PREFER_BUSY_POLL 69
+#endif
+
+/* Prepare the socket 'sFd' for busy polling, with a kernel busy polling budget of 'budget_us' microseconds for each receive call.
+The receive timeout currently set with SO_RCVTIMEO is applied to busyPollRecvmsg()/busyPollRecvfrom() too, as a deadline.
+SO_PREFER_BUSY_POLL is requested too, when available, not to have the NIC interrupts re-enabled while the socket is spinning.
+Even when an error is returned, 'bp' can still be used to spin on non-blocking receives (without any kernel busy polling).
+Return values:
+0: ok
+<0: error (see the BUSYPOLL_E* macros in busy_poll.h)
+*/
+int busyPollCreate(busyPoll *bp, int sFd, unsigned int budget_us) {
+	struct timeval rcvtimeo;
+	socklen_t rcvtimeoLen=sizeof(rcvtimeo);
+	int busy_poll_val=(int) budget_us;
+	int prefer_val=1;
+
+	bp->descriptor=sFd;
+
+	if(getsockopt(sFd,SOL_SOCKET,SO_RCVTIMEO,&rcvtimeo,&rcvtimeoLen)==0 && (rcvtimeo.tv_sec!=0 || rcvtimeo.tv_usec!=0)) {
+		bp->timeout_ns=(uint64_t) rcvtimeo.tv_sec*SEC_TO_NANOSEC+(uint64_t) rcvtimeo.tv_usec*MICROSEC_TO_NANOSEC;
+	} else {
+		bp->timeout_ns=0;
+	}
+
+	if(setsockopt(sFd,SOL_SOCKET,SO_BUSY_POLL,&busy_poll_val,sizeof(busy_poll_val))!=0) {
+		return BUSYPOLL_ESETSOCKOPT;
+	}
+
+	// Failures are not fatal (kernels older than 5.11)
+	setsockopt(sFd,SOL_SOCKET,SO_PREFER_BUSY_POLL,&prefer_val,sizeof(prefer_val));
+
+	return 0;
+}
+
+/* Spin on non-blocking recvmsg() calls until a datagram is received or the deadline (SO_RCVTIMEO) expires.
+Return values (as recvmsg()):
+>=0: datagram length
+-1: error (errno is set to EAGAIN if the deadline expired)
+*/
+ssize_t busyPollRecvmsg(busyPoll *bp, struct msghdr *mhdr) {
+	struct timespec now;
+	uint64_t deadline_ns=0;
+	ssize_t rcv_bytes;
+
+	if(bp->timeout_ns>0) {
+		clock_gettime(CLOCK_MONOTONIC,&now);
+		deadline_ns=timespecToNs(&now)+bp->timeout_ns;
+	}
+
+	while(1) {
+		rcv_bytes=recvmsg(bp->descriptor,mhdr,MSG_DONTWAIT);
+
+		if(rcv_bytes>=0 || (errno!=EAGAIN && errno!=EWOULDBLOCK && errno!=EINTR)) {
+			return rcv_bytes;
+		}
+
+		if(deadline_ns>0) {
+			clock_gettime(CLOCK_MONOTONIC,&now);
+			if(timespecToNs(&now)>=deadline_ns) {
+				errno=EAGAIN;
+				return -1;
+			}
+		}
+	}
+}
+
+// Same as busyPollRecvmsg(), with the same arguments as recvfrom() (without flags)
+ssize_t busyPollRecvfrom(busyPoll *bp, void *buf, size_t len, struct sockaddr *addr, socklen_t *addrlen) {
+	struct msghdr mhdr;
+	struct iovec iov;
+	ssize_t rcv_bytes;
+
+	iov.iov_base=buf;
+	iov.iov_len=len;
+
+	memset(&mhdr,0,sizeof(mhdr));
+	mhdr.msg_name=addr;
+	mhdr.msg_namelen=addrlen!=NULL ? *addrlen : 0;
+	mhdr.msg_iov=&iov;
+	mhdr.msg_iovlen=1;
+
+	rcv_bytes=busyPollRecvmsg(bp,&mhdr);
+
+	if(rcv_bytes>=0 && addrlen!=NULL) {
+		*addrlen=mhdr.msg_namelen;
+	}
+
+	return rcv_bytes;
+}
+
+/* Pin the calling thread to the CPU 'cpu', so that the spinning receive loop gets a dedicated core.
+If 'oldAffinity' is not NULL, the current affinity of the thread is saved inside it, to be restored with busyPollRestoreAffinity()
+(e.g. at the end of a daemon server session, when the next session may not use --busy-poll-cpu).
+Return values:
+0: ok
+<0: error (see the BUSYPOLL_E* macros in busy_poll.h)
+*/
+int busyPollPinThread(int cpu, cpu_set_t *oldAffinity) {
+	cpu_set_t cpuset;
+	int affinity_ret;
+
+	if(oldAffinity!=NULL) {
+		affinity_ret=pthread_getaffinity_np(pthread_self(),sizeof(cpu_set_t),oldAffinity);
+		if(affinity_ret!=0) {
+			errno=affinity_ret;
+			return BUSYPOLL_EAFFINITY;
+		}
+	}
+
+	CPU_ZERO(&cpuset);
+	CPU_SET(cpu,&cpuset);
+
+	affinity_ret=pthread_setaffinity_np(pthread_self(),sizeof(cpuset),&cpuset);
+	if(affinity_ret!=0) {
+		errno=affinity_ret;
+		return BUSYPOLL_EAFFINITY;
+	}
+
+	return 0;
+}
+
+void busyPollRestoreAffinity(const cpu_set_t *oldAffinity) {
+	pthread_setaffinity_np(pthread_self(),sizeof(cpu_set_t),oldAffinity);
+}
+
+// Request nanosecond software receive timestamps (SO_TIMESTAMPNS) on 'sFd', to compute the host receive delay
+// Return values: 0 (ok) or -1 (setsockopt() error)
+int hostRxDelayEnable(int sFd) {
+	int enable=1;
+
+	return setsockopt(sFd,SOL_SOCKET,SO_TIMESTAMPNS,&enable,sizeof(enable));
+}
+
+void hostRxDelayInit(hostRxDelay *delay) {
+	delay->min_ns=UINT64_MAX;
+	delay->max_ns=0;
+	delay->sum_ns=0;
+	delay->count=0;
+	delay->errors=0;
+}
+
+// Update the statistics with the delay between the SO_TIMESTAMPNS timestamp stored inside 'mhdr' and 'user_ts'
+// ('user_ts' must be a CLOCK_REALTIME timestamp, taken as soon as the datagram was returned by the receive call)
+void hostRxDelayUpdate(hostRxDelay *delay, struct msghdr *mhdr, struct timespec *user_ts) {
+	struct cmsghdr *cmsg;
+	struct timespec *krn_ts=NULL;
+	uint64_t delay_ns;
+
+	for(cmsg=CMSG_FIRSTHDR(mhdr);cmsg!=NULL;cmsg=CMSG_NXTHDR(mhdr,cmsg)) {
+		if(cmsg->cmsg_level==SOL_SOCKET && cmsg->cmsg_type==SCM_TIMESTAMPNS) {
+			krn_ts=(struct timespec *) CMSG_DATA(cmsg);
+		}
+	}
+
+	if(krn_ts==NULL || timespecToNs(krn_ts)>timespecToNs(user_ts)) {
+		delay->errors++;
+		return;
+	}
+
+	delay_ns=timespecToNs(user_ts)-timespecToNs(krn_ts);
+
+	if(delay_ns<delay->min_ns) {
+		delay->min_ns=delay_ns;
+	}
+	if(delay_ns>delay->max_ns) {
+		delay->max_ns=delay_ns;
+	}
+	delay->sum_ns+=delay_ns;
+	delay->count++;
+}
+
+void hostRxDelayPrint(FILE *stream, hostRxDelay *delay, uint8_t busy_poll) {
+	fprintf(stream,"Host receive delay (kernel receive timestamp -> user space, %s):\n",busy_poll ? "busy polling" : "blocking receive");
+
+	if(delay->count==0) {
+		fprintf(stream,"\tno data available (%" PRIu64 " datagrams without a valid kernel timestamp).\n",delay->errors);
+		return;
+	}
+
+	fprintf(stream,"\tmin/avg/max = %.3f/%.3f/%.3f us, over %" PRIu64 " replies (%" PRIu64 " without a valid kernel timestamp).\n",
+		(double) delay->min_ns/MICROSEC_TO_NANOSEC,(double) delay->sum_ns/delay->count/MICROSEC_TO_NANOSEC,(double) delay->max_ns/MICROSEC_TO_NANOSEC,
+		delay->count,delay->errors);
+	fprintf(stream,"\tThis delay is still included in the user-to-user values. The wakeup latency %s by busy polling is not measured\n"
+		"\tdirectly: it is the difference between this average value and the one of a run %s --busy-poll.\n",
+		busy_poll ? "removed" : "which would be removed", busy_poll ? "without" : "with");
+}
@@ -0,0 +1,158 @@
+#include "clock_source.h"
+#include <time.h>
+#include "timer_man.h"
+#include "timeval_utils.h"
+
+// The TSC is read directly only on x86-64, where its invariance can be checked with CPUID and where 128 bit products are available
+#if defined(__x86_64__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define CLOCKSOURCE_TSC_SUPPORTED 1
+#endif
+
+// Clock source selected with clockSourceInit() (CLOCK_REALTIME until then)
+static clocksource_t clock_source=CLOCKSRC_REALTIME;
+
+#ifdef CLOCKSOURCE_TSC_SUPPORTED
+// TSC to CLOCK_MONOTONIC_RAW conversion: ns=tsc_base_ns+(tsc-tsc_base)*tsc_mult/2^32
+static uint64_t tsc_base;
+static uint64_t tsc_base_ns;
+static uint64_t tsc_mult; // ns per TSC cycle, as a 32.32 fixed point value
+#endif
+
+static inline uint64_t monorawNs(void) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC_RAW,&now);
+
+	return timespecToNs(&now);
+}
+
+#ifdef CLOCKSOURCE_TSC_SUPPORTED
+// Take a CLOCK_MONOTONIC_RAW timestamp, together with the TSC value in the middle of the clock_gettime() call
+// The attempt with the shortest TSC window is kept, as it is the least likely to have been interrupted
+static void tscSample(uint64_t *tsc, uint64_t *ns) {
+	uint64_t tsc_before, tsc_after, sample_ns;
+	uint64_t best_window=UINT64_MAX;
+
+	for(int i=0;i<CLOCK_TSC_SAMPLE_ATTEMPTS;i++) {
+		tsc_before=__rdtsc();
+		sample_ns=monorawNs();
+		tsc_after=__rdtsc();
+
+		if(tsc_after-tsc_before<best_window) {
+			best_window=tsc_after-tsc_before;
+			*tsc=tsc_before+(tsc_after-tsc_before)/2;
+			*ns=sample_ns;
+		}
+	}
+}
+
+static int tscCalibrate(void) {
+	unsigned int eax, ebx, ecx, edx;
+	uint64_t tsc_start, tsc_end, ns_start, ns_end;
+	struct timespec calibration_time={.tv_sec=0,.tv_nsec=CLOCK_TSC_CALIBRATION_MS*MILLISEC_TO_NANOSEC};
+
+	// CPUID leaf 0x80000007, EDX bit 8: invariant TSC (constant rate in all the P-, C- and T-states)
+	if(!__get_cpuid(0x80000007,&eax,&ebx,&ecx,&edx) || !(edx & (1U<<8))) {
+		return CLOCKSOURCE_ENOTSC;
+	}
+
+	tscSample(&tsc_start,&ns_start);
+	while(nanosleep(&calibration_time,&calibration_time)!=0);
+	tscSample(&tsc_end,&ns_end);
+
+	if(tsc_end<=tsc_start || ns_end<=ns_start) {
+		return CLOCKSOURCE_ECALIB;
+	}
+
+	tsc_mult=((ns_end-ns_start)<<32)/(tsc_end-tsc_start);
+	tsc_base=tsc_end;
+	tsc_base_ns=ns_end;
+
+	return 0;
+}
+#endif
+
+/* Select the clock returned by clockSourceNs(). With CLOCKSRC_TSC, the TSC is calibrated against CLOCK_MONOTONIC_RAW
+(taking CLOCK_TSC_CALIBRATION_MS), and the returned values keep the CLOCK_MONOTONIC_RAW epoch.
+This function must be called before starting any thread using clockSourceNs().
+Return values:
+0: ok
+<0: error (see the CLOCKSOURCE_E* macros in clock_source.h) - the previous clock source is kept
+*/
+int clockSourceInit(clocksource_t source) {
+	if(source==CLOCKSRC_TSC) {
+		#ifdef CLOCKSOURCE_TSC_SUPPORTED
+		int calib_ret=tscCalibrate();
+
+		if(calib_ret<0) {
+			return calib_ret;
+		}
+		#else
+		return CLOCKSOURCE_ENOTSC;
+		#endif
+	}
+
+	clock_source=source;
+
+	return 0;
+}
+
+// User space timestamp, in ns, taken with the selected clock source
+uint64_t clockSourceNs(void) {
+	switch(clock_source) {
+		case CLOCKSRC_MONORAW:
+			return monorawNs();
+
+		#ifdef CLOCKSOURCE_TSC_SUPPORTED
+		case CLOCKSRC_TSC:
+			return tsc_base_ns+(uint64_t) (((unsigned __int128) (__rdtsc()-tsc_base)*tsc_mult)>>32);
+		#endif
+
+		default:
+			return realtimeNs();
+	}
+}
+
+void clockStepDetectorInit(clockStepDetector *detector) {
+	detector->offset_ns=0;
+	detector->monoraw_ns=0;
+	detector->init=0;
+}
+
+/* Check whether CLOCK_REALTIME has been stepped (e.g. by NTP or by the user) since the last call, by comparing it with CLOCK_MONOTONIC_RAW.
+Return values:
+1: step detected
+0: no step detected (or no reliable check could be performed this time)
+*/
+int clockStepDetect(clockStepDetector *detector) {
+	uint64_t rt_before, rt_after, monoraw;
+	int64_t offset, offset_change;
+	uint64_t max_change;
+	int step=0;
+
+	rt_before=realtimeNs();
+	monoraw=monorawNs();
+	rt_after=realtimeNs();
+
+	// The clock may be stepped backwards exactly between the two reads, too: discard the check in that case as well
+	if(rt_after<rt_before || rt_after-rt_before>CLOCK_STEP_MAX_READ_WINDOW_NS) {
+		return 0;
+	}
+
+	offset=(int64_t) (rt_before+(rt_after-rt_before)/2-monoraw);
+
+	if(detector->init==1) {
+		offset_change=offset>detector->offset_ns ? offset-detector->offset_ns : detector->offset_ns-offset;
+		max_change=CLOCK_STEP_THRESHOLD_NS+(monoraw-detector->monoraw_ns)/(1000000/CLOCK_STEP_MAX_PPM);
+
+		step=(uint64_t) offset_change>max_change;
+	}
+
+	detector->offset_ns=offset;
+	detector->monoraw_ns=monoraw;
+	detector->init=1;
+
+	return step;
+}
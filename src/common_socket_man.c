@@ -49,7 +49,7 @@ int socketSetTimestamping(struct lampsock_data sData, int mode) {
 			return SOCKETSETTS_ENOSUPP;
 		}
 
-		setsockopt_optname=SO_TIMESTAMP;
+		setsockopt_optname=SO_TIMESTAMPNS;
 		flags=1;
 	} else if(mode==SET_TIMESTAMPING_HW) {
 		// Clear hardware timestamping configuration structures (see: kernel.org/doc/Documentation/networking/timestamping.txt)
@@ -97,4 +97,32 @@ int pollErrqueueWait(int sFd,uint64_t timeout_ms) {
 	while((poll_retval=poll(&errqueueMon,1,timeout_ms))>0 && errqueueMon.revents!=POLLERR);
 
 	return poll_retval;
-}
\ No newline at end of file
+}
+/* Add SOF_TIMESTAMPING_OPT_ID and SOF_TIMESTAMPING_OPT_TSONLY to the tx timestamping flags already set by socketSetTimestamping()
+('mode' must be the same, either SET_TIMESTAMPING_SW_RXTX or SET_TIMESTAMPING_HW).
+From now on, each tx timestamp is queued without the looped-back packet, and with a key counting the packets sent since this call
+(starting from 0), which can be used to match it with its packet. No other packet should be sent on the socket before the
+measurement packets, as it would shift the key.
+Return values:
+0: ok
+<0: error (see the SOCKETSETTS_E* macros in common_socket_man.h)
+*/
+int socketSetTimestampingTxID(int sFd, int mode) {
+	int flags;
+
+	if(mode==SET_TIMESTAMPING_HW) {
+		flags=SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_TX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE;
+	} else if(mode==SET_TIMESTAMPING_SW_RXTX) {
+		flags=SOF_TIMESTAMPING_SOFTWARE | SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_RX_SOFTWARE;
+	} else {
+		return SOCKETSETTS_EINVAL;
+	}
+
+	flags|=SOF_TIMESTAMPING_OPT_ID | SOF_TIMESTAMPING_OPT_TSONLY;
+
+	if(setsockopt(sFd,SOL_SOCKET,SO_TIMESTAMPING,&flags,sizeof(flags))<0) {
+		return SOCKETSETTS_ESETSOCKOPT;
+	}
+
+	return 0;
+}
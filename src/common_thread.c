@@ -1,4 +1,12 @@
 #include "common_thread.h"
+#include <signal.h>
+
+// Flag set when the user asks to stop the current test (SIGINT or SIGTERM), once testStopInit() has been called
+static volatile sig_atomic_t test_stop_flag=0;
+
+static void test_stop_hdlr(int sig) {
+	test_stop_flag=sig;
+}
 
 void thread_error_print(const char *name, t_error_types err) {
 	switch(err) {
@@ -53,8 +61,40 @@ void thread_error_print(const char *name, t_error_types err) {
 		case ERR_TXSTAMP:
 			fprintf(stderr,"%s reported an error when retrieving the TX timestamp in hardware mode. Try using another mode.\n",name);
 			break;
+		case ERR_TXSCHED:
+			fprintf(stderr,"%s reported an error when waiting for the next transmission deadline (clock_nanosleep()).\n",name);
+			break;
+		case ERR_TXRING:
+			fprintf(stderr,"%s reported an error when writing a frame into the PACKET_MMAP TX ring (no free slot).\n",name);
+			break;
+		case ERR_XDPSOCK:
+			fprintf(stderr,"%s reported an error when sending a frame through the AF_XDP socket.\n",name);
+			break;
 		default:
 			fprintf(stderr,"%s reported a generic error.\n",name);
 			break;
 	}
-}
\ No newline at end of file
+}
+/* Let the client stop the current test gracefully, when SIGINT or SIGTERM is received: the Tx loop sends
+its last packet as the final one, and the statistics of the packets sent so far are printed as usual.
+The handler is installed only once (SA_RESETHAND), so that a second signal terminates the program immediately.
+No SA_RESTART is set, but the blocking calls of the Tx and Rx loops are already retried on EINTR. */
+void testStopInit(void) {
+	struct sigaction sa;
+
+	memset(&sa,0,sizeof(sa));
+	sa.sa_handler=test_stop_hdlr;
+	sa.sa_flags=SA_RESETHAND;
+	sigemptyset(&sa.sa_mask);
+
+	test_stop_flag=0;
+
+	if(sigaction(SIGINT,&sa,NULL)<0 || sigaction(SIGTERM,&sa,NULL)<0) {
+		perror("sigaction() error");
+		fprintf(stderr,"Warning: cannot set the SIGINT/SIGTERM handlers.\n\tThe test will not be stopped gracefully when interrupted.\n");
+	}
+}
+
+int testStopRequested(void) {
+	return test_stop_flag!=0;
+}
@@ -8,6 +8,15 @@
 #include <unistd.h>
 #include <stdio.h>   
 #include <stdlib.h> 
+#include "timeval_utils.h"
+
+// Write a 64-bit ns value inside the FOLLOWUP_DATA payload, in network byte order
+static void followUpPayloadEncode(byte_t *payload,uint64_t tDiff_ns) {
+	for(int i=FOLLOWUP_DATA_PAYLOAD_SIZE-1;i>=0;i--) {
+		payload[i]=(byte_t) (tDiff_ns & 0xFF);
+		tDiff_ns>>=8;
+	}
+}
 
 /* Send control message.
 Return values:
@@ -360,7 +369,7 @@ int controlReceiverUDP_RAW(int sFd, in_port_t port, in_addr_t ip, controlRCVdata
 			}
 		}
 
-		// Filter out all outgoing packets - [IMPROVEMENT] use BPF instead
+		// Filter out all outgoing packets (they are already dropped by the BPF filter, if it could be attached - see bpf_filter.c)
 		if(addrll.sll_pkttype==PACKET_OUTGOING) {
 			continue;
 		}
@@ -422,29 +431,38 @@ int controlReceiverUDP_RAW(int sFd, in_port_t port, in_addr_t ip, controlRCVdata
 	return 0;
 }
 
-/* Send FOLLOWUP_DATA message with no payload
+/* Send FOLLOWUP_DATA message, carrying the processing delta 'tDiff_ns' both in the payload, with full ns resolution,
+and in the LaMP header timestamp, truncated to us, as expected by the clients not reading the payload
 Return values:
 0: message sent correctly
 1; error when sending the message
 */
-int sendFollowUpData(struct lampsock_data sData,uint16_t id,uint16_t seq,struct timeval tDiff) {
+int sendFollowUpData(struct lampsock_data sData,uint16_t id,uint16_t seq,uint64_t tDiff_ns) {
 	struct lamphdr lampHeader;
+	byte_t lampPacket[LAMP_HDR_PAYLOAD_SIZE(FOLLOWUP_DATA_PAYLOAD_SIZE)];
+	byte_t payload[FOLLOWUP_DATA_PAYLOAD_SIZE];
+	struct timeval tDiff=nsToTimeval(tDiff_ns);
 
 	lampHeadPopulate(&lampHeader, CTRL_FOLLOWUP_DATA, id, seq);
 
 	lampHeadSetTimestamp(&lampHeader,&tDiff);
 
-	return sendto(sData.descriptor,(byte_t *)&lampHeader,LAMP_HDR_SIZE(),NO_FLAGS,(struct sockaddr *)&(sData.addru.addrin[1]),sizeof(struct sockaddr_in))!=LAMP_HDR_SIZE();
+	followUpPayloadEncode(payload,tDiff_ns);
+	lampEncapsulate(lampPacket,&lampHeader,payload,FOLLOWUP_DATA_PAYLOAD_SIZE);
+
+	return sendto(sData.descriptor,lampPacket,sizeof(lampPacket),NO_FLAGS,(struct sockaddr *)&(sData.addru.addrin[1]),sizeof(struct sockaddr_in))!=sizeof(lampPacket);
 }
 
-/* Send FOLLOWUP_DATA message with no payload (raw socket)
+/* Send FOLLOWUP_DATA message (raw socket), with the same content of sendFollowUpData()
 Return values:
 0: message sent correctly
 1; error when sending the message
 */
-int sendFollowUpData_RAW(arg_struct *args,controlRCVdata *rcvData,uint16_t id,uint16_t ip_id,uint16_t seq,struct timeval tDiff) {
+int sendFollowUpData_RAW(arg_struct *args,controlRCVdata *rcvData,uint16_t id,uint16_t ip_id,uint16_t seq,uint64_t tDiff_ns) {
 	struct pktheaders_udp headers;
-	struct pktbuffers_udp_nopayload_fixed buffers;
+	struct pktbuffers_udp_followup_fixed buffers;
+	byte_t payload[FOLLOWUP_DATA_PAYLOAD_SIZE];
+	struct timeval tDiff=nsToTimeval(tDiff_ns);
 	size_t finalpktsize;
 	struct ipaddrs ipaddrs;
 	struct lamphdr *inpacket_lamphdr;
@@ -457,12 +475,30 @@ int sendFollowUpData_RAW(arg_struct *args,controlRCVdata *rcvData,uint16_t id,ui
 	IP4headAddID(&(headers.ipHeader),(unsigned short) ip_id);
 	UDPheadPopulate(&(headers.udpHeader), args->opts->mode_cs==CLIENT ? rcvData->controlRCV.port : args->opts->port, args->opts->mode_cs==CLIENT ? args->opts->port : rcvData->controlRCV.port);
 
-	UDPencapsulate(buffers.udppacket,&(headers.udpHeader),(byte_t *)&(headers.lampHeader),LAMP_HDR_SIZE(),ipaddrs);
-	IP4Encapsulate(buffers.ippacket, &(headers.ipHeader), buffers.udppacket, UDP_PACKET_SIZE_S(LAMP_HDR_SIZE()));
-	finalpktsize=etherEncapsulate(buffers.ethernetpacket, &(headers.etherHeader), buffers.ippacket, IP_UDP_PACKET_SIZE_S(LAMP_HDR_SIZE()));
+	followUpPayloadEncode(payload,tDiff_ns);
+	lampEncapsulate(buffers.lamppacket,&(headers.lampHeader),payload,FOLLOWUP_DATA_PAYLOAD_SIZE);
+
+	UDPencapsulate(buffers.udppacket,&(headers.udpHeader),buffers.lamppacket,sizeof(buffers.lamppacket),ipaddrs);
+	IP4Encapsulate(buffers.ippacket, &(headers.ipHeader), buffers.udppacket, UDP_PACKET_SIZE_S(sizeof(buffers.lamppacket)));
+	finalpktsize=etherEncapsulate(buffers.ethernetpacket, &(headers.etherHeader), buffers.ippacket, IP_UDP_PACKET_SIZE_S(sizeof(buffers.lamppacket)));
 
 	// Get "in packet" LaMP header pointer, as required by rawLampSend
 	inpacket_lamphdr=(struct lamphdr *) (buffers.ethernetpacket+sizeof(struct ether_header)+sizeof(struct iphdr)+sizeof(struct udphdr));
 
 	return rawLampSend(args->sData.descriptor, args->sData.addru.addrll, inpacket_lamphdr, buffers.ethernetpacket, finalpktsize, FLG_NONE, UDP);
-}
\ No newline at end of file
+}
+
+// Get the processing delta (in ns) of a received FOLLOWUP_DATA message: older servers send it only inside the LaMP header timestamp (i.e. in us)
+uint64_t getFollowUpDataNs(struct timeval *tDiff,byte_t *payload,uint16_t payloadlen) {
+	uint64_t tDiff_ns=0;
+
+	if(payload==NULL || payloadlen<FOLLOWUP_DATA_PAYLOAD_SIZE) {
+		return timevalToNs(tDiff);
+	}
+
+	for(int i=0;i<FOLLOWUP_DATA_PAYLOAD_SIZE;i++) {
+		tDiff_ns=(tDiff_ns<<8) | payload[i];
+	}
+
+	return tDiff_ns;
+}
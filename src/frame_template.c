@@ -0,0 +1,157 @@
+#include "frame_template.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+// Maximum size of a patched region (currently, the LaMP timestamp: 'sec' and 'usec')
+#define MAX_PATCH_SIZE 16
+
+// Incremental checksum update, as described in RFC 1624 (eqn. 3): HC' = ~(~HC + ~m + m')
+// 'oldData' and 'newData' contain 'len' bytes (len must be even) starting at an even offset from the beginning of the checksummed data.
+// The one's complement sum is byte order independent, thus the 16 bit words are read as they are stored in memory,
+// and the checksum is updated in the same (network) byte order it is stored inside the frame.
+static uint16_t csumIncrementalUpdate(uint16_t csum, const byte_t *oldData, const byte_t *newData, size_t len) {
+	uint32_t sum=(uint16_t) ~csum;
+	uint16_t oldWord, newWord;
+
+	for(size_t i=0;i<len;i+=2) {
+		memcpy(&oldWord,oldData+i,sizeof(uint16_t));
+		memcpy(&newWord,newData+i,sizeof(uint16_t));
+
+		sum+=(uint16_t) ~oldWord;
+		sum+=newWord;
+	}
+
+	// Fold the carries back into 16 bits
+	while(sum>>16) {
+		sum=(sum & 0xFFFF)+(sum>>16);
+	}
+
+	return (uint16_t) ~sum;
+}
+
+// Update the UDP checksum after a region covered by it ('newData', including the IP addresses of the pseudo-header) has been
+// modified ('oldData' stores the previous content - see csumIncrementalUpdate() for the constraints on 'len' and on the offset)
+void udpCsumIncrementalUpdate(struct udphdr *udpHeader, const byte_t *oldData, const byte_t *newData, size_t len) {
+	uint16_t csum;
+
+	// A zero UDP checksum means that no checksum was computed: nothing to update
+	if(udpHeader->check==0) {
+		return;
+	}
+
+	csum=csumIncrementalUpdate(udpHeader->check,oldData,newData,len);
+
+	// As per RFC 768, a computed checksum equal to zero is transmitted as all ones
+	udpHeader->check=csum==0 ? 0xFFFF : csum;
+}
+
+// Update the UDP checksum after a LaMP header region has been modified ('oldData' stores the previous content)
+static inline void udpCsumUpdate(frameTemplate *tmpl, const byte_t *oldData, size_t offset, size_t len) {
+	udpCsumIncrementalUpdate(tmpl->udpHeader,oldData,((byte_t *) tmpl->lampHeader)+offset,len);
+}
+
+/* Build the frame template, starting from already populated headers.
+Return values:
+0: ok
+-1: malloc() error: cannot allocate memory
+*/
+int frameTemplateInit(frameTemplate *tmpl, struct pktheaders_udp *headers, struct ipaddrs ipaddrs, byte_t *payload, uint16_t payloadlen) {
+	// Temporary buffers, needed only to build the frame once
+	struct pktbuffers_udp buffers = {NULL, NULL, NULL, NULL};
+	size_t lampPacketSize=LAMP_HDR_PAYLOAD_SIZE(payloadlen);
+	int retval=0;
+
+	tmpl->frame=NULL;
+
+	buffers.lamppacket=malloc(lampPacketSize);
+	buffers.udppacket=malloc(UDP_PACKET_SIZE_S(lampPacketSize));
+	buffers.ippacket=malloc(IP_UDP_PACKET_SIZE_S(lampPacketSize));
+	buffers.ethernetpacket=malloc(ETH_IP_UDP_PACKET_SIZE_S(lampPacketSize));
+
+	if(!buffers.lamppacket || !buffers.udppacket || !buffers.ippacket || !buffers.ethernetpacket) {
+		retval=-1;
+	} else {
+		if(payloadlen!=0) {
+			lampEncapsulate(buffers.lamppacket, &(headers->lampHeader), payload, payloadlen);
+		} else {
+			memcpy(buffers.lamppacket,&(headers->lampHeader),LAMP_HDR_SIZE());
+		}
+
+		UDPencapsulate(buffers.udppacket,&(headers->udpHeader),buffers.lamppacket,lampPacketSize,ipaddrs);
+		IP4Encapsulate(buffers.ippacket, &(headers->ipHeader), buffers.udppacket, UDP_PACKET_SIZE_S(lampPacketSize));
+
+		// The Ethernet buffer becomes the template itself
+		tmpl->frame_size=etherEncapsulate(buffers.ethernetpacket, &(headers->etherHeader), buffers.ippacket, IP_UDP_PACKET_SIZE_S(lampPacketSize));
+		tmpl->frame=buffers.ethernetpacket;
+		buffers.ethernetpacket=NULL;
+
+		tmpl->ipHeader=(struct iphdr *) (tmpl->frame+sizeof(struct ether_header));
+		tmpl->udpHeader=(struct udphdr *) (tmpl->frame+sizeof(struct ether_header)+sizeof(struct iphdr));
+		tmpl->lampHeader=(struct lamphdr *) (tmpl->frame+sizeof(struct ether_header)+sizeof(struct iphdr)+sizeof(struct udphdr));
+	}
+
+	// Free the temporary buffers (free(NULL) is a no-op)
+	free(buffers.lamppacket);
+	free(buffers.udppacket);
+	free(buffers.ippacket);
+	free(buffers.ethernetpacket);
+
+	return retval;
+}
+
+// Set the IP identification field (only the IP header checksum covers it)
+void frameTemplateSetIPid(frameTemplate *tmpl, uint16_t id) {
+	byte_t oldData[sizeof(uint16_t)];
+
+	memcpy(oldData,&(tmpl->ipHeader->id),sizeof(uint16_t));
+	IP4headAddID(tmpl->ipHeader,(unsigned short) id);
+
+	tmpl->ipHeader->check=csumIncrementalUpdate(tmpl->ipHeader->check,oldData,(byte_t *) &(tmpl->ipHeader->id),sizeof(uint16_t));
+}
+
+// Turn the current packet into the last one of the session (UNIDIR_STOP or PINGLIKE_ENDREQ/PINGLIKE_ENDREQ_TLESS)
+// 'ctrl' is stored at an odd offset: the whole 16 bit word containing 'reserved' and 'ctrl' is considered
+void frameTemplateSetEnd(frameTemplate *tmpl) {
+	byte_t oldData[sizeof(uint16_t)];
+
+	memcpy(oldData,tmpl->lampHeader,sizeof(uint16_t));
+
+	if(tmpl->lampHeader->ctrl==CTRL_UNIDIR_CONTINUE || tmpl->lampHeader->ctrl==CTRL_UNIDIR_STOP) {
+		lampSetUnidirStop(tmpl->lampHeader);
+	} else {
+		lampSetPinglikeEndreqAll(tmpl->lampHeader);
+	}
+
+	udpCsumUpdate(tmpl,oldData,0,sizeof(uint16_t));
+}
+
+// Set the LaMP timestamp ('sec' and 'usec' fields)
+void frameTemplateSetTimestamp(frameTemplate *tmpl, struct timeval *tv) {
+	byte_t oldData[MAX_PATCH_SIZE];
+	size_t offset=offsetof(struct lamphdr,sec);
+	size_t len=LAMP_HDR_SIZE()-offset;
+
+	memcpy(oldData,((byte_t *) tmpl->lampHeader)+offset,len);
+	lampHeadSetTimestamp(tmpl->lampHeader,tv);
+
+	udpCsumUpdate(tmpl,oldData,offset,len);
+}
+
+// Increase the LaMP sequence number by one
+void frameTemplateIncreaseSeq(frameTemplate *tmpl) {
+	byte_t oldData[sizeof(uint16_t)];
+	size_t offset=offsetof(struct lamphdr,seq);
+
+	memcpy(oldData,((byte_t *) tmpl->lampHeader)+offset,sizeof(uint16_t));
+	lampHeadIncreaseSeq(tmpl->lampHeader);
+
+	udpCsumUpdate(tmpl,oldData,offset,sizeof(uint16_t));
+}
+
+void frameTemplateFree(frameTemplate *tmpl) {
+	if(tmpl->frame) {
+		free(tmpl->frame);
+		tmpl->frame=NULL;
+	}
+}
@@ -0,0 +1,86 @@
+#include "hdr_hist.h"
+#include <string.h>
+#include <math.h>
+
+// Index of the bucket storing 'value'
+static inline unsigned int hdrHistIndex(uint64_t value) {
+	unsigned int shift;
+
+	if(value<HDR_HIST_SUB_BUCKETS) {
+		return (unsigned int) value;
+	}
+
+	if(value>=(1ULL<<HDR_HIST_MAX_BITS)) {
+		value=(1ULL<<HDR_HIST_MAX_BITS)-1;
+	}
+
+	// Shift bringing 'value' inside [HDR_HIST_SUB_BUCKETS/2, HDR_HIST_SUB_BUCKETS), i.e. the width of its bucket is 2^shift
+	shift=(unsigned int) (63-__builtin_clzll(value))-(HDR_HIST_SUB_BUCKET_BITS-1);
+
+	return HDR_HIST_SUB_BUCKETS+(shift-1)*(HDR_HIST_SUB_BUCKETS/2)+(unsigned int) ((value>>shift)-HDR_HIST_SUB_BUCKETS/2);
+}
+
+// Value represented by the bucket with index 'idx' (i.e. the middle of the range of values it stores)
+static inline uint64_t hdrHistValue(unsigned int idx) {
+	unsigned int shift;
+	uint64_t lowest;
+
+	if(idx<HDR_HIST_SUB_BUCKETS) {
+		return idx;
+	}
+
+	shift=(idx-HDR_HIST_SUB_BUCKETS)/(HDR_HIST_SUB_BUCKETS/2)+1;
+	lowest=(uint64_t) (HDR_HIST_SUB_BUCKETS/2+(idx-HDR_HIST_SUB_BUCKETS)%(HDR_HIST_SUB_BUCKETS/2))<<shift;
+
+	return lowest+((1ULL<<shift)-1)/2;
+}
+
+void hdrHistInit(hdrHist *hist) {
+	memset(hist->counts,0,sizeof(hist->counts));
+	hist->total=0;
+}
+
+void hdrHistRecord(hdrHist *hist, uint64_t value) {
+	hist->counts[hdrHistIndex(value)]++;
+	hist->total++;
+}
+
+// Add all the values recorded inside 'src' to 'dst' (the result is the same as recording all of them inside 'dst')
+void hdrHistMerge(hdrHist *dst, const hdrHist *src) {
+	for(unsigned int i=0;i<HDR_HIST_BUCKETS;i++) {
+		dst->counts[i]+=src->counts[i];
+	}
+
+	dst->total+=src->total;
+}
+
+// Smallest recorded value (within the histogram resolution) which is larger than or equal to 'percentile'% of the recorded values
+// 0 is returned if no value has been recorded yet
+uint64_t hdrHistValueAtPercentile(hdrHist *hist, double percentile) {
+	return hdrHistValueAtRank(hist,(uint64_t) ceil(percentile/100.0*hist->total));
+}
+
+// 'rank'-th smallest recorded value (starting from 1, within the histogram resolution), or 0 if no value has been recorded yet
+uint64_t hdrHistValueAtRank(hdrHist *hist, uint64_t rank) {
+	uint64_t cumulative=0;
+
+	if(hist->total==0) {
+		return 0;
+	}
+
+	if(rank==0) {
+		rank=1;
+	} else if(rank>hist->total) {
+		rank=hist->total;
+	}
+
+	for(unsigned int i=0;i<HDR_HIST_BUCKETS;i++) {
+		cumulative+=hist->counts[i];
+
+		if(cumulative>=rank) {
+			return hdrHistValue(i);
+		}
+	}
+
+	return hdrHistValue(HDR_HIST_BUCKETS-1);
+}
@@ -0,0 +1,281 @@
+#include "interim_report.h"
+#include <inttypes.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <math.h>
+#include <sys/socket.h>
+#include "timer_man.h"
+#include "timeval_utils.h"
+
+static inline uint64_t monotonicNs(void) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC,&now);
+
+	return timespecToNs(&now);
+}
+
+// Reset the report of the current window (the sliding receive window is not used, as the interim reports only show the number of lost packets)
+static void interimWindowReset(interimReporter *ir, uint64_t window_start_ns) {
+	reportStructureInit(&ir->window,0,0,ir->latencyType,ir->followupMode);
+	ir->window._seqWindowEnabled=0;
+
+	ir->window_start_ns=window_start_ns;
+	ir->highestSeqValid=0;
+}
+
+// Print the statistics of the current window, ending at 'window_end_ns', to stdout (and to the --interim-csv file, if available)
+static void interimWindowEmit(interimReporter *ir, uint64_t window_end_ns) {
+	reportStructure *report=&ir->window;
+	double start_s, end_s;
+	double lostPktPerc;
+	uint64_t lostPackets;
+
+	ir->window_index++;
+
+	// Packets expected in this window: the ones with a sequence number between the end of the previous window and the highest received one
+	// (late packets belonging to previous windows may make the number of received packets larger than that)
+	if(ir->highestSeqValid && ir->highestSeq>=ir->nextExpectedSeq) {
+		report->totalPackets=ir->highestSeq-ir->nextExpectedSeq+1;
+		ir->nextExpectedSeq=ir->highestSeq+1;
+	}
+
+	if(report->totalPackets<report->packetCount) {
+		report->totalPackets=report->packetCount;
+	}
+
+	reportStructureFinalize(report);
+
+	lostPackets=report->totalPackets-report->packetCount;
+	lostPktPerc=report->totalPackets>0 ? ((double) lostPackets)*100/report->totalPackets : 0;
+
+	start_s=((double) (ir->window_start_ns-ir->start_ns))/SEC_TO_NANOSEC;
+	end_s=((double) (window_end_ns-ir->start_ns))/SEC_TO_NANOSEC;
+
+	fprintf(stdout,"Interim report #%" PRIu64 " [%.3f-%.3f s]: %" PRIu64 " packets",ir->window_index,start_s,end_s,report->packetCount);
+
+	if(report->minLatency!=UINT64_MAX) {
+		fprintf(stdout," - %.3f/%.3f/%.3f ms (min/avg/max)",
+			((double) report->minLatency)/MILLISEC_TO_NANOSEC,report->averageLatency/MILLISEC_TO_NANOSEC,((double) report->maxLatency)/MILLISEC_TO_NANOSEC);
+	}
+
+	if(report->percentiles[0]!=0) {
+		fprintf(stdout," - %.3f/%.3f/%.3f ms (p50/p99/p99.9)",
+			((double) report->percentiles[0])/MILLISEC_TO_NANOSEC,((double) report->percentiles[2])/MILLISEC_TO_NANOSEC,((double) report->percentiles[3])/MILLISEC_TO_NANOSEC);
+	}
+
+	if(report->jitter>=0) {
+		fprintf(stdout," - jitter %.3f ms",report->jitter/MILLISEC_TO_NANOSEC);
+	}
+
+	fprintf(stdout," - lost %.2f%% (%" PRIu64 "/%" PRIu64 ")",lostPktPerc,lostPackets,report->totalPackets);
+
+	if(report->errorsCount>0) {
+		fprintf(stdout," - %" PRIu64 " errors",report->errorsCount);
+	}
+
+	fprintf(stdout,"\n");
+
+	if(ir->csvfd>=0) {
+		dprintf(ir->csvfd,"%" PRIu64 ",%.6f,%.6f,%" PRIu64 ",%" PRIu64 ",%.2f,%" PRIu64 ",",
+			ir->window_index,start_s,end_s,report->packetCount,lostPackets,lostPktPerc,report->errorsCount);
+
+		if(report->minLatency!=UINT64_MAX) {
+			dprintf(ir->csvfd,"%.6f,%.6f,%.6f,%.6f,",
+				((double) report->minLatency)/MILLISEC_TO_NANOSEC,
+				report->averageLatency/MILLISEC_TO_NANOSEC,
+				((double) report->maxLatency)/MILLISEC_TO_NANOSEC,
+				sqrt(report->variance)/MILLISEC_TO_NANOSEC);
+		} else {
+			dprintf(ir->csvfd,",,,,");
+		}
+
+		// Empty fields when the percentiles or the jitter are not available
+		for(int i=0;i<REPORT_PERCENTILES_NUMBER;i++) {
+			if(report->percentiles[i]!=0) {
+				dprintf(ir->csvfd,"%.6f",((double) report->percentiles[i])/MILLISEC_TO_NANOSEC);
+			}
+
+			dprintf(ir->csvfd,",");
+		}
+
+		if(report->jitter>=0) {
+			dprintf(ir->csvfd,"%.6f",report->jitter/MILLISEC_TO_NANOSEC);
+		}
+		dprintf(ir->csvfd,"\n");
+	}
+}
+
+void interimReporterInit(interimReporter *ir, struct options *opts) {
+	uint8_t fileAlreadyExists=0;
+
+	ir->interval_ns=opts->interim_ns;
+	ir->interval_packets=opts->interim_packets;
+	ir->latencyType=opts->latencyType;
+	ir->followupMode=opts->followup_mode;
+
+	ir->start_ns=monotonicNs();
+	ir->next_deadline_ns=ir->start_ns+ir->interval_ns;
+	ir->window_index=0;
+	ir->nextExpectedSeq=0;
+
+	ir->rx_descriptor=-1;
+	ir->rx_timeout_ns=0;
+	ir->last_rx_ns=ir->start_ns;
+
+	interimWindowReset(ir,ir->start_ns);
+
+	ir->csvfd=-1;
+	ir->csvFilename=opts->interim_filename;
+
+	if(opts->interim_filename!=NULL) {
+		errno=0;
+
+		ir->csvfd=open(opts->interim_filename, O_CREAT | O_EXCL | O_WRONLY, S_IRUSR | S_IWUSR);
+
+		if(ir->csvfd<0 && errno==EEXIST) {
+			fileAlreadyExists=1;
+			ir->csvfd=open(opts->interim_filename, O_WRONLY | O_APPEND);
+		}
+
+		if(ir->csvfd<0) {
+			perror("open() error");
+			fprintf(stderr,"Warning: cannot open %s for writing the interim reports.\n\tThey will be printed to stdout only.\n",opts->interim_filename);
+		} else if(!fileAlreadyExists) {
+			dprintf(ir->csvfd,"Window,Start-s,End-s,Packets,LostPackets,LostPackets-Perc,ErrorsCount,MinLatency-ms,AvgLatency-ms,MaxLatency-ms,StDev-ms,P50-ms,P90-ms,P99-ms,P99.9-ms,P99.99-ms,Jitter-ms\n");
+		}
+	}
+}
+
+// Close the current time based window, if its end is not in the future (the window is reported to end at its deadline)
+static void interimWindowExpire(interimReporter *ir, uint64_t now_ns) {
+	uint64_t last_deadline_ns;
+
+	if(now_ns>=ir->next_deadline_ns) {
+		// Move to the latest deadline which is not in the future
+		last_deadline_ns=ir->next_deadline_ns+((now_ns-ir->next_deadline_ns)/ir->interval_ns)*ir->interval_ns;
+
+		interimWindowEmit(ir,last_deadline_ns);
+		interimWindowReset(ir,last_deadline_ns);
+
+		ir->next_deadline_ns=last_deadline_ns+ir->interval_ns;
+	}
+}
+
+/* With time based windows, shorten the receive timeout of 'sFd' to the window duration, so that the receive loop can close the
+windows on time even when no reply is received (see interimReporterRxTimeout()). The original timeout is restored by interimReporterClose().
+To be called before the receive rings are created, as they read the timeout only once (see rx_ring.c and xdp_sock.c). */
+void interimReporterSetRxTimeout(interimReporter *ir, int sFd) {
+	struct timeval rcvtimeo;
+	socklen_t rcvtimeoLen=sizeof(rcvtimeo);
+
+	if(ir->interval_ns==0 || getsockopt(sFd,SOL_SOCKET,SO_RCVTIMEO,&rcvtimeo,&rcvtimeoLen)<0) {
+		return;
+	}
+
+	ir->rx_timeout_ns=(uint64_t) rcvtimeo.tv_sec*SEC_TO_NANOSEC+(uint64_t) rcvtimeo.tv_usec*MICROSEC_TO_NANOSEC;
+
+	// The current timeout is already short enough
+	if(ir->rx_timeout_ns!=0 && ir->rx_timeout_ns<=ir->interval_ns) {
+		return;
+	}
+
+	rcvtimeo.tv_sec=ir->interval_ns/SEC_TO_NANOSEC;
+	rcvtimeo.tv_usec=(ir->interval_ns%SEC_TO_NANOSEC)/MICROSEC_TO_NANOSEC;
+
+	// A zero timeout would mean "no timeout"
+	if(rcvtimeo.tv_sec==0 && rcvtimeo.tv_usec==0) {
+		rcvtimeo.tv_usec=1;
+	}
+
+	if(setsockopt(sFd,SOL_SOCKET,SO_RCVTIMEO,&rcvtimeo,sizeof(rcvtimeo))<0) {
+		perror("setsockopt() error");
+		fprintf(stderr,"Warning: could not shorten RCVTIMEO: the interim reports will be printed only when replies are received.\n");
+		return;
+	}
+
+	ir->rx_descriptor=sFd;
+	ir->last_rx_ns=monotonicNs();
+}
+
+/* Account for a received packet, closing the current window first, if needed.
+Time based windows are closed when the first packet after their end is received, or when a receive times out after their end
+(see interimReporterRxTimeout()); packet based windows are closed as soon as their last packet is received. */
+void interimReporterUpdate(interimReporter *ir, uint64_t tripTime, uint64_t seqNumber) {
+	uint64_t now_ns;
+
+	if(ir->interval_ns>0) {
+		now_ns=monotonicNs();
+
+		interimWindowExpire(ir,now_ns);
+		ir->last_rx_ns=now_ns;
+	}
+
+	reportStructureUpdate(&ir->window,tripTime,seqNumber);
+
+	if(!ir->highestSeqValid || seqNumber>ir->highestSeq) {
+		ir->highestSeq=seqNumber;
+		ir->highestSeqValid=1;
+	}
+
+	if(ir->interval_packets>0 && ir->window.packetCount>=ir->interval_packets) {
+		now_ns=monotonicNs();
+
+		interimWindowEmit(ir,now_ns);
+		interimWindowReset(ir,now_ns);
+	}
+}
+
+/* To be called when a receive times out (EAGAIN): close the current time based window, if it is over, even if no packet was received in it.
+Return values:
+1: the receive has to be retried, as only the timeout shortened by interimReporterSetRxTimeout() expired
+0: the original receive timeout expired too
+*/
+int interimReporterRxTimeout(interimReporter *ir) {
+	uint64_t now_ns;
+
+	if(ir->interval_ns==0) {
+		return 0;
+	}
+
+	now_ns=monotonicNs();
+
+	interimWindowExpire(ir,now_ns);
+
+	return ir->rx_descriptor>=0 && (ir->rx_timeout_ns==0 || now_ns-ir->last_rx_ns<ir->rx_timeout_ns);
+}
+
+// Print the last (partial) window, if it contains any packet: to be called at the end of the test, or when it is interrupted
+void interimReporterFlush(interimReporter *ir) {
+	uint64_t now_ns;
+
+	if(ir->window.packetCount==0) {
+		return;
+	}
+
+	now_ns=monotonicNs();
+
+	interimWindowEmit(ir,now_ns);
+	interimWindowReset(ir,now_ns);
+}
+
+void interimReporterClose(interimReporter *ir) {
+	struct timeval rcvtimeo;
+
+	if(ir->rx_descriptor>=0) {
+		rcvtimeo.tv_sec=ir->rx_timeout_ns/SEC_TO_NANOSEC;
+		rcvtimeo.tv_usec=(ir->rx_timeout_ns%SEC_TO_NANOSEC)/MICROSEC_TO_NANOSEC;
+		setsockopt(ir->rx_descriptor,SOL_SOCKET,SO_RCVTIMEO,&rcvtimeo,sizeof(rcvtimeo));
+		ir->rx_descriptor=-1;
+	}
+
+	if(ir->csvfd>=0) {
+		close(ir->csvfd);
+		ir->csvfd=-1;
+
+		fprintf(stdout,"Interim report data was saved inside %s\n",ir->csvFilename);
+	}
+}
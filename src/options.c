@@ -10,11 +10,39 @@
 #include <arpa/inet.h>
 #include <inttypes.h>
 #include "rawsock.h"
+#include "timer_man.h"
+#include "rx_ring.h"
+#include "tfile_writer.h"
 
 #define CSV_EXTENSION_LEN 4 // '.csv' length
 #define CSV_EXTENSION_STR ".csv"
 
 static const char *latencyTypes[]={"Unknown","User-to-user","KRT","Software (kernel) timestamps","Hardware timestamps"};
+static const char *clockSources[]={"CLOCK_REALTIME","CLOCK_MONOTONIC_RAW","invariant TSC"};
+
+static const struct option long_opts[]={
+	{"pps",			required_argument,	NULL,	LONGOPT_PPS},
+	{"tx-spin",		required_argument,	NULL,	LONGOPT_TX_SPIN},
+	{"burst",		required_argument,	NULL,	LONGOPT_BURST},
+	{"tx-ring",		no_argument,		NULL,	LONGOPT_TX_RING},
+	{"qdisc-bypass",	no_argument,		NULL,	LONGOPT_QDISC_BYPASS},
+	{"rx-ring",		no_argument,		NULL,	LONGOPT_RX_RING},
+	{"xdp",			no_argument,		NULL,	LONGOPT_XDP},
+	{"xdp-queue",		required_argument,	NULL,	LONGOPT_XDP_QUEUE},
+	{"xdp-reflect",		no_argument,		NULL,	LONGOPT_XDP_REFLECT},
+	{"rx-batch",		required_argument,	NULL,	LONGOPT_RX_BATCH},
+	{"busy-poll",		required_argument,	NULL,	LONGOPT_BUSY_POLL},
+	{"busy-poll-cpu",	required_argument,	NULL,	LONGOPT_BUSY_POLL_CPU},
+	{"host-rx-delay",	no_argument,		NULL,	LONGOPT_HOST_RX_DELAY},
+	{"clock",		required_argument,	NULL,	LONGOPT_CLOCK},
+	{"interim",		required_argument,	NULL,	LONGOPT_INTERIM},
+	{"interim-csv",		required_argument,	NULL,	LONGOPT_INTERIM_CSV},
+	{"w-sync",		required_argument,	NULL,	LONGOPT_W_SYNC},
+	{"trace",		required_argument,	NULL,	LONGOPT_TRACE},
+	{"pcapng",		required_argument,	NULL,	LONGOPT_PCAPNG},
+	{"shm-stats",		required_argument,	NULL,	LONGOPT_SHM_STATS},
+	{NULL,			0,					NULL,	0}
+};
 
 static void print_long_info(void) {
 	fprintf(stdout,"\nUsage: %s [-c <destination address> [mode] | -l [mode] | -s | -m] [protocol] [options]\n"
@@ -31,7 +59,7 @@ static void print_long_info(void) {
 
 		"[mode]:\n"
 		"  Client operating mode (the server will adapt its mode depending on the incoming packets).\n"
-		"  -B: ping-like bidirectional mode\n"
+		"  -B: ping-like bidirectional mode (Ctrl+C or SIGTERM stops the test, printing the statistics of the packets sent so far)\n"
 		"  -U: unidirectional mode (requires clocks to be perfectly synchronized - highly experimental\n"
 		"\t  - use at your own risk!)\n"
 		"\n"
@@ -48,7 +76,20 @@ static void print_long_info(void) {
 
 		"[options] - Optional client options:\n"
 		"  -n <total number of packets to be sent>: specifies how many packets to send (default: %d).\n"
-		"  -t <time interval in ms>: specifies the periodicity, in milliseconds, to send at (default: %d ms).\n"
+		"  -t <time interval>[ms|us|ns]: specifies the periodicity to send at (default: %d ms).\n"
+		"\t  The interval is expressed in milliseconds, unless a 'us' (microseconds) or 'ns' (nanoseconds)\n"
+		"\t  unit is appended to the value (e.g. -t 250us). Packets are scheduled against absolute deadlines,\n"
+		"\t  so that a late transmission does not delay the following ones.\n"
+		"  --pps <rate>: specify the periodicity as a packet rate, in packets per second, instead of using -t.\n"
+		"  --tx-spin <time in us>: enable the hybrid sleep-then-spin transmission mode: the Tx loop sleeps until\n"
+		"\t  the specified amount of microseconds before each deadline, then busy-waits until the deadline is\n"
+		"\t  reached (maximum: %d us - default: 0, i.e. sleep only). Useful with very short intervals, at the\n"
+		"\t  expense of one CPU core being busy for the specified time before each packet.\n"
+		"  --burst <number of packets>: burst mode: send the specified number of back-to-back packets for each\n"
+		"\t  interval, using a single sendmmsg() call, instead of a single packet (maximum: %d - default: 1).\n"
+		"\t  In ping-like mode, the statistics are also reported for each position inside the burst, to measure\n"
+		"\t  any latency growth due to queueing. -n still specifies the total number of packets.\n"
+		"\t  With raw sockets, each packet of a burst is sent with its own sendto() call, unless --tx-ring is used.\n"
 		"  -f <filename, without extension>: print the report to a CSV file other than printing\n"
 		"\t  it on the screen.\n"
 		"\t  The default behaviour will append to an existing file; if the file does not exist,\n" 
@@ -59,6 +100,45 @@ static void print_long_info(void) {
 		"  -r: use raw sockets, if supported for the current protocol.\n"
 		"\t  When '-r' is set, the program tries to insert the LaMP timestamp in the last \n"
 		"\t  possible instant before sending. 'sudo' (or proper permissions) is required in this case.\n"
+		"  --tx-ring: valid only with '-r'; write the frames into a PACKET_MMAP TX ring, shared with the kernel,\n"
+		"\t  instead of sending each of them with sendto(). The frames of each burst (see --burst) are then\n"
+		"\t  sent with a single system call. Not supported with '-L s' and '-L h'.\n"
+		"  --qdisc-bypass: valid only with '--tx-ring'; send the frames directly to the NIC driver, bypassing the\n"
+		"\t  kernel queueing discipline (qdisc) layer.\n"
+		"  --rx-ring: valid only with '-r'; receive the frames through a PACKET_MMAP (TPACKET_V3) RX ring, shared\n"
+		"\t  with the kernel, instead of copying each of them with recvfrom()/recvmsg(). The client supports it\n"
+		"\t  only in ping-like mode. Frames are handed over in blocks, which are released at least every %d ms:\n"
+		"\t  use it with kernel timestamps ('-L r', '-L s', '-L h') or with the follow-up mode, as any user-to-user\n"
+		"\t  measurement would include this additional delay.\n"
+		"  --xdp: use raw sockets, sending and receiving the LaMP packets through an AF_XDP socket (kernel >= 5.9).\n"
+		"\t  A minimal XDP program, attached in generic (SKB) mode, redirects to it only the LaMP packets directed\n"
+		"\t  to this host, so that any interface (e.g. veth pairs) can be used. The control packets (INIT, ACK,\n"
+		"\t  follow-up requests and reports) are still exchanged through a normal raw socket. Only user-to-user\n"
+		"\t  latency ('-L u', with or without -F) is supported. Not compatible with --tx-ring and --rx-ring.\n"
+		"  --xdp-queue <queue index>: valid only with '--xdp'; bind the AF_XDP socket to the specified receive queue\n"
+		"\t  of the interface (default: 0). Only the packets received on this queue are redirected to the socket.\n"
+		"  --rx-batch <number of datagrams>: valid only without '-r'; receive up to the specified number of datagrams\n"
+		"\t  with a single recvmmsg() call (maximum: %d - default: 1, i.e. one recvfrom()/recvmsg() call for each\n"
+		"\t  datagram). The kernel timestamps ('-L r', '-L s', '-L h') are kept for each datagram, while any user-to-user\n"
+		"\t  timestamp is taken when each datagram is extracted from its batch.\n"
+		"  --busy-poll <budget in us>: valid only without '-r'; instead of sleeping inside each receive call, spin on\n"
+		"\t  non-blocking receives, with SO_BUSY_POLL (and SO_PREFER_BUSY_POLL, when available) set to the specified\n"
+		"\t  budget (maximum: %d us). The receive timeout becomes a deadline checked inside the spin loop. One CPU\n"
+		"\t  core is kept busy for the whole test: see --busy-poll-cpu. Values above net.core.busy_read require\n"
+		"\t  CAP_NET_ADMIN. Not compatible with --rx-batch. The client supports it only in ping-like mode.\n"
+		"  --busy-poll-cpu <CPU index>: valid only with '--busy-poll'; pin the receiving thread to the specified CPU.\n"
+		"  --host-rx-delay: valid only without '-r' and with '-L u'; report the delay between the kernel receive\n"
+		"\t  timestamp of each reply and the instant in which it reaches user space (implied by --busy-poll).\n"
+		"\t  Running with and without --busy-poll gives the wakeup latency removed by busy polling.\n"
+		"  --clock <realtime | monoraw | tsc>: valid only in ping-like mode with '-L u'; clock used to timestamp the\n"
+		"\t  requests and the replies: CLOCK_REALTIME (default, as gettimeofday()), CLOCK_MONOTONIC_RAW or the\n"
+		"\t  invariant TSC, calibrated against CLOCK_MONOTONIC_RAW at startup (x86-64 only). The last two are not\n"
+		"\t  affected by NTP slews and steps, which are otherwise detected and reported in the statistics.\n"
+		"  --interim <value>[s | ms | p]: valid only in ping-like mode; print interim statistics (min/avg/max, percentiles,\n"
+		"\t  jitter and loss), computed over the last window only, every <value> seconds (s, default), milliseconds (ms)\n"
+		"\t  or received replies (p). A time window is closed at its end, even when no reply is received in it. When the\n"
+		"\t  test is interrupted with Ctrl+C (SIGINT) or SIGTERM, the last partial window is printed anyway.\n"
+		"  --interim-csv <filename>: valid only with '--interim'; append each interim report to the specified CSV file too.\n"
 		"  -A <access category: BK | BE | VI | VO>: forces a certain EDCA MAC access category to\n"
 		"\t  be used (patched kernel required!).\n"
 		"  -L <latency type: u | r | s | h>: select latency type: user-to-user, KRT (Kernel Receive Timestamp),\n"
@@ -78,7 +158,24 @@ static void print_long_info(void) {
 		"\t  estimate of the server processing time, which is computed depending on the chosen latency type.\n"
 		"  -W <filename, without extension>: write, for the current test only, the single packet latency\n"
 		"\t  measurement data to the specified CSV file. If the file already exists, data will be appended\n"
-		"\t  to the file, with a new header line. Warning! This option may negatively impact performance.\n"
+		"\t  to the file, with a new header line. The data is written by a separate thread, in large blocks,\n"
+		"\t  not to delay the reception of the replies: if the storage cannot keep up, some lines may be dropped\n"
+		"\t  (their number is reported at the end of the test).\n"
+		"  --w-sync <none | close | block>: valid only with '-W'; call fdatasync() on the -W file never (none, default),\n"
+		"\t  once at the end of the test (close), or after each block of data is written (block).\n"
+		"  --trace <filename>: valid only in ping-like mode; write, for the current test only, the single packet\n"
+		"\t  tx/rx timestamps (and server processing times) to the specified binary trace file, which is overwritten\n"
+		"\t  if it already exists. The trace is much more compact and cheaper to write than the '-W' CSV file;\n"
+		"\t  it can be converted to the same CSV format with 'tools/lamptrace2csv'.\n"
+		"  --pcapng <filename>: write all the LaMP packets sent and received during the test to the specified pcapng\n"
+		"\t  file (overwritten if it already exists), with ns resolution. The user, kernel and hardware timestamps\n"
+		"\t  of each packet, when available, are stored inside its comment; the packet timestamp is the hardware one,\n"
+		"\t  or the kernel one, or the time at which the packet is written, in this order. Without '-r', the IPv4 and\n"
+		"\t  UDP headers are rebuilt by the program (with no UDP checksum).\n"
+		"  --shm-stats <name>: publish the live statistics of the test (counters, min/avg/max latency, latency\n"
+		"\t  histogram, losses) inside the POSIX shared memory segment '/<name>' (i.e. /dev/shm/<name>), which is\n"
+		"\t  updated after each reply and removed at the end. It can be polled at any rate, with no impact on\n"
+		"\t  the test, with 'tools/lampstats <name>'.\n"
 		"\n"
 
 		"[options] - Mandatory server options:\n"
@@ -86,7 +183,7 @@ static void print_long_info(void) {
 		"\n"
 
 		"[options] - Optional server options:\n"
-		"  -t <timeout in ms>: specifies the timeout after which the connection should be\n"
+		"  -t <timeout>[ms|us|ns]: specifies the timeout after which the connection should be\n"
 		"\t  considered lost (minimum value: %d ms, otherwise %d ms will be automatically set - default: %d ms).\n"
 		"  -r: use raw sockets, if supported for the current protocol.\n"
 		"\t  When '-r' is set, the program tries to insert the LaMP timestamp in the last \n"
@@ -104,6 +201,26 @@ static void print_long_info(void) {
 		"\t  look for available wireless interfaces and return an error if none are found.\n"
 		"  -p <port>: specifies the port to be used. Can be specified only if protocol is UDP (default: %d).\n"
 		"  -0: force refusing follow-up mode, even when a client is requesting to use it.\n"
+		"  --rx-batch <number of datagrams>: valid only without '-r'; receive the requests with recvmmsg()\n"
+		"\t  (see the corresponding client option).\n"
+		"  --busy-poll <budget in us>: valid only without '-r'; spin on non-blocking receives, with kernel busy\n"
+		"\t  polling, instead of sleeping inside each receive call (see the corresponding client option).\n"
+		"  --busy-poll-cpu <CPU index>: valid only with '--busy-poll'; pin the receiving thread to the specified CPU.\n"
+		"  --clock <realtime | monoraw | tsc>: clock used to compute the server processing time sent inside the\n"
+		"\t  follow-up messages, for application level timestamps (see the corresponding client option).\n"
+		"  --rx-ring: valid only with '-r'; receive the frames through a PACKET_MMAP (TPACKET_V3) RX ring\n"
+		"\t  (see the corresponding client option).\n"
+		"  --xdp: receive the requests and send the replies through an AF_XDP socket (see the corresponding client option).\n"
+		"\t  The follow-up requests are accepted only for application level timestamps.\n"
+		"  --xdp-queue <queue index>: valid only with '--xdp'; see the corresponding client option.\n"
+		"  --xdp-reflect: valid only with '-r'; in ping-like sessions, reply to the requests directly inside the kernel,\n"
+		"\t  with an XDP program (generic mode, kernel >= 5.9) swapping the addresses and sending back each request\n"
+		"\t  belonging to the current session. Only the control packets and the last request reach the server.\n"
+		"\t  The follow-up requests are always denied, as no per-packet processing time is available.\n"
+		"  --pcapng <filename>: see the corresponding client option. In continuous daemon mode ('-d'), each session\n"
+		"\t  is appended to the file, as a new section. The requests replied by the XDP reflector are not written.\n"
+		"  --shm-stats <name>: see the corresponding client option. The latency statistics are available only in\n"
+		"\t  unidirectional sessions; in continuous daemon mode ('-d'), the segment is kept across the sessions.\n"
 		"\n"
 
 		"Example of usage:\n"
@@ -127,7 +244,7 @@ static void print_long_info(void) {
 		"%s\n",
 		PROG_NAME_SHORT,PROG_NAME_SHORT,PROG_NAME_SHORT, // Basic help
 		CLIENT_DEF_NUMBER, // Optional client options
-		CLIENT_DEF_INTERVAL, // Optional client options
+		CLIENT_DEF_INTERVAL,MAX_TX_SPIN_US,MAX_BURST_SIZE,RX_RING_BLOCK_TIMEOUT,MAX_RX_BATCH_SIZE,MAX_BUSY_POLL_US, // Optional client options
 		DEFAULT_UDP_PORT,DEF_CONFIDENCE_INTERVAL_MASK, // Optional client options
 		MIN_TIMEOUT_VAL_S,MIN_TIMEOUT_VAL_S,SERVER_DEF_TIMEOUT, // Optional server options
 		DEFAULT_UDP_PORT, // Optional server options
@@ -165,6 +282,26 @@ void options_initialize(struct options *options) {
 	options->mode_cs=UNSET_MCS;
 	options->mode_ub=UNSET_MUB;
 	options->interval=0;
+	options->interval_ns=0;
+	options->tx_spin_ns=0;
+	options->burst_size=1;
+	options->rx_batch=1;
+	options->busy_poll_us=0;
+	options->busy_poll_cpu=-1;
+	options->host_rx_delay=0;
+	options->clock_source=CLOCKSRC_REALTIME;
+	options->interim_ns=0;
+	options->interim_packets=0;
+	options->interim_filename=NULL;
+	options->w_sync=TFILE_WRITER_SYNC_NONE;
+	options->trace_filename=NULL;
+	options->pcapng_filename=NULL;
+	options->shm_stats_name=NULL;
+	options->tx_ring=0;
+	options->qdisc_bypass=0;
+	options->rx_ring=0;
+	options->xdp_queue=0;
+	options->xdp_reflect=0;
 	options->number=CLIENT_DEF_NUMBER;
 	options->payloadlen=0;
 
@@ -212,6 +349,23 @@ unsigned int parse_options(int argc, char **argv, struct options *options) {
 	uint8_t eI_flag=0; // =1 if either -e or -I (or both) was specified, otheriwse = 0
 	uint8_t C_flag=0; // =1 if -C was specified, otheriwise = 0
 	uint8_t F_flag=0; // =1 if -F was specified, otherwise = 0
+	uint8_t t_flag=0; // =1 if -t was specified, otherwise = 0
+	uint8_t pps_flag=0; // =1 if --pps was specified, otherwise = 0
+	uint8_t spin_flag=0; // =1 if --tx-spin was specified, otherwise = 0
+	uint8_t burst_flag=0; // =1 if --burst was specified, otherwise = 0
+	uint64_t unit_multiplier; // Multiplier to convert the value specified with -t to nanoseconds
+	unsigned long long pps_rate; // Packet rate specified with --pps
+	unsigned long long spin_us; // Spin window specified with --tx-spin
+	unsigned long burst_size; // Burst size specified with --burst
+	unsigned long rx_batch; // Batch size specified with --rx-batch
+	uint8_t busy_poll_flag=0; // =1 if --busy-poll was specified, otherwise = 0
+	unsigned long busy_poll_us; // Busy polling budget specified with --busy-poll
+	long busy_poll_cpu; // CPU index specified with --busy-poll-cpu
+	uint8_t xdp_flag=0; // =1 if --xdp was specified, otherwise = 0
+	uint8_t w_sync_flag=0; // =1 if --w-sync was specified, otherwise = 0
+	uint8_t xdp_queue_flag=0; // =1 if --xdp-queue was specified, otherwise = 0
+	unsigned long xdp_queue; // Queue index specified with --xdp-queue
+	unsigned long long interim_value; // Interim report period (or number of replies) specified with --interim
 	/* 
 	   The p_flag has been inserted only for future use: it is set as a port is explicitely defined. This allows to check if a port was specified
 	   for a protocol without the concept of 'port', as more protocols will be implemented in the future. In that case, it will be possible to
@@ -227,7 +381,7 @@ unsigned int parse_options(int argc, char **argv, struct options *options) {
 		return 1;
 	}
 
-	while ((char_option=getopt(argc, argv, VALID_OPTS)) != EOF) {
+	while ((char_option=getopt_long(argc, argv, VALID_OPTS, long_opts, NULL)) != EOF) {
 		switch(char_option) {
 			case 'h':
 				print_long_info();
@@ -247,8 +401,8 @@ unsigned int parse_options(int argc, char **argv, struct options *options) {
 				break;
 
 			case 't':
-				errno=0; // Setting errno to 0 as suggested in the strtoul() man page
-				options->interval=strtoul(optarg,&sPtr,0);
+				errno=0; // Setting errno to 0 as suggested in the strtoull() man page
+				options->interval_ns=strtoull(optarg,&sPtr,0);
 				if(sPtr==optarg) {
 					fprintf(stderr,"Cannot find any digit in the specified time interval.\n");
 					print_short_info_err(options);
@@ -256,6 +410,26 @@ unsigned int parse_options(int argc, char **argv, struct options *options) {
 					fprintf(stderr,"Error in parsing the time interval.\n");
 					print_short_info_err(options);
 				}
+
+				// Parse the (optional) unit, following the numeric value: milliseconds are assumed when no unit is specified
+				if(*sPtr=='\0' || strcmp(sPtr,"ms")==0) {
+					unit_multiplier=MILLISEC_TO_NANOSEC;
+				} else if(strcmp(sPtr,"us")==0) {
+					unit_multiplier=MICROSEC_TO_NANOSEC;
+				} else if(strcmp(sPtr,"ns")==0) {
+					unit_multiplier=1;
+				} else {
+					fprintf(stderr,"Error: invalid time unit '%s' after -t. Valid units: ms (default), us, ns.\n",sPtr);
+					print_short_info_err(options);
+				}
+
+				if(options->interval_ns>UINT64_MAX/unit_multiplier) {
+					fprintf(stderr,"Error: the specified time interval is too big.\n");
+					print_short_info_err(options);
+				}
+
+				options->interval_ns*=unit_multiplier;
+				t_flag=1;
 				break;
 
 			case 'n':
@@ -528,6 +702,248 @@ unsigned int parse_options(int argc, char **argv, struct options *options) {
 				options->refuseFollowup=1;
 				break;
 
+			case LONGOPT_PPS:
+				errno=0; // Setting errno to 0 as suggested in the strtoull() man page
+				pps_rate=strtoull(optarg,&sPtr,0);
+				if(sPtr==optarg) {
+					fprintf(stderr,"Cannot find any digit in the specified packet rate.\n");
+					print_short_info_err(options);
+				} else if(errno || *sPtr!='\0' || pps_rate==0 || pps_rate>SEC_TO_NANOSEC) {
+					fprintf(stderr,"Error in parsing the packet rate.\n\tPlease note that values between 1 and %d pps are accepted.\n",SEC_TO_NANOSEC);
+					print_short_info_err(options);
+				}
+				options->interval_ns=SEC_TO_NANOSEC/pps_rate;
+				pps_flag=1;
+				break;
+
+			case LONGOPT_TX_SPIN:
+				errno=0; // Setting errno to 0 as suggested in the strtoull() man page
+				spin_us=strtoull(optarg,&sPtr,0);
+				if(sPtr==optarg) {
+					fprintf(stderr,"Cannot find any digit in the specified spin time.\n");
+					print_short_info_err(options);
+				} else if(errno || *sPtr!='\0' || spin_us>MAX_TX_SPIN_US) {
+					fprintf(stderr,"Error in parsing the spin time.\n\tPlease note that values up to %d us are accepted.\n",MAX_TX_SPIN_US);
+					print_short_info_err(options);
+				}
+				options->tx_spin_ns=spin_us*MICROSEC_TO_NANOSEC;
+				spin_flag=1;
+				break;
+
+			case LONGOPT_BURST:
+				errno=0; // Setting errno to 0 as suggested in the strtoul() man page
+				burst_size=strtoul(optarg,&sPtr,0);
+				if(sPtr==optarg) {
+					fprintf(stderr,"Cannot find any digit in the specified burst size.\n");
+					print_short_info_err(options);
+				} else if(errno || *sPtr!='\0' || burst_size==0 || burst_size>MAX_BURST_SIZE) {
+					fprintf(stderr,"Error in parsing the burst size.\n\tPlease note that values between 1 and %d are accepted.\n",MAX_BURST_SIZE);
+					print_short_info_err(options);
+				}
+				options->burst_size=(unsigned int) burst_size;
+				burst_flag=1;
+				break;
+
+			case LONGOPT_TX_RING:
+				options->tx_ring=1;
+				break;
+
+			case LONGOPT_QDISC_BYPASS:
+				options->qdisc_bypass=1;
+				break;
+
+			case LONGOPT_RX_RING:
+				options->rx_ring=1;
+				break;
+
+			case LONGOPT_XDP:
+				fprintf(stderr,"Warning: root privilieges are required to use AF_XDP sockets.\n");
+				xdp_flag=1;
+				break;
+
+			case LONGOPT_XDP_QUEUE:
+				errno=0; // Setting errno to 0 as suggested in the strtoul() man page
+				xdp_queue=strtoul(optarg,&sPtr,0);
+				if(sPtr==optarg) {
+					fprintf(stderr,"Cannot find any digit in the specified queue index.\n");
+					print_short_info_err(options);
+				} else if(errno || *sPtr!='\0' || xdp_queue>=UINT16_MAX) {
+					fprintf(stderr,"Error in parsing the queue index.\n");
+					print_short_info_err(options);
+				}
+				options->xdp_queue=(unsigned int) xdp_queue;
+				xdp_queue_flag=1;
+				break;
+
+			case LONGOPT_XDP_REFLECT:
+				options->xdp_reflect=1;
+				break;
+
+			case LONGOPT_RX_BATCH:
+				errno=0; // Setting errno to 0 as suggested in the strtoul() man page
+				rx_batch=strtoul(optarg,&sPtr,0);
+				if(sPtr==optarg) {
+					fprintf(stderr,"Cannot find any digit in the specified batch size.\n");
+					print_short_info_err(options);
+				} else if(errno || *sPtr!='\0' || rx_batch==0 || rx_batch>MAX_RX_BATCH_SIZE) {
+					fprintf(stderr,"Error in parsing the batch size.\n\tPlease note that values between 1 and %d are accepted.\n",MAX_RX_BATCH_SIZE);
+					print_short_info_err(options);
+				}
+				options->rx_batch=(unsigned int) rx_batch;
+				break;
+
+			case LONGOPT_BUSY_POLL:
+				errno=0; // Setting errno to 0 as suggested in the strtoul() man page
+				busy_poll_us=strtoul(optarg,&sPtr,0);
+				if(sPtr==optarg) {
+					fprintf(stderr,"Cannot find any digit in the specified busy polling budget.\n");
+					print_short_info_err(options);
+				} else if(errno || *sPtr!='\0' || busy_poll_us==0 || busy_poll_us>MAX_BUSY_POLL_US) {
+					fprintf(stderr,"Error in parsing the busy polling budget.\n\tPlease note that values between 1 and %d us are accepted.\n",MAX_BUSY_POLL_US);
+					print_short_info_err(options);
+				}
+				options->busy_poll_us=(unsigned int) busy_poll_us;
+				busy_poll_flag=1;
+				break;
+
+			case LONGOPT_BUSY_POLL_CPU:
+				errno=0; // Setting errno to 0 as suggested in the strtol() man page
+				busy_poll_cpu=strtol(optarg,&sPtr,10);
+				if(sPtr==optarg) {
+					fprintf(stderr,"Cannot find any digit in the specified CPU index.\n");
+					print_short_info_err(options);
+				} else if(errno || *sPtr!='\0' || busy_poll_cpu<0 || busy_poll_cpu>=sysconf(_SC_NPROCESSORS_CONF)) {
+					fprintf(stderr,"Error in parsing the CPU index.\n\tPlease note that values between 0 and %ld are accepted.\n",sysconf(_SC_NPROCESSORS_CONF)-1);
+					print_short_info_err(options);
+				}
+				options->busy_poll_cpu=(int) busy_poll_cpu;
+				break;
+
+			case LONGOPT_HOST_RX_DELAY:
+				options->host_rx_delay=1;
+				break;
+
+			case LONGOPT_CLOCK:
+				if(strcmp(optarg,"realtime")==0) {
+					options->clock_source=CLOCKSRC_REALTIME;
+				} else if(strcmp(optarg,"monoraw")==0) {
+					options->clock_source=CLOCKSRC_MONORAW;
+				} else if(strcmp(optarg,"tsc")==0) {
+					options->clock_source=CLOCKSRC_TSC;
+				} else {
+					fprintf(stderr,"Error: unknown clock source '%s'.\n\tValid clock sources: realtime, monoraw, tsc.\n",optarg);
+					print_short_info_err(options);
+				}
+				break;
+
+			case LONGOPT_INTERIM:
+				errno=0; // Setting errno to 0 as suggested in the strtoull() man page
+				interim_value=strtoull(optarg,&sPtr,0);
+				if(sPtr==optarg) {
+					fprintf(stderr,"Cannot find any digit in the specified interim report period.\n");
+					print_short_info_err(options);
+				} else if(errno || interim_value==0) {
+					fprintf(stderr,"Error in parsing the interim report period.\n");
+					print_short_info_err(options);
+				}
+
+				// Parse the (optional) unit, following the numeric value: seconds are assumed when no unit is specified
+				if(*sPtr=='\0' || strcmp(sPtr,"s")==0) {
+					unit_multiplier=SEC_TO_NANOSEC;
+				} else if(strcmp(sPtr,"ms")==0) {
+					unit_multiplier=MILLISEC_TO_NANOSEC;
+				} else if(strcmp(sPtr,"p")==0) {
+					unit_multiplier=0;
+				} else {
+					fprintf(stderr,"Error: invalid unit '%s' after --interim. Valid units: s (default), ms, p (received replies).\n",sPtr);
+					print_short_info_err(options);
+				}
+
+				if(unit_multiplier==0) {
+					options->interim_packets=interim_value;
+				} else if(interim_value>UINT64_MAX/unit_multiplier) {
+					fprintf(stderr,"Error: the specified interim report period is too big.\n");
+					print_short_info_err(options);
+				} else {
+					options->interim_ns=interim_value*unit_multiplier;
+				}
+				break;
+
+			case LONGOPT_INTERIM_CSV:
+				filenameLen=strlen(optarg)+1;
+				if(filenameLen>1) {
+					options->interim_filename=malloc((filenameLen+CSV_EXTENSION_LEN)*sizeof(char));
+					if(!options->interim_filename) {
+						fprintf(stderr,"Error in parsing the filename for --interim-csv: cannot allocate memory.\n");
+						print_short_info_err(options);
+					}
+					strncpy(options->interim_filename,optarg,filenameLen);
+					strncat(options->interim_filename,CSV_EXTENSION_STR,CSV_EXTENSION_LEN);
+				} else {
+					fprintf(stderr,"Error in parsing the filename for --interim-csv: null string length.\n");
+					print_short_info_err(options);
+				}
+				break;
+
+			case LONGOPT_W_SYNC:
+				if(strcmp(optarg,"none")==0) {
+					options->w_sync=TFILE_WRITER_SYNC_NONE;
+				} else if(strcmp(optarg,"close")==0) {
+					options->w_sync=TFILE_WRITER_SYNC_CLOSE;
+				} else if(strcmp(optarg,"block")==0) {
+					options->w_sync=TFILE_WRITER_SYNC_BLOCK;
+				} else {
+					fprintf(stderr,"Error: unknown --w-sync policy '%s'.\n\tValid policies: none, close, block.\n",optarg);
+					print_short_info_err(options);
+				}
+				w_sync_flag=1;
+				break;
+
+			case LONGOPT_TRACE:
+				filenameLen=strlen(optarg)+1;
+				if(filenameLen>1) {
+					options->trace_filename=malloc(filenameLen*sizeof(char));
+					if(!options->trace_filename) {
+						fprintf(stderr,"Error in parsing the filename for --trace: cannot allocate memory.\n");
+						print_short_info_err(options);
+					}
+					strncpy(options->trace_filename,optarg,filenameLen);
+				} else {
+					fprintf(stderr,"Error in parsing the filename for --trace: null string length.\n");
+					print_short_info_err(options);
+				}
+				break;
+
+			case LONGOPT_PCAPNG:
+				filenameLen=strlen(optarg)+1;
+				if(filenameLen>1) {
+					options->pcapng_filename=malloc(filenameLen*sizeof(char));
+					if(!options->pcapng_filename) {
+						fprintf(stderr,"Error in parsing the filename for --pcapng: cannot allocate memory.\n");
+						print_short_info_err(options);
+					}
+					strncpy(options->pcapng_filename,optarg,filenameLen);
+				} else {
+					fprintf(stderr,"Error in parsing the filename for --pcapng: null string length.\n");
+					print_short_info_err(options);
+				}
+				break;
+
+			case LONGOPT_SHM_STATS:
+				filenameLen=strlen(optarg)+1;
+				if(filenameLen>1) {
+					options->shm_stats_name=malloc(filenameLen*sizeof(char));
+					if(!options->shm_stats_name) {
+						fprintf(stderr,"Error in parsing the name for --shm-stats: cannot allocate memory.\n");
+						print_short_info_err(options);
+					}
+					strncpy(options->shm_stats_name,optarg,filenameLen);
+				} else {
+					fprintf(stderr,"Error in parsing the name for --shm-stats: null string length.\n");
+					print_short_info_err(options);
+				}
+				break;
+
 			default:
 				print_short_info_err(options);
 
@@ -539,11 +955,16 @@ unsigned int parse_options(int argc, char **argv, struct options *options) {
 		exit(EXIT_SUCCESS); // Exit with SUCCESS code if -v was selected
 	}
 
+	// --xdp implies raw sockets (whether -r was specified or not), as the AF_XDP data path is built on top of the raw client and server
+	if(xdp_flag==1) {
+		options->mode_raw=XDP;
+	}
+
 	if(options->mode_cs==UNSET_MCS) {
 		fprintf(stderr,"Error: a mode must be specified, either client (-c) or server (-s).\n");
 		print_short_info_err(options);
 	} else if(options->mode_cs==CLIENT) {
-		if(options->mode_raw==RAW && M_flag==0) {
+		if(options->mode_raw!=NON_RAW && M_flag==0) {
 			fprintf(stderr,"Error: in this initial version, the raw client requires the destionation MAC address too (with -M).\n");
 			print_short_info_err(options);
 		}
@@ -567,7 +988,7 @@ unsigned int parse_options(int argc, char **argv, struct options *options) {
 			fprintf(stderr,"Error: -I/-e are not supported when using loopback interfaces, as only one interface is used.\n");
 			print_short_info_err(options);
 		}
-		if(options->mode_raw==RAW) {
+		if(options->mode_raw!=NON_RAW) {
 			fprintf(stderr,"Error: raw sockets are not supported in loopback clients.\n");
 			print_short_info_err(options);
 		}
@@ -580,7 +1001,7 @@ unsigned int parse_options(int argc, char **argv, struct options *options) {
 			fprintf(stderr,"Error: -I/-e are not supported when using loopback interfaces, as only one interface is used.\n");
 			print_short_info_err(options);
 		}
-		if(options->mode_raw==RAW) {
+		if(options->mode_raw!=NON_RAW) {
 			fprintf(stderr,"Error: raw sockets are not supported in loopback servers.\n");
 			print_short_info_err(options);
 		}
@@ -592,16 +1013,155 @@ unsigned int parse_options(int argc, char **argv, struct options *options) {
 		}
 	}
 
-	if(options->interval==0) {
+	if(t_flag==1 && pps_flag==1) {
+		fprintf(stderr,"Error: only one option between -t and --pps is allowed.\n");
+		print_short_info_err(options);
+	}
+
+	if((options->mode_cs==SERVER || options->mode_cs==LOOPBACK_SERVER) && (pps_flag==1 || spin_flag==1 || burst_flag==1)) {
+		fprintf(stderr,"Error: --pps, --tx-spin and --burst are client-only options.\n");
+		print_short_info_err(options);
+	}
+
+	if(options->tx_ring==1) {
+		if(options->mode_cs!=CLIENT || options->mode_raw!=RAW) {
+			fprintf(stderr,"Error: --tx-ring is supported only by the raw client (-c with -r).\n");
+			print_short_info_err(options);
+		}
+		if(options->latencyType==SOFTWARE || options->latencyType==HARDWARE) {
+			fprintf(stderr,"Error: --tx-ring cannot be used together with '-L s' or '-L h', as no transmit timestamp\n"
+				"\tcan be retrieved from the socket error queue for the frames sent through the TX ring.\n");
+			print_short_info_err(options);
+		}
+	}
+
+	if(options->qdisc_bypass==1 && options->tx_ring==0) {
+		fprintf(stderr,"Error: --qdisc-bypass can be specified only together with --tx-ring.\n");
+		print_short_info_err(options);
+	}
+
+	if(options->rx_ring==1) {
+		if((options->mode_cs!=CLIENT && options->mode_cs!=SERVER) || options->mode_raw!=RAW) {
+			fprintf(stderr,"Error: --rx-ring is supported only by the raw client and server (-c or -s with -r).\n");
+			print_short_info_err(options);
+		}
+		if(options->mode_cs==CLIENT && options->mode_ub==UNIDIR) {
+			fprintf(stderr,"Error: --rx-ring is supported by the client only in ping-like mode.\n");
+			print_short_info_err(options);
+		}
+		if(options->mode_cs==CLIENT && options->latencyType==USERTOUSER && options->followup_mode==FOLLOWUP_OFF) {
+			fprintf(stderr,"Warning: --rx-ring is used with user-to-user latency: the measured values will include the\n"
+				"\tRX ring block delivery delay (up to %d ms).\n",RX_RING_BLOCK_TIMEOUT);
+		}
+	}
+
+	if(options->mode_raw==XDP) {
+		if(options->tx_ring==1 || options->rx_ring==1) {
+			fprintf(stderr,"Error: --xdp cannot be used together with --tx-ring or --rx-ring.\n");
+			print_short_info_err(options);
+		}
+		if(options->latencyType!=USERTOUSER) {
+			fprintf(stderr,"Error: --xdp supports only user-to-user latency ('-L u'), as no kernel timestamp is available\n"
+				"\tfor the frames sent and received through an AF_XDP socket.\n");
+			print_short_info_err(options);
+		}
+	}
+
+	if(xdp_queue_flag==1 && xdp_flag==0) {
+		fprintf(stderr,"Error: --xdp-queue can be specified only together with --xdp.\n");
+		print_short_info_err(options);
+	}
+
+	if(options->rx_batch>1 && options->mode_raw!=NON_RAW) {
+		fprintf(stderr,"Error: --rx-batch is supported only by the non raw client and server (i.e. without -r).\n");
+		print_short_info_err(options);
+	}
+
+	if(options->rx_batch>1 && (options->mode_cs==CLIENT || options->mode_cs==LOOPBACK_CLIENT) && options->mode_ub==UNIDIR) {
+		fprintf(stderr,"Warning: --rx-batch is used by the client only in ping-like mode. It will be ignored.\n");
+	}
+
+	if(busy_poll_flag==1) {
+		// AF_PACKET sockets do not support busy polling: only the UDP sockets are considered
+		if(options->mode_raw!=NON_RAW) {
+			fprintf(stderr,"Error: --busy-poll is supported only by the non raw client and server (i.e. without -r).\n");
+			print_short_info_err(options);
+		}
+		if(options->rx_batch>1) {
+			fprintf(stderr,"Error: --busy-poll cannot be used together with --rx-batch.\n");
+			print_short_info_err(options);
+		}
+		if((options->mode_cs==CLIENT || options->mode_cs==LOOPBACK_CLIENT) && options->mode_ub==UNIDIR) {
+			fprintf(stderr,"Warning: --busy-poll is used by the client only in ping-like mode. It will be ignored.\n");
+		}
+	} else if(options->busy_poll_cpu>=0) {
+		fprintf(stderr,"Error: --busy-poll-cpu can be specified only together with --busy-poll.\n");
+		print_short_info_err(options);
+	}
+
+	if(options->host_rx_delay==1) {
+		if(options->mode_cs!=CLIENT && options->mode_cs!=LOOPBACK_CLIENT) {
+			fprintf(stderr,"Error: --host-rx-delay is a client only option.\n");
+			print_short_info_err(options);
+		}
+		if(options->mode_raw!=NON_RAW || options->latencyType!=USERTOUSER) {
+			fprintf(stderr,"Error: --host-rx-delay is supported only without '-r' and with user-to-user latency ('-L u').\n");
+			print_short_info_err(options);
+		}
+	} else if(busy_poll_flag==1 && (options->mode_cs==CLIENT || options->mode_cs==LOOPBACK_CLIENT) && options->latencyType==USERTOUSER) {
+		// The host receive delay is what busy polling is expected to reduce: measure it whenever it does not interfere with the selected latency type
+		options->host_rx_delay=1;
+	}
+
+	// The kernel and hardware timestamps, and the unidirectional measurements, always rely on CLOCK_REALTIME: the other clock sources
+	// can be used only when both timestamps of each interval are taken in user space by the same host
+	if(options->clock_source!=CLOCKSRC_REALTIME && (options->mode_cs==CLIENT || options->mode_cs==LOOPBACK_CLIENT) &&
+		(options->mode_ub!=PINGLIKE || options->latencyType!=USERTOUSER)) {
+		fprintf(stderr,"Error: --clock is supported by the client only in ping-like mode (-B) with user-to-user latency ('-L u').\n");
+		print_short_info_err(options);
+	}
+
+	// The unidirectional statistics are computed by the server, and sent to the client only at the end of the test
+	if(options->interim_ns>0 || options->interim_packets>0) {
+		if((options->mode_cs!=CLIENT && options->mode_cs!=LOOPBACK_CLIENT) || options->mode_ub!=PINGLIKE) {
+			fprintf(stderr,"Error: --interim is supported only by the client, in ping-like mode (-B).\n");
+			print_short_info_err(options);
+		}
+	} else if(options->interim_filename!=NULL) {
+		fprintf(stderr,"Error: --interim-csv can be specified only together with --interim.\n");
+		print_short_info_err(options);
+	}
+
+	// The per-packet data is available only to the ping-like client (in unidirectional mode, the latency is measured by the server)
+	if(options->trace_filename!=NULL && ((options->mode_cs!=CLIENT && options->mode_cs!=LOOPBACK_CLIENT) || options->mode_ub!=PINGLIKE)) {
+		fprintf(stderr,"Error: --trace is supported only by the client, in ping-like mode (-B).\n");
+		print_short_info_err(options);
+	}
+
+	if(w_sync_flag==1 && options->Wfilename==NULL) {
+		fprintf(stderr,"Error: --w-sync can be specified only together with -W.\n");
+		print_short_info_err(options);
+	}
+
+	// Only one XDP program can be attached to the interface at a time: --xdp-reflect and --xdp are mutually exclusive
+	if(options->xdp_reflect==1 && (options->mode_cs!=SERVER || options->mode_raw!=RAW)) {
+		fprintf(stderr,"Error: --xdp-reflect is supported only by the raw server (-s with -r), and it cannot be used together with --xdp.\n");
+		print_short_info_err(options);
+	}
+
+	if(options->interval_ns==0) {
 		if(options->mode_cs==CLIENT || options->mode_cs==LOOPBACK_CLIENT) {
 			// Set the default periodicity value if no explicit value was defined
-			options->interval=CLIENT_DEF_INTERVAL;
+			options->interval_ns=(uint64_t) CLIENT_DEF_INTERVAL*MILLISEC_TO_NANOSEC;
 		} else if(options->mode_cs==SERVER || options->mode_cs==LOOPBACK_SERVER) {
 			// Set the default timeout value if no explicit value was defined
-			options->interval=SERVER_DEF_TIMEOUT;
+			options->interval_ns=(uint64_t) SERVER_DEF_TIMEOUT*MILLISEC_TO_NANOSEC;
 		}
 	}
 
+	// 'interval' keeps storing the same value in ms, as it is used to compute the client and server timeouts
+	options->interval=options->interval_ns/MILLISEC_TO_NANOSEC;
+
 	// Important note: when adding futher protocols that cannot support, somehow, raw sockets, always check for -r not being set
 
 	// Check for -L and -B/-U consistency (-L supported only with -B in clients, -L supported only with -U in servers, otherwise, it is ignored)
@@ -700,6 +1260,22 @@ void options_free(struct options *options) {
 	if(options->Wfilename) {
 		free(options->Wfilename);
 	}
+
+	if(options->interim_filename) {
+		free(options->interim_filename);
+	}
+
+	if(options->trace_filename) {
+		free(options->trace_filename);
+	}
+
+	if(options->pcapng_filename) {
+		free(options->pcapng_filename);
+	}
+
+	if(options->shm_stats_name) {
+		free(options->shm_stats_name);
+	}
 }
 
 void options_set_destIPaddr(struct options *options, struct in_addr destIPaddr) {
@@ -709,4 +1285,9 @@ void options_set_destIPaddr(struct options *options, struct in_addr destIPaddr)
 const char * latencyTypePrinter(latencytypes_t latencyType) {
 	// enum can be used as index array, provided that the order inside the definition of latencytypes_t is the same as the one inside latencyTypes[]
 	return latencyTypes[latencyType];
+}
+
+const char * clockSourcePrinter(clocksource_t clockSource) {
+	// Same as latencyTypePrinter(), with the order of clocksource_t
+	return clockSources[clockSource];
 }
\ No newline at end of file
@@ -0,0 +1,316 @@
+#include "pcapng_writer.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include "version.h"
+
+// Block types
+#define PCAPNG_BT_SHB 0x0A0D0D0A
+#define PCAPNG_BT_IDB 0x00000001
+#define PCAPNG_BT_EPB 0x00000006
+
+#define PCAPNG_BYTE_ORDER_MAGIC 0x1A2B3C4D
+
+// Option codes
+#define PCAPNG_OPT_ENDOFOPT 0
+#define PCAPNG_OPT_COMMENT 1
+#define PCAPNG_OPT_SHB_USERAPPL 4
+#define PCAPNG_OPT_IF_NAME 2
+#define PCAPNG_OPT_IF_TSRESOL 9
+#define PCAPNG_OPT_EPB_FLAGS 2
+
+// if_tsresol: 10^-9 s, i.e. all the timestamps are written with ns resolution
+#define PCAPNG_TSRESOL_NS 9
+
+// Maximum length of the EPB comment carrying the timestamps ("user=<20 digits> kernel=<20 digits> hw=<20 digits> req_tx=<20 digits>")
+#define PCAPNG_STAMPS_COMMENT_MAX_LEN 128
+
+// Size of the IPv4 (without options) and UDP headers rebuilt for the packets of non-raw sockets
+#define PCAPNG_IPV4_HDR_LEN 20
+#define PCAPNG_UDP_HDR_LEN 8
+
+#define PCAPNG_PAD4(len) (((len)+3) & ~((size_t) 3))
+
+// Options are always followed by opt_endofopt: 4 bytes for the option header + the padded value
+#define PCAPNG_OPT_LEN(len) (4+PCAPNG_PAD4(len))
+
+static const uint8_t zeroPad[4]={0,0,0,0};
+
+static int pcapngPut(pcapngWriter *pw, const void *data, size_t len) {
+	if(len==0) {
+		return 0;
+	}
+
+	return fwrite(data,1,len,pw->file)==len ? 0 : -1;
+}
+
+static int pcapngPutU32(pcapngWriter *pw, uint32_t value) {
+	return pcapngPut(pw,&value,sizeof(value));
+}
+
+// Write a single option, padding its value to 32 bits
+static int pcapngPutOption(pcapngWriter *pw, uint16_t code, const void *value, uint16_t len) {
+	uint16_t opt_hdr[2]={code,len};
+
+	if(pcapngPut(pw,opt_hdr,sizeof(opt_hdr))<0 || pcapngPut(pw,value,len)<0) {
+		return -1;
+	}
+
+	return pcapngPut(pw,zeroPad,PCAPNG_PAD4(len)-len);
+}
+
+static int pcapngPutEndOfOpt(pcapngWriter *pw) {
+	return pcapngPutOption(pw,PCAPNG_OPT_ENDOFOPT,NULL,0);
+}
+
+static int pcapngWriteSHB(pcapngWriter *pw) {
+	const char *userappl=PROG_NAME_SHORT " " VERSION;
+	uint32_t block_len=28+PCAPNG_OPT_LEN(strlen(userappl))+4;
+	uint16_t version[2]={1,0};
+	int64_t section_len=-1; // Not specified
+
+	if(pcapngPutU32(pw,PCAPNG_BT_SHB)<0 || pcapngPutU32(pw,block_len)<0 || pcapngPutU32(pw,PCAPNG_BYTE_ORDER_MAGIC)<0 ||
+		pcapngPut(pw,version,sizeof(version))<0 || pcapngPut(pw,&section_len,sizeof(section_len))<0 ||
+		pcapngPutOption(pw,PCAPNG_OPT_SHB_USERAPPL,userappl,strlen(userappl))<0 || pcapngPutEndOfOpt(pw)<0) {
+		return -1;
+	}
+
+	return pcapngPutU32(pw,block_len);
+}
+
+static int pcapngWriteIDB(pcapngWriter *pw, const char *ifname, const char *comment) {
+	uint8_t tsresol=PCAPNG_TSRESOL_NS;
+	uint16_t linktype_reserved[2]={pw->linktype,0};
+	uint32_t snaplen=0; // No limit
+	uint32_t block_len=20+PCAPNG_OPT_LEN(sizeof(tsresol))+4;
+
+	if(ifname!=NULL && ifname[0]!='\0') {
+		block_len+=PCAPNG_OPT_LEN(strlen(ifname));
+	}
+
+	if(comment!=NULL && comment[0]!='\0') {
+		block_len+=PCAPNG_OPT_LEN(strlen(comment));
+	}
+
+	if(pcapngPutU32(pw,PCAPNG_BT_IDB)<0 || pcapngPutU32(pw,block_len)<0 ||
+		pcapngPut(pw,linktype_reserved,sizeof(linktype_reserved))<0 || pcapngPutU32(pw,snaplen)<0) {
+		return -1;
+	}
+
+	if(ifname!=NULL && ifname[0]!='\0' && pcapngPutOption(pw,PCAPNG_OPT_IF_NAME,ifname,strlen(ifname))<0) {
+		return -1;
+	}
+
+	if(pcapngPutOption(pw,PCAPNG_OPT_IF_TSRESOL,&tsresol,sizeof(tsresol))<0) {
+		return -1;
+	}
+
+	if(comment!=NULL && comment[0]!='\0' && pcapngPutOption(pw,PCAPNG_OPT_COMMENT,comment,strlen(comment))<0) {
+		return -1;
+	}
+
+	if(pcapngPutEndOfOpt(pw)<0) {
+		return -1;
+	}
+
+	return pcapngPutU32(pw,block_len);
+}
+
+/* Open 'filename' (overwriting it, or appending a new section to it if 'append' is 1, e.g. for the sessions of a server in
+continuous daemon mode) and write the section and interface headers.
+'comment' is stored inside the interface description (it can be NULL).
+Return values:
+0: ok
+<0: error (see the PCAPNG_E* macros in pcapng_writer.h)
+*/
+int pcapngOpen(pcapngWriter *pw, const char *filename, uint8_t append, uint16_t linktype, const char *ifname, const char *comment) {
+	pw->linktype=linktype;
+	pw->ip_id=0;
+	pw->packets=0;
+	pw->writeErrors=0;
+	pw->buffer=NULL;
+
+	pw->file=fopen(filename,append ? "ab" : "wb");
+	if(pw->file==NULL) {
+		return PCAPNG_EOPEN;
+	}
+
+	// If the buffer cannot be allocated, the (smaller) default stdio buffer is used
+	pw->buffer=malloc(PCAPNG_BUFFER_SIZE);
+	if(pw->buffer!=NULL) {
+		setvbuf(pw->file,pw->buffer,_IOFBF,PCAPNG_BUFFER_SIZE);
+	}
+
+	if(pcapngWriteSHB(pw)<0 || pcapngWriteIDB(pw,ifname,comment)<0) {
+		fclose(pw->file);
+		free(pw->buffer);
+		pw->file=NULL;
+		pw->buffer=NULL;
+		return PCAPNG_EWRITE;
+	}
+
+	errno=pthread_mutex_init(&(pw->mut),NULL);
+	if(errno!=0) {
+		fclose(pw->file);
+		free(pw->buffer);
+		pw->file=NULL;
+		pw->buffer=NULL;
+		return PCAPNG_EMUTEX;
+	}
+
+	return 0;
+}
+
+// Write an Enhanced Packet Block, made of 'prefix' (e.g. the rebuilt IPv4/UDP headers) followed by 'data' (must be called with 'mut' held)
+static int pcapngWriteEPB(pcapngWriter *pw, uint32_t direction, const uint8_t *prefix, size_t prefix_len, const uint8_t *data, size_t len, const pcapngStamps *stamps) {
+	char comment[PCAPNG_STAMPS_COMMENT_MAX_LEN];
+	int comment_len=0;
+	uint32_t block_len;
+	uint32_t ts[2];
+	uint32_t caplen=prefix_len+len;
+	uint64_t ts_ns;
+	struct timespec now;
+
+	// The packet timestamp is the most precise one which is available: hardware, then kernel, then the current wall clock time
+	// (the application level timestamps may come from a clock which is not related to the UNIX epoch, see --clock)
+	if(stamps->hw_ns!=0) {
+		ts_ns=stamps->hw_ns;
+	} else if(stamps->kernel_ns!=0) {
+		ts_ns=stamps->kernel_ns;
+	} else {
+		clock_gettime(CLOCK_REALTIME,&now);
+		ts_ns=(uint64_t) now.tv_sec*1000000000+now.tv_nsec;
+	}
+
+	ts[0]=(uint32_t) (ts_ns>>32);
+	ts[1]=(uint32_t) ts_ns;
+
+	// All the available timestamps are stored inside the comment, in ns
+	if(stamps->user_ns!=0) {
+		comment_len+=snprintf(comment+comment_len,sizeof(comment)-comment_len,"user=%" PRIu64,stamps->user_ns);
+	}
+	if(stamps->kernel_ns!=0) {
+		comment_len+=snprintf(comment+comment_len,sizeof(comment)-comment_len,"%skernel=%" PRIu64,comment_len>0 ? " " : "",stamps->kernel_ns);
+	}
+	if(stamps->hw_ns!=0) {
+		comment_len+=snprintf(comment+comment_len,sizeof(comment)-comment_len,"%shw=%" PRIu64,comment_len>0 ? " " : "",stamps->hw_ns);
+	}
+	if(stamps->req_tx_ns!=0) {
+		comment_len+=snprintf(comment+comment_len,sizeof(comment)-comment_len,"%sreq_tx=%" PRIu64,comment_len>0 ? " " : "",stamps->req_tx_ns);
+	}
+
+	block_len=28+PCAPNG_PAD4(caplen)+PCAPNG_OPT_LEN(sizeof(direction))+4+4;
+	if(comment_len>0) {
+		block_len+=PCAPNG_OPT_LEN(comment_len);
+	}
+
+	if(pcapngPutU32(pw,PCAPNG_BT_EPB)<0 || pcapngPutU32(pw,block_len)<0 || pcapngPutU32(pw,0)<0 || // Interface 0
+		pcapngPut(pw,ts,sizeof(ts))<0 || pcapngPutU32(pw,caplen)<0 || pcapngPutU32(pw,caplen)<0 ||
+		pcapngPut(pw,prefix,prefix_len)<0 || pcapngPut(pw,data,len)<0 || pcapngPut(pw,zeroPad,PCAPNG_PAD4(caplen)-caplen)<0) {
+		return -1;
+	}
+
+	if(pcapngPutOption(pw,PCAPNG_OPT_EPB_FLAGS,&direction,sizeof(direction))<0) {
+		return -1;
+	}
+
+	if(comment_len>0 && pcapngPutOption(pw,PCAPNG_OPT_COMMENT,comment,comment_len)<0) {
+		return -1;
+	}
+
+	if(pcapngPutEndOfOpt(pw)<0) {
+		return -1;
+	}
+
+	return pcapngPutU32(pw,block_len);
+}
+
+// Write a whole Ethernet frame (PCAPNG_LINKTYPE_ETHERNET), sent or received (PCAPNG_DIR_*) through a raw socket
+int pcapngWriteFrame(pcapngWriter *pw, uint32_t direction, const uint8_t *frame, size_t len, const pcapngStamps *stamps) {
+	int ret;
+
+	pthread_mutex_lock(&(pw->mut));
+
+	ret=pcapngWriteEPB(pw,direction,NULL,0,frame,len,stamps);
+	if(ret<0) {
+		pw->writeErrors++;
+	} else {
+		pw->packets++;
+	}
+
+	pthread_mutex_unlock(&(pw->mut));
+
+	return ret;
+}
+
+// Write a UDP payload (PCAPNG_LINKTYPE_RAW), sent or received (PCAPNG_DIR_*) through a non-raw socket, from 'src' to 'dst'
+// The IPv4 header is rebuilt with a valid checksum, while the UDP checksum is set to 0 (i.e. not computed, which is valid over IPv4)
+int pcapngWriteUDP(pcapngWriter *pw, uint32_t direction, const struct sockaddr_in *src, const struct sockaddr_in *dst, const uint8_t *payload, size_t len, const pcapngStamps *stamps) {
+	uint16_t hdrs16[(PCAPNG_IPV4_HDR_LEN+PCAPNG_UDP_HDR_LEN)/2];
+	uint8_t *hdrs=(uint8_t *) hdrs16;
+	uint32_t csum=0;
+	uint16_t ip_len, udp_len;
+	int ret;
+
+	if(len>UINT16_MAX-sizeof(hdrs16)) {
+		len=UINT16_MAX-sizeof(hdrs16);
+	}
+
+	ip_len=htons(sizeof(hdrs16)+len);
+	udp_len=htons(PCAPNG_UDP_HDR_LEN+len);
+
+	pthread_mutex_lock(&(pw->mut));
+
+	memset(hdrs16,0,sizeof(hdrs16));
+	hdrs[0]=0x45; // Version 4, IHL 5
+	memcpy(&hdrs[2],&ip_len,sizeof(ip_len));
+	hdrs16[2]=htons(pw->ip_id++);
+	hdrs[6]=0x40; // Don't fragment
+	hdrs[8]=64; // TTL
+	hdrs[9]=IPPROTO_UDP;
+	memcpy(&hdrs[12],&(src->sin_addr.s_addr),4);
+	memcpy(&hdrs[16],&(dst->sin_addr.s_addr),4);
+
+	for(int i=0;i<PCAPNG_IPV4_HDR_LEN/2;i++) {
+		csum+=hdrs16[i];
+	}
+	while(csum>>16) {
+		csum=(csum & 0xFFFF)+(csum>>16);
+	}
+	hdrs16[5]=(uint16_t) ~csum;
+
+	memcpy(&hdrs[PCAPNG_IPV4_HDR_LEN],&(src->sin_port),2);
+	memcpy(&hdrs[PCAPNG_IPV4_HDR_LEN+2],&(dst->sin_port),2);
+	memcpy(&hdrs[PCAPNG_IPV4_HDR_LEN+4],&udp_len,sizeof(udp_len));
+
+	ret=pcapngWriteEPB(pw,direction,hdrs,sizeof(hdrs16),payload,len,stamps);
+	if(ret<0) {
+		pw->writeErrors++;
+	} else {
+		pw->packets++;
+	}
+
+	pthread_mutex_unlock(&(pw->mut));
+
+	return ret;
+}
+
+// Flush the remaining data and close the file
+void pcapngClose(pcapngWriter *pw) {
+	if(pw->file==NULL) {
+		return;
+	}
+
+	if(fclose(pw->file)!=0) {
+		pw->writeErrors++;
+	}
+
+	free(pw->buffer);
+	pthread_mutex_destroy(&(pw->mut));
+
+	pw->file=NULL;
+	pw->buffer=NULL;
+}
@@ -7,6 +7,9 @@
 #include <unistd.h>
 #include <time.h>
 #include <math.h>
+#include <stdlib.h>
+#include "timer_man.h"
+#include "stats_page.h"
 
 // Condidence interval array sizes
 #define TSTUDSIZE90 125
@@ -20,6 +23,10 @@
 
 #define TSTUDTHRS_INCR 0.001
 
+// Statistics of all the sessions of a daemon server: each session updates only its own report, merged here when it ends
+static reportStructure sessionsReport;
+static uint64_t sessionsCount=0;
+
 // Static function to compute ts, to be used to compute the confidence intervals
 /* 	It tries to emulate functions such as MATLAB's tinv(), but without inverting the Student's T cumulative distribution,
 	guaranteeing a precision of 3 decimal digits over the returned values.
@@ -111,6 +118,7 @@ void reportStructureInit(reportStructure *report, uint16_t initialSeqNumber, uin
 	report->packetCount=0;
 	report->totalPackets=totalPackets;
 	report->errorsCount=0;
+	report->clockStepsCount=0;
 
 	report->variance=0;
 
@@ -122,20 +130,59 @@ void reportStructureInit(reportStructure *report, uint16_t initialSeqNumber, uin
 
 	report->_welfordM2=0;
 
+	hdrHistInit(&report->_latencyHist);
+
 	for(int i=0;i<CONFINT_NUMBER;i++) {
 		report->confidenceIntervalDev[i]=-1.0;
 	}
+
+	for(int i=0;i<REPORT_PERCENTILES_NUMBER;i++) {
+		report->percentiles[i]=0;
+	}
+
+	report->jitter=-1.0;
+	report->ipdvMin=INT64_MAX;
+	report->ipdvMax=INT64_MIN;
+	report->ipdvAbsAverage=0;
+
+	report->_lastTripTime=0;
+	report->_ipdvCount=0;
+	hdrHistInit(&report->_ipdvPosHist);
+	hdrHistInit(&report->_ipdvNegHist);
+
+	for(int i=0;i<REPORT_IPDV_PERCENTILES_NUMBER;i++) {
+		report->ipdvPercentiles[i]=0;
+	}
+
+	report->reorderedCount=0;
+	report->maxReorderExtent=0;
+	report->duplicateCount=0;
+	report->lossBurstCount=0;
+	report->maxLossBurstLength=0;
+	report->gilbertP=-1.0;
+	report->gilbertR=-1.0;
+
+	for(int i=0;i<SEQ_WINDOW_LOSS_BURST_BINS;i++) {
+		report->lossBurstLengths[i]=0;
+	}
+
+	// The packets lost before the first received one are detected too, as the window starts from the first expected sequence number
+	seqWindowInit(&report->_seqWindow,initialSeqNumber);
+	report->_initialSeqNumber=initialSeqNumber;
+	report->_seqWindowEnabled=1;
 }
 
-void reportStructureUpdate(reportStructure *report, uint64_t tripTime, uint16_t seqNumber) {
+void reportStructureUpdate(reportStructure *report, uint64_t tripTime, uint64_t seqNumber) {
+	int64_t tripTimeDiff;
+
 	report->packetCount++;
 
+	// Packets with timestamping errors have been received anyway: they are taken into account for the loss and reordering statistics
+	if(report->_seqWindowEnabled) {
+		seqWindowUpdate(&report->_seqWindow,seqNumber);
+	}
+
 	if(tripTime!=0) {
-		// Set _lastSeqNumber on first update
-		if(report->_isFirstUpdate==1) {
-			report->_lastSeqNumber = seqNumber==0 ? UINT16_MAX : seqNumber-1;
-			report->_isFirstUpdate=0;
-		}
 
 		report->_welfordAverageLatencyOld=report->averageLatency;
 		report->averageLatency+=(tripTime-report->averageLatency)/report->packetCount;
@@ -150,12 +197,46 @@ void reportStructureUpdate(reportStructure *report, uint64_t tripTime, uint16_t
 
 		// An out of order packet is detected if any decreasing sequence number trend is detected in the sequence of packets.
 		// The out of order count is related here to the number of times a decreasing sequence number is detected.
-		// When the last sequence number is 65535 (UINT16_MAX), due to cyclic numbers, the expected current one is 0
-		// This should not be detected as an error, as it is the only situation in which a decreasing sequence number is expected
-		if(report->_lastSeqNumber==UINT16_MAX ? seqNumber!=0 : seqNumber<=report->_lastSeqNumber) {
+		// As extended (64-bit) sequence numbers are used, no wrap-around has to be taken into account
+		if(report->_isFirstUpdate==1) {
+			report->_isFirstUpdate=0;
+		} else if(seqNumber<=report->_lastSeqNumber) {
 			report->outOfOrderCount++;
 		}
 
+		// Delay variation metrics, computed online from the trip times of two consecutively received packets:
+		// - RFC 3550 interarrival jitter: D(i-1,i)=(R_i-R_i-1)-(S_i-S_i-1) is equal to the difference between the two trip times
+		// - RFC 5481 IPDV: the same difference, but only when the two packets have consecutive sequence numbers
+		// The RFC 5481 PDV (trip time - minimum trip time) distribution, instead, is directly obtained from the latency percentiles
+		if(report->_lastTripTime!=0) {
+			tripTimeDiff=(int64_t) (tripTime-report->_lastTripTime);
+
+			if(report->jitter<0) {
+				report->jitter=0;
+			}
+			report->jitter+=((double) llabs(tripTimeDiff)-report->jitter)/16;
+
+			if(seqNumber==report->_lastSeqNumber+1) {
+				report->_ipdvCount++;
+				report->ipdvAbsAverage+=((double) llabs(tripTimeDiff)-report->ipdvAbsAverage)/report->_ipdvCount;
+
+				if(tripTimeDiff<report->ipdvMin) {
+					report->ipdvMin=tripTimeDiff;
+				}
+
+				if(tripTimeDiff>report->ipdvMax) {
+					report->ipdvMax=tripTimeDiff;
+				}
+
+				if(tripTimeDiff>=0) {
+					hdrHistRecord(&report->_ipdvPosHist,(uint64_t) tripTimeDiff);
+				} else {
+					hdrHistRecord(&report->_ipdvNegHist,(uint64_t) -tripTimeDiff);
+				}
+			}
+		}
+		report->_lastTripTime=tripTime;
+
 		// Set last sequence number
 		report->_lastSeqNumber=seqNumber;
 
@@ -164,6 +245,8 @@ void reportStructureUpdate(reportStructure *report, uint64_t tripTime, uint16_t
 		if(report->packetCount>1) {
 			report->variance=report->_welfordM2/(report->packetCount-1);
 		}
+
+		hdrHistRecord(&report->_latencyHist,tripTime);
 	} else {
 		// If tripTime is zero, a timestamping error occurred: count the current packet as a packet containing an error
 		// This packet will be counter as received, but it will not be used to compute the final statistics
@@ -171,21 +254,286 @@ void reportStructureUpdate(reportStructure *report, uint64_t tripTime, uint16_t
 	}
 }
 
+/* Merge the statistics gathered inside 'src' into 'dst', e.g. to combine the reports privately kept by several threads or flows,
+without sharing any report on the hot path.
+Mean and variance are combined with Chan et al.'s parallel algorithm, while the latency histograms are summed bucket by bucket.
+The counters are summed too: the out of order count of the merged report is the sum of the per-flow ones.
+The RFC 3550 jitter, which depends on the order of the packets, cannot be merged exactly: the average of the per-flow values,
+weighted by their number of packets, is used.
+reportStructureFinalize() should be called on 'dst' only after all the merges, to get the percentiles of the whole data set, and on
+each 'src' before merging it, in order to classify all its sequence numbers as received or lost.
+*/
+void reportStructureMerge(reportStructure *dst, const reportStructure *src) {
+	double delta;
+	uint64_t dstValues, srcValues;
+
+	// Number of values used to compute the mean (the same weight used by reportStructureUpdate())
+	dstValues=dst->packetCount;
+	srcValues=src->packetCount;
+
+	dst->packetCount+=src->packetCount;
+	dst->outOfOrderCount+=src->outOfOrderCount;
+	dst->totalPackets+=src->totalPackets;
+	dst->errorsCount+=src->errorsCount;
+	dst->clockStepsCount+=src->clockStepsCount;
+
+	seqWindowMerge(&dst->_seqWindow,&src->_seqWindow);
+
+	dst->reorderedCount+=src->reorderedCount;
+	dst->duplicateCount+=src->duplicateCount;
+	dst->lossBurstCount+=src->lossBurstCount;
+
+	if(src->maxReorderExtent>dst->maxReorderExtent) {
+		dst->maxReorderExtent=src->maxReorderExtent;
+	}
+
+	if(src->maxLossBurstLength>dst->maxLossBurstLength) {
+		dst->maxLossBurstLength=src->maxLossBurstLength;
+	}
+
+	for(int i=0;i<SEQ_WINDOW_LOSS_BURST_BINS;i++) {
+		dst->lossBurstLengths[i]+=src->lossBurstLengths[i];
+	}
+
+	seqWindowGilbert(&dst->_seqWindow,&dst->gilbertP,&dst->gilbertR);
+
+	// 'src' does not contain any valid latency value: only the counters have to be merged
+	if(src->minLatency==UINT64_MAX) {
+		return;
+	}
+
+	if(dst->minLatency==UINT64_MAX) {
+		// 'dst' does not contain any valid latency value yet: just take the 'src' statistics
+		dst->averageLatency=src->averageLatency;
+		dst->_welfordM2=src->_welfordM2;
+		dst->_lastSeqNumber=src->_lastSeqNumber;
+		dst->_isFirstUpdate=src->_isFirstUpdate;
+	} else {
+		delta=src->averageLatency-dst->averageLatency;
+
+		dst->averageLatency+=delta*srcValues/(dstValues+srcValues);
+		dst->_welfordM2+=src->_welfordM2+delta*delta*dstValues*srcValues/(dstValues+srcValues);
+	}
+
+	if(dst->packetCount>1) {
+		dst->variance=dst->_welfordM2/(dst->packetCount-1);
+	}
+
+	if(src->jitter>=0) {
+		dst->jitter=dst->jitter<0 ? src->jitter : (dst->jitter*dstValues+src->jitter*srcValues)/(dstValues+srcValues);
+	}
+
+	if(src->_ipdvCount>0) {
+		dst->ipdvAbsAverage=(dst->ipdvAbsAverage*dst->_ipdvCount+src->ipdvAbsAverage*src->_ipdvCount)/(dst->_ipdvCount+src->_ipdvCount);
+		dst->_ipdvCount+=src->_ipdvCount;
+
+		if(src->ipdvMin<dst->ipdvMin) {
+			dst->ipdvMin=src->ipdvMin;
+		}
+
+		if(src->ipdvMax>dst->ipdvMax) {
+			dst->ipdvMax=src->ipdvMax;
+		}
+	}
+
+	if(src->minLatency<dst->minLatency) {
+		dst->minLatency=src->minLatency;
+	}
+
+	if(src->maxLatency>dst->maxLatency) {
+		dst->maxLatency=src->maxLatency;
+	}
+
+	hdrHistMerge(&dst->_latencyHist,&src->_latencyHist);
+	hdrHistMerge(&dst->_ipdvPosHist,&src->_ipdvPosHist);
+	hdrHistMerge(&dst->_ipdvNegHist,&src->_ipdvNegHist);
+}
+
+/* Add the (finalized) report of a daemon server session to the statistics of all the sessions, printed by printSessionsStats().
+As the server does not know how many packets each client sent, the total is given by the received packets (without the duplicates)
+and by the ones detected as lost by the receive window. */
+void reportSessionsAdd(const reportStructure *report) {
+	uint64_t totalPackets;
+
+	if(sessionsCount==0) {
+		reportStructureInit(&sessionsReport,0,0,report->latencyType,report->followupMode);
+	}
+
+	totalPackets=sessionsReport.totalPackets;
+	reportStructureMerge(&sessionsReport,report);
+	sessionsReport.totalPackets=totalPackets+report->packetCount-report->_seqWindow.duplicateCount+report->_seqWindow.lossCount;
+
+	sessionsCount++;
+}
+
+// Print the statistics of all the sessions added with reportSessionsAdd() (if any)
+void printSessionsStats(FILE *stream, uint8_t confidenceIntervalsMask) {
+	if(sessionsCount==0) {
+		return;
+	}
+
+	reportStructureFinalize(&sessionsReport);
+
+	fprintf(stream,"\nStatistics over all the %" PRIu64 " unidirectional sessions:\n",sessionsCount);
+	printStats(&sessionsReport,stream,confidenceIntervalsMask);
+}
+
+// Value at 'percentile' of the (signed) IPDV distribution, stored inside two histograms: the negative values are ranked first,
+// with the largest absolute values (i.e. the smallest IPDV values) first
+static int64_t ipdvValueAtPercentile(reportStructure *report, double percentile) {
+	uint64_t negTotal=report->_ipdvNegHist.total;
+	uint64_t rank;
+
+	rank=(uint64_t) ceil(percentile/100.0*(negTotal+report->_ipdvPosHist.total));
+	if(rank==0) {
+		rank=1;
+	}
+
+	if(rank<=negTotal) {
+		return -(int64_t) hdrHistValueAtRank(&report->_ipdvNegHist,negTotal-rank+1);
+	}
+
+	return (int64_t) hdrHistValueAtRank(&report->_ipdvPosHist,rank-negTotal);
+}
+
 void reportStructureFinalize(reportStructure *report) {
+	const double percentileValues[REPORT_PERCENTILES_NUMBER]={50.0,90.0,99.0,99.9,99.99};
+	const double ipdvPercentileValues[REPORT_IPDV_PERCENTILES_NUMBER]={0.1,1.0,50.0,99.0,99.9};
 	double stderr;
 
-	// Standard error - in us
+	// Standard error - in ns
 	stderr=sqrt(report->variance/report->packetCount);
 
 	// Compute confidence intervals using Student's T distribution
 	for(int i=0;i<CONFINT_NUMBER;i++) {
 		report->confidenceIntervalDev[i]=tsCalculator(report->packetCount-1,i)*stderr;
 	}
+
+	// Classify all the sequence numbers, then compute the reordering and loss burst statistics
+	// As for the percentiles, keep the values received from the server when no packet was tracked locally
+	if(report->_seqWindowEnabled && report->_seqWindow.highest>=0) {
+		// When the number of packets is known, the ones lost after the last received packet are classified too
+		seqWindowFlush(&report->_seqWindow,report->totalPackets>0 ? (int64_t) (report->_initialSeqNumber+report->totalPackets-1) : -1);
+
+		report->reorderedCount=report->_seqWindow.reorderedCount;
+		report->maxReorderExtent=report->_seqWindow.maxReorderExtent;
+		report->duplicateCount=report->_seqWindow.duplicateCount;
+		report->lossBurstCount=report->_seqWindow.lossBurstCount;
+		report->maxLossBurstLength=report->_seqWindow.maxLossBurstLength;
+		seqWindowGilbert(&report->_seqWindow,&report->gilbertP,&report->gilbertR);
+
+		for(int i=0;i<SEQ_WINDOW_LOSS_BURST_BINS;i++) {
+			report->lossBurstLengths[i]=report->_seqWindow.lossBurstLengths[i];
+		}
+	}
+
+	// Compute the percentiles only when latency values have been recorded locally, not to overwrite the ones received
+	// from the server (unidirectional mode)
+	if(report->_latencyHist.total>0) {
+		for(int i=0;i<REPORT_PERCENTILES_NUMBER;i++) {
+			report->percentiles[i]=hdrHistValueAtPercentile(&report->_latencyHist,percentileValues[i]);
+
+			// Keep the percentiles inside the actual [min,max] range, as the histogram has a limited resolution
+			if(report->percentiles[i]<report->minLatency) {
+				report->percentiles[i]=report->minLatency;
+			} else if(report->percentiles[i]>report->maxLatency) {
+				report->percentiles[i]=report->maxLatency;
+			}
+		}
+	}
+
+	// The same applies to the IPDV percentiles
+	if(report->_ipdvPosHist.total+report->_ipdvNegHist.total>0) {
+		for(int i=0;i<REPORT_IPDV_PERCENTILES_NUMBER;i++) {
+			report->ipdvPercentiles[i]=ipdvValueAtPercentile(report,ipdvPercentileValues[i]);
+
+			if(report->ipdvPercentiles[i]<report->ipdvMin) {
+				report->ipdvPercentiles[i]=report->ipdvMin;
+			} else if(report->ipdvPercentiles[i]>report->ipdvMax) {
+				report->ipdvPercentiles[i]=report->ipdvMax;
+			}
+		}
+	}
+}
+
+/* Publish the current statistics of 'report' inside the live statistics page (--shm-stats), if one has been opened.
+'tripTime' is the value just passed to reportStructureUpdate() (0 = no new value, e.g. after reportStructureFinalize()): it is
+recorded inside the histogram of the page, instead of copying the whole histogram each time. */
+void reportStructurePublish(const reportStructure *report, uint64_t tripTime) {
+	statsPageSession *session;
+
+	session=statsPageWriteBegin();
+	if(session==NULL) {
+		return;
+	}
+
+	session->updates++;
+	session->total_packets=report->totalPackets;
+	session->packet_count=report->packetCount;
+	session->errors_count=report->errorsCount;
+	session->out_of_order_count=report->outOfOrderCount;
+
+	// Without a locally tracked receive window (e.g. unidirectional client), use the values received from the server
+	if(report->_seqWindowEnabled && report->_seqWindow.highest>=0) {
+		session->reordered_count=report->_seqWindow.reorderedCount;
+		session->duplicate_count=report->_seqWindow.duplicateCount;
+		session->loss_count=report->_seqWindow.lossCount;
+		session->loss_burst_count=report->_seqWindow.lossBurstCount;
+		session->max_loss_burst_length=report->_seqWindow.maxLossBurstLength;
+	} else {
+		session->reordered_count=report->reorderedCount;
+		session->duplicate_count=report->duplicateCount;
+		session->loss_count=report->totalPackets>report->packetCount ? report->totalPackets-report->packetCount : 0;
+		session->loss_burst_count=report->lossBurstCount;
+		session->max_loss_burst_length=report->maxLossBurstLength;
+	}
+
+	session->min_latency=report->minLatency;
+	session->max_latency=report->maxLatency;
+	session->average_latency=report->averageLatency;
+	session->variance=report->variance;
+	session->jitter=report->jitter;
+
+	for(int i=0;i<STATSPAGE_PERCENTILES_NUMBER && i<REPORT_PERCENTILES_NUMBER;i++) {
+		session->percentiles[i]=report->percentiles[i];
+	}
+
+	if(tripTime!=0) {
+		hdrHistRecord(&session->hist,tripTime);
+	}
+
+	statsPageWriteEnd();
+}
+
+/* Parse the report received from the server.
+The reports of older servers do not start with REPORT_NS_TAG, carry only the first 8 fields and express the latency values in us:
+these values are converted to ns, while all the other statistics are left to their "not available" values. */
+void reportStructureParse(reportStructure *report, const char *str) {
+	if(repscanf(str,&(*report))>0) {
+		return;
+	}
+
+	if(sscanf(str,"%" SCNu64 "-%lf-%" SCNu64 "-%" SCNu64 "-%" SCNu64 "-%" SCNu64 "-%d-%lf",
+		&report->minLatency,&report->averageLatency,&report->maxLatency,&report->packetCount,
+		&report->outOfOrderCount,&report->errorsCount,(int *) &report->latencyType,&report->variance)<3) {
+		return;
+	}
+
+	// A server which did not receive any valid packet sends UINT64_MAX as minimum value
+	if(report->minLatency!=UINT64_MAX) {
+		report->minLatency*=MICROSEC_TO_NANOSEC;
+	}
+
+	report->averageLatency*=MICROSEC_TO_NANOSEC;
+	report->maxLatency*=MICROSEC_TO_NANOSEC;
+	report->variance*=(double) MICROSEC_TO_NANOSEC*MICROSEC_TO_NANOSEC;
 }
 
 void printStats(reportStructure *report, FILE *stream, uint8_t confidenceIntervalsMask) {
 	int i;
 	const char *confidenceIntervalLabels[]={".90",".95",".99"};
+	const char *percentileLabels[]={"50","90","99","99.9","99.99"};
+	const char *ipdvPercentileLabels[]={"0.1","1","50","99","99.9"};
 
 	if(report->minLatency==UINT64_MAX) {
 		// No packets have been received (or they all caused timestamping errors)
@@ -208,24 +556,57 @@ void printStats(reportStructure *report, FILE *stream, uint8_t confidenceInterva
 
 		// Latency/RTT is computed over all the correctly received packets, excluding all the packets which caused timestamping errors (counted by report->errorsCount)
 		fprintf(stream,"Latency over %" PRIu64 " packets:\n"
-			"(%s)%s Minimum: %.3f ms - Maximum: %.3f ms - Average: %.3f ms\n"
-			"Standard Dev.: %.4f ms\n",
+			"(%s)%s Minimum: %.6f ms - Maximum: %.6f ms - Average: %.6f ms\n"
+			"Standard Dev.: %.6f ms\n",
 			report->totalPackets-report->errorsCount,
 			latencyTypePrinter(report->latencyType),
 			report->followupMode!=FOLLOWUP_OFF ? " (follow-up)" : "",
-			report->minLatency==UINT64_MAX ? 0 : ((double) report->minLatency)/1000, 
-			((double) report->maxLatency)/1000,
-			report->averageLatency/1000,
-			sqrt(report->variance)/1000);
+			report->minLatency==UINT64_MAX ? 0 : ((double) report->minLatency)/MILLISEC_TO_NANOSEC, 
+			((double) report->maxLatency)/MILLISEC_TO_NANOSEC,
+			report->averageLatency/MILLISEC_TO_NANOSEC,
+			sqrt(report->variance)/MILLISEC_TO_NANOSEC);
 
 		// Print only the confidence intervals which were requested
 		for(i=0;i<CONFINT_NUMBER;i++) {
 			if(confidenceIntervalsMask & (1<<i)) {
-				fprintf(stream,"Confidence intervals (%s): [%.3f ; %.3f] ms\n",
+				fprintf(stream,"Confidence intervals (%s): [%.6f ; %.6f] ms\n",
 					confidenceIntervalLabels[i],
-					report->averageLatency-report->confidenceIntervalDev[i]<0?0:(report->averageLatency-report->confidenceIntervalDev[i])/1000,
-					(report->averageLatency+report->confidenceIntervalDev[i])/1000);
+					report->averageLatency-report->confidenceIntervalDev[i]<0?0:(report->averageLatency-report->confidenceIntervalDev[i])/MILLISEC_TO_NANOSEC,
+					(report->averageLatency+report->confidenceIntervalDev[i])/MILLISEC_TO_NANOSEC);
+			}
+		}
+
+		// Percentiles are not available when they are not sent by the server (unidirectional mode with an older server)
+		if(report->percentiles[0]!=0) {
+			fprintf(stream,"Percentiles:");
+			for(i=0;i<REPORT_PERCENTILES_NUMBER;i++) {
+				fprintf(stream,"%s p%s: %.6f ms",i==0 ? "" : " -",percentileLabels[i],((double) report->percentiles[i])/MILLISEC_TO_NANOSEC);
 			}
+			fprintf(stream,"\n");
+
+			// RFC 5481 PDV: each trip time is referred to the minimum one
+			fprintf(stream,"PDV (RFC 5481):");
+			for(i=0;i<REPORT_PERCENTILES_NUMBER;i++) {
+				fprintf(stream,"%s p%s: %.6f ms",i==0 ? "" : " -",percentileLabels[i],((double) (report->percentiles[i]-report->minLatency))/MILLISEC_TO_NANOSEC);
+			}
+			fprintf(stream,"\n");
+		}
+
+		if(report->jitter>=0) {
+			fprintf(stream,"Jitter (RFC 3550): %.6f ms\n",report->jitter/MILLISEC_TO_NANOSEC);
+		}
+
+		if(report->ipdvMin<=report->ipdvMax) {
+			fprintf(stream,"IPDV (RFC 5481): Minimum: %.6f ms - Maximum: %.6f ms - Average of abs. values: %.6f ms\n",
+				((double) report->ipdvMin)/MILLISEC_TO_NANOSEC,
+				((double) report->ipdvMax)/MILLISEC_TO_NANOSEC,
+				report->ipdvAbsAverage/MILLISEC_TO_NANOSEC);
+
+			fprintf(stream,"IPDV percentiles:");
+			for(i=0;i<REPORT_IPDV_PERCENTILES_NUMBER;i++) {
+				fprintf(stream,"%s p%s: %.6f ms",i==0 ? "" : " -",ipdvPercentileLabels[i],((double) report->ipdvPercentiles[i])/MILLISEC_TO_NANOSEC);
+			}
+			fprintf(stream,"\n");
 		}
 
 		// Negative percentages (should never enter here)
@@ -247,11 +628,87 @@ void printStats(reportStructure *report, FILE *stream, uint8_t confidenceInterva
 
 		fprintf(stream, "Out of order count (approx. as the number of times a decreasing seq. number is detected): %" PRIu64 "\n",
 			report->outOfOrderCount);
+
+		if(report->gilbertP>=0) {
+			fprintf(stream,"Reordered packets (RFC 4737): %" PRIu64 " - Max. reordering extent: %" PRIu64 " packets - Duplicates: %" PRIu64 "\n",
+				report->reorderedCount,
+				report->maxReorderExtent,
+				report->duplicateCount);
+
+			fprintf(stream,"Loss bursts: %" PRIu64 " - Max. loss burst length: %" PRIu64 " packets\n",
+				report->lossBurstCount,
+				report->maxLossBurstLength);
+
+			if(report->lossBurstCount>0) {
+				fprintf(stream,"Loss burst lengths (packets: bursts):");
+				for(i=0;i<SEQ_WINDOW_LOSS_BURST_BINS;i++) {
+					if(report->lossBurstLengths[i]>0) {
+						fprintf(stream," %s%d: %" PRIu64,i==SEQ_WINDOW_LOSS_BURST_BINS-1 ? ">=" : "",i+1,report->lossBurstLengths[i]);
+					}
+				}
+				fprintf(stream,"\n");
+			}
+
+			if(report->gilbertR>=0) {
+				// With random losses p+r is close to 1, while bursty losses (e.g. due to fading) lead to a much smaller r
+				// Simple (two parameter) Gilbert model: no losses in the good state, no received packets in the bad one
+				fprintf(stream,"Simple Gilbert loss model: p (received->lost): %.6f - r (lost->received): %.6f - Avg. loss burst length: %.2f packets\n",
+					report->gilbertP,
+					report->gilbertR,
+					1/report->gilbertR);
+			}
+		}
+	}
+
+	if(report->clockStepsCount>0) {
+		fprintf(stream,"Warning: %" PRIu64 " wall clock step(s) detected during the test: the latency values measured across them\n"
+			"\t are not reliable. With '-L u', consider using a monotonic clock source (--clock monoraw or --clock tsc).\n",
+			report->clockStepsCount);
+	}
+}
+
+// Allocate and initialize one report structure for each position inside a burst (--burst mode)
+// The packets in position 'i' are the ones with 'seq % burst_size == i', as each burst starts with a multiple of 'burst_size'
+// NULL is returned if memory cannot be allocated
+reportStructure *burstReportsInit(unsigned int burst_size, uint64_t totalPackets, latencytypes_t latencyType, modefollowup_t followupMode) {
+	reportStructure *reports;
+
+	reports=malloc(burst_size*sizeof(reportStructure));
+
+	if(reports!=NULL) {
+		for(unsigned int i=0;i<burst_size;i++) {
+			reportStructureInit(&reports[i], i, totalPackets/burst_size+(i<totalPackets%burst_size ? 1 : 0), latencyType, followupMode);
+
+			// Each report only gets one packet every 'burst_size': the receive window would detect all the others as lost
+			reports[i]._seqWindowEnabled=0;
+		}
 	}
 
-	if(report->totalPackets>UINT16_MAX) {
-		fprintf(stream,"Note: the number of packets is very large. Since it causes the sequence numbers to cyclically reset,\n"
-			"\t the out of order count may be inaccurate, in the order of +- <number of resets that occurred>.\n");
+	return reports;
+}
+
+// Set the number of packets expected by each burst position report, when only the first 'totalPackets' packets have been sent (e.g. after an interruption)
+void burstReportsSetTotalPackets(reportStructure *reports, unsigned int burst_size, uint64_t totalPackets) {
+	for(unsigned int i=0;i<burst_size;i++) {
+		reports[i].totalPackets=totalPackets/burst_size+(i<totalPackets%burst_size ? 1 : 0);
+	}
+}
+
+void printBurstStats(reportStructure *reports, unsigned int burst_size, FILE *stream) {
+	fprintf(stream,"\nStatistics for each position inside a burst of %u packets:\n",burst_size);
+
+	for(unsigned int i=0;i<burst_size;i++) {
+		if(reports[i].minLatency==UINT64_MAX) {
+			fprintf(stream,"[%u] Minimum: - ms - Maximum: - ms - Average: - ms - Lost packets: 100%%\n",i);
+		} else {
+			fprintf(stream,"[%u] Minimum: %.6f ms - Maximum: %.6f ms - Average: %.6f ms - Standard Dev.: %.6f ms - Lost packets: %.2f%%\n",
+				i,
+				((double) reports[i].minLatency)/MILLISEC_TO_NANOSEC,
+				((double) reports[i].maxLatency)/MILLISEC_TO_NANOSEC,
+				reports[i].averageLatency/MILLISEC_TO_NANOSEC,
+				sqrt(reports[i].variance)/MILLISEC_TO_NANOSEC,
+				((double) reports[i].totalPackets-(double) reports[i].packetCount)*100/reports[i].totalPackets);
+		}
 	}
 }
 
@@ -285,7 +742,7 @@ int printStatsCSV(struct options *opts, reportStructure *report, const char *fil
 
 		if(opts->overwrite || !fileAlreadyExists) {
 			// Recreate CSV first line
-			dprintf(csvfp,"Date,Time,ClientMode,SocketType,Protocol,UP,PayloadLen-B,TotReqPackets,Interval-s,LatencyType,FollowUp,MinLatency-ms,MaxLatency-ms,AvgLatency-ms,LostPackets-Perc,ErrorsCount,OutOfOrderCountDecr,StDev-ms,ConfInt90-,ConfInt90+,ConfInt95-,ConfInt95+,ConfInt99-,ConfInt99+\n");
+			dprintf(csvfp,"Date,Time,ClientMode,SocketType,Protocol,UP,PayloadLen-B,TotReqPackets,Interval-s,LatencyType,FollowUp,MinLatency-ms,MaxLatency-ms,AvgLatency-ms,LostPackets-Perc,ErrorsCount,OutOfOrderCountDecr,StDev-ms,ConfInt90-,ConfInt90+,ConfInt95-,ConfInt95+,ConfInt99-,ConfInt99+,P50-ms,P90-ms,P99-ms,P99.9-ms,P99.99-ms,Jitter-ms,IPDVMin-ms,IPDVMax-ms,IPDVAbsAvg-ms,PDV99-ms,PDV99.9-ms,IPDVP0.1-ms,IPDVP1-ms,IPDVP50-ms,IPDVP99-ms,IPDVP99.9-ms,Reordered,MaxReorderExtent,Duplicates,LossBursts,MaxLossBurst,GilbertP,GilbertR\n");
 		}
 
 		// Set lostPktPerc depending on the sign of report->totalPackets-report->packetCount (the negative sign should never occur in normal program operations)
@@ -301,7 +758,7 @@ int printStatsCSV(struct options *opts, reportStructure *report, const char *fil
 		dprintf(csvfp,"%d-%02d-%02d,%02d:%02d:%02d,",currdate->tm_year+1900,currdate->tm_mon+1,currdate->tm_mday,currdate->tm_hour,currdate->tm_min,currdate->tm_sec);
 
 		// Save current mode (unidirectional or pinglike) and socket type
-		dprintf(csvfp,"%s,%s,",opts->mode_ub==UNIDIR ? "Unidirectional" : "Pinglike",opts->mode_raw==RAW ? "Raw" : "Non raw");
+		dprintf(csvfp,"%s,%s,",opts->mode_ub==UNIDIR ? "Unidirectional" : "Pinglike",opts->mode_raw==NON_RAW ? "Non raw" : (opts->mode_raw==XDP ? "AF_XDP" : "Raw"));
 
 		// Save current protocol (even if UDP only is supported as of now, it can be convenient to write a switch-case statement, to allow an easier future extensibility of the code with other protocols)
 		switch(opts->protocol) {
@@ -317,43 +774,97 @@ int printStatsCSV(struct options *opts, reportStructure *report, const char *fil
 		dprintf(csvfp,"%d," 		// macUP
 			"%" PRIu16 ","			// payloadLen
 			"%" PRIu64 ","			// total number of packets requested
-			"%.3f,"					// interval between packets (in s)
+			"%.9f,"					// interval between packets (in s)
 			"%s,"					// latency type (-L)
 			"%s,"					// follow-up (-F)
-			"%.3f,"					// minLatency
-			"%.3f,"					// maxLatency
-			"%.3f,"					// avgLatency
+			"%.6f,"					// minLatency
+			"%.6f,"					// maxLatency
+			"%.6f,"					// avgLatency
 			"%.2f,"					// lost packets (perc)
 			"%" PRIu64 ","			// errors count
 			"%" PRIu64 ","			// out-of-order count
-			"%.4f,",				// standard deviation
+			"%.6f,",				// standard deviation
 			opts->macUP==UINT8_MAX ? 0 : opts->macUP,																				// macUP (UNSET is interpreted as '0', as AC_BE seems to be used when it is not explicitly defined)
 			opts->payloadlen,																										// out-of-order count (# of decreasing sequence breaks)
 			opts->number,																											// total number of packets requested
-			((double) opts->interval)/1000,																							// interval between packets (in s)
+			((double) opts->interval_ns)/SEC_TO_NANOSEC,																				// interval between packets (in s)
 			latencyTypePrinter(report->latencyType),																				// latency type (-L)
 			report->followupMode!=FOLLOWUP_OFF ? "On" : "Off",																		// follow-up (-F)					
-			report->minLatency==UINT64_MAX ? 0 : ((double) report->minLatency)/1000,												// minLatency
-			((double) report->maxLatency)/1000,																						// maxLatency
-			report->minLatency==UINT64_MAX ? 0 : report->averageLatency/1000,														// avgLatency
+			report->minLatency==UINT64_MAX ? 0 : ((double) report->minLatency)/MILLISEC_TO_NANOSEC,												// minLatency
+			((double) report->maxLatency)/MILLISEC_TO_NANOSEC,																						// maxLatency
+			report->minLatency==UINT64_MAX ? 0 : report->averageLatency/MILLISEC_TO_NANOSEC,														// avgLatency
 			lostPktPerc,																											// lost packets (perc)
 			report->errorsCount,																									// errors count
 			report->outOfOrderCount,																								// Out-of-order count
-			sqrt(report->variance)/1000);																							// standard deviation (sqrt of variance)
+			sqrt(report->variance)/MILLISEC_TO_NANOSEC);																							// standard deviation (sqrt of variance)
 
 		// Save confidence intervals data
 		for(int i=0;i<CONFINT_NUMBER;i++) {
 			dprintf(csvfp,
-				"%.3f,"
-				"%.3f",
-				report->averageLatency-report->confidenceIntervalDev[i]<0?0:(report->averageLatency-report->confidenceIntervalDev[i])/1000,
-				(report->averageLatency+report->confidenceIntervalDev[i])/1000);
+				"%.6f,"
+				"%.6f",
+				report->averageLatency-report->confidenceIntervalDev[i]<0?0:(report->averageLatency-report->confidenceIntervalDev[i])/MILLISEC_TO_NANOSEC,
+				(report->averageLatency+report->confidenceIntervalDev[i])/MILLISEC_TO_NANOSEC);
 
-			if(i<CONFINT_NUMBER-1) {
-				dprintf(csvfp,",");
-			} else {
-				dprintf(csvfp,"\n");
+			dprintf(csvfp,",");
+		}
+
+		// Save percentiles data (empty fields when they are not available)
+		for(int i=0;i<REPORT_PERCENTILES_NUMBER;i++) {
+			if(report->percentiles[i]!=0) {
+				dprintf(csvfp,"%.6f",((double) report->percentiles[i])/MILLISEC_TO_NANOSEC);
 			}
+
+			dprintf(csvfp,",");
+		}
+
+		// Save jitter, IPDV and PDV data (empty fields when they are not available)
+		if(report->jitter>=0) {
+			dprintf(csvfp,"%.6f",report->jitter/MILLISEC_TO_NANOSEC);
+		}
+		dprintf(csvfp,",");
+
+		if(report->ipdvMin<=report->ipdvMax) {
+			dprintf(csvfp,"%.6f,%.6f,%.6f,",
+				((double) report->ipdvMin)/MILLISEC_TO_NANOSEC,
+				((double) report->ipdvMax)/MILLISEC_TO_NANOSEC,
+				report->ipdvAbsAverage/MILLISEC_TO_NANOSEC);
+		} else {
+			dprintf(csvfp,",,,");
+		}
+
+		if(report->percentiles[0]!=0) {
+			dprintf(csvfp,"%.6f,%.6f,",
+				((double) (report->percentiles[2]-report->minLatency))/MILLISEC_TO_NANOSEC,
+				((double) (report->percentiles[3]-report->minLatency))/MILLISEC_TO_NANOSEC);
+		} else {
+			dprintf(csvfp,",,");
+		}
+
+		for(int i=0;i<REPORT_IPDV_PERCENTILES_NUMBER;i++) {
+			if(report->ipdvMin<=report->ipdvMax) {
+				dprintf(csvfp,"%.6f",((double) report->ipdvPercentiles[i])/MILLISEC_TO_NANOSEC);
+			}
+
+			dprintf(csvfp,",");
+		}
+
+		// Save reordering and loss burst data (empty fields when they are not available)
+		if(report->gilbertP>=0) {
+			dprintf(csvfp,"%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%.6f,",
+				report->reorderedCount,
+				report->maxReorderExtent,
+				report->duplicateCount,
+				report->lossBurstCount,
+				report->maxLossBurstLength,
+				report->gilbertP);
+
+			if(report->gilbertR>=0) {
+				dprintf(csvfp,"%.6f",report->gilbertR);
+			}
+			dprintf(csvfp,"\n");
+		} else {
+			dprintf(csvfp,",,,,,,\n");
 		}
 
 		close(csvfp);
@@ -383,25 +894,22 @@ int openTfile(const char *Tfilename,int followup_on_flag) {
 	}
 
 	// Write CSV file header, depending on the followup_on_flag flag value
-	if(followup_on_flag==0) {
-		dprintf(csvfd,"Sequence Number,RTT/Latency,Error\n");
-	} else {
-		dprintf(csvfd,"Sequence Number,RTT/Latency,Est server processing time,Error\n");
-	}
+	dprintf(csvfd,"%s",tFileHeaderLine(followup_on_flag));
 
 	return csvfd;
 }
 
 int writeToTFile(int Tfiledescriptor,int followup_on_flag,int decimal_digits,uint64_t seqNo,uint64_t tripTime,uint64_t tripTimeProc) {
-	int dprintf_ret_val;
+	char record[TFILE_RECORD_MAX_LEN];
+	int record_len;
 
-	if(followup_on_flag==0) {
-		dprintf_ret_val=dprintf(Tfiledescriptor,"%" PRIu64 ",%.*f,%d\n",seqNo,decimal_digits,(double)tripTime/1000,tripTime==0 ? 1 : 0);
-	} else {
-		dprintf_ret_val=dprintf(Tfiledescriptor,"%" PRIu64 ",%.*f,%.*f,%d\n",seqNo,decimal_digits,(double)tripTime/1000,decimal_digits,(double)tripTimeProc/1000,tripTime==0 ? 1 : 0);
+	record_len=sprintTRecord(record,TFILE_RECORD_MAX_LEN,followup_on_flag,decimal_digits,seqNo,tripTime,tripTimeProc);
+
+	if(record_len<0 || record_len>=TFILE_RECORD_MAX_LEN) {
+		return -1;
 	}
 
-	return dprintf_ret_val;
+	return write(Tfiledescriptor,record,record_len);
 }
 
 void closeTfile(int Tfiledescriptor) {
@@ -0,0 +1,96 @@
+// recvmmsg() is Linux-specific: _GNU_SOURCE is required in order to get its declaration
+#define _GNU_SOURCE
+#include "rx_batch.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Allocate the buffers for receiving up to 'size' datagrams of up to 'buf_size' bytes each, with a single recvmmsg() call.
+Return values:
+0: ok
+<0: error (see the RXBATCH_E* macros in rx_batch.h)
+*/
+int rxBatchCreate(rxBatch *batch, unsigned int size, size_t buf_size) {
+	batch->size=size;
+	batch->buf_size=buf_size;
+	batch->msgs_nr=0;
+	batch->msgs_idx=0;
+
+	batch->bufs=malloc((size_t) size*buf_size);
+	batch->ctrl_bufs=malloc((size_t) size*RX_BATCH_CTRL_SIZE);
+	batch->addrs=malloc(size*sizeof(struct sockaddr_in));
+	batch->iovs=malloc(size*sizeof(struct iovec));
+	batch->msgs=malloc(size*sizeof(struct mmsghdr));
+
+	if(!batch->bufs || !batch->ctrl_bufs || !batch->addrs || !batch->iovs || !batch->msgs) {
+		rxBatchDestroy(batch);
+		return RXBATCH_EMALLOC;
+	}
+
+	memset(batch->msgs,0,size*sizeof(struct mmsghdr));
+	for(unsigned int i=0;i<size;i++) {
+		batch->iovs[i].iov_base=batch->bufs+i*buf_size;
+		batch->iovs[i].iov_len=buf_size;
+
+		batch->msgs[i].msg_hdr.msg_iov=&(batch->iovs[i]);
+		batch->msgs[i].msg_hdr.msg_iovlen=1;
+	}
+
+	return 0;
+}
+
+/* Get the next received datagram: when all the datagrams of the current batch have already been returned, a new batch is
+received with recvmmsg(), waiting (up to the SO_RCVTIMEO timeout) only for the first datagram (MSG_WAITFORONE).
+'*data' points to the datagram and '*mhdr' to its message header (storing the source address inside 'msg_name' and the
+ancillary data, e.g. the kernel timestamps, inside 'msg_control'): both are valid until the next call to rxBatchRecv().
+Return values (as recvfrom()):
+>=0: datagram length
+-1: error (errno is set to EAGAIN if the timeout expired)
+*/
+ssize_t rxBatchRecv(rxBatch *batch, int sFd, byte_t **data, struct msghdr **mhdr) {
+	int recv_retval;
+
+	if(batch->msgs_idx>=batch->msgs_nr) {
+		// The name and control lengths are overwritten by the kernel: reset them before each call
+		for(unsigned int i=0;i<batch->size;i++) {
+			batch->msgs[i].msg_hdr.msg_name=&(batch->addrs[i]);
+			batch->msgs[i].msg_hdr.msg_namelen=sizeof(struct sockaddr_in);
+			batch->msgs[i].msg_hdr.msg_control=batch->ctrl_bufs+(size_t) i*RX_BATCH_CTRL_SIZE;
+			batch->msgs[i].msg_hdr.msg_controllen=RX_BATCH_CTRL_SIZE;
+			batch->msgs[i].msg_hdr.msg_flags=0;
+		}
+
+		while((recv_retval=recvmmsg(sFd,batch->msgs,batch->size,MSG_WAITFORONE,NULL))==-1 && errno==EINTR);
+
+		if(recv_retval<=0) {
+			batch->msgs_nr=0;
+			batch->msgs_idx=0;
+			return -1;
+		}
+
+		batch->msgs_nr=(unsigned int) recv_retval;
+		batch->msgs_idx=0;
+	}
+
+	*data=batch->iovs[batch->msgs_idx].iov_base;
+	*mhdr=&(batch->msgs[batch->msgs_idx].msg_hdr);
+
+	return (ssize_t) batch->msgs[batch->msgs_idx++].msg_len;
+}
+
+// Free all the buffers
+void rxBatchDestroy(rxBatch *batch) {
+	free(batch->bufs);
+	free(batch->ctrl_bufs);
+	free(batch->addrs);
+	free(batch->iovs);
+	free(batch->msgs);
+
+	batch->bufs=NULL;
+	batch->ctrl_bufs=NULL;
+	batch->addrs=NULL;
+	batch->iovs=NULL;
+	batch->msgs=NULL;
+	batch->msgs_nr=0;
+	batch->msgs_idx=0;
+}
@@ -0,0 +1,171 @@
+#include "rx_ring.h"
+#include <errno.h>
+#include <sys/time.h>
+#include <string.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <linux/net_tstamp.h>
+#include "timer_man.h"
+
+static inline struct tpacket_block_desc *rxRingBlock(rxRing *ring, unsigned int idx) {
+	return (struct tpacket_block_desc *) (ring->map+(size_t) idx*RX_RING_BLOCK_SIZE);
+}
+
+/* Create a TPACKET_V3 RX ring on the (already bound) socket 'sFd'.
+The receive timeout currently set with SO_RCVTIMEO is applied to rxRingRecv() too.
+Return values:
+0: ok
+<0: error (see the RXRING_E* macros in rx_ring.h)
+*/
+int rxRingCreate(rxRing *ring, int sFd, int hw_timestamps) {
+	struct tpacket_req3 req;
+	struct timeval rcvtimeo;
+	socklen_t rcvtimeoLen=sizeof(rcvtimeo);
+	int version=TPACKET_V3;
+
+	ring->descriptor=sFd;
+	ring->map=MAP_FAILED;
+	ring->block=NULL;
+	ring->frame=NULL;
+	ring->frames_left=0;
+	ring->block_idx=0;
+
+	if(getsockopt(sFd,SOL_SOCKET,SO_RCVTIMEO,&rcvtimeo,&rcvtimeoLen)==0 && (rcvtimeo.tv_sec!=0 || rcvtimeo.tv_usec!=0)) {
+		ring->timeout_ms=rcvtimeo.tv_sec*SEC_TO_MILLISEC+rcvtimeo.tv_usec/MILLISEC_TO_MICROSEC;
+	} else {
+		ring->timeout_ms=INDEFINITE_BLOCK;
+	}
+
+	if(setsockopt(sFd,SOL_PACKET,PACKET_VERSION,&version,sizeof(version))!=0) {
+		return RXRING_ESETSOCKOPT;
+	}
+
+	if(hw_timestamps && rxRingSetHwTimestamps(ring,1)<0) {
+		return RXRING_ESETSOCKOPT;
+	}
+
+	memset(&req,0,sizeof(req));
+	req.tp_block_size=RX_RING_BLOCK_SIZE;
+	req.tp_block_nr=RX_RING_BLOCK_NR;
+	req.tp_frame_size=RX_RING_FRAME_SIZE;
+	req.tp_frame_nr=(RX_RING_BLOCK_SIZE/RX_RING_FRAME_SIZE)*RX_RING_BLOCK_NR;
+	req.tp_retire_blk_tov=RX_RING_BLOCK_TIMEOUT;
+	req.tp_feature_req_word=0;
+
+	if(setsockopt(sFd,SOL_PACKET,PACKET_RX_RING,&req,sizeof(req))!=0) {
+		return RXRING_ESETSOCKOPT;
+	}
+
+	ring->map_size=(size_t) RX_RING_BLOCK_SIZE*RX_RING_BLOCK_NR;
+	ring->map=mmap(NULL,ring->map_size,PROT_READ | PROT_WRITE,MAP_SHARED | MAP_LOCKED,sFd,0);
+	if(ring->map==MAP_FAILED) {
+		// Retry without MAP_LOCKED, which may fail when RLIMIT_MEMLOCK is too low
+		ring->map=mmap(NULL,ring->map_size,PROT_READ | PROT_WRITE,MAP_SHARED,sFd,0);
+	}
+
+	if(ring->map==MAP_FAILED) {
+		// Release the ring, so that the socket can be used again with recvfrom()/recvmsg()
+		memset(&req,0,sizeof(req));
+		setsockopt(sFd,SOL_PACKET,PACKET_RX_RING,&req,sizeof(req));
+		return RXRING_EMMAP;
+	}
+
+	return 0;
+}
+
+/* Request (enable=1) or stop requesting (enable=0) raw hardware timestamps in the frame headers.
+When hardware timestamps are not available for a frame, the kernel falls back to software ones (and 'ts_hw' is = 0).
+Return values:
+0: ok
+-1: setsockopt() error
+*/
+int rxRingSetHwTimestamps(rxRing *ring, int enable) {
+	int tstamp=enable ? SOF_TIMESTAMPING_RAW_HARDWARE : 0;
+
+	if(setsockopt(ring->descriptor,SOL_PACKET,PACKET_TIMESTAMP,&tstamp,sizeof(tstamp))!=0) {
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Get the next received frame, waiting up to 'timeout_ms' for a new block to be handed over by the kernel.
+The block containing the previously returned frame is given back to the kernel as soon as all its frames have been returned.
+Return values (as recvfrom()):
+>=0: frame length
+-1: error (errno is set to EAGAIN if the timeout expired)
+*/
+ssize_t rxRingRecv(rxRing *ring, rxRingFrame *frame) {
+	struct pollfd pfd;
+	int poll_retval;
+	struct sockaddr_ll *sll;
+	struct tpacket3_hdr *hdr;
+
+	if(ring->frames_left==0) {
+		// Release the current block, if any, and move to the next one
+		if(ring->block!=NULL) {
+			__sync_synchronize();
+			ring->block->hdr.bh1.block_status=TP_STATUS_KERNEL;
+			ring->block=NULL;
+			ring->block_idx=(ring->block_idx+1)%RX_RING_BLOCK_NR;
+		}
+
+		// Wait for the next block to be retired by the kernel
+		while(!(rxRingBlock(ring,ring->block_idx)->hdr.bh1.block_status & TP_STATUS_USER)) {
+			pfd.fd=ring->descriptor;
+			pfd.events=POLLIN | POLLERR;
+			pfd.revents=0;
+
+			poll_retval=poll(&pfd,1,ring->timeout_ms);
+
+			if(poll_retval==0) {
+				errno=EAGAIN;
+				return -1;
+			} else if(poll_retval<0 && errno!=EINTR) {
+				return -1;
+			}
+		}
+
+		__sync_synchronize();
+		ring->block=rxRingBlock(ring,ring->block_idx);
+		ring->frames_left=ring->block->hdr.bh1.num_pkts;
+		ring->frame=(struct tpacket3_hdr *) (((byte_t *) ring->block)+ring->block->hdr.bh1.offset_to_first_pkt);
+
+		// A block may be retired by the timer with no frames at all
+		if(ring->frames_left==0) {
+			return rxRingRecv(ring,frame);
+		}
+	}
+
+	hdr=ring->frame;
+	sll=(struct sockaddr_ll *) (((byte_t *) hdr)+TPACKET_ALIGN(sizeof(struct tpacket3_hdr)));
+
+	frame->data=((byte_t *) hdr)+hdr->tp_mac;
+	frame->pkttype=sll->sll_pkttype;
+	frame->ts.tv_sec=hdr->tp_sec;
+	frame->ts.tv_nsec=hdr->tp_nsec;
+	frame->ts_hw=(hdr->tp_status & TP_STATUS_TS_RAW_HARDWARE) ? 1 : 0;
+
+	// Move to the next frame inside the same block
+	ring->frames_left--;
+	ring->frame=(struct tpacket3_hdr *) (((byte_t *) hdr)+hdr->tp_next_offset);
+
+	return (ssize_t) hdr->tp_snaplen;
+}
+
+// Unmap and release the ring: after this call, the socket can be used again with recvfrom()/recvmsg()
+void rxRingDestroy(rxRing *ring) {
+	struct tpacket_req3 req;
+
+	if(ring->map!=MAP_FAILED) {
+		munmap(ring->map,ring->map_size);
+		ring->map=MAP_FAILED;
+	}
+
+	memset(&req,0,sizeof(req));
+	setsockopt(ring->descriptor,SOL_PACKET,PACKET_RX_RING,&req,sizeof(req));
+
+	ring->block=NULL;
+	ring->frames_left=0;
+}
@@ -0,0 +1,159 @@
+#include "seq_window.h"
+#include <string.h>
+
+#define SEQ_WINDOW_BIT_TEST(win,seq) ((win)->bitmap[((seq) & SEQ_WINDOW_MASK)/64] & (1ULL<<((seq) & 63)))
+#define SEQ_WINDOW_BIT_SET(win,seq) ((win)->bitmap[((seq) & SEQ_WINDOW_MASK)/64] |= (1ULL<<((seq) & 63)))
+#define SEQ_WINDOW_BIT_CLEAR(win,seq) ((win)->bitmap[((seq) & SEQ_WINDOW_MASK)/64] &= ~(1ULL<<((seq) & 63)))
+
+static inline void lossBurstEnd(seqWindow *win) {
+	if(win->currentBurstLength==0) {
+		return;
+	}
+
+	win->lossBurstCount++;
+	win->lossBurstLengths[(win->currentBurstLength<SEQ_WINDOW_LOSS_BURST_BINS ? win->currentBurstLength : SEQ_WINDOW_LOSS_BURST_BINS)-1]++;
+
+	if(win->currentBurstLength>win->maxLossBurstLength) {
+		win->maxLossBurstLength=win->currentBurstLength;
+	}
+
+	win->currentBurstLength=0;
+}
+
+// Account for 'count' consecutive sequence numbers leaving the window, all received or all lost ('lost'=1)
+static inline void seqWindowClassify(seqWindow *win, uint8_t lost, uint64_t count) {
+	if(lost) {
+		if(win->lastLost==1) {
+			win->transLostLost++;
+		} else if(win->lastLost==0) {
+			win->transRecvLost++;
+		}
+
+		win->transLostLost+=count-1;
+		win->lossCount+=count;
+		win->currentBurstLength+=count;
+	} else {
+		if(win->lastLost==1) {
+			win->transLostRecv++;
+		} else if(win->lastLost==0) {
+			win->transRecvRecv++;
+		}
+
+		win->transRecvRecv+=count-1;
+		lossBurstEnd(win);
+	}
+
+	win->lastLost=lost;
+}
+
+// Classify (and remove from the window) all the sequence numbers up to 'last' (included)
+static void seqWindowEvict(seqWindow *win, int64_t last) {
+	// Sequence numbers which are still inside the window: check them one by one
+	while(win->evicted<=last && win->evicted<=win->highest) {
+		seqWindowClassify(win,!SEQ_WINDOW_BIT_TEST(win,win->evicted),1);
+		SEQ_WINDOW_BIT_CLEAR(win,win->evicted);
+		win->evicted++;
+	}
+
+	// Sequence numbers above the highest received one (i.e. after a jump larger than the window size): all lost
+	if(win->evicted<=last) {
+		seqWindowClassify(win,1,last-win->evicted+1);
+		win->evicted=last+1;
+	}
+}
+
+// 'firstSeqNumber' is the first expected sequence number: if the first packets are lost, they are classified as a loss burst too
+void seqWindowInit(seqWindow *win, uint64_t firstSeqNumber) {
+	memset(win,0,sizeof(seqWindow));
+
+	win->highest=-1;
+	win->evicted=(int64_t) firstSeqNumber;
+	win->lastLost=-1;
+}
+
+void seqWindowUpdate(seqWindow *win, uint64_t seqNumber) {
+	int64_t seq=(int64_t) seqNumber;
+	uint32_t extent;
+
+	win->arrivals++;
+
+	// Nothing received yet: all the sequence numbers from the first expected one are missing so far
+	if(win->highest<0) {
+		win->highest=win->evicted-1;
+	}
+
+	if(seq>win->highest) {
+		// Make room for the new sequence number, then store, for all the skipped ones, the arrival index of this packet
+		seqWindowEvict(win,seq-SEQ_WINDOW_SIZE);
+
+		for(int64_t i=win->highest+1>win->evicted ? win->highest+1 : win->evicted;i<seq;i++) {
+			win->firstGreaterArrival[i & SEQ_WINDOW_MASK]=win->arrivals;
+		}
+
+		SEQ_WINDOW_BIT_SET(win,seq);
+		win->highest=seq;
+	} else if(seq>=win->evicted) {
+		if(SEQ_WINDOW_BIT_TEST(win,seq)) {
+			win->duplicateCount++;
+		} else {
+			// RFC 4737: a packet is reordered when its sequence number is lower than the next expected one;
+			// its extent is the number of packets received since the first one with a larger sequence number
+			SEQ_WINDOW_BIT_SET(win,seq);
+			win->reorderedCount++;
+
+			extent=win->arrivals-win->firstGreaterArrival[seq & SEQ_WINDOW_MASK];
+			if(extent>win->maxReorderExtent) {
+				win->maxReorderExtent=extent;
+			}
+		}
+	} else {
+		// The window has already moved past this sequence number: it was declared lost, but it is actually a (very) late packet,
+		// or a duplicate which cannot be told apart from it anymore
+		win->reorderedCount++;
+	}
+}
+
+// Classify all the sequence numbers up to 'lastSeqNumber', the last expected one (or up to the highest received one, if it is larger
+// or if 'lastSeqNumber' is < 0, i.e. unknown): to be called once all the packets have been received
+void seqWindowFlush(seqWindow *win, int64_t lastSeqNumber) {
+	if(win->highest>=0) {
+		seqWindowEvict(win,lastSeqNumber>win->highest ? lastSeqNumber : win->highest);
+	}
+	lossBurstEnd(win);
+}
+
+// Add the statistics of 'src' to 'dst' (only the sequence numbers which have already been classified, e.g. after seqWindowFlush())
+void seqWindowMerge(seqWindow *dst, const seqWindow *src) {
+	dst->reorderedCount+=src->reorderedCount;
+	dst->duplicateCount+=src->duplicateCount;
+	dst->lossCount+=src->lossCount;
+	dst->lossBurstCount+=src->lossBurstCount;
+
+	if(src->maxReorderExtent>dst->maxReorderExtent) {
+		dst->maxReorderExtent=src->maxReorderExtent;
+	}
+
+	if(src->maxLossBurstLength>dst->maxLossBurstLength) {
+		dst->maxLossBurstLength=src->maxLossBurstLength;
+	}
+
+	for(int i=0;i<SEQ_WINDOW_LOSS_BURST_BINS;i++) {
+		dst->lossBurstLengths[i]+=src->lossBurstLengths[i];
+	}
+
+	dst->transRecvLost+=src->transRecvLost;
+	dst->transRecvRecv+=src->transRecvRecv;
+	dst->transLostRecv+=src->transLostRecv;
+	dst->transLostLost+=src->transLostLost;
+}
+
+/* Estimate the parameters of the simple Gilbert loss model, from the received/lost transitions:
+'p' is the probability of moving from the good (received) to the bad (lost) state, 'r' the one of moving back.
+Unlike the Gilbert-Elliott model, every packet is received in the good state and lost in the bad one, so that the two parameters
+are directly given by the transitions: 1/r is the average loss burst length and, with random (non bursty) losses, p+r=1.
+'r' is set to -1 when no loss occurred (i.e. the bad state was never observed).
+*/
+void seqWindowGilbert(const seqWindow *win, double *p, double *r) {
+	*p=win->transRecvLost+win->transRecvRecv>0 ? ((double) win->transRecvLost)/(win->transRecvLost+win->transRecvRecv) : 0.0;
+	*r=win->transLostRecv+win->transLostLost>0 ? ((double) win->transLostRecv)/(win->transLostRecv+win->transLostLost) : -1.0;
+}
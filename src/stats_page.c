@@ -0,0 +1,263 @@
+#include "stats_page.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Page published by the current process (statsPageOpen()), shared by all its sessions (NULL = no page)
+static statsPage *page=NULL;
+static char pageName[STATSPAGE_NAME_MAX_LEN];
+// Current (even) value of the seqlock: the page has a single writer at any time, i.e. the thread updating the main report
+static uint64_t pageSeq=0;
+
+// Build the POSIX shared memory object name ("/<name>"), adding the leading '/' if the user did not specify it
+static int statsPageName(char *buf, const char *name) {
+	const char *basename=name[0]=='/' ? name+1 : name;
+
+	if(basename[0]=='\0' || strchr(basename,'/')!=NULL || strlen(basename)+2>STATSPAGE_NAME_MAX_LEN) {
+		return STATSPAGE_ENAME;
+	}
+
+	buf[0]='/';
+	strcpy(buf+1,basename);
+
+	return 0;
+}
+
+static uint64_t realtimeNs(void) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_REALTIME,&now);
+
+	return (uint64_t) now.tv_sec*1000000000ULL+now.tv_nsec;
+}
+
+/* Create the live statistics page 'name' (e.g. "late-server", i.e. /dev/shm/late-server on Linux), readable by any user.
+A page left by a process which is no longer running is reused, while the page of a running process is never overwritten.
+Return values:
+0: ok
+<0: error (see the STATSPAGE_E* macros in stats_page.h)
+*/
+int statsPageOpen(const char *name, uint8_t role) {
+	statsPageReader reader;
+	pid_t owner;
+	int fd;
+	void *map;
+
+	if(statsPageName(pageName,name)<0) {
+		return STATSPAGE_ENAME;
+	}
+
+	fd=shm_open(pageName,O_CREAT | O_EXCL | O_RDWR,S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+
+	if(fd<0 && errno==EEXIST) {
+		if(statsPageAttach(&reader,pageName)<0) {
+			// Not a statistics page (or not a supported one): leave it untouched
+			return STATSPAGE_EEXIST;
+		}
+
+		owner=reader.page->pid;
+		statsPageDetach(&reader);
+
+		if(owner!=getpid() && (kill(owner,0)==0 || errno!=ESRCH)) {
+			return STATSPAGE_EEXIST;
+		}
+
+		fd=shm_open(pageName,O_RDWR,0);
+	}
+
+	if(fd<0) {
+		return STATSPAGE_EOPEN;
+	}
+
+	if(ftruncate(fd,sizeof(statsPage))<0) {
+		close(fd);
+		shm_unlink(pageName);
+		return STATSPAGE_EMMAP;
+	}
+
+	map=mmap(NULL,sizeof(statsPage),PROT_READ | PROT_WRITE,MAP_SHARED,fd,0);
+	close(fd);
+
+	if(map==MAP_FAILED) {
+		shm_unlink(pageName);
+		return STATSPAGE_EMMAP;
+	}
+
+	page=(statsPage *) map;
+
+	// The magic string is written last, so that a reader attaching now either rejects the page or sees it fully initialized
+	memset(page,0,sizeof(statsPage));
+	page->version=STATSPAGE_VERSION;
+	page->role=role;
+	page->page_size=sizeof(statsPage);
+	page->pid=getpid();
+	page->session.state=STATSPAGE_STATE_IDLE;
+	page->session.jitter=-1.0;
+	pageSeq=0;
+
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	memcpy(page->magic,STATSPAGE_MAGIC,sizeof(page->magic));
+
+	return 0;
+}
+
+/* Start updating the statistics of the page (no-op returning NULL if no page has been opened).
+Until statsPageWriteEnd() is called, the readers retry their snapshots: the update should only consist of plain stores. */
+statsPageSession *statsPageWriteBegin(void) {
+	if(page==NULL) {
+		return NULL;
+	}
+
+	// The odd value must be visible before any store to the session data (release fence = store-store barrier)
+	__atomic_store_n(&page->seqlock,pageSeq+1,__ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	return &page->session;
+}
+
+void statsPageWriteEnd(void) {
+	if(page==NULL) {
+		return;
+	}
+
+	pageSeq+=2;
+	__atomic_store_n(&page->seqlock,pageSeq,__ATOMIC_RELEASE);
+}
+
+// Reset the statistics of the page for a new session (each session of a daemon server starts from scratch)
+void statsPageSessionStart(uint16_t lamp_id, uint64_t totalPackets, uint8_t latencyType, uint8_t followup) {
+	statsPageSession *session;
+	uint64_t session_index;
+
+	session=statsPageWriteBegin();
+	if(session==NULL) {
+		return;
+	}
+
+	session_index=session->session_index;
+
+	memset(session,0,sizeof(statsPageSession));
+	session->session_index=session_index+1;
+	session->start_realtime_ns=realtimeNs();
+	session->lamp_id=lamp_id;
+	session->state=STATSPAGE_STATE_RUNNING;
+	session->latency_type=latencyType;
+	session->followup=followup;
+	session->total_packets=totalPackets;
+	session->min_latency=UINT64_MAX;
+	session->jitter=-1.0;
+	hdrHistInit(&session->hist);
+
+	statsPageWriteEnd();
+}
+
+void statsPageSessionEnd(uint8_t state) {
+	statsPageSession *session;
+
+	session=statsPageWriteBegin();
+	if(session==NULL) {
+		return;
+	}
+
+	session->state=state;
+	session->end_realtime_ns=realtimeNs();
+
+	statsPageWriteEnd();
+}
+
+// Unmap and remove the page: the readers which already mapped it can still read its last content
+void statsPageClose(void) {
+	if(page==NULL) {
+		return;
+	}
+
+	munmap(page,sizeof(statsPage));
+	shm_unlink(pageName);
+
+	page=NULL;
+}
+
+/* Map the page 'name' (read-only), checking its header.
+Return values:
+0: ok
+<0: error (see the STATSPAGE_E* macros in stats_page.h)
+*/
+int statsPageAttach(statsPageReader *reader, const char *name) {
+	char fullName[STATSPAGE_NAME_MAX_LEN];
+	struct stat st;
+	void *map;
+	int fd;
+
+	reader->page=NULL;
+
+	if(statsPageName(fullName,name)<0) {
+		return STATSPAGE_ENAME;
+	}
+
+	fd=shm_open(fullName,O_RDONLY,0);
+	if(fd<0) {
+		return STATSPAGE_EOPEN;
+	}
+
+	if(fstat(fd,&st)<0 || (size_t) st.st_size<sizeof(statsPage)) {
+		close(fd);
+		return STATSPAGE_EFORMAT;
+	}
+
+	map=mmap(NULL,sizeof(statsPage),PROT_READ,MAP_SHARED,fd,0);
+	close(fd);
+
+	if(map==MAP_FAILED) {
+		return STATSPAGE_EMMAP;
+	}
+
+	reader->page=(const statsPage *) map;
+
+	if(memcmp(reader->page->magic,STATSPAGE_MAGIC,sizeof(reader->page->magic))!=0 || reader->page->version!=STATSPAGE_VERSION ||
+		reader->page->page_size!=sizeof(statsPage)) {
+		statsPageDetach(reader);
+		return STATSPAGE_EFORMAT;
+	}
+
+	return 0;
+}
+
+/* Copy a consistent snapshot of the session statistics into 'session', retrying while the page is being written.
+Return values:
+0: ok
+STATSPAGE_EBUSY: no consistent snapshot could be taken (e.g. the writer died while updating the page)
+*/
+int statsPageSnapshot(const statsPageReader *reader, statsPageSession *session) {
+	uint64_t seq;
+
+	for(int i=0;i<STATSPAGE_READ_ATTEMPTS;i++) {
+		seq=__atomic_load_n(&reader->page->seqlock,__ATOMIC_ACQUIRE);
+
+		if((seq & 1)==0) {
+			memcpy(session,&reader->page->session,sizeof(statsPageSession));
+
+			// The copy must be complete before the seqlock is read again
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+			if(__atomic_load_n(&reader->page->seqlock,__ATOMIC_RELAXED)==seq) {
+				return 0;
+			}
+		}
+	}
+
+	return STATSPAGE_EBUSY;
+}
+
+void statsPageDetach(statsPageReader *reader) {
+	if(reader->page!=NULL) {
+		munmap((void *) reader->page,sizeof(statsPage));
+	}
+
+	reader->page=NULL;
+}
@@ -0,0 +1,182 @@
+#include "tfile_writer.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include "trace_file.h"
+
+// Write the whole content of the formatting buffer, retrying after partial writes
+static void tFileWriterFlushBlock(tFileWriter *writer, size_t len) {
+	size_t written=0;
+	ssize_t ret;
+
+	while(written<len) {
+		ret=write(writer->descriptor,writer->block+written,len-written);
+
+		if(ret<0) {
+			if(errno==EINTR) {
+				continue;
+			}
+
+			writer->writeErrors++;
+			return;
+		}
+
+		written+=ret;
+	}
+
+	if(writer->sync_policy==TFILE_WRITER_SYNC_BLOCK && fdatasync(writer->descriptor)<0) {
+		writer->writeErrors++;
+	}
+}
+
+// Format and write all the records stored so far, returning the number of records which have been consumed
+static uint64_t tFileWriterDrain(tFileWriter *writer) {
+	uint64_t head, tail, first;
+	size_t len=0;
+	int record_len;
+	tFileRecord *rec;
+
+	head=__atomic_load_n(&(writer->head),__ATOMIC_ACQUIRE);
+	first=writer->tail;
+
+	for(tail=first;tail!=head;tail++) {
+		// Write the current block when the next record may not fit inside it, releasing the slots of the records it contains
+		if(len+TFILE_RECORD_MAX_LEN>TFILE_WRITER_BLOCK_SIZE) {
+			__atomic_store_n(&(writer->tail),tail,__ATOMIC_RELEASE);
+			tFileWriterFlushBlock(writer,len);
+			len=0;
+		}
+
+		rec=&(writer->records[tail & writer->mask]);
+		record_len=sprintTRecord(writer->block+len,TFILE_RECORD_MAX_LEN,writer->followup_on_flag,writer->decimal_digits,rec->seqNo,rec->tripTime,rec->tripTimeProc);
+
+		if(record_len>0 && record_len<TFILE_RECORD_MAX_LEN) {
+			len+=record_len;
+		}
+	}
+
+	__atomic_store_n(&(writer->tail),head,__ATOMIC_RELEASE);
+
+	if(len>0) {
+		tFileWriterFlushBlock(writer,len);
+	}
+
+	return head-first;
+}
+
+static void *tFileWriterLoop(void *arg) {
+	tFileWriter *writer=(tFileWriter *) arg;
+	struct timespec idle={.tv_sec=0,.tv_nsec=TFILE_WRITER_IDLE_US*1000};
+
+	while(!__atomic_load_n(&(writer->stop),__ATOMIC_ACQUIRE)) {
+		// Sleep only when there is nothing to do, to write as large blocks as possible without spinning
+		if(tFileWriterDrain(writer)==0) {
+			nanosleep(&idle,NULL);
+		}
+	}
+
+	// The producer has already stopped: write all the remaining records
+	tFileWriterDrain(writer);
+
+	pthread_exit(NULL);
+}
+
+/* Start the writer thread on the already opened (see openTfile()) file descriptor 'fd', with a ring of 'size' records
+('size' must be a power of two, e.g. TFILE_WRITER_DEFAULT_SIZE).
+Return values:
+0: ok
+<0: error (see the TFILEWRITER_E* macros in tfile_writer.h)
+*/
+int tFileWriterStart(tFileWriter *writer, int fd, uint8_t followup_on_flag, int decimal_digits, unsigned int size, uint8_t sync_policy) {
+	int create_ret;
+
+	writer->records=NULL;
+	writer->block=NULL;
+	writer->mask=0;
+	writer->head=0;
+	writer->tail=0;
+	writer->descriptor=fd;
+	writer->followup_on_flag=followup_on_flag;
+	writer->decimal_digits=decimal_digits;
+	writer->sync_policy=sync_policy;
+	writer->dropped=0;
+	writer->writeErrors=0;
+	writer->running=0;
+	writer->stop=0;
+
+	if(size==0 || (size & (size-1))!=0) {
+		return TFILEWRITER_EINVAL;
+	}
+
+	writer->records=malloc(size*sizeof(tFileRecord));
+	writer->block=malloc(TFILE_WRITER_BLOCK_SIZE);
+	if(writer->records==NULL || writer->block==NULL) {
+		free(writer->records);
+		free(writer->block);
+		writer->records=NULL;
+		writer->block=NULL;
+		return TFILEWRITER_EMALLOC;
+	}
+
+	writer->mask=size-1;
+
+	create_ret=pthread_create(&(writer->tid),NULL,&tFileWriterLoop,(void *) writer);
+	if(create_ret!=0) {
+		free(writer->records);
+		free(writer->block);
+		writer->records=NULL;
+		writer->block=NULL;
+		errno=create_ret;
+		return TFILEWRITER_ETHREAD;
+	}
+
+	writer->running=1;
+
+	return 0;
+}
+
+/* Store a record, to be written by the writer thread (to be called by a single thread, e.g. the Rx loop).
+Return values:
+0: ok
+<0: error (see the TFILEWRITER_E* macros in tfile_writer.h)
+*/
+int tFileWriterPush(tFileWriter *writer, uint64_t seqNo, uint64_t tripTime, uint64_t tripTimeProc) {
+	uint64_t head=writer->head;
+	tFileRecord *rec;
+
+	if(head-__atomic_load_n(&(writer->tail),__ATOMIC_ACQUIRE)>writer->mask) {
+		writer->dropped++;
+		return TFILEWRITER_EFULL;
+	}
+
+	rec=&(writer->records[head & writer->mask]);
+	rec->seqNo=seqNo;
+	rec->tripTime=tripTime;
+	rec->tripTimeProc=tripTimeProc;
+
+	// Publish the record only after it has been completely written
+	__atomic_store_n(&(writer->head),head+1,__ATOMIC_RELEASE);
+
+	return 0;
+}
+
+// Stop the writer thread, after all the stored records have been written, and free the ring (the file descriptor is not closed).
+void tFileWriterStop(tFileWriter *writer) {
+	if(!writer->running) {
+		return;
+	}
+
+	__atomic_store_n(&(writer->stop),1,__ATOMIC_RELEASE);
+	pthread_join(writer->tid,NULL);
+	writer->running=0;
+
+	if(writer->sync_policy==TFILE_WRITER_SYNC_CLOSE && fdatasync(writer->descriptor)<0) {
+		writer->writeErrors++;
+	}
+
+	free(writer->records);
+	free(writer->block);
+	writer->records=NULL;
+	writer->block=NULL;
+}
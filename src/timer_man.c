@@ -1,5 +1,33 @@
 #include "timer_man.h"
 #include <unistd.h>
+#include <errno.h>
+
+// Add 'ns' nanoseconds to the timespec pointed by 'ts', keeping tv_nsec normalized
+static inline void timespecAddNs(struct timespec *ts, uint64_t ns) {
+	ts->tv_sec+=(time_t) (ns/SEC_TO_NANOSEC);
+	ts->tv_nsec+=(long) (ns%SEC_TO_NANOSEC);
+
+	if(ts->tv_nsec>=SEC_TO_NANOSEC) {
+		ts->tv_sec++;
+		ts->tv_nsec-=SEC_TO_NANOSEC;
+	}
+}
+
+// Subtract 'ns' nanoseconds from the timespec pointed by 'ts', keeping tv_nsec normalized
+static inline void timespecSubNs(struct timespec *ts, uint64_t ns) {
+	ts->tv_sec-=(time_t) (ns/SEC_TO_NANOSEC);
+	ts->tv_nsec-=(long) (ns%SEC_TO_NANOSEC);
+
+	if(ts->tv_nsec<0) {
+		ts->tv_sec--;
+		ts->tv_nsec+=SEC_TO_NANOSEC;
+	}
+}
+
+// Returns 1 if 'a' is earlier than 'b', 0 otherwise
+static inline int timespecBefore(struct timespec *a, struct timespec *b) {
+	return a->tv_sec<b->tv_sec || (a->tv_sec==b->tv_sec && a->tv_nsec<b->tv_nsec);
+}
 
 /* This function creates a monotonic increasing timerfd timer and starts it, using as period the time_ms argument (specified in ms).
 Return vale:
@@ -38,4 +66,64 @@ int timerCreateAndSet(struct pollfd *timerMon, int *clockFd, uint64_t time_ms) {
 	}
 
 	return 0;
-}
\ No newline at end of file
+}
+
+/* This function initializes an absolute deadline scheduler with a period of 'interval_ns' nanoseconds.
+The first deadline is set one period after the current time, as it happened with timerCreateAndSet().
+'spin_ns', if different than 0, enables the hybrid sleep-then-spin mode: the thread will sleep until
+'spin_ns' before each deadline and then busy-wait on the clock until the deadline is reached.
+Return value:
+0: ok
+-1: error when reading the current time
+*/
+int txSchedulerInit(txScheduler *sched, uint64_t interval_ns, uint64_t spin_ns) {
+	if(clock_gettime(CLOCK_MONOTONIC,&sched->next_deadline)==-1) {
+		return -1;
+	}
+
+	sched->interval_ns=interval_ns;
+	// The spin window can never be longer than the whole period
+	sched->spin_ns=spin_ns>interval_ns ? interval_ns : spin_ns;
+
+	timespecAddNs(&sched->next_deadline,interval_ns);
+
+	return 0;
+}
+
+/* This function waits until the next deadline is reached, then advances it by one period.
+If the caller is late (i.e. one or more deadlines already expired), it returns immediately, without
+skipping any deadline: the following packets are then sent back-to-back until the schedule is caught up,
+so that no drift is accumulated over the whole test.
+Return value:
+0: ok
+-1: error in clock_nanosleep() or clock_gettime()
+*/
+int txSchedulerWaitNext(txScheduler *sched) {
+	struct timespec wakeup=sched->next_deadline;
+	struct timespec now;
+	int nanosleep_ret;
+
+	if(sched->spin_ns>0) {
+		timespecSubNs(&wakeup,sched->spin_ns);
+	}
+
+	while((nanosleep_ret=clock_nanosleep(CLOCK_MONOTONIC,TIMER_ABSTIME,&wakeup,NULL))==EINTR);
+
+	if(nanosleep_ret!=0) {
+		errno=nanosleep_ret;
+		return -1;
+	}
+
+	// Hybrid mode: spin over the last part of the period, to avoid the timer slack and the wakeup latency of the scheduler
+	if(sched->spin_ns>0) {
+		do {
+			if(clock_gettime(CLOCK_MONOTONIC,&now)==-1) {
+				return -1;
+			}
+		} while(timespecBefore(&now,&sched->next_deadline));
+	}
+
+	timespecAddNs(&sched->next_deadline,sched->interval_ns);
+
+	return 0;
+}
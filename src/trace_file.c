@@ -0,0 +1,252 @@
+// MAP_POPULATE is Linux-specific
+#define _GNU_SOURCE
+#include "trace_file.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// The same as MILLISEC_TO_NANOSEC (timer_man.h), which cannot be included here without the Rawsock library
+#define TRACE_MILLISEC_TO_NANOSEC 1000000
+
+// Minimum number of records added each time a trace has to be extended
+#define TRACE_GROW_MIN_RECORDS 65536
+
+// Format a single packet line of the "-W" CSV file into 'buf' (at most TFILE_RECORD_MAX_LEN characters are needed), returning its length, as snprintf()
+int sprintTRecord(char *buf,size_t size,int followup_on_flag,int decimal_digits,uint64_t seqNo,uint64_t tripTime,uint64_t tripTimeProc) {
+	if(followup_on_flag==0) {
+		return snprintf(buf,size,"%" PRIu64 ",%.*f,%d\n",seqNo,decimal_digits,(double)tripTime/TRACE_MILLISEC_TO_NANOSEC,tripTime==0 ? 1 : 0);
+	} else {
+		return snprintf(buf,size,"%" PRIu64 ",%.*f,%.*f,%d\n",seqNo,decimal_digits,(double)tripTime/TRACE_MILLISEC_TO_NANOSEC,decimal_digits,(double)tripTimeProc/TRACE_MILLISEC_TO_NANOSEC,tripTime==0 ? 1 : 0);
+	}
+}
+
+// Header line of the "-W" CSV file
+const char *tFileHeaderLine(int followup_on_flag) {
+	return followup_on_flag==0 ? "Sequence Number,RTT/Latency,Error\n" : "Sequence Number,RTT/Latency,Est server processing time,Error\n";
+}
+
+// Fill the format related fields of a trace header (the session metadata is left to the caller, zeroed)
+void traceHeaderInit(traceHeader *header) {
+	struct timespec now;
+
+	memset(header,0,sizeof(traceHeader));
+
+	memcpy(header->magic,TRACE_MAGIC,sizeof(header->magic));
+	header->version=TRACE_VERSION;
+	header->header_size=sizeof(traceHeader);
+	header->record_size=sizeof(traceRecord);
+	header->byte_order_mark=TRACE_BYTE_ORDER_MARK;
+
+	clock_gettime(CLOCK_REALTIME,&now);
+	header->start_realtime_ns=(uint64_t) now.tv_sec*1000000000ULL+now.tv_nsec;
+}
+
+// Allocate the file space for 'capacity' records and map the whole file in memory
+static int traceFileMapCapacity(traceFile *trace, uint64_t capacity) {
+	size_t size=sizeof(traceHeader)+capacity*sizeof(traceRecord);
+	void *map;
+
+	// posix_fallocate() returns the error code directly, instead of setting errno
+	errno=posix_fallocate(trace->descriptor,0,size);
+	if(errno!=0) {
+		return TRACEFILE_EALLOC;
+	}
+
+	// Prefault the pages, so that the first record written on each page does not pay a page fault inside the Rx loop
+	map=mmap(NULL,size,PROT_READ | PROT_WRITE,MAP_SHARED | MAP_POPULATE,trace->descriptor,0);
+	if(map==MAP_FAILED) {
+		return TRACEFILE_EMMAP;
+	}
+
+	trace->header=(traceHeader *) map;
+	trace->records=(traceRecord *) ((char *) map+sizeof(traceHeader));
+	trace->capacity=capacity;
+
+	return 0;
+}
+
+/* Create (or overwrite) the binary trace 'filename', with room for 'capacity' records (e.g. the number of packets to be sent):
+the trace is extended automatically if more records are written.
+Return values:
+0: ok
+<0: error (see the TRACEFILE_E* macros in trace_file.h)
+*/
+int traceFileCreate(traceFile *trace, const char *filename, const traceHeader *header, uint64_t capacity) {
+	int ret;
+
+	trace->header=NULL;
+	trace->records=NULL;
+	trace->capacity=0;
+	trace->count=0;
+	trace->dropped=0;
+
+	trace->descriptor=open(filename, O_CREAT | O_TRUNC | O_RDWR, S_IRUSR | S_IWUSR);
+	if(trace->descriptor<0) {
+		return TRACEFILE_EOPEN;
+	}
+
+	ret=traceFileMapCapacity(trace,capacity>0 ? capacity : TRACE_GROW_MIN_RECORDS);
+	if(ret<0) {
+		close(trace->descriptor);
+		unlink(filename);
+		trace->descriptor=-1;
+		return ret;
+	}
+
+	memcpy(trace->header,header,sizeof(traceHeader));
+	trace->header->record_count=0;
+
+	return 0;
+}
+
+/* Append a record to the trace (the mapping is extended, when full: this is the only case in which a system call is performed).
+Return values:
+0: ok
+<0: error (see the TRACEFILE_E* macros in trace_file.h)
+*/
+int traceFileAppend(traceFile *trace, uint64_t seq, uint64_t tx_ns, uint64_t rx_ns, uint64_t proc_ns, uint32_t flags) {
+	traceRecord *record;
+	uint64_t old_capacity;
+
+	// The mapping has been lost by a previous call (see below): no more records can be written
+	if(trace->records==NULL) {
+		trace->dropped++;
+		return TRACEFILE_EFULL;
+	}
+
+	if(trace->count>=trace->capacity) {
+		old_capacity=trace->capacity;
+
+		munmap(trace->header,sizeof(traceHeader)+old_capacity*sizeof(traceRecord));
+
+		if(traceFileMapCapacity(trace,old_capacity+(old_capacity>TRACE_GROW_MIN_RECORDS ? old_capacity : TRACE_GROW_MIN_RECORDS))<0 &&
+			traceFileMapCapacity(trace,old_capacity)<0) {
+			// Not even the old mapping can be restored: no more records can be written
+			trace->header=NULL;
+			trace->records=NULL;
+			trace->capacity=0;
+		}
+
+		if(trace->records==NULL || trace->count>=trace->capacity) {
+			trace->dropped++;
+			return TRACEFILE_EFULL;
+		}
+	}
+
+	record=&(trace->records[trace->count]);
+	record->seq=seq;
+	record->tx_ns=tx_ns;
+	record->rx_ns=rx_ns;
+	record->proc_ns=proc_ns<UINT32_MAX ? proc_ns : UINT32_MAX;
+	record->flags=flags;
+
+	trace->count++;
+
+	return 0;
+}
+
+// Write the number of records inside the header, then unmap and close the trace, truncating it to the size of the valid records
+void traceFileClose(traceFile *trace) {
+	if(trace->descriptor<0) {
+		return;
+	}
+
+	if(trace->header!=NULL) {
+		trace->header->record_count=trace->count;
+		munmap(trace->header,sizeof(traceHeader)+trace->capacity*sizeof(traceRecord));
+
+		if(ftruncate(trace->descriptor,sizeof(traceHeader)+trace->count*sizeof(traceRecord))<0) {
+			perror("ftruncate() error");
+		}
+	}
+
+	close(trace->descriptor);
+
+	trace->descriptor=-1;
+	trace->header=NULL;
+	trace->records=NULL;
+}
+
+/* Map an existing trace in memory (read-only), checking its header.
+When the trace was not closed properly (e.g. the client crashed), the records are read up to the first empty one.
+Return values:
+0: ok
+<0: error (see the TRACEFILE_E* macros in trace_file.h)
+*/
+int traceFileMap(traceFileReader *reader, const char *filename) {
+	struct stat st;
+	void *map;
+	int fd;
+	uint64_t max_count;
+	static const traceRecord emptyRecord;
+
+	reader->header=NULL;
+	reader->records=NULL;
+	reader->count=0;
+	reader->map_size=0;
+
+	fd=open(filename,O_RDONLY);
+	if(fd<0) {
+		return TRACEFILE_EOPEN;
+	}
+
+	if(fstat(fd,&st)<0 || (size_t) st.st_size<sizeof(traceHeader)) {
+		close(fd);
+		return TRACEFILE_EFORMAT;
+	}
+
+	map=mmap(NULL,st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+	close(fd);
+
+	if(map==MAP_FAILED) {
+		return TRACEFILE_EMMAP;
+	}
+
+	reader->header=(const traceHeader *) map;
+	reader->map_size=st.st_size;
+
+	if(memcmp(reader->header->magic,TRACE_MAGIC,sizeof(reader->header->magic))!=0 || reader->header->byte_order_mark!=TRACE_BYTE_ORDER_MARK ||
+		reader->header->version!=TRACE_VERSION || reader->header->header_size!=sizeof(traceHeader) || reader->header->record_size!=sizeof(traceRecord)) {
+		traceFileUnmap(reader);
+		return TRACEFILE_EFORMAT;
+	}
+
+	reader->records=(const traceRecord *) ((const char *) map+sizeof(traceHeader));
+	max_count=(st.st_size-sizeof(traceHeader))/sizeof(traceRecord);
+
+	if(reader->header->record_count>0 && reader->header->record_count<=max_count) {
+		reader->count=reader->header->record_count;
+	} else {
+		while(reader->count<max_count && memcmp(&(reader->records[reader->count]),&emptyRecord,sizeof(traceRecord))!=0) {
+			reader->count++;
+		}
+	}
+
+	return 0;
+}
+
+// Latency (or RTT) of a record, in ns, computed as the client does (0 = timestamping error, as in the "-W" CSV file)
+uint64_t traceRecordTripTime(const traceRecord *record) {
+	if((record->flags & TRACE_FLAG_ERROR) || record->rx_ns<record->tx_ns || record->rx_ns-record->tx_ns<record->proc_ns) {
+		return 0;
+	}
+
+	return record->rx_ns-record->tx_ns-record->proc_ns;
+}
+
+void traceFileUnmap(traceFileReader *reader) {
+	if(reader->header!=NULL) {
+		munmap((void *) reader->header,reader->map_size);
+	}
+
+	reader->header=NULL;
+	reader->records=NULL;
+	reader->count=0;
+	reader->map_size=0;
+}
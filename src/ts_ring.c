@@ -0,0 +1,72 @@
+#include "ts_ring.h"
+#include <stdlib.h>
+
+/* Allocate a ring with 'size' slots ('size' must be a power of two, up to TS_RING_MAX_SIZE).
+Return values:
+0: ok
+<0: error (see the TSRING_E* macros in ts_ring.h)
+*/
+int tsRingInit(tsRing *ring, unsigned int size) {
+	ring->slots=NULL;
+	ring->mask=0;
+
+	if(size==0 || size>TS_RING_MAX_SIZE || (size & (size-1))!=0) {
+		return TSRING_EINVAL;
+	}
+
+	// calloc() leaves all the tags to 0, i.e. all the slots are empty
+	ring->slots=calloc(size,sizeof(tsRingSlot));
+	if(ring->slots==NULL) {
+		return TSRING_EMALLOC;
+	}
+
+	ring->mask=size-1;
+
+	return 0;
+}
+
+// Store the timestamp of the packet with sequence number 'seqNo', overwriting any older (stale) entry in the same slot
+void tsRingInsert(tsRing *ring, uint16_t seqNo, uint64_t stamp_ns) {
+	tsRingSlot *slot=&(ring->slots[seqNo & ring->mask]);
+
+	// Invalidate the slot first, so that a concurrent tsRingGather() can never return a partially written timestamp
+	__atomic_store_n(&(slot->tag),0,__ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	__atomic_store_n(&(slot->stamp_ns),stamp_ns,__ATOMIC_RELAXED);
+	__atomic_store_n(&(slot->tag),TS_RING_TAG_VALID | seqNo,__ATOMIC_RELEASE);
+}
+
+/* Get (and remove) the timestamp of the packet with sequence number 'seqNo'.
+Return values:
+0: ok ('*stamp_ns' is set)
+<0: error (see the TSRING_E* macros in ts_ring.h)
+*/
+int tsRingGather(tsRing *ring, uint16_t seqNo, uint64_t *stamp_ns) {
+	tsRingSlot *slot=&(ring->slots[seqNo & ring->mask]);
+	uint32_t tag=TS_RING_TAG_VALID | seqNo;
+	uint64_t stamp;
+
+	if(__atomic_load_n(&(slot->tag),__ATOMIC_ACQUIRE)!=tag) {
+		return TSRING_ENOTFOUND;
+	}
+
+	stamp=__atomic_load_n(&(slot->stamp_ns),__ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+	// Free the slot, only if it was not overwritten in the meantime (in that case, 'stamp' may belong to the newer entry)
+	if(!__atomic_compare_exchange_n(&(slot->tag),&tag,0,0,__ATOMIC_ACQ_REL,__ATOMIC_ACQUIRE)) {
+		return TSRING_ENOTFOUND;
+	}
+
+	*stamp_ns=stamp;
+
+	return 0;
+}
+
+// Free the ring
+void tsRingFree(tsRing *ring) {
+	free(ring->slots);
+
+	ring->slots=NULL;
+	ring->mask=0;
+}
@@ -0,0 +1,204 @@
+// sched_yield() is used while waiting for a tx timestamp which has not been reaped yet
+#define _GNU_SOURCE
+#include "tx_reaper.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <linux/errqueue.h>
+#include <linux/if_packet.h>
+#include "rawsock_lamp.h"
+#include "common_socket_man.h"
+#include "timer_man.h"
+#include "timeval_utils.h"
+
+// PACKET_TX_TIMESTAMP (error queue control messages of packet sockets) may not be defined by older headers
+#ifndef PACKET_TX_TIMESTAMP
+#define PACKET_TX_TIMESTAMP 16
+#endif
+
+// Ancillary data buffer size: one SO_TIMESTAMPING control message and one extended error (IP_RECVERR or PACKET_TX_TIMESTAMP)
+#define TXREAPER_CTRL_SIZE (CMSG_SPACE(sizeof(struct scm_timestamping))+CMSG_SPACE(sizeof(struct sock_extended_err)+sizeof(struct sockaddr_in)))
+
+static void *txReaperLoop(void *arg) {
+	txReaper *reaper=(txReaper *) arg;
+
+	struct msghdr mhdr;
+	struct iovec iov;
+	struct cmsghdr *cmsg;
+	char ctrlBuf[TXREAPER_CTRL_SIZE];
+	ssize_t rcv_bytes;
+
+	struct scm_timestamping *ts;
+	struct sock_extended_err *serr;
+	uint64_t tx_timestamp_ns;
+
+	uint16_t seq;
+	lamptype_t lamp_type;
+	uint8_t matched;
+
+	while(!__atomic_load_n(&(reaper->stop),__ATOMIC_ACQUIRE)) {
+		if(pollErrqueueWait(reaper->descriptor,TXREAPER_POLL_TIMEOUT)<=0) {
+			continue;
+		}
+
+		// Drain the whole error queue before polling again
+		while(1) {
+			iov.iov_base=reaper->buf;
+			iov.iov_len=reaper->buf_size;
+
+			memset(&mhdr,0,sizeof(mhdr));
+			mhdr.msg_control=ctrlBuf;
+			mhdr.msg_controllen=sizeof(ctrlBuf);
+			// With SOF_TIMESTAMPING_OPT_TSONLY no data is returned: no buffer is needed
+			mhdr.msg_iov=&iov;
+			mhdr.msg_iovlen=reaper->buf!=NULL ? 1 : 0;
+
+			rcv_bytes=recvmsg(reaper->descriptor,&mhdr,MSG_ERRQUEUE | MSG_DONTWAIT);
+			if(rcv_bytes<0) {
+				if(errno==EINTR) {
+					continue;
+				}
+				break;
+			}
+
+			ts=NULL;
+			serr=NULL;
+			for(cmsg=CMSG_FIRSTHDR(&mhdr);cmsg!=NULL;cmsg=CMSG_NXTHDR(&mhdr,cmsg)) {
+				if(cmsg->cmsg_level==SOL_SOCKET && cmsg->cmsg_type==SO_TIMESTAMPING) {
+					ts=(struct scm_timestamping *) CMSG_DATA(cmsg);
+				} else if((cmsg->cmsg_level==SOL_IP && cmsg->cmsg_type==IP_RECVERR) || (cmsg->cmsg_level==SOL_PACKET && cmsg->cmsg_type==PACKET_TX_TIMESTAMP)) {
+					serr=(struct sock_extended_err *) CMSG_DATA(cmsg);
+				}
+			}
+
+			if(ts==NULL || (serr!=NULL && (serr->ee_origin!=SO_EE_ORIGIN_TIMESTAMPING || serr->ee_info!=SCM_TSTAMP_SND))) {
+				continue;
+			}
+
+			matched=0;
+			if(reaper->match==TXREAPER_MATCH_ID) {
+				// The key counts the packets sent since SOF_TIMESTAMPING_OPT_ID was enabled, i.e. it is equal to the sequence number
+				// Entries still carrying a packet (truncated, as no buffer is provided) were queued before OPT_TSONLY was enabled,
+				// e.g. for the control messages: skip them
+				if(serr!=NULL && !(mhdr.msg_flags & MSG_TRUNC)) {
+					seq=(uint16_t) serr->ee_data;
+					matched=1;
+				}
+			} else if(rcv_bytes>0) {
+				lampHeadGetData(UDPgetpacketpointers(reaper->buf,NULL,NULL,NULL),&lamp_type,NULL,&seq,NULL,NULL,NULL); // From Rawsock library
+				matched=lamp_type==PINGLIKE_REQ_TLESS || lamp_type==PINGLIKE_ENDREQ_TLESS;
+			}
+
+			if(!matched) {
+				continue;
+			}
+
+			tx_timestamp_ns=timespecToNs(&(ts->ts[reaper->ts_idx]));
+			if(tx_timestamp_ns==0) {
+				continue;
+			}
+
+			tsRingInsert(reaper->ring,seq,tx_timestamp_ns);
+			__atomic_store_n(&(reaper->last_seq),(int32_t) seq,__ATOMIC_RELEASE);
+		}
+	}
+
+	pthread_exit(NULL);
+}
+
+/* Start the reaper thread on the socket 'sFd', storing each tx timestamp inside 'ring' (hardware timestamps if 'hw' is 1,
+software ones otherwise).
+With TXREAPER_MATCH_ID, SOF_TIMESTAMPING_OPT_ID and SOF_TIMESTAMPING_OPT_TSONLY must be already set on the socket (see
+socketSetTimestampingTxID()), right before the first packet is sent; with TXREAPER_MATCH_PAYLOAD, 'buf_size' is the size
+of the largest looped-back packet.
+Return values:
+0: ok
+<0: error (see the TXREAPER_E* macros in tx_reaper.h)
+*/
+int txReaperStart(txReaper *reaper, int sFd, tsRing *ring, uint8_t match, uint8_t hw, size_t buf_size) {
+	int create_ret;
+
+	reaper->descriptor=sFd;
+	reaper->ring=ring;
+	reaper->match=match;
+	reaper->ts_idx=hw ? 2 : 0;
+	reaper->buf=NULL;
+	reaper->buf_size=0;
+	reaper->running=0;
+	reaper->stop=0;
+	reaper->last_seq=-1;
+
+	if(match==TXREAPER_MATCH_PAYLOAD) {
+		reaper->buf=malloc(buf_size);
+		if(reaper->buf==NULL) {
+			return TXREAPER_EMALLOC;
+		}
+		reaper->buf_size=buf_size;
+	}
+
+	create_ret=pthread_create(&(reaper->tid),NULL,&txReaperLoop,(void *) reaper);
+	if(create_ret!=0) {
+		free(reaper->buf);
+		reaper->buf=NULL;
+		errno=create_ret;
+		return TXREAPER_ETHREAD;
+	}
+
+	reaper->running=1;
+
+	return 0;
+}
+
+/* Get (and remove) the tx timestamp of the packet with sequence number 'seqNo'.
+If it has not been reaped yet, wait for it up to 'timeout_ms' milliseconds, unless the reaper has already gone past 'seqNo'
+(i.e. the timestamp has been lost, or it has already been gathered).
+Return values:
+0: ok
+<0: error (see the TXREAPER_E* macros in tx_reaper.h)
+*/
+int txReaperGather(txReaper *reaper, uint16_t seqNo, uint64_t *stamp_ns, uint64_t timeout_ms) {
+	struct timespec now;
+	uint64_t deadline_ns;
+	int32_t last_seq;
+
+	clock_gettime(CLOCK_MONOTONIC,&now);
+	deadline_ns=timespecToNs(&now)+timeout_ms*MILLISEC_TO_NANOSEC;
+
+	while(1) {
+		// Read the last reaped sequence number before looking inside the ring: if the reaper has already gone past 'seqNo',
+		// the timestamp, when reaped, is guaranteed to be visible to the following tsRingGather()
+		last_seq=__atomic_load_n(&(reaper->last_seq),__ATOMIC_ACQUIRE);
+
+		if(tsRingGather(reaper->ring,seqNo,stamp_ns)==0) {
+			return 0;
+		}
+
+		// Sequence numbers wrap around: compare them as 16 bit signed differences
+		if(last_seq>=0 && (int16_t) ((uint16_t) last_seq-seqNo)>=0) {
+			return TXREAPER_ENOTFOUND;
+		}
+
+		clock_gettime(CLOCK_MONOTONIC,&now);
+		if(timespecToNs(&now)>=deadline_ns) {
+			return TXREAPER_ENOTFOUND;
+		}
+
+		sched_yield();
+	}
+}
+
+// Stop the reaper thread and free its buffer
+void txReaperStop(txReaper *reaper) {
+	if(reaper->running) {
+		__atomic_store_n(&(reaper->stop),1,__ATOMIC_RELEASE);
+		pthread_join(reaper->tid,NULL);
+		reaper->running=0;
+	}
+
+	free(reaper->buf);
+	reaper->buf=NULL;
+}
@@ -0,0 +1,153 @@
+#include "tx_ring.h"
+#include "common_socket_man.h"
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+
+// Offset of the frame data inside each slot, when PACKET_TX_HAS_OFF is not set (see the kernel packet_mmap documentation)
+#define TX_RING_DATA_OFFSET (TPACKET2_HDRLEN-sizeof(struct sockaddr_ll))
+
+static inline struct tpacket2_hdr *txRingSlot(txRing *ring, unsigned int idx) {
+	return (struct tpacket2_hdr *) (ring->map+(size_t) idx*ring->frame_size);
+}
+
+/* Create a TPACKET_V2 TX ring, bound to the interface specified inside 'addrll'.
+'priority' is applied with SO_PRIORITY, unless it is set to UINT8_MAX (i.e. when no user priority was requested).
+Return values:
+0: ok
+<0: error (see the TXRING_E* macros in tx_ring.h)
+*/
+int txRingCreate(txRing *ring, struct sockaddr_ll addrll, size_t max_frame_len, unsigned int min_frame_nr, int qdisc_bypass, int priority) {
+	struct tpacket_req req;
+	struct sockaddr_ll bindaddr;
+	int version=TPACKET_V2;
+	unsigned int page_size=(unsigned int) sysconf(_SC_PAGESIZE);
+	unsigned int frames_per_block;
+
+	ring->map=MAP_FAILED;
+
+	ring->descriptor=socket(AF_PACKET,SOCK_RAW,0);
+	if(ring->descriptor==-1) {
+		return TXRING_ESOCKET;
+	}
+
+	if(setsockopt(ring->descriptor,SOL_PACKET,PACKET_VERSION,&version,sizeof(version))!=0) {
+		close(ring->descriptor);
+		return TXRING_ESETSOCKOPT;
+	}
+
+	if(qdisc_bypass && setsockopt(ring->descriptor,SOL_PACKET,PACKET_QDISC_BYPASS,&qdisc_bypass,sizeof(qdisc_bypass))!=0) {
+		close(ring->descriptor);
+		return TXRING_ESETSOCKOPT;
+	}
+
+	if(priority!=UINT8_MAX && setsockopt(ring->descriptor,SOL_SOCKET,SO_PRIORITY,&priority,sizeof(priority))!=0) {
+		close(ring->descriptor);
+		return TXRING_ESETSOCKOPT;
+	}
+
+	// Each slot must be TPACKET_ALIGNMENT aligned; blocks are made of one or more pages, as required by the kernel
+	ring->frame_size=TPACKET_ALIGN(TX_RING_DATA_OFFSET+max_frame_len);
+	req.tp_block_size=page_size;
+	while(req.tp_block_size<ring->frame_size) {
+		req.tp_block_size<<=1;
+	}
+	frames_per_block=req.tp_block_size/ring->frame_size;
+
+	req.tp_block_nr=(min_frame_nr+frames_per_block-1)/frames_per_block;
+	req.tp_frame_size=ring->frame_size;
+	req.tp_frame_nr=req.tp_block_nr*frames_per_block;
+
+	if(setsockopt(ring->descriptor,SOL_PACKET,PACKET_TX_RING,&req,sizeof(req))!=0) {
+		close(ring->descriptor);
+		return TXRING_ESETSOCKOPT;
+	}
+
+	ring->map_size=(size_t) req.tp_block_size*req.tp_block_nr;
+	ring->map=mmap(NULL,ring->map_size,PROT_READ | PROT_WRITE,MAP_SHARED,ring->descriptor,0);
+	if(ring->map==MAP_FAILED) {
+		close(ring->descriptor);
+		return TXRING_EMMAP;
+	}
+
+	ring->frame_nr=req.tp_frame_nr;
+	ring->frame_idx=0;
+
+	// Bind to the interface only, with protocol = 0, so that no frame is ever queued for reception on this socket
+	memset(&bindaddr,0,sizeof(bindaddr));
+	bindaddr.sll_family=AF_PACKET;
+	bindaddr.sll_ifindex=addrll.sll_ifindex;
+	bindaddr.sll_protocol=0;
+
+	if(bind(ring->descriptor,(struct sockaddr *) &bindaddr,sizeof(bindaddr))<0) {
+		munmap(ring->map,ring->map_size);
+		close(ring->descriptor);
+		return TXRING_EBIND;
+	}
+
+	// The frames will be sent with the same protocol and interface of the main raw socket
+	ring->addrll=addrll;
+
+	return 0;
+}
+
+/* Copy a frame inside the next free TX ring slot (the frame is not sent until txRingFlush() is called).
+Return values:
+0: ok
+<0: error (see the TXRING_E* macros in tx_ring.h)
+*/
+int txRingWrite(txRing *ring, byte_t *frame, size_t len) {
+	struct tpacket2_hdr *hdr=txRingSlot(ring,ring->frame_idx);
+	struct pollfd pfd;
+
+	if(TX_RING_DATA_OFFSET+len>ring->frame_size) {
+		return TXRING_ETOOBIG;
+	}
+
+	// The slot may still be owned by the kernel, if it has not been sent yet: wait for it to be released
+	if(hdr->tp_status!=TP_STATUS_AVAILABLE) {
+		pfd.fd=ring->descriptor;
+		pfd.events=POLLOUT;
+		pfd.revents=0;
+
+		if(poll(&pfd,1,TX_RING_SLOT_WAIT_TIMEOUT)<=0 || hdr->tp_status!=TP_STATUS_AVAILABLE) {
+			return TXRING_EFULL;
+		}
+	}
+
+	memcpy(((byte_t *) hdr)+TX_RING_DATA_OFFSET,frame,len);
+	hdr->tp_len=len;
+
+	// Hand the slot over to the kernel; the barrier guarantees that the frame is written before the status
+	__sync_synchronize();
+	hdr->tp_status=TP_STATUS_SEND_REQUEST;
+
+	ring->frame_idx=(ring->frame_idx+1)%ring->frame_nr;
+
+	return 0;
+}
+
+/* Send all the frames written since the last flush, with a single system call.
+Return values:
+0: ok
+-1: sendto() error
+*/
+int txRingFlush(txRing *ring) {
+	if(sendto(ring->descriptor,NULL,0,NO_FLAGS,(struct sockaddr *) &(ring->addrll),sizeof(struct sockaddr_ll))<0) {
+		return -1;
+	}
+
+	return 0;
+}
+
+void txRingDestroy(txRing *ring) {
+	if(ring->map!=MAP_FAILED) {
+		munmap(ring->map,ring->map_size);
+		ring->map=MAP_FAILED;
+	}
+
+	close(ring->descriptor);
+}
@@ -1,3 +1,5 @@
+// sendmmsg() and recvmmsg() are Linux-specific: _GNU_SOURCE is required in order to get their declarations
+#define _GNU_SOURCE
 #include "udp_client.h"
 #include <sys/ioctl.h>
 #include <sys/socket.h>
@@ -11,14 +13,41 @@
 #include <errno.h>
 #include <linux/errqueue.h>
 #include "timeval_utils.h"
+#include "ts_ring.h"
+#include "clock_source.h"
+#include "seq_extend.h"
 #include "common_thread.h"
 #include "timer_man.h"
 #include "common_udp.h"
+#include "rx_batch.h"
+#include "busy_poll.h"
+#include "tx_reaper.h"
+#include "interim_report.h"
+#include "tfile_writer.h"
+#include "trace_file.h"
+#include "pcapng_writer.h"
+#include "stats_page.h"
 
 // Local global variables
 static pthread_t txLoop_tid, rxLoop_tid, ackListenerInit_tid, initSender_tid, followupReplyListener_tid, followupRequestSender_tid;
 static uint16_t lamp_id_session;
 static reportStructure reportData;
+// Per-position statistics, one report for each position inside a burst (allocated only in ping-like burst mode)
+static reportStructure *burstReportData=NULL;
+
+// Interim reports (--interim only)
+static interimReporter interimData;
+static uint8_t interim_active=0;
+
+// Number of packets actually sent by the Tx loop (it is lower than the requested one when the test is interrupted)
+static uint64_t txPacketsSent=0;
+
+// pcapng export of the LaMP packets (--pcapng only), written by both the tx and rx loops
+static pcapngWriter pcapngData;
+static uint8_t pcapng_active=0;
+static struct sockaddr_in pcapngLocalAddr;
+// Delay between the kernel receive timestamp of each reply and its delivery to user space (--host-rx-delay only)
+static hostRxDelay hostRxDelayData;
 
 // Transmit error container
 static t_error_types t_tx_error=NO_ERR;
@@ -27,18 +56,19 @@ static t_error_types t_rx_error=NO_ERR;
 
 // Data structure to store tx timestamps for HARDWARE/SOFTWARE mode
 // When in HARDWARE/SOFTWARE mode, a structure to store the tx timestamps is needed
-// Using timevalStoreList, as defined in timeval_utils.h
+// Using a tsRing, as defined in ts_ring.h
 // This structure will be allocated only if HARDWARE/SOFTWARE mode is properly supported 
-timevalStoreList tslist;
+static tsRing tslist={.slots=NULL};
 
-// The same applies for the following list, used to store temporary trip times (as timestamp differences)
+// The same applies for the following ring, used to store temporary trip times (as timestamp differences)
 // when waiting for the server follow-ups, containing an estimate on the time needed
 // to process each client request and send the reply down to the hardware
-// This list is allocated only when the follow-up mode is active
-timevalStoreList triptimelist;
+// This ring is allocated only when the follow-up mode is active
+static tsRing triptimelist={.slots=NULL};
 
-// Mutex to protect tslist, as defined before
-static pthread_mutex_t tslist_mut=PTHREAD_MUTEX_INITIALIZER;
+// Tx timestamp reaper (HARDWARE/SOFTWARE mode only): it drains the socket error queue in its own thread and stores the
+// tx timestamps inside tslist, so that the Tx loop never waits for them
+static txReaper txReaperData={.running=0,.buf=NULL};
 
 static uint8_t ack_init_received=0; // Global flag set by the ackListenerInit thread: = 1 when an ACK has been received, otherwise it is = 0
 static pthread_mutex_t ack_init_received_mut=PTHREAD_MUTEX_INITIALIZER; // Mutex to protect the ack_init_received variable (as it written by a thread and read by another one)
@@ -183,18 +213,12 @@ static void *txLoop_t (void *arg) {
 }
 
 static void txLoop (arg_struct_udp *args) {
-	// LaMP header and LaMP packet buffer
+	// LaMP header and LaMP packet buffers (one for each packet of a burst, stored contiguously)
 	struct lamphdr lampHeader;
-	byte_t *lampPacket=NULL;
-	byte_t *lampPacketRxPtr=NULL;
+	byte_t *lampPackets=NULL;
 
-	// Timer variables
-	struct pollfd timerMon;
-	int clockFd;
-	int timerCaS_res=0;
-
-	// Junk variable (needed to clear the timer event with read())
-	unsigned long long junk;
+	// Transmission scheduler (absolute deadlines)
+	txScheduler txSched;
 
 	// Payload buffer
 	byte_t *payload_buff=NULL;
@@ -206,32 +230,26 @@ static void txLoop (arg_struct_udp *args) {
 	uint8_t ctrl=CTRL_PINGLIKE_REQ;
 	uint32_t lampPacketSize=0;
 
-	// SO_TIMESTAMPING variables and structs (cmsg)
-	struct msghdr mhdr;
-	struct iovec iov;
-	struct cmsghdr *cmsg = NULL;
-
-	// Ancillary data buffer
-	char ctrlBuf[CMSG_SPACE(sizeof(struct scm_timestamping))];
-
-	// struct scm_timestamping and struct timeval for the tx timestamp
-	struct scm_timestamping hw_ts;
+	// Application level tx timestamp, inserted inside each packet
 	struct timeval tx_timestamp;
+	uint64_t tx_timestamp_ns;
+	uint16_t tx_seq;
+	// = 1 if the ns tx timestamps have to be stored inside 'tslist' too (see runUDPclient())
+	uint8_t store_tx_ns=tslist.slots!=NULL && (args->opts->latencyType==USERTOUSER || args->opts->latencyType==KRT);
 
-	// recvfrom variable (for HARDWARE mode only)
-	ssize_t rcv_bytes;
+	// sendmmsg() structures: each packet of a burst is described by its own message, with a single iovec
+	struct mmsghdr *burst_msgs=NULL;
+	struct iovec *burst_iovs=NULL;
+	unsigned int burst_len; // Number of packets to be sent in the current burst (the last burst may be shorter)
+	unsigned int burst_idx; // Index of the first packet of the burst which has not been sent yet
+	int sent_msgs;
 
-	// LaMP fields for packet retrieved from socket error queue (hardware tx timestamping only)
-	uint16_t lamp_seq_rx_errqueue=0;
-	lamptype_t lamp_type_rx_errqueue;
+	// = 1 when the test has been interrupted by the user: the next packet is sent as the last one
+	uint8_t stop_flag=0;
 
-	// Buffer used in HARDWARE mode only, set as iov_base.
-	// As "the recvmsg call returns the original
-	//  outgoing data packet with two ancillary messages attached"
-	//  the size of this buffer is set to be equal to the size of
-	//  the lampPacket buffer, allocated later on, plus all the 
-	//  UDP/IPv4/Ethernet headers
-	byte_t *data_iov=NULL;
+	// Timestamps of the packets written to the pcapng file (--pcapng only)
+	pcapngStamps pcapStamps={0};
+	struct timeval pcap_tx_timestamp;
 
 	// Populating the LaMP header
 	if(args->opts->mode_ub==PINGLIKE) {
@@ -250,49 +268,34 @@ static void txLoop (arg_struct_udp *args) {
 	}
 	lampHeadPopulate(&lampHeader, ctrl, lamp_id_session, 0); // Starting from sequence number = 0
 
-	// Allocating packet buffers (with and without payload)
+	// Packet size (with and without payload)
 	if(args->opts->payloadlen!=0) {
-		lampPacket=malloc(sizeof(struct lamphdr)+args->opts->payloadlen);
-		if(!lampPacket) {
-			t_tx_error=ERR_MALLOC;
-			pthread_exit(NULL);
-		}
-
 		lampPacketSize=LAMP_HDR_PAYLOAD_SIZE(args->opts->payloadlen);
 	} else {
-		// There is no need to allocate the lamppacket buffer, as the LaMP header will be directly sent as UDP payload
 		lampPacketSize=LAMP_HDR_SIZE();
 	}
 
-	memset(&mhdr,0,sizeof(mhdr));
-	// Prepare ancillary data structures, if HARDWARE or SOFTWARE mode is selected (to get send timestamps)
-	if(args->opts->latencyType==HARDWARE || args->opts->latencyType==SOFTWARE) {
-		data_iov=malloc(ETH_IP_UDP_PACKET_SIZE_S(sizeof(struct lamphdr)+args->opts->payloadlen));
-
-		if(!data_iov) {
-			free(lampPacket);
-			t_tx_error=ERR_MALLOC;
-			pthread_exit(NULL);
-		}
-
-		// iovec buffers (scatter/gather arrays) 
-		iov.iov_base=(void *)data_iov;
-		iov.iov_len=ETH_IP_UDP_PACKET_SIZE_S(sizeof(struct lamphdr)+args->opts->payloadlen); // Macro from Rawsock library
-
-		// Socket address structure (not needed here)
-		mhdr.msg_name=NULL;
-		mhdr.msg_namelen=0;
-
-		// Ancillary data (control message)
-		mhdr.msg_control=ctrlBuf;
-        mhdr.msg_controllen=sizeof(ctrlBuf);
+	// Allocating the packet buffers and the sendmmsg() structures, for a whole burst (i.e. for a single packet when not in burst mode)
+	lampPackets=malloc(args->opts->burst_size*lampPacketSize);
+	burst_msgs=malloc(args->opts->burst_size*sizeof(struct mmsghdr));
+	burst_iovs=malloc(args->opts->burst_size*sizeof(struct iovec));
+	if(!lampPackets || !burst_msgs || !burst_iovs) {
+		free(lampPackets);
+		free(burst_msgs);
+		free(burst_iovs);
+		t_tx_error=ERR_MALLOC;
+		pthread_exit(NULL);
+	}
 
-        // iovec arrays
-		mhdr.msg_iov=&iov;
-		mhdr.msg_iovlen=1; // 1 element for each recvmsg()
+	memset(burst_msgs,0,args->opts->burst_size*sizeof(struct mmsghdr));
+	for(unsigned int i=0;i<args->opts->burst_size;i++) {
+		burst_iovs[i].iov_base=lampPackets+i*lampPacketSize;
+		burst_iovs[i].iov_len=lampPacketSize;
 
-		// As reported into socket.h, these are the "flags on received message"
-		mhdr.msg_flags=NO_FLAGS;
+		burst_msgs[i].msg_hdr.msg_name=(void *)&(args->sData.addru.addrin[1]);
+		burst_msgs[i].msg_hdr.msg_namelen=sizeof(struct sockaddr_in);
+		burst_msgs[i].msg_hdr.msg_iov=&burst_iovs[i];
+		burst_msgs[i].msg_hdr.msg_iovlen=1;
 	}
 
 	// Populate payload buffer only if 'payloadlen' is different than 0
@@ -300,12 +303,9 @@ static void txLoop (arg_struct_udp *args) {
 		payload_buff=malloc((args->opts->payloadlen)*sizeof(byte_t));
 
 		if(!payload_buff) {
-			free(lampPacket);
-
-			if(data_iov) {
-				free(data_iov);
-			}
-
+			free(lampPackets);
+			free(burst_msgs);
+			free(burst_iovs);
 			t_tx_error=ERR_MALLOC;
 			pthread_exit(NULL);
 		}
@@ -315,26 +315,37 @@ static void txLoop (arg_struct_udp *args) {
 		}
 	}
 
-	// Create and start timer
-	timerCaS_res=timerCreateAndSet(&timerMon, &clockFd, args->opts->interval);
-
-	if(timerCaS_res==-1) {
-		t_tx_error=ERR_TIMERCREATE;
-		pthread_exit(NULL);
-	} else if(timerCaS_res==-2) {
-		t_tx_error=ERR_SETTIMER;
+	// Initialize the transmission scheduler (the first deadline is one interval from now)
+	if(txSchedulerInit(&txSched, args->opts->interval_ns, args->opts->tx_spin_ns)<0) {
+		free(lampPackets);
+		free(burst_msgs);
+		free(burst_iovs);
+		free(payload_buff);
+		t_tx_error=ERR_TXSCHED;
 		pthread_exit(NULL);
 	}
 
 	// Run until 'number' is reached
 	while(counter<args->opts->number) {
-		// poll waiting for events happening on the timer descriptor (i.e. wait for timer expiration)
-		if(poll(&timerMon,1,INDEFINITE_BLOCK)>0) {
-			// "Clear the event" by performing a read() on a junk variable
-			read(clockFd,&junk,sizeof(junk));
+		// Wait until the next absolute deadline is reached
+		if(txSchedulerWaitNext(&txSched)<0) {
+			t_tx_error=ERR_TXSCHED;
+			break;
+		}
+
+		// Send 'burst_size' packets for each deadline, or less, if the total number of packets is not a multiple of 'burst_size'
+		// When the test has been interrupted, send just one more packet, to let the server terminate the session
+		stop_flag=testStopRequested();
+		if(stop_flag) {
+			burst_len=1;
+		} else {
+			burst_len=args->opts->number-counter<args->opts->burst_size ? args->opts->number-counter : args->opts->burst_size;
+		}
 
+		// Prepare the packets of the current burst, each with its own sequence number
+		for(unsigned int i=0;i<burst_len;i++) {
 			// Set UNIDIR_STOP or PINGLIKE_ENDREQ (TLESS for HARDWARE mode) when the last packet has to be transmitted, depending on the current mode_ub ("mode unidirectional/bidirectional")
-			if(counter==args->opts->number-1) {
+			if(counter+i==args->opts->number-1 || stop_flag) {
 				if(args->opts->mode_ub==UNIDIR) {
 					lampSetUnidirStop(&lampHeader);
 				} else if(args->opts->mode_ub==PINGLIKE) {
@@ -344,106 +355,146 @@ static void txLoop (arg_struct_udp *args) {
 
 			// Encapsulate LaMP payload only if it is available
 			if(args->opts->payloadlen!=0) {
-				lampEncapsulate(lampPacket, &lampHeader, payload_buff, args->opts->payloadlen);
-				// Set timestamp
-				lampHeadSetTimestamp((struct lamphdr *)lampPacket,NULL);
+				lampEncapsulate(lampPackets+i*lampPacketSize, &lampHeader, payload_buff, args->opts->payloadlen);
 			} else {
-				lampHeadSetTimestamp(&lampHeader,NULL);
-				lampPacket=(byte_t *)&lampHeader; // The LaMP packet is only composed by the header
+				memcpy(lampPackets+i*lampPacketSize,&lampHeader,LAMP_HDR_SIZE()); // The LaMP packet is only composed by the header
 			}
 
-			if(args->opts->latencyType==HARDWARE || args->opts->latencyType==SOFTWARE) {
-				pthread_mutex_lock(&tslist_mut);
+			// Increase sequence number for the next packet
+			lampHeadIncreaseSeq(&lampHeader);
+		}
+
+		// Set the timestamps as late as possible, i.e. just before sending the whole burst
+		for(unsigned int i=0;i<burst_len;i++) {
+			tx_timestamp_ns=clockSourceNs();
+			tx_timestamp=nsToTimeval(tx_timestamp_ns);
+			lampHeadSetTimestamp((struct lamphdr *)(lampPackets+i*lampPacketSize),&tx_timestamp);
+
+			if(store_tx_ns) {
+				lampHeadGetData(lampPackets+i*lampPacketSize,NULL,NULL,&tx_seq,NULL,NULL,NULL);
+				tsRingInsert(&tslist,tx_seq,tx_timestamp_ns);
 			}
+		}
 
-			if(sendto(args->sData.descriptor,lampPacket,lampPacketSize,NO_FLAGS,(struct sockaddr *)&(args->sData.addru.addrin[1]),sizeof(struct sockaddr_in))!=lampPacketSize) {
-				perror("sendto() for sending LaMP packet failed");
-				fprintf(stderr,"Failed sending latency measurement packet with seq: %u.\nThe execution will terminate now.\n",lampHeader.seq);
+		// sendmmsg() may send only a part of the burst: in that case, send the remaining packets with another call
+		for(burst_idx=0;burst_idx<burst_len;burst_idx+=sent_msgs) {
+			sent_msgs=sendmmsg(args->sData.descriptor,burst_msgs+burst_idx,burst_len-burst_idx,NO_FLAGS);
+
+			if(sent_msgs<=0) {
 				break;
 			}
+		}
 
-			// Retrieve tx timestamp if mode is HARDWARE/SOFTWARE (i.e. either HARDWARE or software kernel tx and rx timestamps)
-			// Extract ancillary data with the tx timestamp (if mode is HARDWARE/SOFTWARE)
-			if(args->opts->latencyType==HARDWARE || args->opts->latencyType==SOFTWARE) {
-				do {
-					if(pollErrqueueWait(args->sData.descriptor,POLL_ERRQUEUE_WAIT_TIMEOUT)<=0) {
-						rcv_bytes=-1;
-						pthread_mutex_unlock(&tslist_mut);
-						break;
-					}
-					saferecvmsg(rcv_bytes,args->sData.descriptor,&mhdr,MSG_ERRQUEUE);
-					lampPacketRxPtr=UDPgetpacketpointers(data_iov,NULL,NULL,NULL); // From Rawsock library
-					lampHeadGetData(lampPacketRxPtr,&lamp_type_rx_errqueue,NULL,&lamp_seq_rx_errqueue,NULL,NULL,NULL);
-				} while(lamp_seq_rx_errqueue!=counter || (lamp_type_rx_errqueue!=PINGLIKE_REQ_TLESS && lamp_type_rx_errqueue!=PINGLIKE_ENDREQ_TLESS));
-
-				if(rcv_bytes==-1) {
-					t_rx_error=ERR_TXSTAMP;
-					pthread_mutex_unlock(&tslist_mut);
-					break;
-				}
-
-				for(cmsg=CMSG_FIRSTHDR(&mhdr);cmsg!=NULL;cmsg=CMSG_NXTHDR(&mhdr, cmsg)) {
-		           	if(cmsg->cmsg_level==SOL_SOCKET && cmsg->cmsg_type==SO_TIMESTAMPING) {
-		            	hw_ts=*((struct scm_timestamping *)CMSG_DATA(cmsg));
-		             	tx_timestamp.tv_sec=hw_ts.ts[args->opts->latencyType==HARDWARE ? 2 : 0].tv_sec;
-		       			tx_timestamp.tv_usec=hw_ts.ts[args->opts->latencyType==HARDWARE ? 2 : 0].tv_nsec/MICROSEC_TO_NANOSEC;
-		           	}
-				}
+		if(burst_idx<burst_len) {
+			perror("sendmmsg() for sending LaMP packets failed");
+			fprintf(stderr,"Failed sending latency measurement packet with seq: %u.\nThe execution will terminate now.\n",counter+burst_idx);
+			break;
+		}
 
-				// Save tx timestamp
-				timevalSL_insert(tslist,counter,tx_timestamp);
-				pthread_mutex_unlock(&tslist_mut);
+		// With --pcapng, write the packets of the current burst, with the application level timestamp they carry (if any)
+		// The kernel/hardware tx timestamps are gathered later on, and written together with the corresponding replies
+		if(pcapng_active) {
+			for(burst_idx=0;burst_idx<burst_len;burst_idx++) {
+				lampHeadGetData(lampPackets+burst_idx*lampPacketSize,NULL,NULL,NULL,NULL,&pcap_tx_timestamp,NULL);
+				pcapStamps.user_ns=timevalToNs(&pcap_tx_timestamp);
+				pcapngWriteUDP(&pcapngData,PCAPNG_DIR_OUTBOUND,&pcapngLocalAddr,&(args->sData.addru.addrin[1]),lampPackets+burst_idx*lampPacketSize,lampPacketSize,&pcapStamps);
 			}
+		}
 
-			if(args->opts->mode_ub==UNIDIR) {
+		if(args->opts->mode_ub==UNIDIR) {
+			for(burst_idx=0;burst_idx<burst_len;burst_idx++) {
 				fprintf(stdout,"Sent unidirectional message with destination IP %s (id=%u, seq=%u)\n",
-					inet_ntoa(args->opts->destIPaddr), lamp_id_session, counter);
+					inet_ntoa(args->opts->destIPaddr), lamp_id_session, counter+burst_idx);
 			}
+		}
 
-			// Increase sequence number for the next iteration
-			lampHeadIncreaseSeq(&lampHeader);
+		// Increase counter
+		counter+=burst_len;
 
-			// Increase counter
-			counter++;
+		if(stop_flag) {
+			break;
 		}
 	}
 
+	txPacketsSent=counter;
+
 	// Free payload buffer
 	if(args->opts->payloadlen!=0) {
 		free(payload_buff);
-		// Free the LaMP packet buffer only if it was allocated (otherwise a SIGSEGV may occur if payloadLen is 0)
-		free(lampPacket);
 	}
 
-	// Close timer file descriptor
-	close(clockFd);
+	// Free the packet buffers and the sendmmsg() structures
+	free(lampPackets);
+	free(burst_msgs);
+	free(burst_iovs);
 }
 
 static void *rxLoop_t (void *arg) {
 	arg_struct_udp *args=(arg_struct_udp *) arg;
 
 	int Wfiledescriptor=-1;
+	// Asynchronous writer of the -W file (= 1 when its thread is running, otherwise the lines are written synchronously)
+	tFileWriter Wwriter;
+	uint8_t W_async=0;
+
+	// Binary per-packet trace (--trace only)
+	traceFile trace;
+	traceHeader traceHdr;
+	uint8_t trace_active=0;
+
+	// Timestamps of the packets written to the pcapng file (--pcapng only)
+	pcapngStamps pcapStamps;
 
 	// Packet buffer with size = maximum LaMP packet length
-	byte_t lampPacket[MAX_LAMP_LEN + LAMP_HDR_SIZE()];
+	byte_t lampPacketBuf[MAX_LAMP_LEN + LAMP_HDR_SIZE()];
+	// Pointer to the current packet: it points to 'lampPacketBuf', or to the buffer of the current datagram inside the batch (--rx-batch)
+	byte_t *lampPacket=lampPacketBuf;
 	// Pointer to the header, inside the packet buffer
 	struct lamphdr *lampHeaderPtr=(struct lamphdr *) lampPacket;
 
 	// recvfrom variables
 	ssize_t rcv_bytes;
 
+	// recvmmsg() batch (--rx-batch only)
+	rxBatch rxBatchData;
+	uint8_t rx_batch_active=0;
+
+	// Spinning receive (--busy-poll only)
+	busyPoll busyPollData;
+	uint8_t busy_poll_active=0;
+
+	// = 1 if the replies are received with recvmsg(), to get the ancillary data (kernel timestamps), otherwise = 0
+	uint8_t use_recvmsg=args->opts->latencyType!=USERTOUSER || args->opts->host_rx_delay==1;
+	// User space receive timestamp, with ns resolution (--host-rx-delay only)
+	struct timespec user_rx_ts;
+
 	int fu_flag=1; // Flag set to 0 when a follow-up is received after an ENDREPLY or ENDREPLY_TLESS (HARDWARE latencyType only, fixed to 0 for other types)
 	int continueFlag=1; // Flag set to 0 when an ENDREPLY or ENDREPLY_TLESS is received
 	int errorTsFlag=0; // Flag set to 1 when an error occurred in retrieving a timestamp (i.e. if no latency data can be reported for the current packet)
 
-	// RX and TX timestamp containers (plus follow-up and trip time timestamps for the HARDWARE mode)
-	struct timeval rx_timestamp, tx_timestamp, triptime_timestamp, packet_timestamp;
+	// Extended (64-bit) sequence number of the received packet, used to update the reports and written to the -W CSV file
+	seqExtender seqExt;
+	uint64_t lamp_seq_rx_ext=0;
+
+	// Wall clock step detection, performed only when the measurement relies on CLOCK_REALTIME (user space or kernel software timestamps)
+	clockStepDetector stepDetector;
+	uint8_t step_check=args->opts->latencyType==KRT || args->opts->latencyType==SOFTWARE ||
+		(args->opts->latencyType==USERTOUSER && args->opts->clock_source==CLOCKSRC_REALTIME);
+
+	// RX and TX timestamps, in ns (plus the trip time, waiting for the follow-up, and the timestamp carried inside the LaMP header)
+	uint64_t rx_timestamp_ns=0, tx_timestamp_ns=0, triptime_ns=0;
+	// ns tx timestamp stored by the Tx loop (-L u and -L r, ping-like mode only)
+	uint64_t tx_stored_ns;
+	struct timeval packet_timestamp;
+	// Server processing delta carried by the last FOLLOWUP_DATA message, in ns
+	uint64_t followup_delta_ns=0;
 	struct scm_timestamping hw_ts;
+	uint8_t hw_ts_valid; // = 1 when 'hw_ts' has been set from the ancillary data of the current packet
 
-	// Variable to store the latency (trip time)
+	// Variable to store the latency (trip time) [ns]
 	uint64_t tripTime=0;
 
-	// Variable to store the processing time (server time delta) when using follow-up mode
+	// Variable to store the processing time (server time delta) when using follow-up mode [ns]
 	uint64_t tripTimeProc=0;
 
 	// LaMP relevant fields
@@ -451,38 +502,45 @@ static void *rxLoop_t (void *arg) {
 	uint16_t lamp_id_rx;
 	uint16_t lamp_seq_rx=0; 
 	uint16_t lamp_payloadlen_rx;
+	byte_t *lamp_payload_rx=NULL;
 
 	// SO_TIMESTAMP variables and structs (cmsg)
 	struct msghdr mhdr;
 	struct iovec iov;
 	struct cmsghdr *cmsg=NULL;
+	// Message header of the last received datagram: it points to 'mhdr', or to the message header of the datagram inside the batch (--rx-batch)
+	struct msghdr *rxMhdr=&mhdr;
 
 	// Ancillary data buffers
-	char ctrlBufSw[CMSG_SPACE(sizeof(struct timeval))];
+	char ctrlBufSw[CMSG_SPACE(sizeof(struct timespec))];
 	char ctrlBufHw[CMSG_SPACE(sizeof(struct scm_timestamping))];
 
 	// struct sockaddr_in to store the source IP address of the received LaMP packets
 	struct sockaddr_in srcAddr;
 	socklen_t srcAddrLen=sizeof(srcAddr);
 
+	clockStepDetectorInit(&stepDetector);
+	seqExtenderInit(&seqExt);
+
 	// Set fu_flag to 0 if follow-up mode is disabled
 	if(args->opts->followup_mode==FOLLOWUP_OFF) {
 		fu_flag=0;
 	}
 
-	// Prepare ancillary data structures, if KRT or HARDWARE/SOFTWARE mode is selected
-	if(args->opts->latencyType==KRT || args->opts->latencyType==SOFTWARE || args->opts->latencyType==HARDWARE) {
+	// Prepare ancillary data structures, if KRT or HARDWARE/SOFTWARE mode is selected (or if the host receive delay is measured)
+	if(use_recvmsg) {
 		// iovec buffers (scatter/gather arrays)
-		iov.iov_base=lampPacket;
-		iov.iov_len=sizeof(lampPacket);
+		iov.iov_base=lampPacketBuf;
+		iov.iov_len=sizeof(lampPacketBuf);
 
 		// Socket address structure
 		mhdr.msg_name=(void *)&srcAddr;
 		mhdr.msg_namelen=srcAddrLen;
 
 		// Ancillary data (control message)
-		mhdr.msg_control=args->opts->latencyType!=KRT ? ctrlBufHw : ctrlBufSw;
-        mhdr.msg_controllen=args->opts->latencyType!=KRT ? sizeof(ctrlBufHw) : sizeof(ctrlBufSw);
+		// KRT and the host receive delay measurement (user-to-user only) both rely on SO_TIMESTAMPNS
+		mhdr.msg_control=args->opts->latencyType==KRT || args->opts->latencyType==USERTOUSER ? ctrlBufSw : ctrlBufHw;
+		mhdr.msg_controllen=args->opts->latencyType==KRT || args->opts->latencyType==USERTOUSER ? sizeof(ctrlBufSw) : sizeof(ctrlBufHw);
 
         // iovec arrays
 		mhdr.msg_iov=&iov;
@@ -497,21 +555,99 @@ static void *rxLoop_t (void *arg) {
 		Wfiledescriptor=openTfile(args->opts->Wfilename,args->opts->followup_mode!=FOLLOWUP_OFF);
 		if(Wfiledescriptor<0) {
 			fprintf(stderr,"Warning! Cannot open file for writing single packet latency data.\nThe '-W' option will be disabled.\n");
+		} else if(tFileWriterStart(&Wwriter,Wfiledescriptor,args->opts->followup_mode!=FOLLOWUP_OFF,W_DECIMAL_DIGITS,TFILE_WRITER_DEFAULT_SIZE,args->opts->w_sync)<0) {
+			perror("tFileWriterStart() error");
+			fprintf(stderr,"Warning: unable to start the '-W' writer thread.\n\tSwitching back to synchronous writes.\n");
+		} else {
+			W_async=1;
 		}
 	}
 
+	// Create the binary trace, with room for all the packets which are going to be sent (it is extended if more replies are received)
+	if(args->opts->trace_filename!=NULL) {
+		traceHeaderInit(&traceHdr);
+		traceHdr.latency_type=args->opts->latencyType;
+		traceHdr.clock_source=args->opts->clock_source;
+		traceHdr.lamp_id=lamp_id_session;
+		traceHdr.payload_len=args->opts->payloadlen;
+		traceHdr.followup=args->opts->followup_mode!=FOLLOWUP_OFF;
+		traceHdr.total_packets=args->opts->number;
+		traceHdr.interval_ns=args->opts->interval_ns;
+		traceHdr.mode_ub=args->opts->mode_ub;
+		traceHdr.burst_size=args->opts->burst_size;
+
+		if(traceFileCreate(&trace,args->opts->trace_filename,&traceHdr,args->opts->number)<0) {
+			perror("traceFileCreate() error");
+			fprintf(stderr,"Warning: cannot create the binary trace file %s.\n\tThe '--trace' option will be disabled.\n",args->opts->trace_filename);
+		} else {
+			trace_active=1;
+		}
+	}
+
+	// If requested, allocate the buffers to receive the replies in batches, with recvmmsg()
+	if(args->opts->rx_batch>1) {
+		if(rxBatchCreate(&rxBatchData,args->opts->rx_batch,sizeof(lampPacketBuf))<0) {
+			fprintf(stderr,"Warning: unable to allocate the recvmmsg() buffers.\n\tSwitching back to recvfrom()/recvmsg().\n");
+		} else {
+			rx_batch_active=1;
+		}
+	}
+
+	// If requested, spin on non-blocking receives, with kernel busy polling, possibly on a dedicated core
+	if(args->opts->busy_poll_us>0) {
+		if(args->opts->busy_poll_cpu>=0 && busyPollPinThread(args->opts->busy_poll_cpu,NULL)<0) {
+			perror("busyPollPinThread() error");
+			fprintf(stderr,"Warning: unable to pin the Rx loop to CPU %d.\n",args->opts->busy_poll_cpu);
+		}
+
+		if(busyPollCreate(&busyPollData,args->sData.descriptor,args->opts->busy_poll_us)<0) {
+			perror("busyPollCreate() error");
+			fprintf(stderr,"Warning: unable to set SO_BUSY_POLL (CAP_NET_ADMIN may be required).\n\tSpinning on non-blocking receives without kernel busy polling.\n");
+		}
+		busy_poll_active=1;
+	}
+
 	// Start receiving packets (this is the ping-like loop), specifying a "struct sockaddr_in" to recvfrom() in order to obtain the source MAC address
 	do {
-		// If in KRT or HARDWARE/SOFTWARE mode, use recvmsg(), otherwise, use recvfrom()
-		if(args->opts->latencyType==KRT || args->opts->latencyType==SOFTWARE || args->opts->latencyType==HARDWARE) {
+		hw_ts_valid=0;
+
+		// When in batch mode, get the next datagram of the current batch (receiving a new batch with recvmmsg() when needed)
+		// Otherwise, if in KRT or HARDWARE/SOFTWARE mode, use recvmsg(), otherwise, use recvfrom()
+		if(rx_batch_active) {
+			rcv_bytes=rxBatchRecv(&rxBatchData,args->sData.descriptor,&lampPacket,&rxMhdr);
+
+			if(rcv_bytes!=-1) {
+				lampHeaderPtr=(struct lamphdr *) lampPacket;
+				memcpy(&srcAddr,rxMhdr->msg_name,sizeof(srcAddr));
+			}
+		} else if(busy_poll_active) {
+			if(use_recvmsg) {
+				rcv_bytes=busyPollRecvmsg(&busyPollData,&mhdr);
+			} else {
+				rcv_bytes=busyPollRecvfrom(&busyPollData,lampPacket,MAX_LAMP_LEN,(struct sockaddr *)&srcAddr,&srcAddrLen);
+			}
+		} else if(use_recvmsg) {
 			saferecvmsg(rcv_bytes,args->sData.descriptor,&mhdr,NO_FLAGS);
 		} else {
 			saferecvfrom(rcv_bytes,args->sData.descriptor,lampPacket,MAX_LAMP_LEN,NO_FLAGS,(struct sockaddr *)&srcAddr,&srcAddrLen);
 		}
 
+		// Take the user space timestamp as soon as possible, to compare it with the kernel receive timestamp
+		if(args->opts->host_rx_delay==1) {
+			clock_gettime(CLOCK_REALTIME,&user_rx_ts);
+		}
+
 		// Timeout or generic recvfrom() error occurred
 		if(rcv_bytes==-1) {
-			if(errno==EAGAIN) {
+			// With time based interim reports, the receive timeout is shortened to the window duration: close the expired window and keep waiting
+			if(errno==EAGAIN && interim_active && interimReporterRxTimeout(&interimData)) {
+				continue;
+			}
+
+			if(errno==EAGAIN && testStopRequested()) {
+				// The reply to the last packet sent after an interruption may be lost: this is not an error
+				fprintf(stderr,"Timeout when waiting for the last reply after the interruption.\n");
+			} else if(errno==EAGAIN) {
 				t_rx_error=ERR_TIMEOUT;
 				fprintf(stderr,"Timeout when waiting for new packets.\n");
 			} else {
@@ -526,7 +662,7 @@ static void *rxLoop_t (void *arg) {
 		}
 
 		// If the packet is really a LaMP packet, get the header data (followup_timestamp will be null when a timestampless reply is received in HARDWARE mode)
-		lampHeadGetData(lampPacket, &lamp_type_rx, &lamp_id_rx, &lamp_seq_rx, &lamp_payloadlen_rx, &packet_timestamp, NULL);
+		lampHeadGetData(lampPacket, &lamp_type_rx, &lamp_id_rx, &lamp_seq_rx, &lamp_payloadlen_rx, &packet_timestamp, &lamp_payload_rx);
 
 		// Discard any LaMP packet which is not of interest
 		if(lamp_id_rx!=lamp_id_session) {
@@ -538,74 +674,116 @@ static void *rxLoop_t (void *arg) {
 			continue;
 		}
 
+		lamp_seq_rx_ext=seqExtend(&seqExt,lamp_seq_rx);
+
 		if(lamp_type_rx==PINGLIKE_REPLY || lamp_type_rx==PINGLIKE_ENDREPLY || lamp_type_rx==PINGLIKE_REPLY_TLESS || lamp_type_rx==PINGLIKE_ENDREPLY_TLESS) {
 			// Extract ancillary data (if mode is KRT or if it is HARDWARE)
 			if(args->opts->latencyType==KRT || args->opts->latencyType==SOFTWARE || args->opts->latencyType==HARDWARE) {
-				for(cmsg=CMSG_FIRSTHDR(&mhdr);cmsg!=NULL;cmsg=CMSG_NXTHDR(&mhdr, cmsg)) {
-	                if(args->opts->latencyType==KRT && cmsg->cmsg_level==SOL_SOCKET && cmsg->cmsg_type==SO_TIMESTAMP) {
-	                    rx_timestamp=*((struct timeval *)CMSG_DATA(cmsg));
+				for(cmsg=CMSG_FIRSTHDR(rxMhdr);cmsg!=NULL;cmsg=CMSG_NXTHDR(rxMhdr, cmsg)) {
+	                if(args->opts->latencyType==KRT && cmsg->cmsg_level==SOL_SOCKET && cmsg->cmsg_type==SCM_TIMESTAMPNS) {
+	                    rx_timestamp_ns=timespecToNs((struct timespec *)CMSG_DATA(cmsg));
 	                }
 
 	               	if((args->opts->latencyType==HARDWARE || args->opts->latencyType==SOFTWARE) && cmsg->cmsg_level==SOL_SOCKET && cmsg->cmsg_type==SO_TIMESTAMPING) {
 	                    hw_ts=*((struct scm_timestamping *)CMSG_DATA(cmsg));
-	                    rx_timestamp.tv_sec=hw_ts.ts[args->opts->latencyType==HARDWARE ? 2 : 0].tv_sec;
-	                    rx_timestamp.tv_usec=hw_ts.ts[args->opts->latencyType==HARDWARE ? 2 : 0].tv_nsec/MICROSEC_TO_NANOSEC;
+	                    hw_ts_valid=1;
+	                    rx_timestamp_ns=timespecToNs(&hw_ts.ts[args->opts->latencyType==HARDWARE ? 2 : 0]);
 	                }
 				}
 			} else if(args->opts->latencyType==USERTOUSER) {
-				gettimeofday(&rx_timestamp,NULL);
+				rx_timestamp_ns=clockSourceNs();
+
+				if(args->opts->host_rx_delay==1) {
+					hostRxDelayUpdate(&hostRxDelayData,rxMhdr,&user_rx_ts);
+				}
+			}
+
+			if(step_check==1 && clockStepDetect(&stepDetector)==1) {
+				fprintf(stderr,"Warning: wall clock step detected when receiving the reply with seq: %d. Its latency may be wrong.\n",lamp_seq_rx);
+				reportData.clockStepsCount++;
 			}
 
 			if(args->opts->latencyType==SOFTWARE || args->opts->latencyType==HARDWARE) {
-				pthread_mutex_lock(&tslist_mut);
-				if(timevalSL_gather(tslist,lamp_seq_rx,&tx_timestamp)) {
+				// The tx timestamp may still be on its way through the error queue: wait for the reaper, if needed
+				if(txReaperGather(&txReaperData,lamp_seq_rx,&tx_timestamp_ns,POLL_ERRQUEUE_WAIT_TIMEOUT)<0) {
 					fprintf(stderr,"Error: could not retrieve transmit timestamp for packet number: %d.\n",lamp_seq_rx);
 					errorTsFlag=1;
 				}
-				pthread_mutex_unlock(&tslist_mut);
 			} else {
-				tx_timestamp=packet_timestamp;
+				// Use the ns tx timestamp stored by the Tx loop, if it is available and if it really refers to this packet
+				tx_timestamp_ns=timevalToNs(&packet_timestamp);
+
+				if(tslist.slots!=NULL && tsRingGather(&tslist,lamp_seq_rx,&tx_stored_ns)==0 && tx_stored_ns/1000==tx_timestamp_ns/1000) {
+					tx_timestamp_ns=tx_stored_ns;
+				}
 			}
 
 			if(errorTsFlag==0) {
-				if(timevalSub(&tx_timestamp,&rx_timestamp)) {
+				if(rx_timestamp_ns<tx_timestamp_ns) {
 					fprintf(stderr,"Error: negative latency!\nThis could potentually indicate that SO_TIMESTAMP is not working properly on your system.\n");
 					errorTsFlag=1;
 				}
 			}
 
 			if(errorTsFlag==1) {
-				// If a timestamping error occurred, set stored timestamp to 0
-				rx_timestamp.tv_sec=0;
-				rx_timestamp.tv_usec=0;
+				// If a timestamping error occurred, set the time difference to 0
+				triptime_ns=0;
 
 				// Set the flag back to 0 for the next iteration
 				errorTsFlag=0;
+			} else {
+				triptime_ns=rx_timestamp_ns-tx_timestamp_ns;
 			}
 
-			// Compute triptime if follow-up mode is not active, otherwise just store the time difference timestamp, while waiting for the
+			// Compute triptime if follow-up mode is not active, otherwise just store the time difference, while waiting for the
 			// follow-up message, containing the processing time delta to be used later on to compute the final triptime
 			if(args->opts->followup_mode==FOLLOWUP_OFF) {
-				tripTime=rx_timestamp.tv_sec*SEC_TO_MICROSEC+rx_timestamp.tv_usec;
+				tripTime=triptime_ns;
 			} else {
-				timevalSL_insert(triptimelist,lamp_seq_rx,rx_timestamp); // rx_timestamp now contains a timestamp difference (triptime as struct timeval)
+				tsRingInsert(&triptimelist,lamp_seq_rx,triptime_ns);
 			}
 		}
 
+		// With --pcapng, write the received packet, with all the rx timestamps extracted from the ancillary data
+		if(pcapng_active) {
+			memset(&pcapStamps,0,sizeof(pcapStamps));
+
+			if(lamp_type_rx!=FOLLOWUP_DATA) {
+				if(args->opts->latencyType==USERTOUSER) {
+					pcapStamps.user_ns=rx_timestamp_ns;
+				} else if(args->opts->latencyType==KRT) {
+					pcapStamps.kernel_ns=rx_timestamp_ns;
+				} else {
+					// Without the SO_TIMESTAMPING ancillary data, only a user space timestamp can be written
+					if(hw_ts_valid) {
+						pcapStamps.kernel_ns=timespecToNs(&hw_ts.ts[0]);
+						pcapStamps.hw_ns=timespecToNs(&hw_ts.ts[2]);
+					} else {
+						pcapStamps.user_ns=clockSourceNs();
+					}
+					pcapStamps.req_tx_ns=tx_timestamp_ns;
+				}
+			}
+
+			pcapngWriteUDP(&pcapngData,PCAPNG_DIR_INBOUND,&srcAddr,&pcapngLocalAddr,lampPacket,rcv_bytes,&pcapStamps);
+		}
+
 		if(args->opts->followup_mode!=FOLLOWUP_OFF && lamp_type_rx==FOLLOWUP_DATA) {
-			if(timevalSL_gather(triptimelist,lamp_seq_rx,&triptime_timestamp)) {
+			followup_delta_ns=getFollowUpDataNs(&packet_timestamp,lamp_payload_rx,lamp_payloadlen_rx);
+
+			if(tsRingGather(&triptimelist,lamp_seq_rx,&triptime_ns)) {
 				fprintf(stderr,"Error: unable to compute delay for packet number: %d.\nIt is possible that a follow-up was received before the corresponding reply.\n",lamp_seq_rx);
 				errorTsFlag=1;
 			} else {
-				if((triptime_timestamp.tv_sec==0 && triptime_timestamp.tv_usec==0) || (packet_timestamp.tv_sec==0 && packet_timestamp.tv_usec==0)) {
+				if(triptime_ns==0 || followup_delta_ns==0) {
 					errorTsFlag=1;
 				}
 
-				if(errorTsFlag==0 && timevalSub(&packet_timestamp,&triptime_timestamp)) {
+				if(errorTsFlag==0 && triptime_ns<followup_delta_ns) {
 					fprintf(stderr,"Warning: negative time!\nThis could potentually indicate that SO_TIMESTAMP is not working properly on your system.\n");
 					errorTsFlag=1;
-				} else {
-					tripTime=triptime_timestamp.tv_sec*SEC_TO_MICROSEC+triptime_timestamp.tv_usec;
+				} else if(errorTsFlag==0) {
+					tripTime=triptime_ns-followup_delta_ns;
 				}
 			}
 		}
@@ -620,15 +798,15 @@ static void *rxLoop_t (void *arg) {
 		// When using the follow-up mode, data is printed only when both the reply and the follow-up have been received
 		if(args->opts->followup_mode==FOLLOWUP_OFF || (args->opts->followup_mode!=FOLLOWUP_OFF && lamp_type_rx==FOLLOWUP_DATA)) {
 			if(tripTime!=0) {
-				fprintf(stdout,"Received a reply from %s (id=%u, seq=%u). Time: %.3f ms (%s)%s\n",
-					inet_ntoa(srcAddr.sin_addr),lamp_id_rx,lamp_seq_rx,(double)tripTime/1000,latencyTypePrinter(args->opts->latencyType),
+				fprintf(stdout,"Received a reply from %s (id=%u, seq=%u). Time: %.6f ms (%s)%s\n",
+					inet_ntoa(srcAddr.sin_addr),lamp_id_rx,lamp_seq_rx,(double)tripTime/MILLISEC_TO_NANOSEC,latencyTypePrinter(args->opts->latencyType),
 					args->opts->followup_mode!=FOLLOWUP_OFF ? " (follow-up)" : "");
 			}
 
 			if(args->opts->followup_mode!=FOLLOWUP_OFF) {
 				if(tripTime!=0) {
-					tripTimeProc=packet_timestamp.tv_sec*SEC_TO_MICROSEC+packet_timestamp.tv_usec;
-					fprintf(stdout,"Est. server processing time (follow-up): %.3f\n",(double)tripTimeProc/1000);
+					tripTimeProc=followup_delta_ns;
+					fprintf(stdout,"Est. server processing time (follow-up): %.6f\n",(double)tripTimeProc/MILLISEC_TO_NANOSEC);
 				} else {
 					tripTimeProc=0;
 					fprintf(stdout,"Error in packet from %s (id=%u, seq=%u, rx_bytes=%d).\nThe server could not report any follow-up information about the processing time.\nNo RTT will be computed.\n",
@@ -637,11 +815,37 @@ static void *rxLoop_t (void *arg) {
 			}
 
 			// Update the current report structure
-			reportStructureUpdate(&reportData,tripTime,lamp_seq_rx);
+			reportStructureUpdate(&reportData,tripTime,lamp_seq_rx_ext);
+
+			// With --shm-stats, publish the updated statistics (a few plain stores inside the shared memory page)
+			reportStructurePublish(&reportData,tripTime);
+
+			// In burst mode, update also the report related to the position of the current packet inside its burst
+			if(burstReportData!=NULL) {
+				reportStructureUpdate(&burstReportData[lamp_seq_rx_ext%args->opts->burst_size],tripTime,lamp_seq_rx_ext);
+			}
+
+			// When interim reports are requested, update also the report of the current window (printing it, if the window is over)
+			if(interim_active) {
+				interimReporterUpdate(&interimData,tripTime,lamp_seq_rx_ext);
+			}
 
 			// In "-W" mode, write the current measured value to the specified CSV file too (if a file was successfully opened)
-			if(Wfiledescriptor>0) {
-				writeToTFile(Wfiledescriptor,args->opts->followup_mode!=FOLLOWUP_OFF,W_DECIMAL_DIGITS,lamp_seq_rx,tripTime,tripTimeProc);
+			// The value is only queued here, when the writer thread is running, not to delay the reception of the next replies
+			if(W_async) {
+				tFileWriterPush(&Wwriter,lamp_seq_rx_ext,tripTime,tripTimeProc);
+			} else if(Wfiledescriptor>0) {
+				writeToTFile(Wfiledescriptor,args->opts->followup_mode!=FOLLOWUP_OFF,W_DECIMAL_DIGITS,lamp_seq_rx_ext,tripTime,tripTimeProc);
+			}
+
+			// With --trace, store the timestamps of the current packet too (in follow-up mode, only their difference is still available here)
+			if(trace_active) {
+				if(args->opts->followup_mode==FOLLOWUP_OFF) {
+					traceFileAppend(&trace,lamp_seq_rx_ext,tx_timestamp_ns,rx_timestamp_ns,0,tripTime==0 ? TRACE_FLAG_ERROR : 0);
+				} else {
+					traceFileAppend(&trace,lamp_seq_rx_ext,0,tripTime+tripTimeProc,tripTimeProc,
+						TRACE_FLAG_RELATIVE | TRACE_FLAG_FOLLOWUP | (tripTime==0 ? TRACE_FLAG_ERROR : 0));
+				}
 			}
 
 			if(continueFlag==0) {
@@ -654,10 +858,30 @@ static void *rxLoop_t (void *arg) {
 		}
 	} while(continueFlag || fu_flag);
 
+	if(rx_batch_active) {
+		rxBatchDestroy(&rxBatchData);
+	}
+
+	if(W_async) {
+		tFileWriterStop(&Wwriter);
+
+		if(Wwriter.dropped>0 || Wwriter.writeErrors>0) {
+			fprintf(stderr,"Warning: %" PRIu64 " lines could not be queued for the '-W' file, and %" PRIu64 " write errors occurred.\n",Wwriter.dropped,Wwriter.writeErrors);
+		}
+	}
+
 	if(Wfiledescriptor>0) {
 		closeTfile(Wfiledescriptor);
 	}
 
+	if(trace_active) {
+		if(trace.dropped>0) {
+			fprintf(stderr,"Warning: %" PRIu64 " packets could not be written to the binary trace, as it could not be extended.\n",trace.dropped);
+		}
+
+		traceFileClose(&trace);
+	}
+
 	pthread_exit(NULL);
 }
 
@@ -720,7 +944,7 @@ static void unidirRxTxLoop (arg_struct_udp *args) {
 		// Parse report structure (for now, it is encoded as a string for conveniency)
 		// Total packets is known to the client only, in this implementation, and it is already set thanks to reportStructureInit(), which
 		// is setting it to 'opts->number'
-		repscanf((const char *)lampPayloadPtr,&reportData);
+		reportStructureParse(&reportData,(const char *)lampPayloadPtr);
 
 		if(controlSenderUDP(args,lamp_id_session,1,ACK,0,0,NULL,NULL)<0) {
 			fprintf(stderr,"Failed sending ACK.\n");
@@ -734,9 +958,17 @@ unsigned int runUDPclient(struct lampsock_data sData, struct options *opts) {
 	arg_struct_udp args;
 	arg_struct_followup_listener ful_args;
 
+	// Tx timestamp reaper matching method (HARDWARE/SOFTWARE mode only)
+	uint8_t reaper_match;
+	int return_value;
+
+	// pcapng file (--pcapng only): local address of the socket and comment of the interface
+	socklen_t pcapngAddrLen;
+	char pcapngComment[64];
+
 	// Inform the user about the current options
 	fprintf(stdout,"UDP client started, with options:\n\t[socket type] = UDP\n"
-		"\t[interval] = %" PRIu64 " ms\n"
+		"\t[interval] = %g ms%s\n"
 		"\t[reception timeout] = %" PRIu64 " ms\n"
 		"\t[total number of packets] = %" PRIu64 "\n"
 		"\t[mode] = %s\n"
@@ -744,7 +976,8 @@ unsigned int runUDPclient(struct lampsock_data sData, struct options *opts) {
 		"\t[destination IP address] = %s\n"
 		"\t[latency type] = %s\n"
 		"\t[follow-up] = %s\n",
-		opts->interval, opts->interval<=MIN_TIMEOUT_VAL_C ? MIN_TIMEOUT_VAL_C+2000 : opts->interval+2000,
+		(double) opts->interval_ns/MILLISEC_TO_NANOSEC, opts->tx_spin_ns>0 ? " (sleep-then-spin)" : "",
+		opts->interval<=MIN_TIMEOUT_VAL_C ? MIN_TIMEOUT_VAL_C+2000 : opts->interval+2000,
 		opts->number, opts->mode_ub==UNIDIR ? "unidirectional" : "ping-like", 
 		opts->payloadlen, inet_ntoa(opts->destIPaddr),
 		latencyTypePrinter(opts->latencyType),
@@ -757,6 +990,30 @@ unsigned int runUDPclient(struct lampsock_data sData, struct options *opts) {
 		fprintf(stdout,"\t[user priority] = %d\n",opts->macUP);
 	}
 
+	// Print the burst size, only when more than one packet is sent for each interval
+	if(opts->burst_size>1) {
+		fprintf(stdout,"\t[burst size] = %u packets\n",opts->burst_size);
+	}
+
+	// Print the clock source, only when it is not the default one
+	if(opts->clock_source!=CLOCKSRC_REALTIME) {
+		fprintf(stdout,"\t[clock source] = %s\n",clockSourcePrinter(opts->clock_source));
+	}
+
+	// Print the receive batch size, only when the replies are received with recvmmsg()
+	if(opts->rx_batch>1 && opts->mode_ub==PINGLIKE) {
+		fprintf(stdout,"\t[rx batch size] = %u datagrams\n",opts->rx_batch);
+	}
+
+	// Print the busy polling budget, only when the Rx loop is spinning
+	if(opts->busy_poll_us>0 && opts->mode_ub==PINGLIKE) {
+		fprintf(stdout,"\t[busy poll] = %u us",opts->busy_poll_us);
+		if(opts->busy_poll_cpu>=0) {
+			fprintf(stdout," (Rx loop on CPU %d)",opts->busy_poll_cpu);
+		}
+		fprintf(stdout,"\n");
+	}
+
 	// LaMP ID is randomly generated between 0 and 65535 (the maximum over 16 bits)
 	lamp_id_session=(rand()+getpid())%UINT16_MAX;
 
@@ -786,9 +1043,31 @@ unsigned int runUDPclient(struct lampsock_data sData, struct options *opts) {
 		}
 	}
 
+	// When requested, get also a ns software receive timestamp for each reply, to measure the host receive delay
+	if(opts->host_rx_delay==1) {
+		if(opts->mode_ub!=PINGLIKE || opts->latencyType!=USERTOUSER) {
+			opts->host_rx_delay=0;
+		} else if(hostRxDelayEnable(sData.descriptor)<0) {
+			perror("hostRxDelayEnable() error");
+			fprintf(stderr,"Warning: SO_TIMESTAMPNS is probably not supported. The host receive delay will not be reported.\n");
+			opts->host_rx_delay=0;
+		} else {
+			hostRxDelayInit(&hostRxDelayData);
+		}
+	}
+
 	// Initialize the report structure
 	reportStructureInit(&reportData, 0, opts->number, opts->latencyType, opts->followup_mode);
 
+	// In ping-like burst mode, initialize also one report for each position inside a burst
+	if(opts->burst_size>1 && opts->mode_ub==PINGLIKE) {
+		burstReportData=burstReportsInit(opts->burst_size, opts->number, opts->latencyType, opts->followup_mode);
+
+		if(burstReportData==NULL) {
+			fprintf(stderr,"Warning: unable to allocate memory for the per-burst-position statistics.\n\tOnly the overall statistics will be reported.\n");
+		}
+	}
+
 	// Prepare sendto sockaddr_in structure (index 1) for the client
 	memset(&(sData.addru.addrin[1]),0,sizeof(sData.addru.addrin[1]));
 	sData.addru.addrin[1].sin_family=AF_INET;
@@ -846,9 +1125,7 @@ unsigned int runUDPclient(struct lampsock_data sData, struct options *opts) {
 
 		// If mode is HARDWARE or SOFTWARE, initialize the data structure to store the tx timestamps and the semaphore 'tx_sem'
 		if(opts->latencyType==HARDWARE || opts->latencyType==SOFTWARE) {
-			tslist=timevalSL_init();
-
-			if(CHECK_SL_NULL(tslist)) {
+			if(tsRingInit(&tslist,TS_RING_DEFAULT_SIZE)<0) {
 				fprintf(stderr,"Warning: unable to allocate/initialize memory for the hardware/software timestamping mode.\n\tSwitching back to user-to-user latency.\n");
 		    	opts->latencyType=USERTOUSER;
 			}
@@ -856,16 +1133,71 @@ unsigned int runUDPclient(struct lampsock_data sData, struct options *opts) {
 
 		// If the follow-up mechanism is active, initialize the data structure to store triptimes when waiting for the follow-up messages
 		if(opts->followup_mode!=FOLLOWUP_OFF) {
-			triptimelist=timevalSL_init();
-
-			if(CHECK_SL_NULL(triptimelist)) {
+			if(tsRingInit(&triptimelist,TS_RING_DEFAULT_SIZE)<0) {
 				fprintf(stderr,"Warning: unable to allocate memory for the follow-up mode.\n\tIt has been disabled.\n");
 		    	opts->followup_mode=FOLLOWUP_OFF;
 			}
 		}
 
+		// Start the tx timestamp reaper, matching the timestamps through their SOF_TIMESTAMPING_OPT_ID key (set only now, as the key
+		// must count the measurement packets only), or, if the key cannot be requested, through the looped-back packets
+		if(opts->mode_ub==PINGLIKE && (opts->latencyType==HARDWARE || opts->latencyType==SOFTWARE)) {
+			reaper_match=TXREAPER_MATCH_ID;
+
+			if(socketSetTimestampingTxID(sData.descriptor,opts->latencyType==HARDWARE ? SET_TIMESTAMPING_HW : SET_TIMESTAMPING_SW_RXTX)<0) {
+				perror("socketSetTimestampingTxID() error");
+				fprintf(stderr,"Warning: cannot request timestamp IDs. The tx timestamps will be matched by parsing the looped-back packets.\n");
+				reaper_match=TXREAPER_MATCH_PAYLOAD;
+			}
+
+			return_value=txReaperStart(&txReaperData,sData.descriptor,&tslist,reaper_match,opts->latencyType==HARDWARE,
+				ETH_IP_UDP_PACKET_SIZE_S(sizeof(struct lamphdr)+opts->payloadlen)); // Macro from Rawsock library
+
+			if(return_value<0) {
+				perror("txReaperStart() error");
+				fprintf(stderr,"Warning: unable to start the tx timestamp reaper (error code: %d).\n\tSwitching back to user-to-user latency.\n",return_value);
+				opts->latencyType=USERTOUSER;
+			}
+		}
+
+		// -L u/-L r, in ping-like mode: the tx timestamps carried by the LaMP header have only us resolution, thus the Tx loop also
+		// stores them inside 'tslist', with ns resolution (if the allocation fails, the ones carried by the replies are used)
+		if(opts->mode_ub==PINGLIKE && (opts->latencyType==USERTOUSER || opts->latencyType==KRT) && tslist.slots==NULL) {
+			if(tsRingInit(&tslist,TS_RING_DEFAULT_SIZE)<0) {
+				fprintf(stderr,"Warning: unable to allocate memory for the tx timestamps.\n\tThe latency will be computed with microsecond resolution on the tx side.\n");
+			}
+		}
+
+		// Open the pcapng file (the local address is needed to rebuild the IPv4/UDP headers of the packets)
+		if(opts->pcapng_filename!=NULL) {
+			pcapngAddrLen=sizeof(pcapngLocalAddr);
+			snprintf(pcapngComment,sizeof(pcapngComment),"LaMP client, user timestamps: %s",clockSourcePrinter(opts->clock_source));
+
+			if(getsockname(sData.descriptor,(struct sockaddr *)&pcapngLocalAddr,&pcapngAddrLen)<0) {
+				perror("getsockname() error");
+				fprintf(stderr,"Warning: cannot get the local address of the socket.\n\tThe '--pcapng' option will be disabled.\n");
+			} else if((return_value=pcapngOpen(&pcapngData,opts->pcapng_filename,0,PCAPNG_LINKTYPE_RAW,sData.devname,pcapngComment))<0) {
+				perror("pcapngOpen() error");
+				fprintf(stderr,"Warning: cannot create the pcapng file %s (error code: %d).\n\tThe '--pcapng' option will be disabled.\n",opts->pcapng_filename,return_value);
+			} else {
+				pcapng_active=1;
+			}
+		}
+
+		// Reset the live statistics page (--shm-stats only) for the current test
+		statsPageSessionStart(lamp_id_session,opts->number,opts->latencyType,opts->followup_mode!=FOLLOWUP_OFF);
+
 		// Start rx and tx loops
 		if(opts->mode_ub==PINGLIKE) {
+			// The test can be interrupted (SIGINT/SIGTERM) without losing the statistics gathered so far
+			testStopInit();
+
+			if(opts->interim_ns>0 || opts->interim_packets>0) {
+				interimReporterInit(&interimData,opts);
+				interimReporterSetRxTimeout(&interimData,sData.descriptor);
+				interim_active=1;
+			}
+
 			// Create a sending thread and a receiving thread, then wait for their termination
 			pthread_create(&txLoop_tid,NULL,&txLoop_t,(void *) &args);
 			pthread_create(&rxLoop_tid,NULL,&rxLoop_t,(void *) &args);
@@ -873,6 +1205,13 @@ unsigned int runUDPclient(struct lampsock_data sData, struct options *opts) {
 			// Wait for the threads to finish
 			pthread_join(txLoop_tid,NULL);
 			pthread_join(rxLoop_tid,NULL);
+
+			txReaperStop(&txReaperData);
+
+			if(interim_active) {
+				interimReporterFlush(&interimData);
+				interimReporterClose(&interimData);
+			}
 		} else if(opts->mode_ub==UNIDIR) {
 			txLoop(&args);
 			unidirRxTxLoop(&args);
@@ -880,6 +1219,14 @@ unsigned int runUDPclient(struct lampsock_data sData, struct options *opts) {
 			fprintf(stderr,"Error: some unknown error caused the mode not be set when starting the UDP client.\n");
 			return 1;
 		}
+
+		if(pcapng_active) {
+			pcapngClose(&pcapngData);
+
+			if(pcapngData.writeErrors>0) {
+				fprintf(stderr,"Warning: %" PRIu64 " packets could not be written to the pcapng file.\n",pcapngData.writeErrors);
+			}
+		}
 	} else {
 		fprintf(stderr,"Error: the init procedure could not be completed. No test will be performed.\n");
 	}
@@ -887,14 +1234,26 @@ unsigned int runUDPclient(struct lampsock_data sData, struct options *opts) {
 	// Print error messages, if errors have occurred (and, in case of error, return 1)
 	if(t_tx_error!=NO_ERR) {
 		thread_error_print("UDP Tx loop", t_tx_error);
+		statsPageSessionEnd(STATSPAGE_STATE_ERROR);
 		return 1;
 	}
 
 	if(t_rx_error!=NO_ERR) {
 		thread_error_print("UDP Rx loop", t_rx_error);
+		statsPageSessionEnd(STATSPAGE_STATE_ERROR);
 		return 1;
 	}
 
+	// When the test has been interrupted, the statistics refer only to the packets which have actually been sent
+	if(testStopRequested()) {
+		fprintf(stdout,"Test interrupted after sending %" PRIu64 " packets (out of %" PRIu64 ").\n",txPacketsSent,opts->number);
+		reportData.totalPackets=txPacketsSent;
+
+		if(burstReportData!=NULL) {
+			burstReportsSetTotalPackets(burstReportData,opts->burst_size,txPacketsSent);
+		}
+	}
+
 	/* Ok, the mode_ub==UNSET_UB case is not managed, but it should never happen to reach this point
 	with an unset mode... at least not without getting errors or a chaotic thread behaviour! But it should not happen anyways. */
 	fprintf(stdout,opts->mode_ub==PINGLIKE?"Ping-like ":"Unidirectional " "statistics:\n");
@@ -902,19 +1261,28 @@ unsigned int runUDPclient(struct lampsock_data sData, struct options *opts) {
 	reportStructureFinalize(&reportData);
 	printStats(&reportData,stdout,opts->confidenceIntervalMask);
 
+	// Publish the final statistics too (in unidirectional mode, these are the only ones, received from the server)
+	reportStructurePublish(&reportData,0);
+	statsPageSessionEnd(STATSPAGE_STATE_FINISHED);
+
 	if(opts->filename!=NULL) {
 		// If '-f' was specified, print the report data to a file too
 		printStatsCSV(opts,&reportData,opts->filename);
 	}
 
-	if(!CHECK_SL_NULL(tslist)) {
-		timevalSL_free(tslist);
+	if(burstReportData!=NULL) {
+		printBurstStats(burstReportData,opts->burst_size,stdout);
+		free(burstReportData);
 	}
 
-	if(!CHECK_SL_NULL(triptimelist)) {
-		timevalSL_free(triptimelist);
+	if(opts->host_rx_delay==1) {
+		hostRxDelayPrint(stdout,&hostRxDelayData,opts->busy_poll_us>0);
 	}
 
+	tsRingFree(&tslist);
+
+	tsRingFree(&triptimelist);
+
 	// Returning 0 if everything worked fine
 	return 0;
 }
\ No newline at end of file
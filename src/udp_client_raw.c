@@ -12,14 +12,48 @@
 #include <errno.h>
 #include <linux/errqueue.h>
 #include "timeval_utils.h"
+#include "ts_ring.h"
+#include "clock_source.h"
+#include "seq_extend.h"
 #include "common_thread.h"
 #include "timer_man.h"
 #include "common_udp.h"
+#include "frame_template.h"
+#include "tx_ring.h"
+#include "rx_ring.h"
+#include "bpf_filter.h"
+#include "xdp_sock.h"
+#include "tx_reaper.h"
+#include "interim_report.h"
+#include "tfile_writer.h"
+#include "trace_file.h"
+#include "pcapng_writer.h"
+#include "stats_page.h"
 
 // Local global variables
 static pthread_t txLoop_tid, rxLoop_tid, ackListenerInit_tid, initSender_tid, followupReplyListener_tid, followupRequestSender_tid;
 static uint16_t lamp_id_session;
 static reportStructure reportData;
+// Per-position statistics, one report for each position inside a burst (allocated only in ping-like burst mode)
+static reportStructure *burstReportData=NULL;
+
+// Interim reports (--interim only)
+static interimReporter interimData;
+static uint8_t interim_active=0;
+
+// Number of packets actually sent by the Tx loop (it is lower than the requested one when the test is interrupted)
+static uint64_t txPacketsSent=0;
+
+// pcapng export of the LaMP frames (--pcapng only), written by both the tx and rx loops
+static pcapngWriter pcapngData;
+static uint8_t pcapng_active=0;
+
+// PACKET_MMAP TX ring (used only when --tx-ring is specified)
+static txRing txRingData;
+// PACKET_MMAP RX ring (used only when --rx-ring is specified, in ping-like mode)
+static rxRing rxRingData;
+// AF_XDP socket (used only when --xdp is specified)
+static xdpSock xdpSockData;
 
 // Transmit error container
 static t_error_types t_tx_error=NO_ERR;
@@ -28,18 +62,19 @@ static t_error_types t_rx_error=NO_ERR;
 
 // Data structure to store tx timestamps for HARDWARE/SOFTWARE mode
 // When in HARDWARE/SOFTWARE mode, a structure to store the tx timestamps is needed
-// Using timevalStoreList, as defined in timeval_utils.h
+// Using a tsRing, as defined in ts_ring.h
 // This structure will be allocated only if HARDWARE/SOFTWARE mode is properly supported 
-timevalStoreList tslist;
+static tsRing tslist={.slots=NULL};
 
-// The same applies for the following list, used to store temporary trip times (as timestamp differences)
+// The same applies for the following ring, used to store temporary trip times (as timestamp differences)
 // when waiting for the server follow-ups, containing an estimate on the time needed
 // to process each client request and send the reply down to the hardware
-// This list is allocated only when the follow-up mode is active
-timevalStoreList triptimelist;
+// This ring is allocated only when the follow-up mode is active
+static tsRing triptimelist={.slots=NULL};
 
-// Mutex to protect tslist, as defined before
-static pthread_mutex_t tslist_mut=PTHREAD_MUTEX_INITIALIZER;
+// Tx timestamp reaper (HARDWARE/SOFTWARE mode only): it drains the socket error queue in its own thread and stores the
+// tx timestamps inside tslist, so that the Tx loop never waits for them
+static txReaper txReaperData={.running=0,.buf=NULL};
 
 static uint8_t ack_init_received=0; // Global flag set by the ackListener thread: = 1 when an ACK has been received, otherwise it is = 0
 static pthread_mutex_t ack_init_received_mut=PTHREAD_MUTEX_INITIALIZER; // Mutex to protect the ack_received variable (as it written by a thread and read by another one)
@@ -51,7 +86,6 @@ extern inline int timevalSub(struct timeval *in, struct timeval *out);
 // Function prototypes
 static void txLoop(arg_struct *args);
 static void unidirRxTxLoop(arg_struct *args);
-static void rawBuffersCleanup(struct pktbuffers_udp buffs);
 
 // Thread entry point function prototypes
 static void *txLoop_t (void *arg);
@@ -200,23 +234,18 @@ static void *txLoop_t (void *arg) {
 }
 
 static void txLoop (arg_struct *args) {
-	// Packet buffers and headers
+	// Packet headers (used only to build the frame template)
 	struct pktheaders_udp headers;
-	struct pktbuffers_udp buffers = {NULL, NULL, NULL, NULL};
 	// IP address (src+dest) structure
 	struct ipaddrs ipaddrs;
 	// id to be inserted in the id field on the IP header
 	unsigned int id=START_ID;
-	// "in packet" LaMP header pointer
-	struct lamphdr *inpacket_lamphdr;
 
-	// Timer management variables
-	struct pollfd timerMon;
-	int clockFd;
-	int timerCaS_res=0;
+	// Pre-built frame: only the IP id and the LaMP ctrl/seq/timestamp fields are patched before each transmission
+	frameTemplate frameTmpl;
 
-	// Junk variable (needed to clear the timer event with read())
-	unsigned long long junk;
+	// Transmission scheduler (absolute deadlines)
+	txScheduler txSched;
 
 	// Payload buffer
 	byte_t *payload_buff=NULL;
@@ -224,43 +253,30 @@ static void txLoop (arg_struct *args) {
 	// while loop counter
 	unsigned int counter=0;
 
-	// Final packet size
-	size_t finalpktsize;
+	// Burst mode variables
+	unsigned int burst_len; // Number of packets to be sent in the current burst (the last burst may be shorter)
+	unsigned int burst_idx; // Position of the current packet inside the burst
 
-	// LaMP packet type and end_flag
-	uint8_t ctrl=CTRL_PINGLIKE_REQ;
-	endflag_t end_flag;
-	uint32_t lampPacketSize=0;
+	// = 1 when the test has been interrupted by the user: the next packet is sent as the last one
+	uint8_t stop_flag=0;
 
-	// SO_TIMESTAMPING variables and structs (cmsg)
-	struct msghdr mhdr;
-	struct iovec iov;
-	struct cmsghdr *cmsg = NULL;
-
-	// Ancillary data buffer
-	char ctrlBuf[CMSG_SPACE(sizeof(struct scm_timestamping))];
-
-	// iov_base buffer pointer
-	byte_t *data_iov=NULL;
-
-	// LaMP packet pointer (from data_iov, to be used in HARDWARE/SOFTWARE mode only)
-	byte_t *lampPacketRxPtr=NULL;
-
-	// LaMP fields for packet retrieved from socket error queue (hardware tx timestamping only)
-	uint16_t lamp_seq_rx_errqueue=0;
-	lamptype_t lamp_type_rx_errqueue;
+	// LaMP packet type
+	uint8_t ctrl=CTRL_PINGLIKE_REQ;
 
-	// recvfrom variable (for HARDWARE/SOFTWARE mode only)
-	ssize_t rcv_bytes;
+	// Application level tx timestamp, inserted inside each packet
+	struct timeval app_tx_timestamp;
+	uint64_t app_tx_timestamp_ns;
+	// = 1 if the ns tx timestamps have to be stored inside 'tslist' too (see runUDPclient_raw())
+	uint8_t store_tx_ns=tslist.slots!=NULL && (args->opts->latencyType==USERTOUSER || args->opts->latencyType==KRT);
 
-	// struct scm_timestamping and struct timeval for the tx timestamp
-	struct scm_timestamping hw_ts;
-	struct timeval tx_timestamp;
+	// Timestamps of the frames written to the pcapng file (--pcapng only)
+	pcapngStamps pcapStamps={0};
 
 	// Populating headers
 	// [IMPROVEMENT] Future improvement: get destination MAC through ARP or broadcasted information and not specified by the user
 	etherheadPopulate(&(headers.etherHeader), args->srcMAC, args->opts->destmacaddr, ETHERTYPE_IP);
 	IP4headPopulateS(&(headers.ipHeader), args->sData.devname, args->opts->destIPaddr, 0, 0, BASIC_UDP_TTL, IPPROTO_UDP, FLAG_NOFRAG_MASK, &ipaddrs);
+	IP4headAddID(&(headers.ipHeader),(unsigned short) id);
 	UDPheadPopulate(&(headers.udpHeader), CLIENT_SRCPORT, args->opts->port);
 	if(args->opts->mode_ub==PINGLIKE) {
 		if(args->opts->latencyType==SOFTWARE || args->opts->latencyType==HARDWARE) {
@@ -277,81 +293,10 @@ static void txLoop (arg_struct *args) {
 	}
 	lampHeadPopulate(&(headers.lampHeader), ctrl, lamp_id_session, 0); // Starting from sequence number = 0
 
-	// Allocating packet buffers (with and without payload)
-	if(args->opts->payloadlen!=0) {
-		buffers.lamppacket=malloc(sizeof(struct lamphdr)+args->opts->payloadlen);
-		if(!buffers.lamppacket) {
-			t_tx_error=ERR_MALLOC;
-			pthread_exit(NULL);
-		}
-
-		lampPacketSize=LAMP_HDR_PAYLOAD_SIZE(args->opts->payloadlen);
-	} else {
-		// There is no need to allocate the lamppacket buffer, as the LaMP header will be directly encapsulated inside UDP
-		lampPacketSize=LAMP_HDR_SIZE();
-	}
-
-	buffers.udppacket=malloc(UDP_PACKET_SIZE_S(lampPacketSize));
-	if(!buffers.udppacket) {
-		rawBuffersCleanup(buffers);
-		t_tx_error=ERR_MALLOC;
-		pthread_exit(NULL);
-	}
-
-	buffers.ippacket=malloc(IP_UDP_PACKET_SIZE_S(lampPacketSize));
-	if(!buffers.ippacket) {
-		rawBuffersCleanup(buffers);
-		t_tx_error=ERR_MALLOC;
-		pthread_exit(NULL);
-	}
-
-	buffers.ethernetpacket=malloc(ETH_IP_UDP_PACKET_SIZE_S(lampPacketSize));
-	if(!buffers.ethernetpacket) {
-		rawBuffersCleanup(buffers);
-		t_tx_error=ERR_MALLOC;
-		pthread_exit(NULL);
-	}
-
-	memset(&mhdr,0,sizeof(mhdr));
-	// Prepare ancillary data structures, if HARDWARE/SOFTWARE mode is selected (to get send timestamps)
-	if(args->opts->latencyType==SOFTWARE || args->opts->latencyType==HARDWARE) {
-		data_iov=malloc((ETH_IP_UDP_PACKET_SIZE_S(sizeof(struct lamphdr)+args->opts->payloadlen))*sizeof(byte_t));
-
-		if(!data_iov) {
-			rawBuffersCleanup(buffers);
-			t_tx_error=ERR_MALLOC;
-			pthread_exit(NULL);
-		}
-
-		// iovec buffers (scatter/gather arrays) 
-		iov.iov_base=(void *)data_iov;
-		iov.iov_len=(ETH_IP_UDP_PACKET_SIZE_S(sizeof(struct lamphdr)+args->opts->payloadlen))*sizeof(byte_t); // Macro from Rawsock library
-
-		// Socket address structure (not needed here)
-		mhdr.msg_name=NULL;
-		mhdr.msg_namelen=0;
-
-		// Ancillary data (control message)
-		mhdr.msg_control=ctrlBuf;
-        mhdr.msg_controllen=sizeof(ctrlBuf);
-
-        // iovec arrays
-		mhdr.msg_iov=&iov;
-		mhdr.msg_iovlen=1; // 1 element for each recvmsg()
-
-		// As reported into socket.h, these are the "flags on received message"
-		mhdr.msg_flags=NO_FLAGS;
-	}
-
 	// Populate payload buffer only if 'payloadlen' is different than 0
 	if(args->opts->payloadlen!=0) {
 		payload_buff=malloc((args->opts->payloadlen)*sizeof(byte_t));
 		if(!payload_buff) {
-			free(buffers.lamppacket);
-			free(buffers.ethernetpacket);
-			free(buffers.ippacket);
-			free(buffers.udppacket);
-
 			t_tx_error=ERR_MALLOC;
 			pthread_exit(NULL);
 		}
@@ -361,133 +306,146 @@ static void txLoop (arg_struct *args) {
 		}
 	}
 
-	// Get "in packet" LaMP header pointer
-	inpacket_lamphdr=(struct lamphdr *) (buffers.ethernetpacket+sizeof(struct ether_header)+sizeof(struct iphdr)+sizeof(struct udphdr));
-
-	// Set end_flag to FLG_CONTINUE
-	end_flag=FLG_CONTINUE;
-
-	// Create and start timer
-	timerCaS_res=timerCreateAndSet(&timerMon, &clockFd, args->opts->interval);
-
-	if(timerCaS_res==-1) {
-		t_tx_error=ERR_TIMERCREATE;
+	// Build the whole frame once (the payload is copied inside the template, thus its buffer is no more needed after this call)
+	if(frameTemplateInit(&frameTmpl, &headers, ipaddrs, payload_buff, args->opts->payloadlen)<0) {
+		free(payload_buff);
+		t_tx_error=ERR_MALLOC;
 		pthread_exit(NULL);
-	} else if(timerCaS_res==-2) {
-		t_tx_error=ERR_SETTIMER;
+	}
+	free(payload_buff);
+
+	// Initialize the transmission scheduler (the first deadline is one interval from now)
+	if(txSchedulerInit(&txSched, args->opts->interval_ns, args->opts->tx_spin_ns)<0) {
+		frameTemplateFree(&frameTmpl);
+		t_tx_error=ERR_TXSCHED;
 		pthread_exit(NULL);
 	}
 
 	// Run until 'number' is reached
 	while(counter<args->opts->number) {
-		// poll waiting for events happening on the timer descriptor (i.e. wait for timer expiration)
-		if(poll(&timerMon,1,INDEFINITE_BLOCK)>0) {
-			// "Clear the event" by performing a read() on a junk variable
-			read(clockFd,&junk,sizeof(junk));
-			
-			// Prepare datagram
-			IP4headAddID(&(headers.ipHeader),(unsigned short) id);
-			id+=INCR_ID;
-
-			// Encapsulate LaMP payload only it is available
-			if(args->opts->payloadlen!=0) {
-				lampEncapsulate(buffers.lamppacket, &(headers.lampHeader), payload_buff, args->opts->payloadlen);
-				UDPencapsulate(buffers.udppacket,&(headers.udpHeader),buffers.lamppacket,(size_t) lampPacketSize,ipaddrs);
-			} else {
-				UDPencapsulate(buffers.udppacket,&(headers.udpHeader),(byte_t *)&(headers.lampHeader),(size_t) lampPacketSize,ipaddrs);
+		// Wait until the next absolute deadline is reached
+		if(txSchedulerWaitNext(&txSched)<0) {
+			t_tx_error=ERR_TXSCHED;
+			break;
+		}
+
+		// Send 'burst_size' packets for each deadline, or less, if the total number of packets is not a multiple of 'burst_size'
+		// When the test has been interrupted, send just one more packet, to let the server terminate the session
+		stop_flag=testStopRequested();
+		if(stop_flag) {
+			burst_len=1;
+		} else {
+			burst_len=args->opts->number-counter<args->opts->burst_size ? args->opts->number-counter : args->opts->burst_size;
+		}
+
+		for(burst_idx=0;burst_idx<burst_len;burst_idx++) {
+			// Patch the IP id (the first packet already carries START_ID)
+			if(counter>0) {
+				id+=INCR_ID;
+				frameTemplateSetIPid(&frameTmpl,(uint16_t) id);
 			}
 
-			// 'IP4headAddTotLen' may also be skipped since IP4Encapsulate already takes care of filling the length field
-			IP4Encapsulate(buffers.ippacket, &(headers.ipHeader), buffers.udppacket, UDP_PACKET_SIZE_S(lampPacketSize));
-			finalpktsize=etherEncapsulate(buffers.ethernetpacket, &(headers.etherHeader), buffers.ippacket, IP_UDP_PACKET_SIZE_S(lampPacketSize));
+			// Set the END/STOP ctrl value when it's time to send the last packet
+			if(counter==(args->opts->number-1) || stop_flag) {
+				frameTemplateSetEnd(&frameTmpl);
+			}
 
 			if(args->opts->mode_ub==UNIDIR) {
 				fprintf(stdout,"Sent unidirectional message with destination MAC: " PRI_MAC " (id=%u, seq=%u).\n",
 					MAC_PRINTER(args->opts->destmacaddr), lamp_id_session, counter);
 			}
 
-			// Set end flag to FLG_STOP when it's time to send the last packet
-			if(counter==(args->opts->number-1)) {
-					end_flag=FLG_STOP;
-			}
+			// Set the timestamp as late as possible, i.e. just before sending the frame
+			app_tx_timestamp_ns=clockSourceNs();
+			app_tx_timestamp=nsToTimeval(app_tx_timestamp_ns);
+			frameTemplateSetTimestamp(&frameTmpl,&app_tx_timestamp);
 
-			if(args->opts->latencyType==SOFTWARE || args->opts->latencyType==HARDWARE) {
-				pthread_mutex_lock(&tslist_mut);
+			if(store_tx_ns) {
+				tsRingInsert(&tslist,(uint16_t) counter,app_tx_timestamp_ns);
 			}
 
-			if(rawLampSend(args->sData.descriptor, args->sData.addru.addrll, inpacket_lamphdr, buffers.ethernetpacket, finalpktsize, end_flag, UDP)) {
+			if(args->opts->mode_raw==XDP) {
+				// Copy the frame inside the UMEM and send it immediately
+				if(xdpSockSend(&xdpSockData,frameTmpl.frame,frameTmpl.frame_size)<0) {
+					fprintf(stderr,"Failed sending latency measurement packet with seq: %u (AF_XDP).\nThe execution will terminate now.\n",counter);
+					t_tx_error=ERR_XDPSOCK;
+					break;
+				}
+			} else if(args->opts->tx_ring) {
+				// Copy the frame inside the TX ring: it will be sent, together with the rest of the burst, by txRingFlush()
+				if(txRingWrite(&txRingData,frameTmpl.frame,frameTmpl.frame_size)<0) {
+					t_tx_error=ERR_TXRING;
+					break;
+				}
+			} else if(sendto(args->sData.descriptor,frameTmpl.frame,frameTmpl.frame_size,NO_FLAGS,(struct sockaddr *)&(args->sData.addru.addrll),sizeof(struct sockaddr_ll))!=(ssize_t) frameTmpl.frame_size) {
 				if(errno==EMSGSIZE) {
 					fprintf(stderr,"Error: EMSGSIZE 90 Message too long.\n");
 				}
-				fprintf(stderr,"Failed sending latency measurement packet with seq: %u.\nThe execution will terminate now.\n",headers.lampHeader.seq);
+				fprintf(stderr,"Failed sending latency measurement packet with seq: %u.\nThe execution will terminate now.\n",counter);
 				break;
 			}
 
-			// Retrieve tx timestamp if mode is HARDWARE/SOFTWARE
-			// Extract ancillary data with the tx timestamp (if mode is HARDWARE/SOFTWARE)
-			if(args->opts->latencyType==SOFTWARE || args->opts->latencyType==HARDWARE) {
-				do {
-					if(pollErrqueueWait(args->sData.descriptor,POLL_ERRQUEUE_WAIT_TIMEOUT)<=0) {
-						rcv_bytes=-1;
-						pthread_mutex_unlock(&tslist_mut);
-						break;
-					}
-					saferecvmsg(rcv_bytes,args->sData.descriptor,&mhdr,MSG_ERRQUEUE);
-					lampPacketRxPtr=UDPgetpacketpointers(data_iov,NULL,NULL,NULL); // From Rawsock library
-					lampHeadGetData(lampPacketRxPtr,&lamp_type_rx_errqueue,NULL,&lamp_seq_rx_errqueue,NULL,NULL,NULL);
-				} while(lamp_seq_rx_errqueue!=counter || (lamp_type_rx_errqueue!=PINGLIKE_REQ_TLESS && lamp_type_rx_errqueue!=PINGLIKE_ENDREQ_TLESS));
-
-				if(rcv_bytes==-1) {
-					t_rx_error=ERR_TXSTAMP;
-					pthread_mutex_unlock(&tslist_mut);
-					break;
-				}
-
-				for(cmsg=CMSG_FIRSTHDR(&mhdr);cmsg!=NULL;cmsg=CMSG_NXTHDR(&mhdr, cmsg)) {
-		           	if(cmsg->cmsg_level==SOL_SOCKET && cmsg->cmsg_type==SO_TIMESTAMPING) {
-		            	hw_ts=*((struct scm_timestamping *)CMSG_DATA(cmsg));
-		             	tx_timestamp.tv_sec=hw_ts.ts[args->opts->latencyType==HARDWARE ? 2 : 0].tv_sec;
-		       			tx_timestamp.tv_usec=hw_ts.ts[args->opts->latencyType==HARDWARE ? 2 : 0].tv_nsec/MICROSEC_TO_NANOSEC;
-		           	}
-				}
-
-				// Save tx timestamp
-				timevalSL_insert(tslist,counter,tx_timestamp);
-				pthread_mutex_unlock(&tslist_mut);
+			// With --pcapng, write the frame, with the application level timestamp it carries
+			// The kernel/hardware tx timestamps are gathered later on, and written together with the corresponding replies
+			if(pcapng_active) {
+				pcapStamps.user_ns=timevalToNs(&app_tx_timestamp);
+				pcapngWriteFrame(&pcapngData,PCAPNG_DIR_OUTBOUND,frameTmpl.frame,frameTmpl.frame_size,&pcapStamps);
 			}
 
 			// Increase sequence number for the next iteration
-			lampHeadIncreaseSeq(&(headers.lampHeader));
+			frameTemplateIncreaseSeq(&frameTmpl);
 
 			// Increase counter
 			counter++;
 		}
-	}
 
-	// Free payload buffer
-	if(args->opts->payloadlen!=0) {
-		free(payload_buff);
+		// Stop if any packet of the current burst could not be sent
+		if(burst_idx<burst_len) {
+			break;
+		}
+
+		// With the TX ring, the whole burst is sent now, with a single system call
+		if(args->opts->tx_ring && txRingFlush(&txRingData)<0) {
+			perror("txRingFlush() error");
+			fprintf(stderr,"Failed sending latency measurement packets up to seq: %u.\nThe execution will terminate now.\n",counter-1);
+			t_tx_error=ERR_SEND;
+			break;
+		}
+
+		if(stop_flag) {
+			break;
+		}
 	}
 
-	// Close timer file descriptor
-	close(clockFd);
+	txPacketsSent=counter;
 
 	// Free all buffers before exiting
-	// Free the LaMP packet buffer only if it was allocated (otherwise a SIGSEGV may occur if payloadLen is 0)
-	if(buffers.lamppacket) free(buffers.lamppacket);
-	if(data_iov) free(data_iov);
-	free(buffers.udppacket);
-	free(buffers.ippacket);
-	free(buffers.ethernetpacket);
+	frameTemplateFree(&frameTmpl);
 }
 
 static void *rxLoop_t (void *arg) {
 	arg_struct *args=(arg_struct *) arg;
 
 	int Wfiledescriptor=-1;
+	// Asynchronous writer of the -W file (= 1 when its thread is running, otherwise the lines are written synchronously)
+	tFileWriter Wwriter;
+	uint8_t W_async=0;
+
+	// Binary per-packet trace (--trace only)
+	traceFile trace;
+	traceHeader traceHdr;
+	uint8_t trace_active=0;
+
+	// Timestamps of the frames written to the pcapng file (--pcapng only)
+	pcapngStamps pcapStamps;
 
 	// Packet buffer with size = Ethernet MTU
-	byte_t packet[RAW_RX_PACKET_BUF_SIZE];
+	byte_t packetBuf[RAW_RX_PACKET_BUF_SIZE];
+	// Pointer to the current packet: it points to 'packetBuf', or directly inside the RX ring (--rx-ring) or the UMEM (--xdp)
+	byte_t *packet=packetBuf;
+
+	// Frame descriptor filled by rxRingRecv() (--rx-ring only)
+	rxRingFrame ringFrame;
 
 	// recvfrom variables
 	ssize_t rcv_bytes;
@@ -496,13 +454,19 @@ static void *rxLoop_t (void *arg) {
 	struct pktheadersptr_udp headerptrs;
 	byte_t *lampPacket=NULL;
 
-	// RX and TX timestamp containers (plus follow-up and trip time timestamps for the HARDWARE/SOFTWARE mode)
-	struct timeval rx_timestamp, tx_timestamp, triptime_timestamp, packet_timestamp;
+	// RX and TX timestamps, in ns (plus the trip time, waiting for the follow-up, and the timestamp carried inside the LaMP header)
+	uint64_t rx_timestamp_ns=0, tx_timestamp_ns=0, triptime_ns=0;
+	// ns tx timestamp stored by the Tx loop (-L u and -L r, ping-like mode only)
+	uint64_t tx_stored_ns;
+	struct timeval packet_timestamp;
+	// Server processing delta carried by the last FOLLOWUP_DATA message, in ns
+	uint64_t followup_delta_ns=0;
 	struct scm_timestamping hw_ts;
+	uint8_t hw_ts_valid; // = 1 when 'hw_ts' has been set from the ancillary data of the current packet
 
-	// Variable to store the latency (trip time)
+	// Variable to store the latency (trip time) [ns]
 	uint64_t tripTime=0;
-	// Variable to store the processing time (server time delta) when using follow-up mode
+	// Variable to store the processing time (server time delta) when using follow-up mode [ns]
 	uint64_t tripTimeProc=0;
 
 	// LaMP relevant fields
@@ -510,6 +474,7 @@ static void *rxLoop_t (void *arg) {
 	uint16_t lamp_id_rx;
 	uint16_t lamp_seq_rx;
 	uint16_t lamp_payloadlen_rx;
+	byte_t *lamp_payload_rx=NULL;
 
 	// struct sockaddr_ll filled by recvfrom() and used to filter out outgoing traffic
 	struct sockaddr_ll addrll;
@@ -521,13 +486,22 @@ static void *rxLoop_t (void *arg) {
 	struct cmsghdr *cmsg = NULL;
 
 	// Ancillary data buffers
-	char ctrlBufKrt[CMSG_SPACE(sizeof(struct timeval))];
+	char ctrlBufKrt[CMSG_SPACE(sizeof(struct timespec))];
 	char ctrlBufHwSw[CMSG_SPACE(sizeof(struct scm_timestamping))];
 
 	int fu_flag=1; // Flag set to 0 when a follow-up is received after an ENDREPLY or ENDREPLY_TLESS (SOFTWARE or HARDWARE latencyType only, fixed to 0 for other types)
 	int continueFlag=1; // Flag set to 0 when an ENDREPLY or ENDREPLY_TLESS is received
 	int errorTsFlag=0; // Flag set to 1 when an error occurred in retrieving a timestamp (i.e. if no latency data can be reported for the current packet)
 
+	// Extended (64-bit) sequence number of the received packet, used to update the reports and written to the -W CSV file
+	seqExtender seqExt;
+	uint64_t lamp_seq_rx_ext=0;
+
+	// Wall clock step detection, performed only when the measurement relies on CLOCK_REALTIME (user space or kernel software timestamps)
+	clockStepDetector stepDetector;
+	uint8_t step_check=args->opts->latencyType==KRT || args->opts->latencyType==SOFTWARE ||
+		(args->opts->latencyType==USERTOUSER && args->opts->clock_source==CLOCKSRC_REALTIME);
+
 	// Container for the source MAC address (read from packet)
 	macaddr_t srcmacaddr_pkt=prepareMacAddrT();
 
@@ -537,6 +511,9 @@ static void *rxLoop_t (void *arg) {
 		pthread_exit(NULL);
 	}
 
+	clockStepDetectorInit(&stepDetector);
+	seqExtenderInit(&seqExt);
+
 	// Set fu_flag to 0 if follow-up mode is disabled
 	if(args->opts->followup_mode==FOLLOWUP_OFF) {
 		fu_flag=0;
@@ -546,8 +523,8 @@ static void *rxLoop_t (void *arg) {
 	memset(&mhdr,0,sizeof(mhdr));
 	if(args->opts->latencyType==KRT || args->opts->latencyType==HARDWARE || args->opts->latencyType==SOFTWARE) {
 		// iovec buffers (scatter/gather arrays)
-		iov.iov_base=packet;
-		iov.iov_len=sizeof(packet);
+		iov.iov_base=packetBuf;
+		iov.iov_len=sizeof(packetBuf);
 
 		// Socket address structure
 		mhdr.msg_name=NULL;
@@ -570,6 +547,32 @@ static void *rxLoop_t (void *arg) {
 		Wfiledescriptor=openTfile(args->opts->Wfilename,args->opts->followup_mode!=FOLLOWUP_OFF);
 		if(Wfiledescriptor<0) {
 			fprintf(stderr,"Warning! Cannot open file for writing single packet latency data.\nThe '-W' option will be disabled.\n");
+		} else if(tFileWriterStart(&Wwriter,Wfiledescriptor,args->opts->followup_mode!=FOLLOWUP_OFF,W_DECIMAL_DIGITS,TFILE_WRITER_DEFAULT_SIZE,args->opts->w_sync)<0) {
+			perror("tFileWriterStart() error");
+			fprintf(stderr,"Warning: unable to start the '-W' writer thread.\n\tSwitching back to synchronous writes.\n");
+		} else {
+			W_async=1;
+		}
+	}
+
+	// Create the binary trace, with room for all the packets which are going to be sent (it is extended if more replies are received)
+	if(args->opts->trace_filename!=NULL) {
+		traceHeaderInit(&traceHdr);
+		traceHdr.latency_type=args->opts->latencyType;
+		traceHdr.clock_source=args->opts->clock_source;
+		traceHdr.lamp_id=lamp_id_session;
+		traceHdr.payload_len=args->opts->payloadlen;
+		traceHdr.followup=args->opts->followup_mode!=FOLLOWUP_OFF;
+		traceHdr.total_packets=args->opts->number;
+		traceHdr.interval_ns=args->opts->interval_ns;
+		traceHdr.mode_ub=args->opts->mode_ub;
+		traceHdr.burst_size=args->opts->burst_size;
+
+		if(traceFileCreate(&trace,args->opts->trace_filename,&traceHdr,args->opts->number)<0) {
+			perror("traceFileCreate() error");
+			fprintf(stderr,"Warning: cannot create the binary trace file %s.\n\tThe '--trace' option will be disabled.\n",args->opts->trace_filename);
+		} else {
+			trace_active=1;
 		}
 	}
 
@@ -581,8 +584,15 @@ static void *rxLoop_t (void *arg) {
 
 	// Start receiving packets until an 'ENDREPLY' one is received (this is the ping-like loop)
 	do {
-		// If in KRT mode or HARDWARE/SOFTWARE mode, use (the safe version of) recvmsg(), otherwise, use recvfrom()
-		if(args->opts->latencyType==KRT || args->opts->latencyType==HARDWARE || args->opts->latencyType==SOFTWARE) {
+		hw_ts_valid=0;
+
+		// When the RX ring is active, get the next frame directly from it (no system call is needed until the current block is exhausted)
+		// Otherwise, if in KRT mode or HARDWARE/SOFTWARE mode, use (the safe version of) recvmsg(), otherwise, use recvfrom()
+		if(args->opts->mode_raw==XDP) {
+			rcv_bytes=xdpSockRecv(&xdpSockData,&packet);
+		} else if(args->opts->rx_ring) {
+			rcv_bytes=rxRingRecv(&rxRingData,&ringFrame);
+		} else if(args->opts->latencyType==KRT || args->opts->latencyType==HARDWARE || args->opts->latencyType==SOFTWARE) {
 			saferecvmsg(rcv_bytes,args->sData.descriptor,&mhdr,NO_FLAGS);
 		} else {
 			saferecvfrom(rcv_bytes,args->sData.descriptor,packet,RAW_RX_PACKET_BUF_SIZE,NO_FLAGS,(struct sockaddr *)&addrll,&addrllLen);
@@ -590,7 +600,15 @@ static void *rxLoop_t (void *arg) {
 
 		// Timeout or other recvfrom() error occurred
 		if(rcv_bytes==-1) {
-			if(errno==EAGAIN) {
+			// With time based interim reports, the receive timeout is shortened to the window duration: close the expired window and keep waiting
+			if(errno==EAGAIN && interim_active && interimReporterRxTimeout(&interimData)) {
+				continue;
+			}
+
+			if(errno==EAGAIN && testStopRequested()) {
+				// The reply to the last packet sent after an interruption may be lost: this is not an error
+				fprintf(stderr,"Timeout when waiting for the last reply after the interruption.\n");
+			} else if(errno==EAGAIN) {
 				t_rx_error=ERR_TIMEOUT;
 				fprintf(stderr,"Timeout when waiting for new packets.\n");
 			} else {
@@ -599,7 +617,21 @@ static void *rxLoop_t (void *arg) {
 			break;
 		}
 
-		// Filter out all outgoing packets - [IMPROVEMENT] use BPF instead
+		// The frame was not copied, when using the RX ring or the AF_XDP socket: point to it inside the ring or the UMEM
+		if(args->opts->rx_ring) {
+			packet=ringFrame.data;
+			addrll.sll_pkttype=ringFrame.pkttype;
+		} else if(args->opts->mode_raw==XDP) {
+			// Only incoming frames are redirected to the AF_XDP socket
+			addrll.sll_pkttype=PACKET_HOST;
+		}
+
+		if(args->opts->rx_ring || args->opts->mode_raw==XDP) {
+			lampPacket=UDPgetpacketpointers(packet,&(headerptrs.etherHeader),&(headerptrs.ipHeader),&(headerptrs.udpHeader));
+			lampGetPacketPointers(lampPacket,&(headerptrs.lampHeader));
+		}
+
+		// Filter out all outgoing packets (they are already dropped by the BPF filter, if it could be attached - see bpf_filter.c)
 		if(addrll.sll_pkttype==PACKET_OUTGOING) {
 			continue;
 		}
@@ -626,7 +658,7 @@ static void *rxLoop_t (void *arg) {
 		}
 
 		// If the packet is really a LaMP packet, get the header data
-		lampHeadGetData(lampPacket, &lamp_type_rx, &lamp_id_rx, &lamp_seq_rx, &lamp_payloadlen_rx, &packet_timestamp, NULL);
+		lampHeadGetData(lampPacket, &lamp_type_rx, &lamp_id_rx, &lamp_seq_rx, &lamp_payloadlen_rx, &packet_timestamp, &lamp_payload_rx);
 
 		// Discard any LaMP packet which is not of interest
 		if(lamp_id_rx!=lamp_id_session) {
@@ -639,74 +671,123 @@ static void *rxLoop_t (void *arg) {
 			}
 		}
 
+		lamp_seq_rx_ext=seqExtend(&seqExt,lamp_seq_rx);
+
 		if(lamp_type_rx==PINGLIKE_REPLY || lamp_type_rx==PINGLIKE_ENDREPLY || lamp_type_rx==PINGLIKE_REPLY_TLESS || lamp_type_rx==PINGLIKE_ENDREPLY_TLESS) {
-			// Extract ancillary data (if mode is KRT or if it is HARDWARE or SOFTWARE)
-			if(args->opts->latencyType==KRT || args->opts->latencyType==HARDWARE || args->opts->latencyType==SOFTWARE) {
+			// When using the RX ring, the kernel receive timestamp is stored inside the frame header (if mode is KRT or if it is HARDWARE or SOFTWARE)
+			// Otherwise, extract ancillary data (if mode is KRT or if it is HARDWARE or SOFTWARE)
+			if(args->opts->rx_ring && args->opts->latencyType!=USERTOUSER) {
+				if(args->opts->latencyType==HARDWARE && !ringFrame.ts_hw) {
+					fprintf(stderr,"Error: no hardware receive timestamp available for packet number: %d.\n",lamp_seq_rx);
+					errorTsFlag=1;
+				}
+
+				rx_timestamp_ns=timespecToNs(&ringFrame.ts);
+			} else if(args->opts->latencyType==KRT || args->opts->latencyType==HARDWARE || args->opts->latencyType==SOFTWARE) {
 				for(cmsg=CMSG_FIRSTHDR(&mhdr);cmsg!=NULL;cmsg=CMSG_NXTHDR(&mhdr, cmsg)) {
-	                if(args->opts->latencyType==KRT && cmsg->cmsg_level==SOL_SOCKET && cmsg->cmsg_type==SO_TIMESTAMP) {
-	                    rx_timestamp=*((struct timeval *)CMSG_DATA(cmsg));
+	                if(args->opts->latencyType==KRT && cmsg->cmsg_level==SOL_SOCKET && cmsg->cmsg_type==SCM_TIMESTAMPNS) {
+	                    rx_timestamp_ns=timespecToNs((struct timespec *)CMSG_DATA(cmsg));
 	                }
 
 	               	if((args->opts->latencyType==HARDWARE || args->opts->latencyType==SOFTWARE) && cmsg->cmsg_level==SOL_SOCKET && cmsg->cmsg_type==SO_TIMESTAMPING) {
 	                    hw_ts=*((struct scm_timestamping *)CMSG_DATA(cmsg));
-	                    rx_timestamp.tv_sec=hw_ts.ts[args->opts->latencyType==HARDWARE ? 2 : 0].tv_sec;
-	                    rx_timestamp.tv_usec=hw_ts.ts[args->opts->latencyType==HARDWARE ? 2 : 0].tv_nsec/MICROSEC_TO_NANOSEC;
+	                    hw_ts_valid=1;
+	                    rx_timestamp_ns=timespecToNs(&hw_ts.ts[args->opts->latencyType==HARDWARE ? 2 : 0]);
 	                }
 				}
 			} else if(args->opts->latencyType==USERTOUSER) {
-				gettimeofday(&rx_timestamp,NULL);
+				rx_timestamp_ns=clockSourceNs();
+			}
+
+			if(step_check==1 && clockStepDetect(&stepDetector)==1) {
+				fprintf(stderr,"Warning: wall clock step detected when receiving the reply with seq: %d. Its latency may be wrong.\n",lamp_seq_rx);
+				reportData.clockStepsCount++;
 			}
 
 			if(args->opts->latencyType==HARDWARE || args->opts->latencyType==SOFTWARE) {
-				pthread_mutex_lock(&tslist_mut);
-				if(timevalSL_gather(tslist,lamp_seq_rx,&tx_timestamp)) {
+				// The tx timestamp may still be on its way through the error queue: wait for the reaper, if needed
+				if(txReaperGather(&txReaperData,lamp_seq_rx,&tx_timestamp_ns,POLL_ERRQUEUE_WAIT_TIMEOUT)<0) {
 					fprintf(stderr,"Error: could not retrieve transmit timestamp for packet number: %d.\n",lamp_seq_rx);
 					errorTsFlag=1;
 				}
-				pthread_mutex_unlock(&tslist_mut);
 			} else {
-				tx_timestamp=packet_timestamp;
+				// Use the ns tx timestamp stored by the Tx loop, if it is available and if it really refers to this packet
+				tx_timestamp_ns=timevalToNs(&packet_timestamp);
+
+				if(tslist.slots!=NULL && tsRingGather(&tslist,lamp_seq_rx,&tx_stored_ns)==0 && tx_stored_ns/1000==tx_timestamp_ns/1000) {
+					tx_timestamp_ns=tx_stored_ns;
+				}
 			}
 
 			if(errorTsFlag==0) {
-				if(timevalSub(&tx_timestamp,&rx_timestamp)) {
+				if(rx_timestamp_ns<tx_timestamp_ns) {
 					fprintf(stderr,"Warning: negative latency!\nThis could potentually indicate that SO_TIMESTAMP is not working properly on your system.\n");
-					tripTime=0;
+					errorTsFlag=1;
 				}
 			}
 
 			if(errorTsFlag==1) {
-				// If a timestamping error occurred, set stored timestamp to 0
-				rx_timestamp.tv_sec=0;
-				rx_timestamp.tv_usec=0;
+				// If a timestamping error occurred, set the time difference to 0
+				triptime_ns=0;
 
 				// Set the flag back to 0 for the next iteration
 				errorTsFlag=0;
+			} else {
+				triptime_ns=rx_timestamp_ns-tx_timestamp_ns;
 			}
 
-			// Compute triptime if follow-up mode is not active, otherwise just store the time difference timestamp, while waiting for the
+			// Compute triptime if follow-up mode is not active, otherwise just store the time difference, while waiting for the
 			// follow-up message, containing the processing time delta to be used later on to compute the final triptime
 			if(args->opts->followup_mode==FOLLOWUP_OFF) {
-				tripTime=rx_timestamp.tv_sec*SEC_TO_MICROSEC+rx_timestamp.tv_usec;
+				tripTime=triptime_ns;
 			} else {
-				timevalSL_insert(triptimelist,lamp_seq_rx,rx_timestamp); // rx_timestamp now contains a timestamp difference (triptime as struct timeval)
+				tsRingInsert(&triptimelist,lamp_seq_rx,triptime_ns);
 			}
 		}
 
+		// With --pcapng, write the received frame, with all the rx timestamps extracted from the ancillary data (or from the RX ring)
+		if(pcapng_active) {
+			memset(&pcapStamps,0,sizeof(pcapStamps));
+
+			if(lamp_type_rx!=FOLLOWUP_DATA) {
+				if(args->opts->latencyType==USERTOUSER) {
+					pcapStamps.user_ns=rx_timestamp_ns;
+				} else if(args->opts->rx_ring && ringFrame.ts_hw) {
+					pcapStamps.hw_ns=rx_timestamp_ns;
+				} else if(args->opts->rx_ring || args->opts->latencyType==KRT) {
+					pcapStamps.kernel_ns=rx_timestamp_ns;
+				} else if(hw_ts_valid) {
+					pcapStamps.kernel_ns=timespecToNs(&hw_ts.ts[0]);
+					pcapStamps.hw_ns=timespecToNs(&hw_ts.ts[2]);
+				} else {
+					// Without the SO_TIMESTAMPING ancillary data, only a user space timestamp can be written
+					pcapStamps.user_ns=clockSourceNs();
+				}
+
+				if(args->opts->latencyType==HARDWARE || args->opts->latencyType==SOFTWARE) {
+					pcapStamps.req_tx_ns=tx_timestamp_ns;
+				}
+			}
+
+			pcapngWriteFrame(&pcapngData,PCAPNG_DIR_INBOUND,packet,rcv_bytes,&pcapStamps);
+		}
+
 		if(args->opts->followup_mode!=FOLLOWUP_OFF && lamp_type_rx==FOLLOWUP_DATA) {
-			if(timevalSL_gather(triptimelist,lamp_seq_rx,&triptime_timestamp)) {
+			followup_delta_ns=getFollowUpDataNs(&packet_timestamp,lamp_payload_rx,lamp_payloadlen_rx);
+
+			if(tsRingGather(&triptimelist,lamp_seq_rx,&triptime_ns)) {
 				fprintf(stderr,"Error: unable to compute delay for packet number: %d.\nIt is possible that a follow-up was received before the corresponding reply.\nReported time will be null.\n",lamp_seq_rx);
 				errorTsFlag=1;
 			} else {
-				if((triptime_timestamp.tv_sec==0 && triptime_timestamp.tv_usec==0) || (packet_timestamp.tv_sec==0 && packet_timestamp.tv_usec==0)) {
+				if(triptime_ns==0 || followup_delta_ns==0) {
 					errorTsFlag=1;
 				}
 
-				if(errorTsFlag==0 && timevalSub(&packet_timestamp,&triptime_timestamp)) {
+				if(errorTsFlag==0 && triptime_ns<followup_delta_ns) {
 					fprintf(stderr,"Warning: negative time!\nThis could potentually indicate that SO_TIMESTAMP is not working properly on your system.\n");
 					errorTsFlag=1;
-				} else {
-					tripTime=triptime_timestamp.tv_sec*SEC_TO_MICROSEC+triptime_timestamp.tv_usec;
+				} else if(errorTsFlag==0) {
+					tripTime=triptime_ns-followup_delta_ns;
 				}
 			}
 		}
@@ -724,15 +805,15 @@ static void *rxLoop_t (void *arg) {
 				// Get source MAC address from packet
 				getSrcMAC(headerptrs.etherHeader,srcmacaddr_pkt);
 
-				fprintf(stdout,"Received a reply from " PRI_MAC " (id=%u, seq=%u). Time: %.3f ms (%s)%s\n",
-					MAC_PRINTER(srcmacaddr_pkt),lamp_id_rx,lamp_seq_rx,(double)tripTime/1000,latencyTypePrinter(args->opts->latencyType),
+				fprintf(stdout,"Received a reply from " PRI_MAC " (id=%u, seq=%u). Time: %.6f ms (%s)%s\n",
+					MAC_PRINTER(srcmacaddr_pkt),lamp_id_rx,lamp_seq_rx,(double)tripTime/MILLISEC_TO_NANOSEC,latencyTypePrinter(args->opts->latencyType),
 					args->opts->followup_mode!=FOLLOWUP_OFF ? " (follow-up)" : "");
 			}
 
 			if(args->opts->followup_mode!=FOLLOWUP_OFF) {
 				if(tripTime!=0) {
-					tripTimeProc=packet_timestamp.tv_sec*SEC_TO_MICROSEC+packet_timestamp.tv_usec;
-					fprintf(stdout,"Est. server processing time (follow-up): %.3f\n",(double)tripTimeProc/1000);
+					tripTimeProc=followup_delta_ns;
+					fprintf(stdout,"Est. server processing time (follow-up): %.6f\n",(double)tripTimeProc/MILLISEC_TO_NANOSEC);
 				} else {
 					tripTimeProc=0;
 					getSrcMAC(headerptrs.etherHeader,srcmacaddr_pkt);
@@ -742,11 +823,37 @@ static void *rxLoop_t (void *arg) {
 			}
 
 			// Update the current report structure
-			reportStructureUpdate(&reportData,tripTime,lamp_seq_rx);
+			reportStructureUpdate(&reportData,tripTime,lamp_seq_rx_ext);
+
+			// With --shm-stats, publish the updated statistics (a few plain stores inside the shared memory page)
+			reportStructurePublish(&reportData,tripTime);
+
+			// In burst mode, update also the report related to the position of the current packet inside its burst
+			if(burstReportData!=NULL) {
+				reportStructureUpdate(&burstReportData[lamp_seq_rx_ext%args->opts->burst_size],tripTime,lamp_seq_rx_ext);
+			}
+
+			// When interim reports are requested, update also the report of the current window (printing it, if the window is over)
+			if(interim_active) {
+				interimReporterUpdate(&interimData,tripTime,lamp_seq_rx_ext);
+			}
 
 			// In "-W" mode, write the current measured value to the specified CSV file too (if a file was successfully opened)
-			if(Wfiledescriptor>0) {
-				writeToTFile(Wfiledescriptor,args->opts->followup_mode!=FOLLOWUP_OFF,W_DECIMAL_DIGITS,lamp_seq_rx,tripTime,tripTimeProc);
+			// The value is only queued here, when the writer thread is running, not to delay the reception of the next replies
+			if(W_async) {
+				tFileWriterPush(&Wwriter,lamp_seq_rx_ext,tripTime,tripTimeProc);
+			} else if(Wfiledescriptor>0) {
+				writeToTFile(Wfiledescriptor,args->opts->followup_mode!=FOLLOWUP_OFF,W_DECIMAL_DIGITS,lamp_seq_rx_ext,tripTime,tripTimeProc);
+			}
+
+			// With --trace, store the timestamps of the current packet too (in follow-up mode, only their difference is still available here)
+			if(trace_active) {
+				if(args->opts->followup_mode==FOLLOWUP_OFF) {
+					traceFileAppend(&trace,lamp_seq_rx_ext,tx_timestamp_ns,rx_timestamp_ns,0,tripTime==0 ? TRACE_FLAG_ERROR : 0);
+				} else {
+					traceFileAppend(&trace,lamp_seq_rx_ext,0,tripTime+tripTimeProc,tripTimeProc,
+						TRACE_FLAG_RELATIVE | TRACE_FLAG_FOLLOWUP | (tripTime==0 ? TRACE_FLAG_ERROR : 0));
+				}
 			}
 
 			if(continueFlag==0) {
@@ -759,6 +866,26 @@ static void *rxLoop_t (void *arg) {
 		}
 	} while(continueFlag || fu_flag);
 
+	if(W_async) {
+		tFileWriterStop(&Wwriter);
+
+		if(Wwriter.dropped>0 || Wwriter.writeErrors>0) {
+			fprintf(stderr,"Warning: %" PRIu64 " lines could not be queued for the '-W' file, and %" PRIu64 " write errors occurred.\n",Wwriter.dropped,Wwriter.writeErrors);
+		}
+	}
+
+	if(Wfiledescriptor>0) {
+		closeTfile(Wfiledescriptor);
+	}
+
+	if(trace_active) {
+		if(trace.dropped>0) {
+			fprintf(stderr,"Warning: %" PRIu64 " packets could not be written to the binary trace, as it could not be extended.\n",trace.dropped);
+		}
+
+		traceFileClose(&trace);
+	}
+
 	// Free source MAC address memory area
 	freeMacAddrT(srcmacaddr_pkt);
 
@@ -815,7 +942,7 @@ static void unidirRxTxLoop (arg_struct *args) {
 			break;
 		}
 
-		// Filter out all outgoing packets - [IMPROVEMENT] use BPF instead
+		// Filter out all outgoing packets (they are already dropped by the BPF filter, if it could be attached - see bpf_filter.c)
 		if(addrll.sll_pkttype==PACKET_OUTGOING) {
 			continue;
 		}
@@ -858,7 +985,7 @@ static void unidirRxTxLoop (arg_struct *args) {
 		// Parse report structure (for now, it is encoded as a string for conveniency)
 		// Total packets is known to the client only, in this implementation, and it is already set thanks to reportStructureInit(), which
 		// is setting it to 'opts->number'
-		repscanf((const char *)payload,&reportData);
+		reportStructureParse(&reportData,(const char *)payload);
 
 		// Fill the ACKdata structure
 		ACKdata.controlRCV.ip=args->opts->destIPaddr;
@@ -872,21 +999,20 @@ static void unidirRxTxLoop (arg_struct *args) {
 	}
 }
 
-static void rawBuffersCleanup(struct pktbuffers_udp buffs) {
-	if(buffs.ethernetpacket) free(buffs.ethernetpacket);
-	if(buffs.ippacket) free(buffs.ippacket);
-	if(buffs.udppacket) free(buffs.udppacket);
-	if(buffs.lamppacket) free(buffs.lamppacket);
-}
-
 unsigned int runUDPclient_raw(struct lampsock_data sData, macaddr_t srcMAC, struct in_addr srcIP, struct options *opts) {
 	// Thread argument structures
 	arg_struct args;
 	arg_struct_followup_listener_raw_ip ful_raw_args;
 
+	// Return value of txRingCreate(), rxRingCreate(), xdpSockCreate() and bpfFilterAttach()
+	int return_value;
+
+	// Comment of the interface of the pcapng file (--pcapng only)
+	char pcapngComment[64];
+
 	// Inform the user about the current options
-	fprintf(stdout,"UDP client started, with options:\n\t[socket type] = RAW\n"
-		"\t[interval] = %" PRIu64 " ms\n"
+	fprintf(stdout,"UDP client started, with options:\n\t[socket type] = %s\n"
+		"\t[interval] = %g ms%s\n"
 		"\t[reception timeout] = %" PRIu64 " ms\n"
 		"\t[total number of packets] = %" PRIu64 "\n"
 		"\t[mode] = %s\n"
@@ -894,7 +1020,9 @@ unsigned int runUDPclient_raw(struct lampsock_data sData, macaddr_t srcMAC, stru
 		"\t[destination IP address] = %s\n"
 		"\t[latency type] = %s\n"
 		"\t[follow-up] = %s\n",
-		opts->interval, opts->interval<=MIN_TIMEOUT_VAL_C ? MIN_TIMEOUT_VAL_C+2000 : opts->interval+2000,
+		opts->mode_raw==XDP ? "RAW (AF_XDP data path)" : "RAW",
+		(double) opts->interval_ns/MILLISEC_TO_NANOSEC, opts->tx_spin_ns>0 ? " (sleep-then-spin)" : "",
+		opts->interval<=MIN_TIMEOUT_VAL_C ? MIN_TIMEOUT_VAL_C+2000 : opts->interval+2000,
 		opts->number, opts->mode_ub==UNIDIR ? "unidirectional" : "ping-like", 
 		opts->payloadlen, inet_ntoa(opts->destIPaddr),
 		latencyTypePrinter(opts->latencyType),
@@ -907,6 +1035,28 @@ unsigned int runUDPclient_raw(struct lampsock_data sData, macaddr_t srcMAC, stru
 		fprintf(stdout,"\t[user priority] = %d\n",opts->macUP);
 	}
 
+	// Print the burst size, only when more than one packet is sent for each interval
+	if(opts->burst_size>1) {
+		fprintf(stdout,"\t[burst size] = %u packets\n",opts->burst_size);
+	}
+
+	// Print the clock source, only when it is not the default one
+	if(opts->clock_source!=CLOCKSRC_REALTIME) {
+		fprintf(stdout,"\t[clock source] = %s\n",clockSourcePrinter(opts->clock_source));
+	}
+
+	if(opts->tx_ring) {
+		fprintf(stdout,"\t[transmission] = PACKET_MMAP TX ring%s\n",opts->qdisc_bypass ? " (qdisc bypass)" : "");
+	}
+
+	if(opts->rx_ring) {
+		fprintf(stdout,"\t[reception] = PACKET_MMAP RX ring (TPACKET_V3)\n");
+	}
+
+	if(opts->mode_raw==XDP) {
+		fprintf(stdout,"\t[AF_XDP queue] = %u\n",opts->xdp_queue);
+	}
+
 	if(opts->latencyType==KRT) {
 		// Check if the KRT mode is supported by the current NIC and set the proper socket options
 		if (socketSetTimestamping(sData,SET_TIMESTAMPING_SW_RX)<0) {
@@ -919,6 +1069,15 @@ unsigned int runUDPclient_raw(struct lampsock_data sData, macaddr_t srcMAC, stru
 	// Initialize the report structure
 	reportStructureInit(&reportData, 0, opts->number, opts->latencyType, opts->followup_mode);
 
+	// In ping-like burst mode, initialize also one report for each position inside a burst
+	if(opts->burst_size>1 && opts->mode_ub==PINGLIKE) {
+		burstReportData=burstReportsInit(opts->burst_size, opts->number, opts->latencyType, opts->followup_mode);
+
+		if(burstReportData==NULL) {
+			fprintf(stderr,"Warning: unable to allocate memory for the per-burst-position statistics.\n\tOnly the overall statistics will be reported.\n");
+		}
+	}
+
 	// Populate/initialize the 'args' structs
 	args.sData=sData;
 	args.opts=opts;
@@ -935,6 +1094,14 @@ unsigned int runUDPclient_raw(struct lampsock_data sData, macaddr_t srcMAC, stru
 	// This fprintf() terminates the series of call to inform the user about current settings -> using \n\n instead of \n
 	fprintf(stdout,"\t[session LaMP ID] = %" PRIu16 "\n\n",lamp_id_session);
 
+	// Attach a BPF filter to the raw socket, in order to receive only the LaMP packets belonging to the current session
+	// The user space checks are kept anyway, as frames may have been queued before the filter is attached
+	return_value=bpfFilterAttach(sData.descriptor, srcIP, CLIENT_SRCPORT, BPF_FILTER_SESSION_ID, lamp_id_session);
+	if(return_value<0) {
+		perror("bpfFilterAttach() error");
+		fprintf(stderr,"Warning: unable to attach the BPF filter to the raw socket (error code: %d).\n\tAll the IPv4 frames will be filtered in user space.\n",return_value);
+	}
+
 	if(opts->latencyType==KRT) {
 		// Check if the KRT mode is supported by the current NIC and set the proper socket options
 		if (socketSetTimestamping(sData,SET_TIMESTAMPING_SW_RX)<0) {
@@ -988,9 +1155,7 @@ unsigned int runUDPclient_raw(struct lampsock_data sData, macaddr_t srcMAC, stru
 
 		// If mode is HARDWARE or SOFTWARE, initialize the data structure to store the tx timestamps
 		if(opts->latencyType==HARDWARE || opts->latencyType==SOFTWARE) {
-			tslist=timevalSL_init();
-
-			if(CHECK_SL_NULL(tslist)) {
+			if(tsRingInit(&tslist,TS_RING_DEFAULT_SIZE)<0) {
 				fprintf(stderr,"Warning: unable to allocate memory for the hardware timestamping mode.\n\tSwitching back to user-to-user latency.\n");
 		    	opts->latencyType=USERTOUSER;
 			}
@@ -998,15 +1163,93 @@ unsigned int runUDPclient_raw(struct lampsock_data sData, macaddr_t srcMAC, stru
 
 		// If the follow-up mechanism is active, initialize the data structure to store triptimes when waiting for the follow-up messages
 		if(opts->followup_mode!=FOLLOWUP_OFF) {
-			triptimelist=timevalSL_init();
-
-			if(CHECK_SL_NULL(triptimelist)) {
+			if(tsRingInit(&triptimelist,TS_RING_DEFAULT_SIZE)<0) {
 				fprintf(stderr,"Warning: unable to allocate memory for the follow-up mode.\n\tIt has been disabled.\n");
 		    	opts->followup_mode=FOLLOWUP_OFF;
 			}
 		}
 
+		// If requested, create the PACKET_MMAP TX ring, large enough to store at least a whole burst
+		if(opts->tx_ring) {
+			return_value=txRingCreate(&txRingData, sData.addru.addrll, ETH_IP_UDP_PACKET_SIZE_S(LAMP_HDR_PAYLOAD_SIZE(opts->payloadlen)),
+				opts->burst_size>TX_RING_MIN_FRAMES ? opts->burst_size : TX_RING_MIN_FRAMES, opts->qdisc_bypass, opts->macUP);
+
+			if(return_value<0) {
+				perror("txRingCreate() error");
+				fprintf(stderr,"Warning: unable to create the PACKET_MMAP TX ring (error code: %d).\n\tSwitching back to sendto().\n",return_value);
+				opts->tx_ring=0;
+			}
+		}
+
+		// Interim reports: the receive timeout is shortened here, before the RX ring or the AF_XDP socket read it
+		if(opts->mode_ub==PINGLIKE && (opts->interim_ns>0 || opts->interim_packets>0)) {
+			interimReporterInit(&interimData,opts);
+			interimReporterSetRxTimeout(&interimData,sData.descriptor);
+			interim_active=1;
+		}
+
+		// If requested, set up the PACKET_MMAP RX ring for the replies (only now, as the control messages are still received with recvfrom())
+		if(opts->rx_ring && opts->mode_ub==PINGLIKE) {
+			return_value=rxRingCreate(&rxRingData, sData.descriptor, opts->latencyType==HARDWARE);
+
+			if(return_value<0) {
+				perror("rxRingCreate() error");
+				fprintf(stderr,"Warning: unable to create the PACKET_MMAP RX ring (error code: %d).\n\tSwitching back to recvfrom()/recvmsg().\n",return_value);
+				opts->rx_ring=0;
+			}
+		}
+
+		// If requested, set up the AF_XDP socket (only now, as the control messages are still exchanged through the raw socket)
+		if(opts->mode_raw==XDP) {
+			return_value=xdpSockCreate(&xdpSockData, sData.descriptor, sData.addru.addrll.sll_ifindex, opts->xdp_queue, srcIP, CLIENT_SRCPORT);
+
+			if(return_value<0) {
+				perror("xdpSockCreate() error");
+				fprintf(stderr,"Warning: unable to set up the AF_XDP socket (error code: %d).\n\tSwitching back to the raw socket.\n",return_value);
+				opts->mode_raw=RAW;
+			}
+		}
+
+		// Start the tx timestamp reaper: packet sockets do not number their tx timestamps on every kernel (SOF_TIMESTAMPING_OPT_ID),
+		// thus the timestamps are matched by parsing the looped-back frames
+		if(opts->mode_ub==PINGLIKE && (opts->latencyType==HARDWARE || opts->latencyType==SOFTWARE)) {
+			return_value=txReaperStart(&txReaperData,sData.descriptor,&tslist,TXREAPER_MATCH_PAYLOAD,opts->latencyType==HARDWARE,
+				ETH_IP_UDP_PACKET_SIZE_S(LAMP_HDR_PAYLOAD_SIZE(opts->payloadlen)));
+
+			if(return_value<0) {
+				perror("txReaperStart() error");
+				fprintf(stderr,"Warning: unable to start the tx timestamp reaper (error code: %d).\n\tSwitching back to user-to-user latency.\n",return_value);
+				opts->latencyType=USERTOUSER;
+			}
+		}
+
+		// -L u/-L r, in ping-like mode: the tx timestamps carried by the LaMP header have only us resolution, thus the Tx loop also
+		// stores them inside 'tslist', with ns resolution (if the allocation fails, the ones carried by the replies are used)
+		if(opts->mode_ub==PINGLIKE && (opts->latencyType==USERTOUSER || opts->latencyType==KRT) && tslist.slots==NULL) {
+			if(tsRingInit(&tslist,TS_RING_DEFAULT_SIZE)<0) {
+				fprintf(stderr,"Warning: unable to allocate memory for the tx timestamps.\n\tThe latency will be computed with microsecond resolution on the tx side.\n");
+			}
+		}
+
+		// Open the pcapng file: the whole frames are written, as they are sent and received
+		if(opts->pcapng_filename!=NULL) {
+			snprintf(pcapngComment,sizeof(pcapngComment),"LaMP client, user timestamps: %s",clockSourcePrinter(opts->clock_source));
+
+			if((return_value=pcapngOpen(&pcapngData,opts->pcapng_filename,0,PCAPNG_LINKTYPE_ETHERNET,sData.devname,pcapngComment))<0) {
+				perror("pcapngOpen() error");
+				fprintf(stderr,"Warning: cannot create the pcapng file %s (error code: %d).\n\tThe '--pcapng' option will be disabled.\n",opts->pcapng_filename,return_value);
+			} else {
+				pcapng_active=1;
+			}
+		}
+
+		// Reset the live statistics page (--shm-stats only) for the current test
+		statsPageSessionStart(lamp_id_session,opts->number,opts->latencyType,opts->followup_mode!=FOLLOWUP_OFF);
+
 		if(opts->mode_ub==PINGLIKE) {
+			// The test can be interrupted (SIGINT/SIGTERM) without losing the statistics gathered so far
+			testStopInit();
+
 			// Create a sending thread and a receiving thread, then wait for their termination
 			pthread_create(&txLoop_tid,NULL,&txLoop_t,(void *) &args);
 			pthread_create(&rxLoop_tid,NULL,&rxLoop_t,(void *) &args);
@@ -1014,13 +1257,46 @@ unsigned int runUDPclient_raw(struct lampsock_data sData, macaddr_t srcMAC, stru
 			// Wait for the threads to finish
 			pthread_join(txLoop_tid,NULL);
 			pthread_join(rxLoop_tid,NULL);
+
+			txReaperStop(&txReaperData);
+
+			if(interim_active) {
+				interimReporterFlush(&interimData);
+				interimReporterClose(&interimData);
+			}
 		} else if(opts->mode_ub==UNIDIR) {
 			txLoop(&args);
+
+			// The report is received through the raw socket: stop redirecting the LaMP packets to the AF_XDP socket
+			if(opts->mode_raw==XDP) {
+				xdpSockDestroy(&xdpSockData);
+			}
+
 			unidirRxTxLoop(&args);
 		} else {
 			fprintf(stderr,"Error: some unknown error caused the mode not be set when starting the UDP client.\n");
 			return 1;
 		}
+
+		if(opts->tx_ring) {
+			txRingDestroy(&txRingData);
+		}
+
+		if(opts->rx_ring && opts->mode_ub==PINGLIKE) {
+			rxRingDestroy(&rxRingData);
+		}
+
+		if(opts->mode_raw==XDP) {
+			xdpSockDestroy(&xdpSockData);
+		}
+
+		if(pcapng_active) {
+			pcapngClose(&pcapngData);
+
+			if(pcapngData.writeErrors>0) {
+				fprintf(stderr,"Warning: %" PRIu64 " packets could not be written to the pcapng file.\n",pcapngData.writeErrors);
+			}
+		}
 	} else {
 		fprintf(stderr,"Error: the init procedure could not be completed. No test will be performed.\n");
 	}
@@ -1028,14 +1304,26 @@ unsigned int runUDPclient_raw(struct lampsock_data sData, macaddr_t srcMAC, stru
 	// Print error messages, if errors have occurred (and, in case of error, return 1)
 	if(t_tx_error!=NO_ERR) {
 		thread_error_print("UDP Tx loop", t_tx_error);
+		statsPageSessionEnd(STATSPAGE_STATE_ERROR);
 		return 1;
 	}
 
 	if(t_rx_error!=NO_ERR) {
 		thread_error_print("UDP Rx loop", t_rx_error);
+		statsPageSessionEnd(STATSPAGE_STATE_ERROR);
 		return 1;
 	}
 
+	// When the test has been interrupted, the statistics refer only to the packets which have actually been sent
+	if(testStopRequested()) {
+		fprintf(stdout,"Test interrupted after sending %" PRIu64 " packets (out of %" PRIu64 ").\n",txPacketsSent,opts->number);
+		reportData.totalPackets=txPacketsSent;
+
+		if(burstReportData!=NULL) {
+			burstReportsSetTotalPackets(burstReportData,opts->burst_size,txPacketsSent);
+		}
+	}
+
 	/* Ok, the mode_ub==UNSET_UB case is not managed, but it should never happen to reach this point
 	with an unset mode... at least not without getting errors or a chaotic thread behaviour! But it should not happen anyways. */
 	fprintf(stdout,opts->mode_ub==PINGLIKE?"Ping-like ":"Unidirectional " "statistics:\n");
@@ -1043,18 +1331,23 @@ unsigned int runUDPclient_raw(struct lampsock_data sData, macaddr_t srcMAC, stru
 	reportStructureFinalize(&reportData);
 	printStats(&reportData,stdout,opts->confidenceIntervalMask);
 
+	// Publish the final statistics too (in unidirectional mode, these are the only ones, received from the server)
+	reportStructurePublish(&reportData,0);
+	statsPageSessionEnd(STATSPAGE_STATE_FINISHED);
+
 	if(opts->filename!=NULL) {
 		// If '-f' was specified, print the report data to a file too
 		printStatsCSV(opts,&reportData,opts->filename);
 	}
 
-	if(!CHECK_SL_NULL(tslist)) {
-		timevalSL_free(tslist);
+	if(burstReportData!=NULL) {
+		printBurstStats(burstReportData,opts->burst_size,stdout);
+		free(burstReportData);
 	}
 
-	if(!CHECK_SL_NULL(triptimelist)) {
-		timevalSL_free(triptimelist);
-	}
+	tsRingFree(&tslist);
+
+	tsRingFree(&triptimelist);
 
 	// Returning 0 if everything worked fine
 	return 0;
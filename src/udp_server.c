@@ -1,7 +1,11 @@
+// recvmmsg() is Linux-specific: _GNU_SOURCE is required in order to get its declaration
+#define _GNU_SOURCE
 #include "udp_server_raw.h"
 #include "report_manager.h"
 #include "packet_structs.h"
 #include "timeval_utils.h"
+#include "clock_source.h"
+#include "seq_extend.h"
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -13,8 +17,13 @@
 #include "common_thread.h"
 #include "timer_man.h"
 #include "common_udp.h"
+#include "rx_batch.h"
+#include "busy_poll.h"
+#include "pcapng_writer.h"
+#include "stats_page.h"
 
-#define CLEAR_ALL() pthread_mutex_destroy(&ack_report_received_mut);
+#define CLEAR_ALL() pthread_mutex_destroy(&ack_report_received_mut); \
+					if(affinity_pinned) busyPollRestoreAffinity(&oldAffinity);
 
 typedef enum {
 	FLAG_UNSET,
@@ -27,11 +36,18 @@ static t_error_types t_tx_error;
 
 // Local global variables
 static reportStructure reportData;
+static seqExtender reportSeqExt; // Extension of the sequence numbers of the packets used to update reportData
 static uint16_t lamp_id_session;
 static modeub_t mode_session;
 static modefollowup_t followup_mode_session;
 static uint8_t ack_report_received; // Global flag set by the ackListener thread: = 1 when an ACK has been received, otherwise it is = 0
 
+// recvmmsg() batch (used only when --rx-batch is specified)
+static rxBatch rxBatchData;
+
+// Spinning receive (used only when --busy-poll is specified)
+static busyPoll busyPollData;
+
 // Thread ID for ackListener
 static pthread_t ackListener_tid;
 
@@ -184,6 +200,9 @@ static int transmitReportUDP(struct lampsock_data sData, struct options *opts) {
 	// Junk variable (needed to clear the timer event with read())
 	unsigned long long junk;
 
+	// Compute the latency percentiles, which are sent to the client together with the other statistics
+	reportStructureFinalize(&reportData);
+
 	// Copying the report string inside the report buffer
 	repprintf(report_buff,reportData);
 
@@ -262,7 +281,9 @@ static int transmitReportUDP(struct lampsock_data sData, struct options *opts) {
 // to discriminate the pinglike and unidirectional communications, making the common portion of the code to be written only once
 unsigned int runUDPserver(struct lampsock_data sData, struct options *opts) {
 	// Packet buffer with size = maximum LaMP packet length
-	byte_t lampPacket[MAX_LAMP_LEN+LAMP_HDR_SIZE()];
+	byte_t lampPacketBuf[MAX_LAMP_LEN+LAMP_HDR_SIZE()];
+	// Pointer to the current packet: it points to 'lampPacketBuf', or to the buffer of the current datagram inside the batch (--rx-batch)
+	byte_t *lampPacket=lampPacketBuf;
 	// Pointer to the header, inside the packet buffer
 	struct lamphdr *lampHeaderPtr=(struct lamphdr *) lampPacket;
 	// Pointer to the LaMP packet inside a UDP raw packet (used only in HARDWARE mode when retrieving tx timestamp through socket error queue)
@@ -271,6 +292,24 @@ unsigned int runUDPserver(struct lampsock_data sData, struct options *opts) {
 	// arg_struct_udp to be passed to ackSenderInit()
 	arg_struct_udp args;
 
+	// Affinity of the server thread before --busy-poll-cpu, restored at the end of the session (see CLEAR_ALL())
+	cpu_set_t oldAffinity;
+	uint8_t affinity_pinned=0;
+
+	// =1 if the datagrams of the current session are received in batches (--rx-batch), i.e. if the recvmmsg() buffers could be allocated
+	uint8_t rx_batch_active=0;
+
+	// pcapng export of the LaMP packets (--pcapng only)
+	pcapngWriter pcapngData;
+	pcapngStamps pcapStamps;
+	uint8_t pcapng_active=0;
+	struct sockaddr_in pcapngLocalAddr;
+	socklen_t pcapngAddrLen=sizeof(pcapngLocalAddr);
+	char pcapngComment[64];
+	int pcapng_ret;
+	// Size of the reply sent in ping-like mode ('rcv_bytes' is overwritten when reading the socket error queue)
+	ssize_t reply_bytes;
+
 	// recvfrom variables
 	ssize_t rcv_bytes;
 	// struct sockaddr_in to store the source IP address of the received LaMP packets
@@ -278,7 +317,9 @@ unsigned int runUDPserver(struct lampsock_data sData, struct options *opts) {
 	socklen_t srcAddrLen=sizeof(srcAddr);
 
 	// RX and TX timestamp containers
-	struct timeval rx_timestamp={.tv_sec=0,.tv_usec=0}, tx_timestamp={.tv_sec=0,.tv_usec=0};
+	uint64_t rx_timestamp_ns=0, tx_timestamp_ns=0; // [ns]
+	// Timestamp carried inside the LaMP header
+	struct timeval packet_timestamp={.tv_sec=0,.tv_usec=0};
 	// Variable to store the latency (trip time)
 	uint64_t tripTime;
 
@@ -303,10 +344,12 @@ unsigned int runUDPserver(struct lampsock_data sData, struct options *opts) {
 	struct msghdr mhdr;
 	struct iovec iov;
 	struct cmsghdr *cmsg = NULL;
+	// Message header of the last received datagram: it points to 'mhdr', or to the message header of the datagram inside the batch (--rx-batch)
+	struct msghdr *rxMhdr=&mhdr;
 
 	// Ancillary data buffers
 	char ctrlBufHw[CMSG_SPACE(sizeof(struct scm_timestamping))];
-	char ctrlBufSw[CMSG_SPACE(sizeof(struct timeval))];
+	char ctrlBufSw[CMSG_SPACE(sizeof(struct timespec))];
 
 	// Follow-up flag: it is used to discard any possibile follow-up request after the first one,
 	//  when a client attempts to establish an hardware timers session
@@ -334,6 +377,11 @@ unsigned int runUDPserver(struct lampsock_data sData, struct options *opts) {
 		opts->interval<=MIN_TIMEOUT_VAL_S ? MIN_TIMEOUT_VAL_S : opts->interval,
 		opts->refuseFollowup==1 ? "refused" : "accepted");
 
+	// Print the clock source of the application level follow-up intervals, only when it is not the default one
+	if(opts->clock_source!=CLOCKSRC_REALTIME) {
+		fprintf(stdout,"\t[follow-up clock source] = %s\n",clockSourcePrinter(opts->clock_source));
+	}
+
 	// Print current UP
 	if(opts->macUP==UINT8_MAX) {
 		fprintf(stdout,"\t[user priority] = unset or unpatched kernel.\n\n");
@@ -342,7 +390,9 @@ unsigned int runUDPserver(struct lampsock_data sData, struct options *opts) {
 	}
 
 	// Report structure inizialization
-	reportStructureInit(&reportData, 0, opts->number, opts->latencyType, opts->followup_mode);
+	// The number of packets sent by the client is not known (0): the packets lost after the last received one cannot be detected
+	reportStructureInit(&reportData, 0, 0, opts->latencyType, opts->followup_mode);
+	seqExtenderInit(&reportSeqExt);
 
 	// Prepare sendto sockaddr_in structure (index 1) for the server ('sin_addr' and 'sin_port' will be set later on, as the server receives its first packet from a client)
 	memset(&sData.addru.addrin[1],0,sizeof(sData.addru.addrin[1]));
@@ -371,8 +421,8 @@ unsigned int runUDPserver(struct lampsock_data sData, struct options *opts) {
 		memset(&mhdr,0,sizeof(mhdr));
 
 		// iovec buffers (scatter/gather arrays)
-		iov.iov_base=lampPacket;
-		iov.iov_len=sizeof(lampPacket);
+		iov.iov_base=lampPacketBuf;
+		iov.iov_len=sizeof(lampPacketBuf);
 
 		// Socket address structure
 		mhdr.msg_name=&(srcAddr);
@@ -400,28 +450,93 @@ unsigned int runUDPserver(struct lampsock_data sData, struct options *opts) {
 		return 1;
 	}
 
+	// If requested, allocate the buffers to receive the datagrams in batches, with recvmmsg() (only now, as the INIT packet is still received with recvfrom())
+	if(opts->rx_batch>1) {
+		if(rxBatchCreate(&rxBatchData,opts->rx_batch,sizeof(lampPacketBuf))<0) {
+			fprintf(stderr,"Warning: unable to allocate the recvmmsg() buffers.\n\tSwitching back to recvfrom()/recvmsg() for the current session.\n");
+		} else {
+			rx_batch_active=1;
+			fprintf(stdout,"Batched receive active for the current session (up to %u datagrams for each recvmmsg() call).\n",opts->rx_batch);
+		}
+	}
+
+	// If requested, spin on non-blocking receives, with kernel busy polling (only now, as the session timeout has just been set by ackSenderInit())
+	if(opts->busy_poll_us>0) {
+		if(opts->busy_poll_cpu>=0) {
+			if(busyPollPinThread(opts->busy_poll_cpu,&oldAffinity)<0) {
+				perror("busyPollPinThread() error");
+				fprintf(stderr,"Warning: unable to pin the receive loop to CPU %d.\n",opts->busy_poll_cpu);
+			} else {
+				affinity_pinned=1;
+			}
+		}
+
+		if(busyPollCreate(&busyPollData,sData.descriptor,opts->busy_poll_us)<0) {
+			perror("busyPollCreate() error");
+			fprintf(stderr,"Warning: unable to set SO_BUSY_POLL (CAP_NET_ADMIN may be required).\n\tSpinning on non-blocking receives without kernel busy polling.\n");
+		} else {
+			fprintf(stdout,"Busy polling active for the current session (budget: %u us).\n",opts->busy_poll_us);
+		}
+	}
+
+	// Reset the live statistics page (--shm-stats only) for the new session
+	statsPageSessionStart(lamp_id_session,reportData.totalPackets,opts->latencyType,followup_mode_session!=FOLLOWUP_OFF);
+
+	// Open the pcapng file (the local address is needed to rebuild the IPv4/UDP headers of the packets)
+	// In continuous daemon mode, each session is appended to the same file, as a new section
+	if(opts->pcapng_filename!=NULL) {
+		snprintf(pcapngComment,sizeof(pcapngComment),"LaMP server, user timestamps: %s",clockSourcePrinter(opts->clock_source));
+
+		if(getsockname(sData.descriptor,(struct sockaddr *)&pcapngLocalAddr,&pcapngAddrLen)<0) {
+			perror("getsockname() error");
+			fprintf(stderr,"Warning: cannot get the local address of the socket.\n\tThe '--pcapng' option will be disabled.\n");
+		} else if((pcapng_ret=pcapngOpen(&pcapngData,opts->pcapng_filename,opts->dmode,PCAPNG_LINKTYPE_RAW,sData.devname,pcapngComment))<0) {
+			perror("pcapngOpen() error");
+			fprintf(stderr,"Warning: cannot create the pcapng file %s (error code: %d).\n\tThe '--pcapng' option will be disabled.\n",opts->pcapng_filename,pcapng_ret);
+		} else {
+			pcapng_active=1;
+		}
+	}
+
 	// Start receiving packets
 	while(continueFlag) {
-		// If in KRT unidirectional/follow-up mode or in HARDWARE/SOFTWARE mode (requested by the client through a follow-up control message, use recvmsg(), otherwise, use recvfrom()
-		if((mode_session==UNIDIR && opts->latencyType==KRT) || followup_mode_session==FOLLOWUP_ON_HW || followup_mode_session==FOLLOWUP_ON_KRN || followup_mode_session==FOLLOWUP_ON_KRN_RX) {
-			saferecvmsg(rcv_bytes,sData.descriptor,&mhdr,NO_FLAGS);
+		// When in batch mode, get the next datagram of the current batch (receiving a new batch with recvmmsg() when needed)
+		// Otherwise, if in KRT unidirectional/follow-up mode or in HARDWARE/SOFTWARE mode (requested by the client through a follow-up control message, use recvmsg(), otherwise, use recvfrom()
+		if(rx_batch_active) {
+			rcv_bytes=rxBatchRecv(&rxBatchData,sData.descriptor,&lampPacket,&rxMhdr);
+
+			if(rcv_bytes!=-1) {
+				lampHeaderPtr=(struct lamphdr *) lampPacket;
+				memcpy(&srcAddr,rxMhdr->msg_name,sizeof(srcAddr));
+			}
+		} else if((mode_session==UNIDIR && opts->latencyType==KRT) || followup_mode_session==FOLLOWUP_ON_HW || followup_mode_session==FOLLOWUP_ON_KRN || followup_mode_session==FOLLOWUP_ON_KRN_RX) {
+			if(opts->busy_poll_us>0) {
+				rcv_bytes=busyPollRecvmsg(&busyPollData,&mhdr);
+			} else {
+				saferecvmsg(rcv_bytes,sData.descriptor,&mhdr,NO_FLAGS);
+			}
+		} else {
+			if(opts->busy_poll_us>0) {
+				rcv_bytes=busyPollRecvfrom(&busyPollData,lampPacket,MAX_LAMP_LEN,(struct sockaddr *)&srcAddr,&srcAddrLen);
+			} else {
+				saferecvfrom(rcv_bytes,sData.descriptor,lampPacket,MAX_LAMP_LEN,NO_FLAGS,(struct sockaddr *)&srcAddr,&srcAddrLen);
+			}
+		}
 
-			// Extract ancillary data
-			for(cmsg=CMSG_FIRSTHDR(&mhdr);cmsg!=NULL;cmsg=CMSG_NXTHDR(&mhdr, cmsg)) {
+		// Extract ancillary data (each datagram of a batch has its own ancillary data)
+		if(rcv_bytes!=-1 && ((mode_session==UNIDIR && opts->latencyType==KRT) || followup_mode_session==FOLLOWUP_ON_HW || followup_mode_session==FOLLOWUP_ON_KRN || followup_mode_session==FOLLOWUP_ON_KRN_RX)) {
+			for(cmsg=CMSG_FIRSTHDR(rxMhdr);cmsg!=NULL;cmsg=CMSG_NXTHDR(rxMhdr, cmsg)) {
 				// KRT (unidirectional) mode
-                if((opts->latencyType==KRT || followup_mode_session==FOLLOWUP_ON_KRN_RX) && cmsg->cmsg_level==SOL_SOCKET && cmsg->cmsg_type==SO_TIMESTAMP) {
-                    rx_timestamp=*((struct timeval *)CMSG_DATA(cmsg));
+                if((opts->latencyType==KRT || followup_mode_session==FOLLOWUP_ON_KRN_RX) && cmsg->cmsg_level==SOL_SOCKET && cmsg->cmsg_type==SCM_TIMESTAMPNS) {
+                    rx_timestamp_ns=timespecToNs((struct timespec *)CMSG_DATA(cmsg));
                 }
 
                 // HARDWARE/SOFTWARE (kernel tx+rx) mode
                	if((followup_mode_session==FOLLOWUP_ON_HW || followup_mode_session==FOLLOWUP_ON_KRN) && cmsg->cmsg_level==SOL_SOCKET && cmsg->cmsg_type==SO_TIMESTAMPING) {
 					hw_ts=*((struct scm_timestamping *)CMSG_DATA(cmsg));
-	    			rx_timestamp.tv_sec=hw_ts.ts[followup_mode_session==FOLLOWUP_ON_HW ? 2 : 0].tv_sec;
-	 				rx_timestamp.tv_usec=hw_ts.ts[followup_mode_session==FOLLOWUP_ON_HW ? 2 : 0].tv_nsec/MICROSEC_TO_NANOSEC;
+	    			rx_timestamp_ns=timespecToNs(&hw_ts.ts[followup_mode_session==FOLLOWUP_ON_HW ? 2 : 0]);
 	           	}
 			}
-		} else {
-			saferecvfrom(rcv_bytes,sData.descriptor,lampPacket,MAX_LAMP_LEN,NO_FLAGS,(struct sockaddr *)&srcAddr,&srcAddrLen);
 		}
 
 		// Try to estimate the receive timestamp, in FOLLOWUP_ON_APP mode, in the best way possible and as soon as possible
@@ -429,7 +544,7 @@ unsigned int runUDPserver(struct lampsock_data sData, struct options *opts) {
 		// Drawback: a rx_timestamp will be written for every received packet, even non-LaMP packets (provided that they can be
 		// received through the UDP socket); in this case the gathered value will be ignored by the program
 		if(followup_mode_session==FOLLOWUP_ON_APP) {
-			gettimeofday(&rx_timestamp,NULL);
+			rx_timestamp_ns=clockSourceNs();
 		}
 
 		// Timeout or other recvfrom() error occurred
@@ -451,7 +566,7 @@ unsigned int runUDPserver(struct lampsock_data sData, struct options *opts) {
 		}
 
 		// If the packet is really a LaMP packet, get the header data
-		lampHeadGetData(lampPacket, &lamp_type_rx, &lamp_id_rx, &lamp_seq_rx, &lamp_payloadlen_rx, &tx_timestamp, NULL);
+		lampHeadGetData(lampPacket, &lamp_type_rx, &lamp_id_rx, &lamp_seq_rx, &lamp_payloadlen_rx, &packet_timestamp, NULL);
 
 		// Discard any (end)reply, ack, init, report or follow-up data, at the moment
 		if(lamp_type_rx==PINGLIKE_REPLY || lamp_type_rx==PINGLIKE_REPLY_TLESS || lamp_type_rx==PINGLIKE_ENDREPLY || lamp_type_rx==ACK || lamp_type_rx==REPORT || lamp_type_rx==INIT || lamp_type_rx==FOLLOWUP_DATA) {
@@ -463,6 +578,23 @@ unsigned int runUDPserver(struct lampsock_data sData, struct options *opts) {
 			continue;
 		}
 
+		// With --pcapng, write the received packet, with the rx timestamps gathered so far (in unidirectional user-to-user
+		// mode, the application level timestamp is taken later on, thus the packet timestamp is the time at which it is written)
+		if(pcapng_active) {
+			memset(&pcapStamps,0,sizeof(pcapStamps));
+
+			if(followup_mode_session==FOLLOWUP_ON_HW || followup_mode_session==FOLLOWUP_ON_KRN) {
+				pcapStamps.kernel_ns=timespecToNs(&hw_ts.ts[0]);
+				pcapStamps.hw_ns=timespecToNs(&hw_ts.ts[2]);
+			} else if((mode_session==UNIDIR && opts->latencyType==KRT) || followup_mode_session==FOLLOWUP_ON_KRN_RX) {
+				pcapStamps.kernel_ns=rx_timestamp_ns;
+			} else if(followup_mode_session==FOLLOWUP_ON_APP) {
+				pcapStamps.user_ns=rx_timestamp_ns;
+			}
+
+			pcapngWriteUDP(&pcapngData,PCAPNG_DIR_INBOUND,&srcAddr,&pcapngLocalAddr,lampPacket,rcv_bytes,&pcapStamps);
+		}
+
 		// Check if this is a follow-up request packet (after the first one, all the subseuent ones will be ignored)
 		// Moreover, if a normal request packet is received, the session will go on without activating follow-ups
 		// and future follow-up requests will be ignored (in order not to provide inconsistent and/or mixed data to the client)
@@ -488,8 +620,8 @@ unsigned int runUDPserver(struct lampsock_data sData, struct options *opts) {
 
 							memset(&mhdr,0,sizeof(mhdr));
 
-							iov.iov_base=lampPacket;
-							iov.iov_len=sizeof(lampPacket);
+							iov.iov_base=lampPacketBuf;
+							iov.iov_len=sizeof(lampPacketBuf);
 
 							mhdr.msg_name=&(srcAddr);
 							mhdr.msg_namelen=srcAddrLen;
@@ -515,8 +647,8 @@ unsigned int runUDPserver(struct lampsock_data sData, struct options *opts) {
 
 							memset(&mhdr,0,sizeof(mhdr));
 
-							iov.iov_base=lampPacket;
-							iov.iov_len=sizeof(lampPacket);
+							iov.iov_base=lampPacketBuf;
+							iov.iov_len=sizeof(lampPacketBuf);
 
 							mhdr.msg_name=&(srcAddr);
 							mhdr.msg_namelen=srcAddrLen;
@@ -565,24 +697,29 @@ unsigned int runUDPserver(struct lampsock_data sData, struct options *opts) {
 		switch(mode_session) {
 			case UNIDIR:
 				if(opts->latencyType==USERTOUSER) {
-					gettimeofday(&rx_timestamp,NULL);
+					rx_timestamp_ns=realtimeNs();
 				}
 
-				if(timevalSub(&tx_timestamp,&rx_timestamp)) {
+				tx_timestamp_ns=timevalToNs(&packet_timestamp);
+
+				if(rx_timestamp_ns<tx_timestamp_ns) {
 					fprintf(stderr,"Error: negative latency for packet from %s (id=%u, seq=%u, rx_bytes=%d)!\nThe clock synchronization is not sufficienty precise to allow unidirectional measurements.\n",
 						inet_ntoa(srcAddr.sin_addr),lamp_id_rx,lamp_seq_rx,(int)rcv_bytes);
 					tripTime=0;
 				} else {
-					tripTime=rx_timestamp.tv_sec*SEC_TO_MICROSEC+rx_timestamp.tv_usec;
+					tripTime=rx_timestamp_ns-tx_timestamp_ns;
 				}
 
 				if(tripTime!=0) {
-					fprintf(stdout,"Received a unidirectional message from %s (id=%u, seq=%u, rx_bytes=%d). Time: %.3f ms (%s)\n",
-						inet_ntoa(srcAddr.sin_addr),lamp_id_rx,lamp_seq_rx,(int)rcv_bytes,(double)tripTime/1000,latencyTypePrinter(opts->latencyType));
+					fprintf(stdout,"Received a unidirectional message from %s (id=%u, seq=%u, rx_bytes=%d). Time: %.6f ms (%s)\n",
+						inet_ntoa(srcAddr.sin_addr),lamp_id_rx,lamp_seq_rx,(int)rcv_bytes,(double)tripTime/MILLISEC_TO_NANOSEC,latencyTypePrinter(opts->latencyType));
 				}
 
 				// Update the current report structure
-				reportStructureUpdate(&reportData,tripTime,lamp_seq_rx);
+				reportStructureUpdate(&reportData,tripTime,seqExtend(&reportSeqExt,lamp_seq_rx));
+
+				// With --shm-stats, publish the updated statistics (a few plain stores inside the shared memory page)
+				reportStructurePublish(&reportData,tripTime);
 			break;
 
 			case PINGLIKE:
@@ -602,18 +739,20 @@ unsigned int runUDPserver(struct lampsock_data sData, struct options *opts) {
 				lamp_type_tx=CTRL_TO_TYPE(lampHeaderPtr->ctrl);
 
 				// If using application level or kernel level RX follow-up mode, gather the tx timestamp just before sending the packet
+				// The KRT rx timestamp comes from CLOCK_REALTIME: the selected clock source is used for application level timestamps only
 				if(followup_mode_session==FOLLOWUP_ON_APP || followup_mode_session==FOLLOWUP_ON_KRN_RX) {
-					gettimeofday(&tx_timestamp,NULL);
+					tx_timestamp_ns=followup_mode_session==FOLLOWUP_ON_APP ? clockSourceNs() : realtimeNs();
 				}
 
 				// Send packet (as the reply does require to carry the client timestamp, the control field should now correspond to CTRL_PINGLIKE_REPLY)
 				// 'rcv_bytes' still stores the packet size, thus it can be used as packet size to be passed to sendto()
+				reply_bytes=rcv_bytes;
 				if(sendto(sData.descriptor,lampPacket,rcv_bytes,NO_FLAGS,(struct sockaddr *)&sData.addru.addrin[1],sizeof(sData.addru.addrin[1]))!=rcv_bytes) {
 					perror("sendto() for sending LaMP packet failed");
 					fprintf(stderr,"UDP server reported that it can't reply to the client with id=%u and seq=%u\n",lamp_id_rx,lamp_seq_rx);
 				}
 
-				// If in hardware/software follow-up mode, gather the tx_timestamp from ancillary data
+				// If in hardware/software follow-up mode, gather the tx timestamp from ancillary data
 				if(followup_mode_session==FOLLOWUP_ON_HW || followup_mode_session==FOLLOWUP_ON_KRN) {
 					// Loop until the right transmitted packet is received (as other packets are sent too, for which we are not
 					//  interested in obtaining any tx timestamp - e.g. all the follow-up data tx timestamps are useless in our case)
@@ -623,7 +762,7 @@ unsigned int runUDPserver(struct lampsock_data sData, struct options *opts) {
 							break;
 						}
 						saferecvmsg(rcv_bytes,sData.descriptor,&mhdr,MSG_ERRQUEUE);
-						lampPacketPtr=UDPgetpacketpointers(lampPacket,NULL,NULL,NULL); // From Rawsock library
+						lampPacketPtr=UDPgetpacketpointers(lampPacketBuf,NULL,NULL,NULL); // From Rawsock library
 						lampHeadGetData(lampPacketPtr,&lamp_type_rx_errqueue,NULL,&lamp_seq_rx_errqueue,NULL,NULL,NULL);
 					} while(lamp_seq_rx_errqueue!=lamp_seq_rx || lamp_type_rx_errqueue!=lamp_type_tx);
 
@@ -635,26 +774,40 @@ unsigned int runUDPserver(struct lampsock_data sData, struct options *opts) {
 					for(cmsg=CMSG_FIRSTHDR(&mhdr);cmsg!=NULL;cmsg=CMSG_NXTHDR(&mhdr, cmsg)) {
 			           	if(cmsg->cmsg_level==SOL_SOCKET && cmsg->cmsg_type==SO_TIMESTAMPING) {
 			            	hw_ts=*((struct scm_timestamping *)CMSG_DATA(cmsg));
-			             	tx_timestamp.tv_sec=hw_ts.ts[followup_mode_session==FOLLOWUP_ON_HW ? 2 : 0].tv_sec;
-			       			tx_timestamp.tv_usec=hw_ts.ts[followup_mode_session==FOLLOWUP_ON_HW ? 2 : 0].tv_nsec/MICROSEC_TO_NANOSEC;
+			             	tx_timestamp_ns=timespecToNs(&hw_ts.ts[followup_mode_session==FOLLOWUP_ON_HW ? 2 : 0]);
 			           	}
 					}
 				}
 
+				// With --pcapng, write the reply, with its tx timestamp
+				// When the tx timestamp is read from the socket error queue, the packet buffer is overwritten by the looped-back reply
+				if(pcapng_active) {
+					memset(&pcapStamps,0,sizeof(pcapStamps));
+
+					if(followup_mode_session==FOLLOWUP_ON_HW || followup_mode_session==FOLLOWUP_ON_KRN) {
+						pcapStamps.kernel_ns=timespecToNs(&hw_ts.ts[0]);
+						pcapStamps.hw_ns=timespecToNs(&hw_ts.ts[2]);
+						pcapngWriteUDP(&pcapngData,PCAPNG_DIR_OUTBOUND,&pcapngLocalAddr,&sData.addru.addrin[1],lampPacketPtr,reply_bytes,&pcapStamps);
+					} else {
+						pcapStamps.user_ns=followup_mode_session!=FOLLOWUP_OFF ? tx_timestamp_ns : 0;
+						pcapngWriteUDP(&pcapngData,PCAPNG_DIR_OUTBOUND,&pcapngLocalAddr,&sData.addru.addrin[1],lampPacket,reply_bytes,&pcapStamps);
+					}
+				}
+
 				// If follow-up mode is active, send the follow-up data packet
 				if(followup_mode_session!=FOLLOWUP_OFF) {
-					// Compute the difference between the rx and tx timestamps (difference stored in tx_timestamp, i.e. the "out" argument of timevalSub())
-					// This is done since normally tx_timestamp > rx_timestamp
-					if(timevalSub(&rx_timestamp,&tx_timestamp)) {
+					// Compute the difference between the rx and tx timestamps (stored in tx_timestamp_ns)
+					// This is done since normally tx_timestamp_ns > rx_timestamp_ns
+					if(tx_timestamp_ns<rx_timestamp_ns) {
 						fprintf(stderr,"Error: negative time!\nCannot compute follow-up processing time for the current packet (id=%u, seq=%u).\n",lamp_id_rx,lamp_seq_rx);
-						tx_timestamp.tv_sec=0;
-						tx_timestamp.tv_usec=0;
+						tx_timestamp_ns=0;
 					} else {
-						fprintf(stdout,"Sending follow-up data (id=%u, seq=%u). Processing delta: %.3f ms.\n",lamp_id_rx,lamp_seq_rx,((double) tx_timestamp.tv_sec)*SEC_TO_MILLISEC+((double) tx_timestamp.tv_usec)/MICROSEC_TO_MILLISEC);
+						tx_timestamp_ns-=rx_timestamp_ns;
+						fprintf(stdout,"Sending follow-up data (id=%u, seq=%u). Processing delta: %.6f ms.\n",lamp_id_rx,lamp_seq_rx,(double) tx_timestamp_ns/MILLISEC_TO_NANOSEC);
 					}
 
 					// Send follow-up with the time difference timestamp
-					if(sendFollowUpData(sData,lamp_id_rx,lamp_seq_rx,tx_timestamp)) {
+					if(sendFollowUpData(sData,lamp_id_rx,lamp_seq_rx,tx_timestamp_ns)) {
 						perror("sendto() for sending LaMP follow-up data failed");
 						fprintf(stderr,"UDP server reported that it can't reply to the client with id=%u and seq=%u (follow-up)\n",lamp_id_rx,lamp_seq_rx);
 					}
@@ -666,15 +819,39 @@ unsigned int runUDPserver(struct lampsock_data sData, struct options *opts) {
 		}
 	}
 
+	if(rx_batch_active) {
+		rxBatchDestroy(&rxBatchData);
+	}
+
+	if(pcapng_active) {
+		pcapngClose(&pcapngData);
+
+		if(pcapngData.writeErrors>0) {
+			fprintf(stderr,"Warning: %" PRIu64 " packets could not be written to the pcapng file.\n",pcapngData.writeErrors);
+		}
+	}
+
 	if(mode_session==UNIDIR) {
 		if(transmitReportUDP(sData, opts)) {
 			fprintf(stderr,"UDP server reported an error while transmitting the report.\n"
 				"No report will be transmitted.\n");
+			statsPageSessionEnd(STATSPAGE_STATE_ERROR);
 			CLEAR_ALL();
 			return 1;
 		}
 	}
 
+	// The statistics of unidirectional sessions have been finalized when transmitting the report
+	// In continuous daemon mode, they are also added to the statistics of all the sessions, printed when the program terminates
+	if(mode_session==UNIDIR) {
+		reportStructurePublish(&reportData,0);
+
+		if(opts->dmode) {
+			reportSessionsAdd(&reportData);
+		}
+	}
+	statsPageSessionEnd(STATSPAGE_STATE_FINISHED);
+
 	// Destroy mutex (as it is no longer needed) and clear all the other data that should be clared (see the CLEAR_ALL() macro)
 	CLEAR_ALL();
 
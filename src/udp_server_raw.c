@@ -2,6 +2,8 @@
 #include "report_manager.h"
 #include "packet_structs.h"
 #include "timeval_utils.h"
+#include "clock_source.h"
+#include "seq_extend.h"
 #include <sys/ioctl.h>
 #include <linux/if.h>
 #include <linux/if.h>
@@ -16,9 +18,17 @@
 #include "ipcsum_alth.h"
 #include "timer_man.h"
 #include "common_udp.h"
+#include "rx_ring.h"
+#include "bpf_filter.h"
+#include "xdp_sock.h"
+#include "frame_template.h"
+#include "pcapng_writer.h"
+#include "stats_page.h"
 
 #define CLEAR_ALL() pthread_mutex_destroy(&ack_report_received_mut); \
-					freeMacAddrT(srcmacaddr_pkt);
+					freeMacAddrT(srcmacaddr_pkt); \
+					if(xdp_fallback) opts->mode_raw=XDP; \
+					if(rx_ring_fallback) opts->rx_ring=1;
 	
 typedef enum {
 	FLAG_UNSET,
@@ -31,12 +41,20 @@ static t_error_types t_tx_error;
 
 // Local global variables
 static reportStructure reportData;
+static seqExtender reportSeqExt; // Extension of the sequence numbers of the packets used to update reportData
 static uint16_t lamp_id_session;
 static modeub_t mode_session;
 static modefollowup_t followup_mode_session;
 static uint16_t client_port_session; // Stored in host byte order
 static uint8_t ack_report_received; // Global flag set by the ackListener thread: = 1 when an ACK has been received, otherwise it is = 0
 
+// PACKET_MMAP RX ring (used only when --rx-ring is specified)
+static rxRing rxRingData;
+// AF_XDP socket (used only when --xdp is specified)
+static xdpSock xdpSockData;
+// In-kernel ping-like reflector (used only when --xdp-reflect is specified)
+static xdpReflector xdpReflectorData;
+
 // Thread ID for ackListener
 static pthread_t ackListener_tid;
 
@@ -205,6 +223,9 @@ static int transmitReport(struct lampsock_data sData, struct options *opts, stru
 	IP4headPopulateS(&(headers.ipHeader), sData.devname, destIP, 0, 0, BASIC_UDP_TTL, IPPROTO_UDP, FLAG_NOFRAG_MASK, &ipaddrs);
 	UDPheadPopulate(&(headers.udpHeader), opts->port, client_port_session);
 
+	// Compute the latency percentiles, which are sent to the client together with the other statistics
+	reportStructureFinalize(&reportData);
+
 	// Copying the report string inside the report buffer
 	repprintf(report_buff,reportData);
 
@@ -315,7 +336,12 @@ unsigned int runUDPserver_raw(struct lampsock_data sData, macaddr_t srcMAC, stru
 	arg_struct args;
 
 	// Packet buffer with size = Ethernet MTU
-	byte_t packet[RAW_RX_PACKET_BUF_SIZE];
+	byte_t packetBuf[RAW_RX_PACKET_BUF_SIZE];
+	// Pointer to the current packet: it points to 'packetBuf', or directly inside the RX ring (--rx-ring) or the UMEM (--xdp)
+	byte_t *packet=packetBuf;
+
+	// Frame descriptor filled by rxRingRecv() (--rx-ring only)
+	rxRingFrame ringFrame;
 
 	// recvfrom variables
 	ssize_t rcv_bytes;
@@ -323,9 +349,12 @@ unsigned int runUDPserver_raw(struct lampsock_data sData, macaddr_t srcMAC, stru
 
 	struct pktheadersptr_udp headerptrs;
 	byte_t *lampPacket=NULL;
+	byte_t *lampPacketErrqueue=NULL; // LaMP packet pointer for the packets retrieved from the socket error queue (always stored inside 'packetBuf')
 
 	// RX and TX timestamp containers
-	struct timeval rx_timestamp={.tv_sec=0,.tv_usec=0}, tx_timestamp={.tv_sec=0,.tv_usec=0};
+	uint64_t rx_timestamp_ns=0, tx_timestamp_ns=0; // [ns]
+	// Timestamp carried inside the LaMP header
+	struct timeval packet_timestamp={.tv_sec=0,.tv_usec=0};
 
 	// Variable to store the latency (trip time)
 	uint64_t tripTime;
@@ -361,7 +390,7 @@ unsigned int runUDPserver_raw(struct lampsock_data sData, macaddr_t srcMAC, stru
 	struct cmsghdr *cmsg = NULL;
 
 	// Ancillary data buffer
-	char ctrlBufKrt[CMSG_SPACE(sizeof(struct timeval))];
+	char ctrlBufKrt[CMSG_SPACE(sizeof(struct timespec))];
 	char ctrlBufHwSw[CMSG_SPACE(sizeof(struct scm_timestamping))];
 
 	// struct in_addr containing the destination IP address (read as source IP address from the packets coming from the client)
@@ -375,8 +404,32 @@ unsigned int runUDPserver_raw(struct lampsock_data sData, macaddr_t srcMAC, stru
 	uint8_t isnotfirst_FU=0;
 	uint16_t followup_reply_type;
 
+	// Fields covered by the UDP checksum, as they were stored inside the request (--xdp only, to update the checksum of the reply incrementally)
+	byte_t oldIPaddrs[2*sizeof(uint32_t)];
+	byte_t oldUDPports[2*sizeof(uint16_t)];
+	byte_t oldLampCtrl[sizeof(uint16_t)];
+
 	controlRCVdata fuData;
 
+	// =1 if the ping-like requests of the current session are replied by the XDP reflector (--xdp-reflect), otherwise =0
+	uint8_t reflector_active=0;
+	// =1 if the AF_XDP socket could not be set up for the current session: the next daemon session tries again (see CLEAR_ALL())
+	uint8_t xdp_fallback=0;
+	// =1 if the PACKET_MMAP RX ring could not be set up for the current session (as above)
+	uint8_t rx_ring_fallback=0;
+	// Number of requests reflected by the XDP program, as of the last receive timeout
+	uint64_t reflected_count=0;
+	uint64_t reflected_count_new;
+
+	// pcapng export of the LaMP frames (--pcapng only)
+	pcapngWriter pcapngData;
+	pcapngStamps pcapStamps;
+	uint8_t pcapng_active=0;
+	char pcapngComment[64];
+	int pcapng_ret;
+	// Size of the reply sent in ping-like mode ('rcv_bytes' is overwritten when reading the socket error queue)
+	ssize_t reply_bytes;
+
 	// Very important: initialize to 0 any flag that is used inside threads
 	ack_report_received=0;
 	followup_mode_session=FOLLOWUP_OFF;
@@ -388,12 +441,18 @@ unsigned int runUDPserver_raw(struct lampsock_data sData, macaddr_t srcMAC, stru
 	}
 
 	// Inform the user about the current options
-	fprintf(stdout,"UDP server started, with options:\n\t[socket type] = RAW\n"
+	fprintf(stdout,"UDP server started, with options:\n\t[socket type] = %s\n"
 		"\t[listening on port] = %ld\n"
 		"\t[timeout] = %" PRIu64 " ms\n",
+		opts->mode_raw==XDP ? "RAW (AF_XDP data path)" : "RAW",
 		opts->port,
 		opts->interval<=MIN_TIMEOUT_VAL_S ? MIN_TIMEOUT_VAL_S : opts->interval);
 
+	// Print the clock source of the application level follow-up intervals, only when it is not the default one
+	if(opts->clock_source!=CLOCKSRC_REALTIME) {
+		fprintf(stdout,"\t[follow-up clock source] = %s\n",clockSourcePrinter(opts->clock_source));
+	}
+
 	// Print current UP
 	if(opts->macUP==UINT8_MAX) {
 		fprintf(stdout,"\t[user priority] = unset or unpatched kernel.\n\n");
@@ -402,7 +461,9 @@ unsigned int runUDPserver_raw(struct lampsock_data sData, macaddr_t srcMAC, stru
 	}
 
 	// Report structure inizialization
-	reportStructureInit(&reportData, 0, opts->number, opts->latencyType, opts->followup_mode);
+	// The number of packets sent by the client is not known (0): the packets lost after the last received one cannot be detected
+	reportStructureInit(&reportData, 0, 0, opts->latencyType, opts->followup_mode);
+	seqExtenderInit(&reportSeqExt);
 
 	// Populate the 'args' struct
 	args.sData=sData;
@@ -410,6 +471,13 @@ unsigned int runUDPserver_raw(struct lampsock_data sData, macaddr_t srcMAC, stru
 	args.srcMAC=srcMAC;
 	args.srcIP=srcIP;
 
+	// Attach a BPF filter to the raw socket, in order to receive only LaMP packets directed to the server port
+	// The session id is not known yet: the filter is replaced with a stricter one as soon as the INIT packet is received
+	if(bpfFilterAttach(sData.descriptor, srcIP, opts->port, BPF_FILTER_ANY_ID, 0)<0) {
+		perror("bpfFilterAttach() error");
+		fprintf(stderr,"Warning: unable to attach the BPF filter to the raw socket.\n\tAll the IPv4 frames will be filtered in user space.\n");
+	}
+
 	if(initReceiverACKsender(&args, opts->interval, opts->port)<0) {
 		if(t_rx_error!=NO_ERR) {
 			thread_error_print("UDP server INIT procedure (INIT reception)", t_rx_error);
@@ -439,8 +507,8 @@ unsigned int runUDPserver_raw(struct lampsock_data sData, macaddr_t srcMAC, stru
 		memset(&mhdr,0,sizeof(mhdr));
 
 		// iovec buffers (scatter/gather arrays)
-		iov.iov_base=packet;
-		iov.iov_len=sizeof(packet);
+		iov.iov_base=packetBuf;
+		iov.iov_len=sizeof(packetBuf);
 
 		// Socket address structure
 		mhdr.msg_name=&(addrll);
@@ -458,28 +526,103 @@ unsigned int runUDPserver_raw(struct lampsock_data sData, macaddr_t srcMAC, stru
 		mhdr.msg_flags=NO_FLAGS;
 	}
 
+	// Accept, from now on, only the packets belonging to the current session
+	if(bpfFilterAttach(sData.descriptor, srcIP, opts->port, BPF_FILTER_SESSION_ID, lamp_id_session)<0) {
+		perror("bpfFilterAttach() error");
+		fprintf(stderr,"Warning: unable to restrict the BPF filter to the current session.\n");
+	}
+
+	// If requested, set up the PACKET_MMAP RX ring (only now, as the INIT packet is still received with recvfrom())
+	if(opts->rx_ring) {
+		if(rxRingCreate(&rxRingData, sData.descriptor, 0)<0) {
+			perror("rxRingCreate() error");
+			fprintf(stderr,"Warning: unable to create the PACKET_MMAP RX ring.\n\tSwitching back to recvfrom()/recvmsg() for the current session.\n");
+			opts->rx_ring=0;
+			rx_ring_fallback=1;
+		} else {
+			fprintf(stdout,"PACKET_MMAP RX ring (TPACKET_V3) active for the current session.\n");
+		}
+	}
+
+	// If requested, set up the AF_XDP socket (only now, as the INIT packet and the ACK are still exchanged through the raw socket)
+	if(opts->mode_raw==XDP) {
+		if(xdpSockCreate(&xdpSockData, sData.descriptor, sData.addru.addrll.sll_ifindex, opts->xdp_queue, srcIP, opts->port)<0) {
+			perror("xdpSockCreate() error");
+			fprintf(stderr,"Warning: unable to set up the AF_XDP socket.\n\tSwitching back to the raw socket for the current session.\n");
+			opts->mode_raw=RAW;
+			xdp_fallback=1;
+		} else {
+			fprintf(stdout,"AF_XDP socket active for the current session (queue: %u).\n",opts->xdp_queue);
+		}
+	}
+
+	// If requested, let the XDP reflector reply to the requests (only in ping-like mode, as nothing is sent back in unidirectional mode)
+	// The control packets and the last request (PINGLIKE_ENDREQ*) are still received and handled below
+	if(opts->xdp_reflect) {
+		if(mode_session!=PINGLIKE) {
+			fprintf(stderr,"Warning: --xdp-reflect is ignored in unidirectional mode.\n");
+		} else if(xdpReflectorCreate(&xdpReflectorData, sData.addru.addrll.sll_ifindex, srcIP, opts->port, lamp_id_session)<0) {
+			perror("xdpReflectorCreate() error");
+			fprintf(stderr,"Warning: unable to attach the XDP reflector.\n\tThe requests will be replied by the server.\n");
+		} else {
+			fprintf(stdout,"XDP reflector active for the current session: the ping-like requests will be replied inside the kernel.\n");
+			reflector_active=1;
+		}
+	}
+
 	// Already get all the packet pointers
 	lampPacket=UDPgetpacketpointers(packet,&(headerptrs.etherHeader),&(headerptrs.ipHeader),&(headerptrs.udpHeader));
 	lampGetPacketPointers(lampPacket,&(headerptrs.lampHeader));
+	lampPacketErrqueue=UDPgetpacketpointers(packetBuf,NULL,NULL,NULL);
 
 	// From now on, 'payload' should -never- be used if (headerptrs.lampHeader)->payloadLen is 0
 
+	// Reset the live statistics page (--shm-stats only) for the new session
+	statsPageSessionStart(lamp_id_session,reportData.totalPackets,opts->latencyType,followup_mode_session!=FOLLOWUP_OFF);
+
+	// Open the pcapng file: the whole frames are written, as they are received and sent
+	// In continuous daemon mode, each session is appended to the same file, as a new section
+	if(opts->pcapng_filename!=NULL) {
+		snprintf(pcapngComment,sizeof(pcapngComment),"LaMP server, user timestamps: %s",clockSourcePrinter(opts->clock_source));
+
+		if((pcapng_ret=pcapngOpen(&pcapngData,opts->pcapng_filename,opts->dmode,PCAPNG_LINKTYPE_ETHERNET,sData.devname,pcapngComment))<0) {
+			perror("pcapngOpen() error");
+			fprintf(stderr,"Warning: cannot create the pcapng file %s (error code: %d).\n\tThe '--pcapng' option will be disabled.\n",opts->pcapng_filename,pcapng_ret);
+		} else {
+			pcapng_active=1;
+		}
+	}
+
 	// Start receiving packets
 	while(continueFlag) {
-		// If in KRT unidirectional mode or in HARDWARE/SOFTWARE mode (requested by the client through a follow-up control message, use recvmsg(), otherwise, use recvfrom())
-		if((mode_session==UNIDIR && opts->latencyType==KRT) || followup_mode_session==FOLLOWUP_ON_HW || followup_mode_session==FOLLOWUP_ON_KRN || followup_mode_session==FOLLOWUP_ON_KRN_RX) {
+		// When the RX ring is active, get the next frame directly from it
+		// Otherwise, if in KRT unidirectional mode or in HARDWARE/SOFTWARE mode (requested by the client through a follow-up control message, use recvmsg(), otherwise, use recvfrom())
+		if(opts->mode_raw==XDP) {
+			rcv_bytes=xdpSockRecv(&xdpSockData,&packet);
+		} else if(opts->rx_ring) {
+			rcv_bytes=rxRingRecv(&rxRingData,&ringFrame);
+		} else if((mode_session==UNIDIR && opts->latencyType==KRT) || followup_mode_session==FOLLOWUP_ON_HW || followup_mode_session==FOLLOWUP_ON_KRN || followup_mode_session==FOLLOWUP_ON_KRN_RX) {
 			saferecvmsg(rcv_bytes,sData.descriptor,&mhdr,NO_FLAGS);
 		} else {
 			saferecvfrom(rcv_bytes,sData.descriptor,packet,RAW_RX_PACKET_BUF_SIZE,NO_FLAGS,(struct sockaddr *)&addrll,&addrllLen);
 		}
 
 		if(followup_mode_session==FOLLOWUP_ON_APP) {
-			gettimeofday(&rx_timestamp,NULL);
+			rx_timestamp_ns=clockSourceNs();
 		}
 
 		// Timeout or other recvfrom() error occurred
 		if(rcv_bytes==-1) {
 			if(errno==EAGAIN) {
+				// With the XDP reflector, the requests never reach the server: the session is still alive if any request was reflected in the meantime
+				if(reflector_active) {
+					reflected_count_new=xdpReflectorGetCount(&xdpReflectorData,lamp_id_session);
+					if(reflected_count_new!=reflected_count) {
+						reflected_count=reflected_count_new;
+						continue;
+					}
+				}
+
 				fprintf(stderr,"Timeout reached when receiving packets. Connection terminated.\n");
 				break;
 			} else {
@@ -488,7 +631,22 @@ unsigned int runUDPserver_raw(struct lampsock_data sData, macaddr_t srcMAC, stru
 			}
 		}
 
-		// Filter out all outgoing packets - [IMPROVEMENT] use BPF instead
+		// The frame was not copied, when using the RX ring or the AF_XDP socket: point to it inside the ring or the UMEM
+		// The reply (ping-like mode) is then built directly inside the received frame
+		if(opts->rx_ring) {
+			packet=ringFrame.data;
+			addrll.sll_pkttype=ringFrame.pkttype;
+		} else if(opts->mode_raw==XDP) {
+			// Only incoming frames are redirected to the AF_XDP socket
+			addrll.sll_pkttype=PACKET_HOST;
+		}
+
+		if(opts->rx_ring || opts->mode_raw==XDP) {
+			lampPacket=UDPgetpacketpointers(packet,&(headerptrs.etherHeader),&(headerptrs.ipHeader),&(headerptrs.udpHeader));
+			lampGetPacketPointers(lampPacket,&(headerptrs.lampHeader));
+		}
+
+		// Filter out all outgoing packets (they are already dropped by the BPF filter, if it could be attached - see bpf_filter.c)
 		if(addrll.sll_pkttype==PACKET_OUTGOING) {
 			continue;
 		}
@@ -518,7 +676,7 @@ unsigned int runUDPserver_raw(struct lampsock_data sData, macaddr_t srcMAC, stru
 		getSrcMAC(headerptrs.etherHeader,srcmacaddr_pkt);
 
 		// If the packet is really a LaMP packet, get the header data
-		lampHeadGetData(lampPacket, &lamp_type_rx, &lamp_id_rx, &lamp_seq_rx, &lamp_payloadlen_rx, &tx_timestamp, NULL);
+		lampHeadGetData(lampPacket, &lamp_type_rx, &lamp_id_rx, &lamp_seq_rx, &lamp_payloadlen_rx, &packet_timestamp, NULL);
 
 		// Discard any (end)reply, ack, init, report or follow-up data, at the moment
 		if(lamp_type_rx==PINGLIKE_REPLY || lamp_type_rx==PINGLIKE_REPLY_TLESS || lamp_type_rx==PINGLIKE_ENDREPLY || lamp_type_rx==ACK || lamp_type_rx==REPORT || lamp_type_rx==INIT || lamp_type_rx==FOLLOWUP_DATA) {
@@ -529,29 +687,61 @@ unsigned int runUDPserver_raw(struct lampsock_data sData, macaddr_t srcMAC, stru
 		if(lamp_id_rx!=lamp_id_session) {
 			continue;
 		}
-		
-		if((mode_session==UNIDIR && opts->latencyType==KRT) || followup_mode_session==FOLLOWUP_ON_HW || followup_mode_session==FOLLOWUP_ON_KRN || followup_mode_session==FOLLOWUP_ON_KRN_RX) {
+
+		// Store the client IP address now, as, with the RX ring, the frame is given back to the kernel after the next reception
+		// In unidirectional mode, it will be used as destination IP address for the report
+		destIP_inaddr.s_addr=headerptrs.ipHeader->saddr;
+
+		if(opts->rx_ring && ((mode_session==UNIDIR && opts->latencyType==KRT) || followup_mode_session==FOLLOWUP_ON_HW || followup_mode_session==FOLLOWUP_ON_KRN || followup_mode_session==FOLLOWUP_ON_KRN_RX)) {
+			// With the RX ring, the kernel receive timestamp is stored inside the frame header
+			// If no hardware timestamp is available, the software one is used, as it happens when SO_TIMESTAMPING does not report any ts[2]
+			rx_timestamp_ns=timespecToNs(&ringFrame.ts);
+		} else if((mode_session==UNIDIR && opts->latencyType==KRT) || followup_mode_session==FOLLOWUP_ON_HW || followup_mode_session==FOLLOWUP_ON_KRN || followup_mode_session==FOLLOWUP_ON_KRN_RX) {
 			for(cmsg=CMSG_FIRSTHDR(&mhdr);cmsg!=NULL;cmsg=CMSG_NXTHDR(&mhdr, cmsg)) {
 				// KRT (unidirectional) mode
-                if((opts->latencyType==KRT || followup_mode_session==FOLLOWUP_ON_KRN_RX) && cmsg->cmsg_level==SOL_SOCKET && cmsg->cmsg_type==SO_TIMESTAMP) {
-                    rx_timestamp=*((struct timeval *)CMSG_DATA(cmsg));
+                if((opts->latencyType==KRT || followup_mode_session==FOLLOWUP_ON_KRN_RX) && cmsg->cmsg_level==SOL_SOCKET && cmsg->cmsg_type==SCM_TIMESTAMPNS) {
+                    rx_timestamp_ns=timespecToNs((struct timespec *)CMSG_DATA(cmsg));
                 }
 
                 // HARDWARE or SOFTWARE (kernel tx+rx) mode (bidirectional/ping-like only)
                	if((followup_mode_session==FOLLOWUP_ON_HW || followup_mode_session==FOLLOWUP_ON_KRN) && cmsg->cmsg_level==SOL_SOCKET && cmsg->cmsg_type==SO_TIMESTAMPING) {
 					hw_ts=*((struct scm_timestamping *)CMSG_DATA(cmsg));
-	    			rx_timestamp.tv_sec=hw_ts.ts[followup_mode_session==FOLLOWUP_ON_HW ? 2 : 0].tv_sec;
-	 				rx_timestamp.tv_usec=hw_ts.ts[followup_mode_session==FOLLOWUP_ON_HW ? 2 : 0].tv_nsec/MICROSEC_TO_NANOSEC;
+	    			rx_timestamp_ns=timespecToNs(&hw_ts.ts[followup_mode_session==FOLLOWUP_ON_HW ? 2 : 0]);
 	           	}
 			}
 		}
 
+		// With --pcapng, write the received frame, with the rx timestamps gathered so far (in unidirectional user-to-user
+		// mode, the application level timestamp is taken later on, thus the packet timestamp is the time at which it is written)
+		if(pcapng_active) {
+			memset(&pcapStamps,0,sizeof(pcapStamps));
+
+			if(followup_mode_session==FOLLOWUP_ON_APP) {
+				pcapStamps.user_ns=rx_timestamp_ns;
+			} else if(opts->rx_ring && ((mode_session==UNIDIR && opts->latencyType==KRT) || followup_mode_session!=FOLLOWUP_OFF)) {
+				if(ringFrame.ts_hw) {
+					pcapStamps.hw_ns=rx_timestamp_ns;
+				} else {
+					pcapStamps.kernel_ns=rx_timestamp_ns;
+				}
+			} else if(followup_mode_session==FOLLOWUP_ON_HW || followup_mode_session==FOLLOWUP_ON_KRN) {
+				pcapStamps.kernel_ns=timespecToNs(&hw_ts.ts[0]);
+				pcapStamps.hw_ns=timespecToNs(&hw_ts.ts[2]);
+			} else if((mode_session==UNIDIR && opts->latencyType==KRT) || followup_mode_session==FOLLOWUP_ON_KRN_RX) {
+				pcapStamps.kernel_ns=rx_timestamp_ns;
+			}
+
+			pcapngWriteFrame(&pcapngData,PCAPNG_DIR_INBOUND,packet,rcv_bytes,&pcapStamps);
+		}
+
 		// Check if this is a follow-up request packet (after the first one, all the subseuent ones will be ignored)
 		// Moreover, if a normal request packet is received, the session will go on without activating follow-ups
 		// and future follow-up requests will be ignored (in order not to provide inconsistent and/or mixed data to the client)
 		if(lamp_type_rx==FOLLOWUP_CTRL && IS_FOLLOWUP_REQUEST(lamp_payloadlen_rx) && isnotfirst_FU==0) {
 			// Received a follow-up request
-			if(opts->refuseFollowup) {
+			// With AF_XDP, no kernel timestamp is available for the received and transmitted frames
+			// With the XDP reflector, the requests are not processed by the server at all: no follow-up data could be sent
+			if(opts->refuseFollowup || reflector_active || (opts->mode_raw==XDP && lamp_payloadlen_rx!=FOLLOWUP_REQUEST_T_APP)) {
 				// Just deny the request
 				followup_reply_type=FOLLOWUP_DENY;
 			} else {
@@ -571,8 +761,8 @@ unsigned int runUDPserver_raw(struct lampsock_data sData, macaddr_t srcMAC, stru
 
 							memset(&mhdr,0,sizeof(mhdr));
 
-							iov.iov_base=packet;
-							iov.iov_len=sizeof(packet);
+							iov.iov_base=packetBuf;
+							iov.iov_len=sizeof(packetBuf);
 
 							mhdr.msg_name=NULL;
 							mhdr.msg_namelen=0;
@@ -596,10 +786,15 @@ unsigned int runUDPserver_raw(struct lampsock_data sData, macaddr_t srcMAC, stru
 							followup_reply_type=FOLLOWUP_ACCEPT;
 							followup_mode_session=lamp_payloadlen_rx==FOLLOWUP_REQUEST_T_HW ? FOLLOWUP_ON_HW : FOLLOWUP_ON_KRN;
 
+							// Request raw hardware timestamps inside the RX ring frame headers too
+							if(opts->rx_ring && followup_mode_session==FOLLOWUP_ON_HW && rxRingSetHwTimestamps(&rxRingData,1)<0) {
+								fprintf(stderr,"Warning: cannot enable hardware timestamps inside the RX ring. Software receive timestamps will be used.\n");
+							}
+
 							memset(&mhdr,0,sizeof(mhdr));
 
-							iov.iov_base=packet;
-							iov.iov_len=sizeof(packet);
+							iov.iov_base=packetBuf;
+							iov.iov_len=sizeof(packetBuf);
 
 							mhdr.msg_name=NULL;
 							mhdr.msg_namelen=0;
@@ -653,24 +848,29 @@ unsigned int runUDPserver_raw(struct lampsock_data sData, macaddr_t srcMAC, stru
 		switch(mode_session) {
 			case UNIDIR:
 				if(opts->latencyType==USERTOUSER) {
-					gettimeofday(&rx_timestamp,NULL);
+					rx_timestamp_ns=realtimeNs();
 				}
 
-				if(timevalSub(&tx_timestamp,&rx_timestamp)) {
+				tx_timestamp_ns=timevalToNs(&packet_timestamp);
+
+				if(rx_timestamp_ns<tx_timestamp_ns) {
 					fprintf(stderr,"Error: negative latency for packet from " PRI_MAC " (id=%u, seq=%u, rx_bytes=%d)!\nThe clock synchronization is not sufficienty precise to allow unidirectional measurements.\n",
 						MAC_PRINTER(srcmacaddr_pkt),lamp_id_rx,lamp_seq_rx,(int)rcv_bytes);
 					tripTime=0;
 				} else {
-					tripTime=rx_timestamp.tv_sec*SEC_TO_MICROSEC+rx_timestamp.tv_usec;
+					tripTime=rx_timestamp_ns-tx_timestamp_ns;
 				}
 
 				if(tripTime!=0) {
-					fprintf(stdout,"Received a unidirectional message from " PRI_MAC " (id=%u, seq=%u, rx_bytes=%d). Time: %.3f ms (%s)\n",
-						MAC_PRINTER(srcmacaddr_pkt),lamp_id_rx,lamp_seq_rx,(int)rcv_bytes,(double)tripTime/1000,latencyTypePrinter(opts->latencyType));
+					fprintf(stdout,"Received a unidirectional message from " PRI_MAC " (id=%u, seq=%u, rx_bytes=%d). Time: %.6f ms (%s)\n",
+						MAC_PRINTER(srcmacaddr_pkt),lamp_id_rx,lamp_seq_rx,(int)rcv_bytes,(double)tripTime/MILLISEC_TO_NANOSEC,latencyTypePrinter(opts->latencyType));
 				}
 
 				// Update the current report structure
-				reportStructureUpdate(&reportData,tripTime,lamp_seq_rx);
+				reportStructureUpdate(&reportData,tripTime,seqExtend(&reportSeqExt,lamp_seq_rx));
+
+				// With --shm-stats, publish the updated statistics (a few plain stores inside the shared memory page)
+				reportStructurePublish(&reportData,tripTime);
 			break;
 
 			case PINGLIKE:
@@ -684,6 +884,13 @@ unsigned int runUDPserver_raw(struct lampsock_data sData, macaddr_t srcMAC, stru
 				fprintf(stdout,"Received a ping-like message from " PRI_MAC " (id=%u, seq=%u, rx_bytes=%d). Replying to client...\n",
 					MAC_PRINTER(srcmacaddr_pkt),lamp_id_rx,lamp_seq_rx,(int)rcv_bytes);
 
+				// With AF_XDP, the UDP checksum is not recomputed when sending: save the fields which are going to be modified
+				if(opts->mode_raw==XDP) {
+					memcpy(oldIPaddrs,&(headerptrs.ipHeader->saddr),sizeof(oldIPaddrs)); // 'saddr' and 'daddr' are contiguous
+					memcpy(oldUDPports,headerptrs.udpHeader,sizeof(oldUDPports));
+					memcpy(oldLampCtrl,headerptrs.lampHeader,sizeof(oldLampCtrl)); // 'reserved' and 'ctrl'
+				}
+
 				// Edit some 'packet' fields
 				// memcpy the MAC addresses
 				memcpy((headerptrs.etherHeader)->ether_shost,srcMAC,ETHER_ADDR_LEN); // As source, my MAC address
@@ -709,18 +916,29 @@ unsigned int runUDPserver_raw(struct lampsock_data sData, macaddr_t srcMAC, stru
 				headerptrs.ipHeader->check=ip_fast_csum((__u8 *)headerptrs.ipHeader, headerptrs.ipHeader->ihl);
 
 				// If using application level or kernel level RX follow-up mode, gather the tx timestamp just before sending the packet
+				// The KRT rx timestamp comes from CLOCK_REALTIME: the selected clock source is used for application level timestamps only
 				if(followup_mode_session==FOLLOWUP_ON_APP || followup_mode_session==FOLLOWUP_ON_KRN_RX) {
-					gettimeofday(&tx_timestamp,NULL);
+					tx_timestamp_ns=followup_mode_session==FOLLOWUP_ON_APP ? clockSourceNs() : realtimeNs();
 				}
 
 				// Send packet (as the reply does require to carry the client timestamp, the control field should now correspond to CTRL_PINGLIKE_REPLY)
 				// 'rcv_bytes' still stores the packet size, thus it can be used as packet size to be passed to rawLampSend(), wich will in turn call sendto() with that size
 				// rawLampSend should also take care of re-computing the checksum, which is changed due to the different fields in the reply packet.
-				if(rawLampSend(sData.descriptor, sData.addru.addrll, headerptrs.lampHeader, packet, rcv_bytes, FLG_NONE, UDP)) {
+				// With AF_XDP, the UDP checksum is updated incrementally and the reply is copied into a TX frame of the UMEM
+				reply_bytes=rcv_bytes;
+				if(opts->mode_raw==XDP) {
+					udpCsumIncrementalUpdate(headerptrs.udpHeader,oldIPaddrs,(byte_t *) &(headerptrs.ipHeader->saddr),sizeof(oldIPaddrs));
+					udpCsumIncrementalUpdate(headerptrs.udpHeader,oldUDPports,(byte_t *) headerptrs.udpHeader,sizeof(oldUDPports));
+					udpCsumIncrementalUpdate(headerptrs.udpHeader,oldLampCtrl,(byte_t *) headerptrs.lampHeader,sizeof(oldLampCtrl));
+
+					if(xdpSockSend(&xdpSockData,packet,rcv_bytes)<0) {
+						fprintf(stderr,"UDP server reported that it can't reply to the client with id=%u and seq=%u (AF_XDP)\n",lamp_id_rx,lamp_seq_rx);
+					}
+				} else if(rawLampSend(sData.descriptor, sData.addru.addrll, headerptrs.lampHeader, packet, rcv_bytes, FLG_NONE, UDP)) {
 					fprintf(stderr,"UDP server reported that it can't reply to the client with id=%u and seq=%u\n",lamp_id_rx,lamp_seq_rx);
 				}
 
-				// If in hardware timestamping or software (kernel) follow-up mode, gather the tx_timestamp from ancillary data
+				// If in hardware timestamping or software (kernel) follow-up mode, gather the tx timestamp from ancillary data
 				if(followup_mode_session==FOLLOWUP_ON_HW || followup_mode_session==FOLLOWUP_ON_KRN) {
 					// Loop until the right transmitted packet is received (as other packets are sent too, for which we are not
 					//  interested in obtaining any tx timestamp - e.g. all the follow-up data tx timestamps are useless in our case)
@@ -730,7 +948,7 @@ unsigned int runUDPserver_raw(struct lampsock_data sData, macaddr_t srcMAC, stru
 							break;
 						}
 						saferecvmsg(rcv_bytes,sData.descriptor,&mhdr,MSG_ERRQUEUE);
-						lampHeadGetData(lampPacket,&lamp_type_rx_errqueue,NULL,&lamp_seq_rx_errqueue,NULL,NULL,NULL);
+						lampHeadGetData(lampPacketErrqueue,&lamp_type_rx_errqueue,NULL,&lamp_seq_rx_errqueue,NULL,NULL,NULL);
 					} while(lamp_seq_rx_errqueue!=lamp_seq_rx || lamp_type_rx_errqueue!=lamp_type_tx);
 
 					if(rcv_bytes==-1) {
@@ -741,26 +959,40 @@ unsigned int runUDPserver_raw(struct lampsock_data sData, macaddr_t srcMAC, stru
 					for(cmsg=CMSG_FIRSTHDR(&mhdr);cmsg!=NULL;cmsg=CMSG_NXTHDR(&mhdr, cmsg)) {
 			           	if(cmsg->cmsg_level==SOL_SOCKET && cmsg->cmsg_type==SO_TIMESTAMPING) {
 			            	hw_ts=*((struct scm_timestamping *)CMSG_DATA(cmsg));
-			             	tx_timestamp.tv_sec=hw_ts.ts[followup_mode_session==FOLLOWUP_ON_HW ? 2 : 0].tv_sec;
-			       			tx_timestamp.tv_usec=hw_ts.ts[followup_mode_session==FOLLOWUP_ON_HW ? 2 : 0].tv_nsec/MICROSEC_TO_NANOSEC;
+			             	tx_timestamp_ns=timespecToNs(&hw_ts.ts[followup_mode_session==FOLLOWUP_ON_HW ? 2 : 0]);
 			           	}
 					}
 				}
 
+				// With --pcapng, write the reply, with its tx timestamp
+				// When the tx timestamp is read from the socket error queue, the looped-back reply is stored inside 'packetBuf'
+				if(pcapng_active) {
+					memset(&pcapStamps,0,sizeof(pcapStamps));
+
+					if(followup_mode_session==FOLLOWUP_ON_HW || followup_mode_session==FOLLOWUP_ON_KRN) {
+						pcapStamps.kernel_ns=timespecToNs(&hw_ts.ts[0]);
+						pcapStamps.hw_ns=timespecToNs(&hw_ts.ts[2]);
+						pcapngWriteFrame(&pcapngData,PCAPNG_DIR_OUTBOUND,packetBuf,reply_bytes,&pcapStamps);
+					} else {
+						pcapStamps.user_ns=followup_mode_session!=FOLLOWUP_OFF ? tx_timestamp_ns : 0;
+						pcapngWriteFrame(&pcapngData,PCAPNG_DIR_OUTBOUND,packet,reply_bytes,&pcapStamps);
+					}
+				}
+
 				// If follow-up mode is active, send the follow-up data packet
 				if(followup_mode_session!=FOLLOWUP_OFF) {
-					// Compute the difference between the rx and tx timestamps (difference stored in tx_timestamp, i.e. the "out" argument of timevalSub())
-					// This is done since normally tx_timestamp > rx_timestamp
-					if(timevalSub(&rx_timestamp,&tx_timestamp)) {
+					// Compute the difference between the rx and tx timestamps (stored in tx_timestamp_ns)
+					// This is done since normally tx_timestamp_ns > rx_timestamp_ns
+					if(tx_timestamp_ns<rx_timestamp_ns) {
 						fprintf(stderr,"Error: negative time!\nCannot compute follow-up processing time for the current packet (id=%u, seq=%u).\n",lamp_id_rx,lamp_seq_rx);
-						tx_timestamp.tv_sec=0;
-						tx_timestamp.tv_usec=0;
+						tx_timestamp_ns=0;
 					} else {
-						fprintf(stdout,"Sending follow-up data. Processing delta: %.3f ms.\n",((double) tx_timestamp.tv_sec)*SEC_TO_MILLISEC+((double) tx_timestamp.tv_usec)/MICROSEC_TO_MILLISEC);
+						tx_timestamp_ns-=rx_timestamp_ns;
+						fprintf(stdout,"Sending follow-up data. Processing delta: %.6f ms.\n",(double) tx_timestamp_ns/MILLISEC_TO_NANOSEC);
 					}
 					
 					// Send follow-up with the time difference timestamp (fuData should be already filled with all the proper data)
-					if(sendFollowUpData_RAW(&args,&fuData,lamp_id_rx,headerptrs.ipHeader->id,lamp_seq_rx,tx_timestamp)) {
+					if(sendFollowUpData_RAW(&args,&fuData,lamp_id_rx,headerptrs.ipHeader->id,lamp_seq_rx,tx_timestamp_ns)) {
 						perror("sendto() for sending LaMP follow-up data failed");
 						fprintf(stderr,"UDP server reported that it can't reply to the client with id=%u and seq=%u (follow-up)\n",lamp_id_rx,lamp_seq_rx);
 					}
@@ -772,18 +1004,52 @@ unsigned int runUDPserver_raw(struct lampsock_data sData, macaddr_t srcMAC, stru
 		}
 	}
 
+	if(pcapng_active) {
+		pcapngClose(&pcapngData);
+
+		if(pcapngData.writeErrors>0) {
+			fprintf(stderr,"Warning: %" PRIu64 " packets could not be written to the pcapng file.\n",pcapngData.writeErrors);
+		}
+	}
+
+	if(reflector_active) {
+		fprintf(stdout,"Requests replied by the XDP reflector: %" PRIu64 ".\n",xdpReflectorGetCount(&xdpReflectorData,lamp_id_session));
+		xdpReflectorDestroy(&xdpReflectorData);
+	}
+
+	// The RX ring must be released before transmitting the report, as the ACK is received with recvfrom()
+	if(opts->rx_ring) {
+		rxRingDestroy(&rxRingData);
+	}
+
+	// The same applies to the AF_XDP socket, which must be destroyed to stop redirecting the LaMP packets (including the ACK) to it
+	if(opts->mode_raw==XDP) {
+		xdpSockDestroy(&xdpSockData);
+	}
+
 	if(mode_session==UNIDIR) {
-		destIP_inaddr.s_addr=headerptrs.ipHeader->saddr;
 		// If the mode is the unidirectional one, get the destination IP/MAC from the last packet
-		// Use as destination IP (destIP), the source IP of the last received packet (headerptrs.ipHeader->saddr)
+		// Use as destination IP (destIP), the source IP of the last received packet (stored in destIP_inaddr)
 		if(transmitReport(sData, opts, destIP_inaddr, srcIP, srcMAC, srcmacaddr_pkt)) {
 			fprintf(stderr,"UDP server reported an error while transmitting the report.\n"
 				"No report will be transmitted.\n");
+			statsPageSessionEnd(STATSPAGE_STATE_ERROR);
 			CLEAR_ALL();
 			return 4;
 		}
 	}
 
+	// The statistics of unidirectional sessions have been finalized when transmitting the report
+	// In continuous daemon mode, they are also added to the statistics of all the sessions, printed when the program terminates
+	if(mode_session==UNIDIR) {
+		reportStructurePublish(&reportData,0);
+
+		if(opts->dmode) {
+			reportSessionsAdd(&reportData);
+		}
+	}
+	statsPageSessionEnd(STATSPAGE_STATE_FINISHED);
+
 	// Destroy mutex (as it is no longer needed) and clear all the other data that should be clared (see the CLEAR_ALL() macro)
 	CLEAR_ALL();
 
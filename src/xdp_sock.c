@@ -0,0 +1,760 @@
+#include "xdp_sock.h"
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <net/ethernet.h>
+#include <netinet/ip.h>
+#include <arpa/inet.h>
+#include <linux/if_xdp.h>
+#include <linux/if_link.h>
+#include <linux/bpf.h>
+#include "timer_man.h"
+#include "rawsock_lamp.h"
+
+#ifndef AF_XDP
+#define AF_XDP 44
+#endif
+
+#ifndef SOL_XDP
+#define SOL_XDP 283
+#endif
+
+// Maximum number of eBPF instructions in the generated XDP programs
+#define XDP_PROG_MAX_LEN 96
+
+// Offsets (from the beginning of the Ethernet frame) of the fields checked by the XDP program
+// Only IP headers without options are matched (as it happens for all the LaMP packets)
+#define ETH_TYPE_OFF 12
+#define IP_OFF 14
+#define IP_VIHL_OFF IP_OFF
+#define IP_FRAG_OFF (IP_OFF+6)
+#define IP_PROTO_OFF (IP_OFF+9)
+#define IP_SADDR_OFF (IP_OFF+12)
+#define IP_DADDR_OFF (IP_OFF+16)
+#define UDP_SPORT_OFF (IP_OFF+20)
+#define UDP_DPORT_OFF (IP_OFF+20+2)
+#define UDP_CHECK_OFF (IP_OFF+20+6)
+#define LAMP_OFF (IP_OFF+20+8)
+// Minimum frame length (Ethernet + IP + UDP headers), checked before accessing any field
+#define XDP_PROG_MIN_FRAME_LEN (IP_OFF+20+8)
+// Minimum frame length for the reflector (the whole LaMP header is required)
+#define XDP_REFLECT_MIN_FRAME_LEN (LAMP_OFF+sizeof(struct lamphdr))
+
+// IPv4 version and header length of a datagram without options
+#define IP_VIHL_NOOPT 0x45
+// IP "more fragments" flag and fragment offset mask: fragmented datagrams are left to the kernel
+#define IP_MF_OFFMASK 0x3FFF
+
+// Placeholder jump offset, replaced with the actual offset to the "pass" instructions once the whole program is generated
+#define JUMP_TO_PASS INT16_MAX
+
+static inline int bpfSyscall(int cmd, union bpf_attr *attr) {
+	return syscall(__NR_bpf,cmd,attr,sizeof(*attr));
+}
+
+static inline int xdpEmit(struct bpf_insn *prog, unsigned int *len, uint8_t code, uint8_t dst, uint8_t src, int16_t off, int32_t imm) {
+	if(*len>=XDP_PROG_MAX_LEN) {
+		return -1;
+	}
+
+	prog[*len].code=code;
+	prog[*len].dst_reg=dst;
+	prog[*len].src_reg=src;
+	prog[*len].off=off;
+	prog[*len].imm=imm;
+	(*len)++;
+
+	return 0;
+}
+
+/* Emit the instructions checking that the frame is an IPv4/UDP datagram, not fragmented, without IP options, directed to
+'dstIP' and to the UDP port 'port' (in host byte order), and at least 'minFrameLen' bytes long; if it is not, jump to the
+"pass" instructions (JUMP_TO_PASS). 'r2' and 'r3' must store, respectively, ctx->data and ctx->data_end; 'r4' and 'r5' are
+overwritten. All the comparisons are performed on the values as they are stored inside the frame (i.e. in network byte order),
+and 32 bit jumps (BPF_JMP32) are used not to have the immediate values sign-extended.
+Return values:
+0: ok
+-1: error (program too long)
+*/
+static int xdpEmitUdpMatch(struct bpf_insn *prog, unsigned int *len, struct in_addr dstIP, uint16_t port, int32_t minFrameLen) {
+	int err=0;
+
+	// Bounds check (required by the verifier before accessing the frame)
+	err|=xdpEmit(prog,len,BPF_ALU64 | BPF_MOV | BPF_X,BPF_REG_4,BPF_REG_2,0,0);
+	err|=xdpEmit(prog,len,BPF_ALU64 | BPF_ADD | BPF_K,BPF_REG_4,0,0,minFrameLen);
+	err|=xdpEmit(prog,len,BPF_JMP | BPF_JGT | BPF_X,BPF_REG_4,BPF_REG_3,JUMP_TO_PASS,0);
+
+	// IPv4 without options, UDP, not a fragment
+	err|=xdpEmit(prog,len,BPF_LDX | BPF_MEM | BPF_H,BPF_REG_5,BPF_REG_2,ETH_TYPE_OFF,0);
+	err|=xdpEmit(prog,len,BPF_JMP32 | BPF_JNE | BPF_K,BPF_REG_5,0,JUMP_TO_PASS,htons(ETHERTYPE_IP));
+	err|=xdpEmit(prog,len,BPF_LDX | BPF_MEM | BPF_B,BPF_REG_5,BPF_REG_2,IP_VIHL_OFF,0);
+	err|=xdpEmit(prog,len,BPF_JMP32 | BPF_JNE | BPF_K,BPF_REG_5,0,JUMP_TO_PASS,IP_VIHL_NOOPT);
+	err|=xdpEmit(prog,len,BPF_LDX | BPF_MEM | BPF_B,BPF_REG_5,BPF_REG_2,IP_PROTO_OFF,0);
+	err|=xdpEmit(prog,len,BPF_JMP32 | BPF_JNE | BPF_K,BPF_REG_5,0,JUMP_TO_PASS,IPPROTO_UDP);
+	err|=xdpEmit(prog,len,BPF_LDX | BPF_MEM | BPF_H,BPF_REG_5,BPF_REG_2,IP_FRAG_OFF,0);
+	err|=xdpEmit(prog,len,BPF_JMP32 | BPF_JSET | BPF_K,BPF_REG_5,0,JUMP_TO_PASS,htons(IP_MF_OFFMASK));
+
+	// Destination IP address and UDP port
+	err|=xdpEmit(prog,len,BPF_LDX | BPF_MEM | BPF_W,BPF_REG_5,BPF_REG_2,IP_DADDR_OFF,0);
+	err|=xdpEmit(prog,len,BPF_JMP32 | BPF_JNE | BPF_K,BPF_REG_5,0,JUMP_TO_PASS,(int32_t) dstIP.s_addr);
+	err|=xdpEmit(prog,len,BPF_LDX | BPF_MEM | BPF_H,BPF_REG_5,BPF_REG_2,UDP_DPORT_OFF,0);
+	err|=xdpEmit(prog,len,BPF_JMP32 | BPF_JNE | BPF_K,BPF_REG_5,0,JUMP_TO_PASS,htons(port));
+
+	return err;
+}
+
+// Resolve the jumps to the "pass" instructions (which must be the last two ones) and load the program
+static int xdpProgFinalizeLoad(struct bpf_insn *prog, unsigned int len) {
+	union bpf_attr attr;
+
+	for(unsigned int i=0;i<len;i++) {
+		if((BPF_CLASS(prog[i].code)==BPF_JMP || BPF_CLASS(prog[i].code)==BPF_JMP32) && prog[i].off==JUMP_TO_PASS) {
+			prog[i].off=(len-2)-(i+1);
+		}
+	}
+
+	memset(&attr,0,sizeof(attr));
+	attr.prog_type=BPF_PROG_TYPE_XDP;
+	attr.insns=(uint64_t) (uintptr_t) prog;
+	attr.insn_cnt=len;
+	attr.license=(uint64_t) (uintptr_t) "GPL";
+
+	return bpfSyscall(BPF_PROG_LOAD,&attr);
+}
+
+// Attach an XDP program to the interface 'ifindex', in generic (SKB) mode, returning the BPF link file descriptor (or -1)
+static int xdpProgAttach(int prog_fd, int ifindex) {
+	union bpf_attr attr;
+
+	memset(&attr,0,sizeof(attr));
+	attr.link_create.prog_fd=prog_fd;
+	attr.link_create.target_ifindex=ifindex;
+	attr.link_create.attach_type=BPF_XDP;
+	attr.link_create.flags=XDP_FLAGS_SKB_MODE;
+
+	return bpfSyscall(BPF_LINK_CREATE,&attr);
+}
+
+/* Generate and load the XDP program redirecting to the socket stored inside 'map_fd' (at the index of the receive queue) all
+the IPv4/UDP frames directed to 'dstIP' and to the UDP port 'port' (in host byte order). Any other frame is passed to the kernel.
+The program is equivalent to:
+	if(frame is IPv4/UDP, not fragmented, without IP options, directed to dstIP:port)
+		return bpf_redirect_map(&xskmap, ctx->rx_queue_index, XDP_PASS);
+	return XDP_PASS;
+Return values:
+>=0: program file descriptor
+-1: error
+*/
+static int xdpProgLoad(int map_fd, struct in_addr dstIP, uint16_t port) {
+	struct bpf_insn prog[XDP_PROG_MAX_LEN];
+	unsigned int len=0;
+	int err=0;
+
+	memset(prog,0,sizeof(prog));
+
+	// r6 = ctx, r2 = data, r3 = data_end
+	err|=xdpEmit(prog,&len,BPF_ALU64 | BPF_MOV | BPF_X,BPF_REG_6,BPF_REG_1,0,0);
+	err|=xdpEmit(prog,&len,BPF_LDX | BPF_MEM | BPF_W,BPF_REG_2,BPF_REG_6,offsetof(struct xdp_md,data),0);
+	err|=xdpEmit(prog,&len,BPF_LDX | BPF_MEM | BPF_W,BPF_REG_3,BPF_REG_6,offsetof(struct xdp_md,data_end),0);
+
+	err|=xdpEmitUdpMatch(prog,&len,dstIP,port,XDP_PROG_MIN_FRAME_LEN);
+
+	// return bpf_redirect_map(map, ctx->rx_queue_index, XDP_PASS) - the map address is loaded with a 2-instructions BPF_LD_IMM64
+	err|=xdpEmit(prog,&len,BPF_LDX | BPF_MEM | BPF_W,BPF_REG_2,BPF_REG_6,offsetof(struct xdp_md,rx_queue_index),0);
+	err|=xdpEmit(prog,&len,BPF_LD | BPF_DW | BPF_IMM,BPF_REG_1,BPF_PSEUDO_MAP_FD,0,map_fd);
+	err|=xdpEmit(prog,&len,0,0,0,0,0);
+	err|=xdpEmit(prog,&len,BPF_ALU64 | BPF_MOV | BPF_K,BPF_REG_3,0,0,XDP_PASS);
+	err|=xdpEmit(prog,&len,BPF_JMP | BPF_CALL,0,0,0,BPF_FUNC_redirect_map);
+	err|=xdpEmit(prog,&len,BPF_JMP | BPF_EXIT,0,0,0,0);
+
+	// "pass": return XDP_PASS
+	err|=xdpEmit(prog,&len,BPF_ALU64 | BPF_MOV | BPF_K,BPF_REG_0,0,0,XDP_PASS);
+	err|=xdpEmit(prog,&len,BPF_JMP | BPF_EXIT,0,0,0,0);
+
+	if(err) {
+		return -1;
+	}
+
+	return xdpProgFinalizeLoad(prog,len);
+}
+
+static int xdpSockRingMap(xdpSockRing *ring, int fd, struct xdp_ring_offset *off, size_t entry_size, off_t pgoff) {
+	ring->map_size=off->desc+XDP_SOCK_RING_SIZE*entry_size;
+	ring->map=mmap(NULL,ring->map_size,PROT_READ | PROT_WRITE,MAP_SHARED | MAP_POPULATE,fd,pgoff);
+
+	if(ring->map==MAP_FAILED) {
+		return -1;
+	}
+
+	ring->producer=(uint32_t *) ((byte_t *) ring->map+off->producer);
+	ring->consumer=(uint32_t *) ((byte_t *) ring->map+off->consumer);
+	ring->desc=(byte_t *) ring->map+off->desc;
+	ring->mask=XDP_SOCK_RING_SIZE-1;
+
+	return 0;
+}
+
+static void xdpSockRingUnmap(xdpSockRing *ring) {
+	if(ring->map!=MAP_FAILED) {
+		munmap(ring->map,ring->map_size);
+		ring->map=MAP_FAILED;
+	}
+}
+
+// Move the TX frames already sent by the kernel (reported inside the completion ring) back to the list of free TX frames
+static void xdpSockReapCompletions(xdpSock *xsk) {
+	uint32_t cons=*(xsk->comp.consumer);
+	uint32_t prod=__atomic_load_n(xsk->comp.producer,__ATOMIC_ACQUIRE);
+
+	while(cons!=prod) {
+		xsk->tx_free[xsk->tx_free_nr++]=((uint64_t *) xsk->comp.desc)[cons & xsk->comp.mask];
+		cons++;
+	}
+
+	__atomic_store_n(xsk->comp.consumer,cons,__ATOMIC_RELEASE);
+}
+
+// Ask the kernel to transmit the frames written inside the TX ring (in copy mode, they are sent during this same call)
+static inline int xdpSockKick(xdpSock *xsk) {
+	if(sendto(xsk->descriptor,NULL,0,MSG_DONTWAIT,NULL,0)<0 && errno!=EAGAIN && errno!=EBUSY && errno!=ENOBUFS) {
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Create an AF_XDP socket on the queue 'queue_id' of the interface 'ifindex' and attach (in generic mode) the XDP program
+redirecting to it the IPv4/UDP frames directed to 'dstIP':'port' ('port' in host byte order).
+The receive timeout currently set with SO_RCVTIMEO on 'sFd' (i.e. the AF_PACKET socket) is applied to xdpSockRecv() too.
+Return values:
+0: ok
+<0: error (see the XDPSOCK_E* macros in xdp_sock.h)
+*/
+int xdpSockCreate(xdpSock *xsk, int sFd, int ifindex, unsigned int queue_id, struct in_addr dstIP, uint16_t port) {
+	struct xdp_umem_reg umemReg;
+	struct xdp_mmap_offsets off;
+	socklen_t offLen=sizeof(off);
+	struct sockaddr_xdp addrxdp;
+	struct timeval rcvtimeo;
+	socklen_t rcvtimeoLen=sizeof(rcvtimeo);
+	struct rlimit memlock={RLIM_INFINITY,RLIM_INFINITY};
+	union bpf_attr attr;
+	int ringSize=XDP_SOCK_RING_SIZE;
+	uint32_t key=queue_id;
+	int err=0;
+
+	xsk->umem=MAP_FAILED;
+	xsk->fill.map=MAP_FAILED;
+	xsk->comp.map=MAP_FAILED;
+	xsk->rx.map=MAP_FAILED;
+	xsk->tx.map=MAP_FAILED;
+	xsk->map_fd=-1;
+	xsk->prog_fd=-1;
+	xsk->link_fd=-1;
+	xsk->rx_held=0;
+	xsk->tx_free_nr=0;
+
+	if(getsockopt(sFd,SOL_SOCKET,SO_RCVTIMEO,&rcvtimeo,&rcvtimeoLen)==0 && (rcvtimeo.tv_sec!=0 || rcvtimeo.tv_usec!=0)) {
+		xsk->timeout_ms=rcvtimeo.tv_sec*SEC_TO_MILLISEC+rcvtimeo.tv_usec/MILLISEC_TO_MICROSEC;
+	} else {
+		xsk->timeout_ms=INDEFINITE_BLOCK;
+	}
+
+	// Kernels older than 5.11 account the UMEM and the BPF maps against RLIMIT_MEMLOCK: try to remove the limit (failures are not fatal)
+	setrlimit(RLIMIT_MEMLOCK,&memlock);
+
+	xsk->descriptor=socket(AF_XDP,SOCK_RAW,0);
+	if(xsk->descriptor<0) {
+		return XDPSOCK_ESOCKET;
+	}
+
+	// Allocate and register the UMEM
+	xsk->umem_size=(size_t) XDP_SOCK_FRAME_SIZE*XDP_SOCK_FRAME_NR;
+	xsk->umem=mmap(NULL,xsk->umem_size,PROT_READ | PROT_WRITE,MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE,-1,0);
+	if(xsk->umem==MAP_FAILED) {
+		err=XDPSOCK_EUMEM;
+		goto xdpsock_create_error;
+	}
+
+	memset(&umemReg,0,sizeof(umemReg));
+	umemReg.addr=(uint64_t) (uintptr_t) xsk->umem;
+	umemReg.len=xsk->umem_size;
+	umemReg.chunk_size=XDP_SOCK_FRAME_SIZE;
+	umemReg.headroom=0;
+
+	if(setsockopt(xsk->descriptor,SOL_XDP,XDP_UMEM_REG,&umemReg,sizeof(umemReg))!=0) {
+		err=XDPSOCK_EUMEM;
+		goto xdpsock_create_error;
+	}
+
+	// Set up and map the four rings
+	if(setsockopt(xsk->descriptor,SOL_XDP,XDP_UMEM_FILL_RING,&ringSize,sizeof(ringSize))!=0 ||
+		setsockopt(xsk->descriptor,SOL_XDP,XDP_UMEM_COMPLETION_RING,&ringSize,sizeof(ringSize))!=0 ||
+		setsockopt(xsk->descriptor,SOL_XDP,XDP_RX_RING,&ringSize,sizeof(ringSize))!=0 ||
+		setsockopt(xsk->descriptor,SOL_XDP,XDP_TX_RING,&ringSize,sizeof(ringSize))!=0 ||
+		getsockopt(xsk->descriptor,SOL_XDP,XDP_MMAP_OFFSETS,&off,&offLen)!=0) {
+		err=XDPSOCK_ESETSOCKOPT;
+		goto xdpsock_create_error;
+	}
+
+	if(xdpSockRingMap(&(xsk->fill),xsk->descriptor,&(off.fr),sizeof(uint64_t),XDP_UMEM_PGOFF_FILL_RING)<0 ||
+		xdpSockRingMap(&(xsk->comp),xsk->descriptor,&(off.cr),sizeof(uint64_t),XDP_UMEM_PGOFF_COMPLETION_RING)<0 ||
+		xdpSockRingMap(&(xsk->rx),xsk->descriptor,&(off.rx),sizeof(struct xdp_desc),XDP_PGOFF_RX_RING)<0 ||
+		xdpSockRingMap(&(xsk->tx),xsk->descriptor,&(off.tx),sizeof(struct xdp_desc),XDP_PGOFF_TX_RING)<0) {
+		err=XDPSOCK_EMMAP;
+		goto xdpsock_create_error;
+	}
+
+	// Give all the RX frames to the kernel, through the fill ring, and mark all the TX frames as free
+	for(unsigned int i=0;i<XDP_SOCK_RX_FRAME_NR;i++) {
+		((uint64_t *) xsk->fill.desc)[i & xsk->fill.mask]=(uint64_t) i*XDP_SOCK_FRAME_SIZE;
+	}
+	__atomic_store_n(xsk->fill.producer,*(xsk->fill.producer)+XDP_SOCK_RX_FRAME_NR,__ATOMIC_RELEASE);
+
+	for(unsigned int i=0;i<XDP_SOCK_TX_FRAME_NR;i++) {
+		xsk->tx_free[xsk->tx_free_nr++]=(uint64_t) (XDP_SOCK_RX_FRAME_NR+i)*XDP_SOCK_FRAME_SIZE;
+	}
+
+	// Bind to the requested queue, in copy mode (supported by any driver, in generic XDP mode)
+	memset(&addrxdp,0,sizeof(addrxdp));
+	addrxdp.sxdp_family=AF_XDP;
+	addrxdp.sxdp_ifindex=ifindex;
+	addrxdp.sxdp_queue_id=queue_id;
+	addrxdp.sxdp_flags=XDP_COPY;
+
+	if(bind(xsk->descriptor,(struct sockaddr *) &addrxdp,sizeof(addrxdp))<0) {
+		err=XDPSOCK_EBIND;
+		goto xdpsock_create_error;
+	}
+
+	// Create the XSKMAP and store the socket at the index of the bound queue
+	memset(&attr,0,sizeof(attr));
+	attr.map_type=BPF_MAP_TYPE_XSKMAP;
+	attr.key_size=sizeof(uint32_t);
+	attr.value_size=sizeof(int);
+	attr.max_entries=queue_id+1;
+
+	xsk->map_fd=bpfSyscall(BPF_MAP_CREATE,&attr);
+	if(xsk->map_fd<0) {
+		err=XDPSOCK_EMAP;
+		goto xdpsock_create_error;
+	}
+
+	memset(&attr,0,sizeof(attr));
+	attr.map_fd=xsk->map_fd;
+	attr.key=(uint64_t) (uintptr_t) &key;
+	attr.value=(uint64_t) (uintptr_t) &(xsk->descriptor);
+	attr.flags=BPF_ANY;
+
+	if(bpfSyscall(BPF_MAP_UPDATE_ELEM,&attr)<0) {
+		err=XDPSOCK_EMAP;
+		goto xdpsock_create_error;
+	}
+
+	// Load the program and attach it in generic (SKB) mode
+	xsk->prog_fd=xdpProgLoad(xsk->map_fd,dstIP,port);
+	if(xsk->prog_fd<0) {
+		err=XDPSOCK_EPROG;
+		goto xdpsock_create_error;
+	}
+
+	xsk->link_fd=xdpProgAttach(xsk->prog_fd,ifindex);
+	if(xsk->link_fd<0) {
+		err=XDPSOCK_EATTACH;
+		goto xdpsock_create_error;
+	}
+
+	return 0;
+
+xdpsock_create_error:
+	xdpSockDestroy(xsk);
+	return err;
+}
+
+/* Get the next received frame, waiting up to 'timeout_ms' for it to be redirected to the socket.
+'*frame' points directly inside the UMEM and it is valid until the next call to xdpSockRecv() or xdpSockDestroy(): the frame
+can thus be modified in place and then passed to xdpSockSend().
+Return values (as recvfrom()):
+>=0: frame length
+-1: error (errno is set to EAGAIN if the timeout expired)
+*/
+ssize_t xdpSockRecv(xdpSock *xsk, byte_t **frame) {
+	struct pollfd pfd;
+	int poll_retval;
+	uint32_t prod, cons;
+	struct xdp_desc *desc;
+
+	// Give the previously returned frame back to the kernel
+	if(xsk->rx_held) {
+		prod=*(xsk->fill.producer);
+		((uint64_t *) xsk->fill.desc)[prod & xsk->fill.mask]=xsk->rx_addr;
+		__atomic_store_n(xsk->fill.producer,prod+1,__ATOMIC_RELEASE);
+		xsk->rx_held=0;
+	}
+
+	cons=*(xsk->rx.consumer);
+
+	// Wait for a new frame
+	while(__atomic_load_n(xsk->rx.producer,__ATOMIC_ACQUIRE)==cons) {
+		pfd.fd=xsk->descriptor;
+		pfd.events=POLLIN;
+		pfd.revents=0;
+
+		poll_retval=poll(&pfd,1,xsk->timeout_ms);
+
+		if(poll_retval==0) {
+			errno=EAGAIN;
+			return -1;
+		} else if(poll_retval<0 && errno!=EINTR) {
+			return -1;
+		}
+	}
+
+	desc=&(((struct xdp_desc *) xsk->rx.desc)[cons & xsk->rx.mask]);
+
+	*frame=xsk->umem+desc->addr;
+	// The fill ring expects the beginning of each frame
+	xsk->rx_addr=desc->addr-desc->addr%XDP_SOCK_FRAME_SIZE;
+	xsk->rx_held=1;
+
+	__atomic_store_n(xsk->rx.consumer,cons+1,__ATOMIC_RELEASE);
+
+	return (ssize_t) desc->len;
+}
+
+/* Copy a frame into a free TX frame of the UMEM and send it immediately.
+Return values:
+0: ok
+<0: error (see the XDPSOCK_E* macros in xdp_sock.h)
+*/
+int xdpSockSend(xdpSock *xsk, byte_t *frame, size_t len) {
+	struct pollfd pfd;
+	struct xdp_desc *desc;
+	uint32_t prod;
+	uint64_t addr;
+
+	if(len>XDP_SOCK_FRAME_SIZE) {
+		return XDPSOCK_ETOOBIG;
+	}
+
+	xdpSockReapCompletions(xsk);
+
+	// Wait for a TX frame to be released, in case all of them are still owned by the kernel
+	for(int i=0;xsk->tx_free_nr==0 && i<XDP_SOCK_TX_WAIT_TIMEOUT;i++) {
+		if(xdpSockKick(xsk)<0) {
+			return XDPSOCK_ESEND;
+		}
+
+		pfd.fd=xsk->descriptor;
+		pfd.events=POLLOUT;
+		pfd.revents=0;
+		poll(&pfd,1,1);
+
+		xdpSockReapCompletions(xsk);
+	}
+
+	if(xsk->tx_free_nr==0) {
+		return XDPSOCK_EFULL;
+	}
+
+	addr=xsk->tx_free[--xsk->tx_free_nr];
+	memcpy(xsk->umem+addr,frame,len);
+
+	// As the number of TX frames is not larger than the TX ring size, a free TX frame always implies a free TX ring slot
+	prod=*(xsk->tx.producer);
+	desc=&(((struct xdp_desc *) xsk->tx.desc)[prod & xsk->tx.mask]);
+	desc->addr=addr;
+	desc->len=len;
+	desc->options=0;
+	__atomic_store_n(xsk->tx.producer,prod+1,__ATOMIC_RELEASE);
+
+	if(xdpSockKick(xsk)<0) {
+		return XDPSOCK_ESEND;
+	}
+
+	return 0;
+}
+
+// Detach the XDP program and release the socket, its rings and the UMEM: after this call, all the frames directed to the LaMP port
+// are received again by the AF_PACKET socket. Calling this function on an already destroyed socket has no effect.
+void xdpSockDestroy(xdpSock *xsk) {
+	if(xsk->link_fd>=0) {
+		close(xsk->link_fd);
+		xsk->link_fd=-1;
+	}
+
+	if(xsk->prog_fd>=0) {
+		close(xsk->prog_fd);
+		xsk->prog_fd=-1;
+	}
+
+	if(xsk->map_fd>=0) {
+		close(xsk->map_fd);
+		xsk->map_fd=-1;
+	}
+
+	if(xsk->descriptor>=0) {
+		xdpSockRingUnmap(&(xsk->fill));
+		xdpSockRingUnmap(&(xsk->comp));
+		xdpSockRingUnmap(&(xsk->rx));
+		xdpSockRingUnmap(&(xsk->tx));
+
+		close(xsk->descriptor);
+		xsk->descriptor=-1;
+	}
+
+	if(xsk->umem!=MAP_FAILED) {
+		munmap(xsk->umem,xsk->umem_size);
+		xsk->umem=MAP_FAILED;
+	}
+
+	xsk->rx_held=0;
+	xsk->tx_free_nr=0;
+}
+
+/* Generate and load the XDP program replying, with XDP_TX, to the ping-like requests directed to 'dstIP':'port' and belonging
+to a session stored inside 'map_fd'. The program is equivalent to:
+	if(frame is not IPv4/UDP, not fragmented, without IP options, directed to dstIP:port)
+		return XDP_PASS;
+	if(lamp->reserved/ctrl == PINGLIKE_REQ) { delta = reqDelta; word = replyWord; }
+	else if(lamp->reserved/ctrl == PINGLIKE_REQ_TLESS) { delta = reqTlessDelta; word = replyTlessWord; }
+	else return XDP_PASS;
+	if(!(counter = bpf_map_lookup_elem(&sessions, &lamp->id))) return XDP_PASS;
+	__sync_fetch_and_add(counter, 1);
+	swap(eth->h_source, eth->h_dest); swap(ip->saddr, ip->daddr); swap(udp->source, udp->dest);
+	lamp->reserved/ctrl = word;
+	if(udp->check != 0) udp->check = incremental update of udp->check, adding 'delta' (RFC 1624);
+	return XDP_TX;
+The IP checksum and the UDP pseudo-header sum do not change when the addresses and ports are swapped: only the LaMP ctrl field
+contributes to the UDP checksum update. The 16 bit words including the LaMP reserved and ctrl fields ('reserved' and 'ctrl' are
+contiguous) are passed as they are loaded from the frame, while the deltas are computed in user space, in network byte order,
+as ~m + m' (with m and m' being, respectively, the request and reply words).
+Return values:
+>=0: program file descriptor
+-1: error
+*/
+static int xdpReflectProgLoad(int map_fd, struct in_addr dstIP, uint16_t port, uint16_t reqWord, uint16_t reqTlessWord, uint16_t replyWord, uint16_t replyTlessWord) {
+	struct bpf_insn prog[XDP_PROG_MAX_LEN];
+	unsigned int len=0;
+	int err=0;
+	uint32_t reqDelta=(uint16_t) ~ntohs(reqWord)+ntohs(replyWord);
+	uint32_t reqTlessDelta=(uint16_t) ~ntohs(reqTlessWord)+ntohs(replyTlessWord);
+
+	memset(prog,0,sizeof(prog));
+
+	// r2 = data, r3 = data_end
+	err|=xdpEmit(prog,&len,BPF_LDX | BPF_MEM | BPF_W,BPF_REG_2,BPF_REG_1,offsetof(struct xdp_md,data),0);
+	err|=xdpEmit(prog,&len,BPF_LDX | BPF_MEM | BPF_W,BPF_REG_3,BPF_REG_1,offsetof(struct xdp_md,data_end),0);
+
+	err|=xdpEmitUdpMatch(prog,&len,dstIP,port,XDP_REFLECT_MIN_FRAME_LEN);
+
+	// r7 = data (r1-r5 are clobbered by the helper call), r8 = checksum delta, r9 = reply reserved/ctrl word
+	err|=xdpEmit(prog,&len,BPF_ALU64 | BPF_MOV | BPF_X,BPF_REG_7,BPF_REG_2,0,0);
+	err|=xdpEmit(prog,&len,BPF_LDX | BPF_MEM | BPF_H,BPF_REG_5,BPF_REG_7,LAMP_OFF+offsetof(struct lamphdr,reserved),0);
+	err|=xdpEmit(prog,&len,BPF_JMP32 | BPF_JEQ | BPF_K,BPF_REG_5,0,4,reqWord);
+	err|=xdpEmit(prog,&len,BPF_JMP32 | BPF_JNE | BPF_K,BPF_REG_5,0,JUMP_TO_PASS,reqTlessWord);
+	err|=xdpEmit(prog,&len,BPF_ALU64 | BPF_MOV | BPF_K,BPF_REG_8,0,0,reqTlessDelta);
+	err|=xdpEmit(prog,&len,BPF_ALU64 | BPF_MOV | BPF_K,BPF_REG_9,0,0,replyTlessWord);
+	err|=xdpEmit(prog,&len,BPF_JMP | BPF_JA,0,0,2,0);
+	err|=xdpEmit(prog,&len,BPF_ALU64 | BPF_MOV | BPF_K,BPF_REG_8,0,0,reqDelta);
+	err|=xdpEmit(prog,&len,BPF_ALU64 | BPF_MOV | BPF_K,BPF_REG_9,0,0,replyWord);
+
+	// Session lookup: the id is copied on the stack, as the helpers cannot take a key pointing inside the frame
+	err|=xdpEmit(prog,&len,BPF_LDX | BPF_MEM | BPF_H,BPF_REG_4,BPF_REG_7,LAMP_OFF+offsetof(struct lamphdr,id),0);
+	err|=xdpEmit(prog,&len,BPF_STX | BPF_MEM | BPF_H,BPF_REG_10,BPF_REG_4,-8,0);
+	err|=xdpEmit(prog,&len,BPF_ALU64 | BPF_MOV | BPF_X,BPF_REG_2,BPF_REG_10,0,0);
+	err|=xdpEmit(prog,&len,BPF_ALU64 | BPF_ADD | BPF_K,BPF_REG_2,0,0,-8);
+	err|=xdpEmit(prog,&len,BPF_LD | BPF_DW | BPF_IMM,BPF_REG_1,BPF_PSEUDO_MAP_FD,0,map_fd);
+	err|=xdpEmit(prog,&len,0,0,0,0,0);
+	err|=xdpEmit(prog,&len,BPF_JMP | BPF_CALL,0,0,0,BPF_FUNC_map_lookup_elem);
+	err|=xdpEmit(prog,&len,BPF_JMP | BPF_JEQ | BPF_K,BPF_REG_0,0,JUMP_TO_PASS,0);
+
+	// Count the reflected request
+	err|=xdpEmit(prog,&len,BPF_ALU64 | BPF_MOV | BPF_K,BPF_REG_1,0,0,1);
+	err|=xdpEmit(prog,&len,BPF_STX | BPF_XADD | BPF_DW,BPF_REG_0,BPF_REG_1,0,0);
+
+	// Swap the MAC addresses (6 bytes each, moved as a 32 bit and a 16 bit word)
+	err|=xdpEmit(prog,&len,BPF_LDX | BPF_MEM | BPF_W,BPF_REG_1,BPF_REG_7,0,0);
+	err|=xdpEmit(prog,&len,BPF_LDX | BPF_MEM | BPF_H,BPF_REG_2,BPF_REG_7,4,0);
+	err|=xdpEmit(prog,&len,BPF_LDX | BPF_MEM | BPF_W,BPF_REG_3,BPF_REG_7,ETHER_ADDR_LEN,0);
+	err|=xdpEmit(prog,&len,BPF_LDX | BPF_MEM | BPF_H,BPF_REG_4,BPF_REG_7,ETHER_ADDR_LEN+4,0);
+	err|=xdpEmit(prog,&len,BPF_STX | BPF_MEM | BPF_W,BPF_REG_7,BPF_REG_3,0,0);
+	err|=xdpEmit(prog,&len,BPF_STX | BPF_MEM | BPF_H,BPF_REG_7,BPF_REG_4,4,0);
+	err|=xdpEmit(prog,&len,BPF_STX | BPF_MEM | BPF_W,BPF_REG_7,BPF_REG_1,ETHER_ADDR_LEN,0);
+	err|=xdpEmit(prog,&len,BPF_STX | BPF_MEM | BPF_H,BPF_REG_7,BPF_REG_2,ETHER_ADDR_LEN+4,0);
+
+	// Swap the IP addresses and the UDP ports
+	err|=xdpEmit(prog,&len,BPF_LDX | BPF_MEM | BPF_W,BPF_REG_1,BPF_REG_7,IP_SADDR_OFF,0);
+	err|=xdpEmit(prog,&len,BPF_LDX | BPF_MEM | BPF_W,BPF_REG_2,BPF_REG_7,IP_DADDR_OFF,0);
+	err|=xdpEmit(prog,&len,BPF_STX | BPF_MEM | BPF_W,BPF_REG_7,BPF_REG_2,IP_SADDR_OFF,0);
+	err|=xdpEmit(prog,&len,BPF_STX | BPF_MEM | BPF_W,BPF_REG_7,BPF_REG_1,IP_DADDR_OFF,0);
+	err|=xdpEmit(prog,&len,BPF_LDX | BPF_MEM | BPF_H,BPF_REG_1,BPF_REG_7,UDP_SPORT_OFF,0);
+	err|=xdpEmit(prog,&len,BPF_LDX | BPF_MEM | BPF_H,BPF_REG_2,BPF_REG_7,UDP_DPORT_OFF,0);
+	err|=xdpEmit(prog,&len,BPF_STX | BPF_MEM | BPF_H,BPF_REG_7,BPF_REG_2,UDP_SPORT_OFF,0);
+	err|=xdpEmit(prog,&len,BPF_STX | BPF_MEM | BPF_H,BPF_REG_7,BPF_REG_1,UDP_DPORT_OFF,0);
+
+	// Set the reply ctrl field
+	err|=xdpEmit(prog,&len,BPF_STX | BPF_MEM | BPF_H,BPF_REG_7,BPF_REG_9,LAMP_OFF+offsetof(struct lamphdr,reserved),0);
+
+	// Incremental UDP checksum update (a zero checksum means that no checksum was computed by the client: leave it as it is)
+	err|=xdpEmit(prog,&len,BPF_LDX | BPF_MEM | BPF_H,BPF_REG_1,BPF_REG_7,UDP_CHECK_OFF,0);
+	err|=xdpEmit(prog,&len,BPF_JMP32 | BPF_JEQ | BPF_K,BPF_REG_1,0,16,0);
+	err|=xdpEmit(prog,&len,BPF_ALU | BPF_END | BPF_TO_BE,BPF_REG_1,0,0,16);
+	err|=xdpEmit(prog,&len,BPF_ALU64 | BPF_XOR | BPF_K,BPF_REG_1,0,0,0xFFFF);
+	err|=xdpEmit(prog,&len,BPF_ALU64 | BPF_ADD | BPF_X,BPF_REG_1,BPF_REG_8,0,0);
+	for(int i=0;i<2;i++) {
+		// Fold the carries
+		err|=xdpEmit(prog,&len,BPF_ALU64 | BPF_MOV | BPF_X,BPF_REG_2,BPF_REG_1,0,0);
+		err|=xdpEmit(prog,&len,BPF_ALU64 | BPF_RSH | BPF_K,BPF_REG_2,0,0,16);
+		err|=xdpEmit(prog,&len,BPF_ALU64 | BPF_AND | BPF_K,BPF_REG_1,0,0,0xFFFF);
+		err|=xdpEmit(prog,&len,BPF_ALU64 | BPF_ADD | BPF_X,BPF_REG_1,BPF_REG_2,0,0);
+	}
+	err|=xdpEmit(prog,&len,BPF_ALU64 | BPF_XOR | BPF_K,BPF_REG_1,0,0,0xFFFF);
+	// A computed checksum equal to 0 must be transmitted as 0xFFFF (RFC 768)
+	err|=xdpEmit(prog,&len,BPF_JMP32 | BPF_JNE | BPF_K,BPF_REG_1,0,1,0);
+	err|=xdpEmit(prog,&len,BPF_ALU64 | BPF_MOV | BPF_K,BPF_REG_1,0,0,0xFFFF);
+	err|=xdpEmit(prog,&len,BPF_ALU | BPF_END | BPF_TO_BE,BPF_REG_1,0,0,16);
+	err|=xdpEmit(prog,&len,BPF_STX | BPF_MEM | BPF_H,BPF_REG_7,BPF_REG_1,UDP_CHECK_OFF,0);
+
+	// return XDP_TX
+	err|=xdpEmit(prog,&len,BPF_ALU64 | BPF_MOV | BPF_K,BPF_REG_0,0,0,XDP_TX);
+	err|=xdpEmit(prog,&len,BPF_JMP | BPF_EXIT,0,0,0,0);
+
+	// "pass": return XDP_PASS
+	err|=xdpEmit(prog,&len,BPF_ALU64 | BPF_MOV | BPF_K,BPF_REG_0,0,0,XDP_PASS);
+	err|=xdpEmit(prog,&len,BPF_JMP | BPF_EXIT,0,0,0,0);
+
+	if(err) {
+		return -1;
+	}
+
+	return xdpProgFinalizeLoad(prog,len);
+}
+
+/* Attach (in generic mode) to the interface 'ifindex' the XDP program replying to the ping-like requests directed to
+'dstIP':'port' ('port' in host byte order) and belonging to the session 'session_id'.
+The LaMP reserved and ctrl fields and the session id are matched as they are written by lampHeadPopulate().
+Return values:
+0: ok
+<0: error (see the XDPREFLECT_E* macros in xdp_sock.h)
+*/
+int xdpReflectorCreate(xdpReflector *xrf, int ifindex, struct in_addr dstIP, uint16_t port, uint16_t session_id) {
+	struct rlimit memlock={RLIM_INFINITY,RLIM_INFINITY};
+	union bpf_attr attr;
+	struct lamphdr lampHeader;
+	uint16_t key;
+	uint64_t count=0;
+	uint16_t reqWord, reqTlessWord, replyWord, replyTlessWord;
+	int err=0;
+
+	xrf->map_fd=-1;
+	xrf->prog_fd=-1;
+	xrf->link_fd=-1;
+
+	// Get the LaMP reserved/ctrl words and the session id, as they are stored inside the packets
+	lampHeadPopulate(&lampHeader, CTRL_PINGLIKE_REQ, session_id, 0);
+	memcpy(&reqWord,(byte_t *) &lampHeader+offsetof(struct lamphdr,reserved),sizeof(reqWord));
+	memcpy(&key,(byte_t *) &lampHeader+offsetof(struct lamphdr,id),sizeof(key));
+	lampHeadPopulate(&lampHeader, CTRL_PINGLIKE_REQ_TLESS, session_id, 0);
+	memcpy(&reqTlessWord,(byte_t *) &lampHeader+offsetof(struct lamphdr,reserved),sizeof(reqTlessWord));
+	lampHeadPopulate(&lampHeader, CTRL_PINGLIKE_REPLY, session_id, 0);
+	memcpy(&replyWord,(byte_t *) &lampHeader+offsetof(struct lamphdr,reserved),sizeof(replyWord));
+	lampHeadPopulate(&lampHeader, CTRL_PINGLIKE_REPLY_TLESS, session_id, 0);
+	memcpy(&replyTlessWord,(byte_t *) &lampHeader+offsetof(struct lamphdr,reserved),sizeof(replyTlessWord));
+
+	// Kernels older than 5.11 account the BPF maps against RLIMIT_MEMLOCK: try to remove the limit (failures are not fatal)
+	setrlimit(RLIMIT_MEMLOCK,&memlock);
+
+	// Create the session map and store the current session, with a zero counter
+	memset(&attr,0,sizeof(attr));
+	attr.map_type=BPF_MAP_TYPE_HASH;
+	attr.key_size=sizeof(uint16_t);
+	attr.value_size=sizeof(uint64_t);
+	attr.max_entries=XDP_REFLECT_MAX_SESSIONS;
+
+	xrf->map_fd=bpfSyscall(BPF_MAP_CREATE,&attr);
+	if(xrf->map_fd<0) {
+		err=XDPREFLECT_EMAP;
+		goto xdpreflect_create_error;
+	}
+
+	memset(&attr,0,sizeof(attr));
+	attr.map_fd=xrf->map_fd;
+	attr.key=(uint64_t) (uintptr_t) &key;
+	attr.value=(uint64_t) (uintptr_t) &count;
+	attr.flags=BPF_ANY;
+
+	if(bpfSyscall(BPF_MAP_UPDATE_ELEM,&attr)<0) {
+		err=XDPREFLECT_EMAP;
+		goto xdpreflect_create_error;
+	}
+
+	xrf->prog_fd=xdpReflectProgLoad(xrf->map_fd,dstIP,port,reqWord,reqTlessWord,replyWord,replyTlessWord);
+	if(xrf->prog_fd<0) {
+		err=XDPREFLECT_EPROG;
+		goto xdpreflect_create_error;
+	}
+
+	xrf->link_fd=xdpProgAttach(xrf->prog_fd,ifindex);
+	if(xrf->link_fd<0) {
+		err=XDPREFLECT_EATTACH;
+		goto xdpreflect_create_error;
+	}
+
+	return 0;
+
+xdpreflect_create_error:
+	xdpReflectorDestroy(xrf);
+	return err;
+}
+
+// Get the number of requests of the session 'session_id' which have been reflected so far (0 if the session is not in the map)
+uint64_t xdpReflectorGetCount(xdpReflector *xrf, uint16_t session_id) {
+	union bpf_attr attr;
+	struct lamphdr lampHeader;
+	uint16_t key;
+	uint64_t count=0;
+
+	if(xrf->map_fd<0) {
+		return 0;
+	}
+
+	lampHeadPopulate(&lampHeader, CTRL_PINGLIKE_REQ, session_id, 0);
+	memcpy(&key,(byte_t *) &lampHeader+offsetof(struct lamphdr,id),sizeof(key));
+
+	memset(&attr,0,sizeof(attr));
+	attr.map_fd=xrf->map_fd;
+	attr.key=(uint64_t) (uintptr_t) &key;
+	attr.value=(uint64_t) (uintptr_t) &count;
+
+	if(bpfSyscall(BPF_MAP_LOOKUP_ELEM,&attr)<0) {
+		return 0;
+	}
+
+	return count;
+}
+
+// Detach the reflector program and release the session map: after this call, all the ping-like requests are received again by
+// the AF_PACKET socket.
+void xdpReflectorDestroy(xdpReflector *xrf) {
+	if(xrf->link_fd>=0) {
+		close(xrf->link_fd);
+		xrf->link_fd=-1;
+	}
+
+	if(xrf->prog_fd>=0) {
+		close(xrf->prog_fd);
+		xrf->prog_fd=-1;
+	}
+
+	if(xrf->map_fd>=0) {
+		close(xrf->map_fd);
+		xrf->map_fd=-1;
+	}
+}
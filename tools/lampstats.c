@@ -0,0 +1,231 @@
+/* lampstats: print the live statistics published by a running LaTe client or server with --shm-stats, once or periodically.
+The shared memory page is only read: polling it, even hundreds of times per second, has no effect on the test. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <signal.h>
+#include "stats_page.h"
+
+#define LAMPSTATS_MILLISEC_TO_NANOSEC 1000000
+#define LAMPSTATS_SEC_TO_NANOSEC 1000000000
+
+// Default polling interval (-i), in ms
+#define LAMPSTATS_DEF_INTERVAL_MS 1000
+
+static const char *latencyTypes[]={"Unknown","User-to-user","KRT","Software (kernel) timestamps","Hardware timestamps"};
+static const char *states[]={"idle","running","finished","error"};
+static const double percentileValues[STATSPAGE_PERCENTILES_NUMBER]={50.0,90.0,99.0,99.9,99.99};
+
+static void print_usage(const char *progname) {
+	fprintf(stderr,"Usage: %s [-i <interval in ms>] [-n <count>] [-c] <name>\n"
+		"Print the live statistics published by a running LaTe client or server with '--shm-stats <name>'.\n"
+		"  -i: polling interval (default: %d ms).\n"
+		"  -n: number of snapshots to print (default: 1, or 0, i.e. until the publishing process terminates, with -i).\n"
+		"  -c: print the snapshots as CSV lines (with a header line).\n",
+		progname,LAMPSTATS_DEF_INTERVAL_MS);
+}
+
+// Percentiles of the session: the final ones computed by the program, if available, otherwise the ones of the histogram of the page
+static void sessionPercentiles(statsPageSession *session, uint64_t *percentiles) {
+	for(int i=0;i<STATSPAGE_PERCENTILES_NUMBER;i++) {
+		if(session->percentiles[0]!=0 || session->hist.total==0) {
+			percentiles[i]=session->percentiles[i];
+		} else {
+			percentiles[i]=hdrHistValueAtPercentile(&session->hist,percentileValues[i]);
+
+			// Keep the percentiles inside the actual [min,max] range, as reportStructureFinalize() does
+			if(percentiles[i]<session->min_latency) {
+				percentiles[i]=session->min_latency;
+			} else if(percentiles[i]>session->max_latency) {
+				percentiles[i]=session->max_latency;
+			}
+		}
+	}
+}
+
+static const char *stateName(uint8_t state) {
+	return state<sizeof(states)/sizeof(states[0]) ? states[state] : "unknown";
+}
+
+static void printSnapshot(const statsPageReader *reader, statsPageSession *session, FILE *stream) {
+	uint64_t percentiles[STATSPAGE_PERCENTILES_NUMBER];
+	uint64_t now_ns;
+	struct timespec now;
+
+	fprintf(stream,"LaTe %s (pid %" PRId32 ") - session %" PRIu64,reader->page->role==STATSPAGE_ROLE_SERVER ? "server" : "client",
+		reader->page->pid,session->session_index);
+
+	if(session->state==STATSPAGE_STATE_IDLE) {
+		fprintf(stream,": idle\n");
+		return;
+	}
+
+	clock_gettime(CLOCK_REALTIME,&now);
+	now_ns=session->end_realtime_ns!=0 ? session->end_realtime_ns : (uint64_t) now.tv_sec*LAMPSTATS_SEC_TO_NANOSEC+now.tv_nsec;
+
+	fprintf(stream," (LaMP id %" PRIu16 "): %s, %.3f s, %" PRIu64 " updates\n",session->lamp_id,stateName(session->state),
+		now_ns>session->start_realtime_ns ? ((double) (now_ns-session->start_realtime_ns))/LAMPSTATS_SEC_TO_NANOSEC : 0,session->updates);
+
+	fprintf(stream,"\tPackets: %" PRIu64 "/%" PRIu64 " received, %" PRIu64 " lost (%" PRIu64 " bursts, max %" PRIu64 "), %" PRIu64 " errors, "
+		"%" PRIu64 " out of order, %" PRIu64 " reordered, %" PRIu64 " duplicates\n",
+		session->packet_count,session->total_packets,session->loss_count,session->loss_burst_count,session->max_loss_burst_length,
+		session->errors_count,session->out_of_order_count,session->reordered_count,session->duplicate_count);
+
+	if(session->packet_count>session->errors_count) {
+		sessionPercentiles(session,percentiles);
+
+		fprintf(stream,"\t%s%s min/avg/max/stdev: %.3f/%.3f/%.3f/%.3f ms - p50/p90/p99/p99.9/p99.99: %.3f/%.3f/%.3f/%.3f/%.3f ms",
+			session->latency_type<sizeof(latencyTypes)/sizeof(latencyTypes[0]) ? latencyTypes[session->latency_type] : "Unknown",
+			session->followup ? " (follow-up)" : "",
+			((double) session->min_latency)/LAMPSTATS_MILLISEC_TO_NANOSEC,session->average_latency/LAMPSTATS_MILLISEC_TO_NANOSEC,
+			((double) session->max_latency)/LAMPSTATS_MILLISEC_TO_NANOSEC,sqrt(session->variance)/LAMPSTATS_MILLISEC_TO_NANOSEC,
+			((double) percentiles[0])/LAMPSTATS_MILLISEC_TO_NANOSEC,((double) percentiles[1])/LAMPSTATS_MILLISEC_TO_NANOSEC,
+			((double) percentiles[2])/LAMPSTATS_MILLISEC_TO_NANOSEC,((double) percentiles[3])/LAMPSTATS_MILLISEC_TO_NANOSEC,
+			((double) percentiles[4])/LAMPSTATS_MILLISEC_TO_NANOSEC);
+
+		if(session->jitter>=0) {
+			fprintf(stream," - jitter %.3f ms",session->jitter/LAMPSTATS_MILLISEC_TO_NANOSEC);
+		}
+
+		fprintf(stream,"\n");
+	}
+}
+
+static void printSnapshotCSV(const statsPageReader *reader, statsPageSession *session, FILE *stream) {
+	uint64_t percentiles[STATSPAGE_PERCENTILES_NUMBER];
+	struct timespec now;
+
+	clock_gettime(CLOCK_REALTIME,&now);
+
+	fprintf(stream,"%" PRIu64 ".%09ld,%" PRId32 ",%" PRIu64 ",%" PRIu16 ",%s,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ","
+		"%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",",
+		(uint64_t) now.tv_sec,now.tv_nsec,reader->page->pid,session->session_index,session->lamp_id,stateName(session->state),session->updates,
+		session->total_packets,session->packet_count,session->loss_count,session->errors_count,session->out_of_order_count,
+		session->reordered_count,session->duplicate_count,session->loss_burst_count,session->max_loss_burst_length);
+
+	if(session->packet_count>session->errors_count) {
+		sessionPercentiles(session,percentiles);
+
+		fprintf(stream,"%.6f,%.6f,%.6f,%.6f",
+			((double) session->min_latency)/LAMPSTATS_MILLISEC_TO_NANOSEC,session->average_latency/LAMPSTATS_MILLISEC_TO_NANOSEC,
+			((double) session->max_latency)/LAMPSTATS_MILLISEC_TO_NANOSEC,sqrt(session->variance)/LAMPSTATS_MILLISEC_TO_NANOSEC);
+
+		for(int i=0;i<STATSPAGE_PERCENTILES_NUMBER;i++) {
+			fprintf(stream,",%.6f",((double) percentiles[i])/LAMPSTATS_MILLISEC_TO_NANOSEC);
+		}
+	} else {
+		fprintf(stream,",,,,,,,,");
+	}
+
+	if(session->jitter>=0) {
+		fprintf(stream,",%.6f\n",session->jitter/LAMPSTATS_MILLISEC_TO_NANOSEC);
+	} else {
+		fprintf(stream,",\n");
+	}
+}
+
+int main(int argc, char **argv) {
+	statsPageReader reader;
+	statsPageSession session;
+	struct timespec interval={.tv_sec=LAMPSTATS_DEF_INTERVAL_MS/1000,.tv_nsec=(LAMPSTATS_DEF_INTERVAL_MS%1000)*LAMPSTATS_MILLISEC_TO_NANOSEC};
+	unsigned long long count=1, value;
+	int count_set=0, interval_set=0, csv=0;
+	char *sPtr;
+	int opt;
+	int ret;
+
+	while((opt=getopt(argc,argv,"i:n:ch"))!=-1) {
+		switch(opt) {
+			case 'i':
+				errno=0;
+				value=strtoull(optarg,&sPtr,10);
+				if(errno || sPtr==optarg || *sPtr!='\0' || value==0) {
+					fprintf(stderr,"Error: invalid polling interval: %s.\n",optarg);
+					exit(EXIT_FAILURE);
+				}
+				interval.tv_sec=value/1000;
+				interval.tv_nsec=(value%1000)*LAMPSTATS_MILLISEC_TO_NANOSEC;
+				interval_set=1;
+				break;
+
+			case 'n':
+				errno=0;
+				count=strtoull(optarg,&sPtr,10);
+				if(errno || sPtr==optarg || *sPtr!='\0') {
+					fprintf(stderr,"Error: invalid number of snapshots: %s.\n",optarg);
+					exit(EXIT_FAILURE);
+				}
+				count_set=1;
+				break;
+
+			case 'c':
+				csv=1;
+				break;
+
+			default:
+				print_usage(argv[0]);
+				exit(opt=='h' ? EXIT_SUCCESS : EXIT_FAILURE);
+		}
+	}
+
+	if(optind!=argc-1) {
+		print_usage(argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	// With -i only, poll until the publishing process terminates
+	if(interval_set && !count_set) {
+		count=0;
+	}
+
+	ret=statsPageAttach(&reader,argv[optind]);
+	if(ret<0) {
+		if(ret==STATSPAGE_EFORMAT) {
+			fprintf(stderr,"Error: %s is not a supported LaTe statistics page.\n",argv[optind]);
+		} else if(ret==STATSPAGE_ENAME) {
+			fprintf(stderr,"Error: invalid shared memory segment name: %s.\n",argv[optind]);
+		} else {
+			fprintf(stderr,"Error: cannot open the shared memory segment %s: %s.\n",argv[optind],strerror(errno));
+		}
+		exit(EXIT_FAILURE);
+	}
+
+	if(csv) {
+		fprintf(stdout,"Timestamp-s,Pid,Session,LaMPid,State,Updates,TotalPackets,Packets,LostPackets,ErrorsCount,OutOfOrder,Reordered,Duplicates,"
+			"LossBursts,MaxLossBurst,MinLatency-ms,AvgLatency-ms,MaxLatency-ms,StDev-ms,P50-ms,P90-ms,P99-ms,P99.9-ms,P99.99-ms,Jitter-ms\n");
+	}
+
+	for(unsigned long long i=0;count==0 || i<count;i++) {
+		if(i>0) {
+			nanosleep(&interval,NULL);
+		}
+
+		if(statsPageSnapshot(&reader,&session)<0) {
+			fprintf(stderr,"Warning: no consistent snapshot could be taken: the page is being updated continuously, or its writer died while updating it.\n");
+		} else if(csv) {
+			printSnapshotCSV(&reader,&session,stdout);
+		} else {
+			printSnapshot(&reader,&session,stdout);
+		}
+
+		fflush(stdout);
+
+		// The page of a terminated process is not updated anymore (and it may have been removed already)
+		if(kill(reader.page->pid,0)<0 && errno==ESRCH) {
+			if(count!=1) {
+				fprintf(stderr,"The publishing process (pid %" PRId32 ") is not running anymore.\n",reader.page->pid);
+			}
+			break;
+		}
+	}
+
+	statsPageDetach(&reader);
+
+	return 0;
+}
@@ -0,0 +1,874 @@
+/* lamptrace-analyze: compute the full statistics of one or more binary per-packet traces, written by the LaTe client with --trace,
+both for each trace and for all of them merged together (e.g. several runs of the same test).
+Unlike the online statistics of the client (see report_manager.c), the percentiles and the CDF are exact, as all the latency
+values are kept and sorted, and the reordering, duplicate and loss burst statistics are not limited by any receive window.
+The traces are mapped in memory and analyzed by a pool of threads, each one taking the next trace which has not been analyzed yet. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include "trace_file.h"
+
+#define ANALYZE_MILLISEC_TO_NANOSEC 1000000
+#define ANALYZE_SEC_TO_NANOSEC 1000000000
+
+// Default number of points of the CDF (-c)
+#define ANALYZE_DEF_CDF_POINTS 1000
+
+// Percentiles computed for each trace, for each window and for the merged data set
+#define ANALYZE_NUM_PERCENTILES 5
+static const double percentileValues[ANALYZE_NUM_PERCENTILES]={0.50,0.90,0.99,0.999,0.9999};
+
+// Statistics of a window of a trace (-w)
+typedef struct windowStats {
+	uint64_t expected; // Number of sequence numbers inside the window (the last window may be shorter)
+	uint64_t received; // Packets received at least once
+	uint64_t errors;
+	uint64_t count; // Number of latency values (= received-errors)
+	uint64_t min, max;
+	double mean, m2;
+	double jitter; // RFC 3550 jitter, restarted at the beginning of each window (< 0 = not available)
+	uint64_t lastTripTime;
+	uint64_t percentiles[ANALYZE_NUM_PERCENTILES];
+} windowStats;
+
+// Statistics of a single trace
+typedef struct runStats {
+	const char *filename;
+	int error; // traceFileMap() error (0 = ok)
+	uint8_t followup;
+	uint8_t mode_ub; // TRACE_MODE_* (TRACE_MODE_UNSET, in the merged data set, when the traces have been written in different modes)
+	uint64_t interval_ns;
+	uint64_t burst_size; // Packets sent for each interval (at least 1)
+
+	uint64_t records; // Records stored inside the trace (including duplicates)
+	uint64_t expected; // Packets which should have been received (requested packets, or highest sequence number + 1, if larger)
+	uint64_t received; // Packets received at least once
+	uint64_t duplicates;
+	uint64_t reordered; // RFC 4737 reordered packets (sequence number lower than the highest one received so far)
+	uint64_t errors; // Packets with timestamping errors
+	uint64_t lossBurstCount;
+	uint64_t maxLossBurst;
+
+	// Latency/RTT statistics (the duplicates are not taken into account)
+	uint64_t count; // Number of latency values (= received-errors)
+	uint64_t min, max;
+	double mean, m2; // Welford's online algorithm
+	double jitter; // RFC 3550 jitter (< 0 = not available)
+	uint64_t percentiles[ANALYZE_NUM_PERCENTILES];
+
+	uint64_t *latencies; // All the latency values, sorted (freed after the merge)
+
+	windowStats *windows; // -w only
+	uint64_t windowCount;
+} runStats;
+
+// Data shared by the worker threads
+typedef struct analyzeJob {
+	runStats *runs;
+	unsigned int runCount;
+	unsigned int nextRun; // Index of the next trace to be analyzed (atomic)
+	uint64_t windowPackets; // Packets of each window, for the time series (0 = no time series)
+	uint64_t window_ns; // Window duration, when specified as a time (converted into packets with the interval of each trace)
+} analyzeJob;
+
+static void print_usage(const char *progname) {
+	fprintf(stderr,"Usage: %s [-j <threads>] [-o <summary CSV>] [-c <CDF CSV>] [-p <CDF points>] [-w <window>[s|ms|p] -W <windows CSV>]\n"
+		"\t<trace file> [<trace file> ...]\n"
+		"Compute the statistics of one or more LaTe binary traces (--trace), for each trace and for all of them merged together.\n"
+		"  -j: number of analysis threads (default: number of online CPUs).\n"
+		"  -o: write the statistics of each trace and of the merged data set ('ALL') to a CSV file too.\n"
+		"  -c: write the CDF of the latency (or RTT) of the merged data set to a CSV file.\n"
+		"  -p: number of points of the CDF (default: %d).\n"
+		"  -w: split each trace into windows of the specified duration, or of the specified number of packets ('p'), based on the\n"
+		"\t  sequence numbers (the duration is converted into packets with the interval and the burst size stored inside each\n"
+		"\t  trace, i.e. the nominal send times are used), and write their statistics to the CSV file specified with -W.\n",
+		progname,ANALYZE_DEF_CDF_POINTS);
+}
+
+static int compareU64(const void *a, const void *b) {
+	uint64_t va=*((const uint64_t *) a);
+	uint64_t vb=*((const uint64_t *) b);
+
+	return (va>vb)-(va<vb);
+}
+
+// Nearest-rank percentile of a sorted array
+static uint64_t sortedPercentile(const uint64_t *sorted, uint64_t count, double p) {
+	uint64_t rank=(uint64_t) ceil(p*count);
+
+	return sorted[rank>0 ? rank-1 : 0];
+}
+
+static void welfordUpdate(uint64_t *count, double *mean, double *m2, uint64_t value) {
+	double delta;
+
+	(*count)++;
+	delta=value-*mean;
+	*mean+=delta/(*count);
+	*m2+=delta*(value-*mean);
+}
+
+static void jitterUpdate(double *jitter, uint64_t *lastTripTime, uint64_t tripTime) {
+	if(*lastTripTime!=0) {
+		if(*jitter<0) {
+			*jitter=0;
+		}
+		*jitter+=(fabs((double) tripTime-(double) *lastTripTime)-*jitter)/16;
+	}
+
+	*lastTripTime=tripTime;
+}
+
+static void analyzeWindows(runStats *run, const traceFileReader *reader, uint8_t *seen, uint64_t windowPackets) {
+	uint64_t *offsets;
+	uint64_t *winLatencies;
+	uint64_t w, tripTime;
+	windowStats *win;
+
+	run->windowCount=(run->expected+windowPackets-1)/windowPackets;
+	run->windows=calloc(run->windowCount,sizeof(windowStats));
+	offsets=calloc(run->windowCount+1,sizeof(uint64_t));
+	winLatencies=malloc((run->count>0 ? run->count : 1)*sizeof(uint64_t));
+
+	if(run->windows==NULL || offsets==NULL || winLatencies==NULL) {
+		fprintf(stderr,"Warning: cannot allocate the windows of %s: no time series will be written for it.\n",run->filename);
+		free(run->windows);
+		run->windows=NULL;
+		run->windowCount=0;
+		free(offsets);
+		free(winLatencies);
+		return;
+	}
+
+	for(w=0;w<run->windowCount;w++) {
+		win=&(run->windows[w]);
+		win->expected=w==run->windowCount-1 ? run->expected-w*windowPackets : windowPackets;
+		win->min=UINT64_MAX;
+		win->jitter=-1.0;
+	}
+
+	// First pass, in arrival order: counters, mean, variance and jitter (the duplicates are skipped, as in the whole trace statistics)
+	// 'seen' is reused to detect the duplicates, clearing the bit of each packet when it is found for the first time
+	for(uint64_t i=0;i<reader->count;i++) {
+		w=reader->records[i].seq/windowPackets;
+		if((seen[reader->records[i].seq/8] & (1<<(reader->records[i].seq%8)))==0) {
+			continue;
+		}
+		seen[reader->records[i].seq/8]&=~(1<<(reader->records[i].seq%8));
+
+		win=&(run->windows[w]);
+		win->received++;
+
+		tripTime=traceRecordTripTime(&(reader->records[i]));
+		if(tripTime==0) {
+			win->errors++;
+			continue;
+		}
+
+		welfordUpdate(&(win->count),&(win->mean),&(win->m2),tripTime);
+		if(tripTime<win->min) {
+			win->min=tripTime;
+		}
+		if(tripTime>win->max) {
+			win->max=tripTime;
+		}
+		jitterUpdate(&(win->jitter),&(win->lastTripTime),tripTime);
+
+		offsets[w+1]++;
+	}
+
+	// Second pass: group the latency values by window (counting sort), then sort each window to get its exact percentiles
+	for(w=0;w<run->windowCount;w++) {
+		offsets[w+1]+=offsets[w];
+	}
+
+	for(uint64_t i=0;i<reader->count;i++) {
+		if((seen[reader->records[i].seq/8] & (1<<(reader->records[i].seq%8)))!=0) {
+			continue;
+		}
+		// Mark the packet again as seen, to skip its duplicates
+		seen[reader->records[i].seq/8]|=1<<(reader->records[i].seq%8);
+
+		tripTime=traceRecordTripTime(&(reader->records[i]));
+		if(tripTime!=0) {
+			winLatencies[offsets[reader->records[i].seq/windowPackets]++]=tripTime;
+		}
+	}
+
+	for(w=0;w<run->windowCount;w++) {
+		win=&(run->windows[w]);
+
+		if(win->count>0) {
+			// After the second pass, offsets[w] is the end of window w, i.e. the start of window w+1
+			qsort(winLatencies+offsets[w]-win->count,win->count,sizeof(uint64_t),compareU64);
+
+			for(int p=0;p<ANALYZE_NUM_PERCENTILES;p++) {
+				win->percentiles[p]=sortedPercentile(winLatencies+offsets[w]-win->count,win->count,percentileValues[p]);
+			}
+		}
+	}
+
+	free(offsets);
+	free(winLatencies);
+}
+
+static void analyzeRun(runStats *run, uint64_t windowPackets, uint64_t window_ns) {
+	traceFileReader reader;
+	uint8_t *seen;
+	uint64_t highestSeq=0;
+	uint64_t lastTripTime=0;
+	uint64_t tripTime, seq, burst;
+	uint8_t highestValid=0;
+
+	run->error=traceFileMap(&reader,run->filename);
+	if(run->error<0) {
+		return;
+	}
+
+	// The traces written before the mode and the burst size were stored inside the header are all ping-like ones, without bursts
+	run->followup=reader.header->followup;
+	run->mode_ub=reader.header->mode_ub!=TRACE_MODE_UNSET ? reader.header->mode_ub : TRACE_MODE_PINGLIKE;
+	run->interval_ns=reader.header->interval_ns;
+	run->burst_size=reader.header->burst_size>0 ? reader.header->burst_size : 1;
+	run->records=reader.count;
+	run->min=UINT64_MAX;
+	run->jitter=-1.0;
+
+	// Packets which should have been received: the requested ones, unless more packets have been received (e.g. the header was not written)
+	run->expected=reader.header->total_packets;
+	for(uint64_t i=0;i<reader.count;i++) {
+		if(reader.records[i].seq>=run->expected) {
+			run->expected=reader.records[i].seq+1;
+		}
+	}
+
+	seen=calloc(run->expected/8+1,sizeof(uint8_t));
+	run->latencies=malloc((reader.count>0 ? reader.count : 1)*sizeof(uint64_t));
+	if(seen==NULL || run->latencies==NULL) {
+		free(seen);
+		free(run->latencies);
+		run->latencies=NULL;
+		traceFileUnmap(&reader);
+		run->error=TRACEFILE_EALLOC;
+		return;
+	}
+
+	// The records are stored in arrival order: the jitter and the reordering statistics can be computed exactly
+	for(uint64_t i=0;i<reader.count;i++) {
+		seq=reader.records[i].seq;
+
+		if(seen[seq/8] & (1<<(seq%8))) {
+			run->duplicates++;
+			continue;
+		}
+		seen[seq/8]|=1<<(seq%8);
+		run->received++;
+
+		if(highestValid && seq<highestSeq) {
+			run->reordered++;
+		} else {
+			highestSeq=seq;
+			highestValid=1;
+		}
+
+		tripTime=traceRecordTripTime(&(reader.records[i]));
+		if(tripTime==0) {
+			run->errors++;
+			continue;
+		}
+
+		run->latencies[run->count]=tripTime;
+		welfordUpdate(&(run->count),&(run->mean),&(run->m2),tripTime);
+
+		if(tripTime<run->min) {
+			run->min=tripTime;
+		}
+		if(tripTime>run->max) {
+			run->max=tripTime;
+		}
+
+		jitterUpdate(&(run->jitter),&lastTripTime,tripTime);
+	}
+
+	// Loss bursts: runs of consecutive sequence numbers which have never been received (including the ones at the end of the test)
+	burst=0;
+	for(seq=0;seq<=run->expected;seq++) {
+		if(seq<run->expected && (seen[seq/8] & (1<<(seq%8)))==0) {
+			burst++;
+		} else if(burst>0) {
+			run->lossBurstCount++;
+			if(burst>run->maxLossBurst) {
+				run->maxLossBurst=burst;
+			}
+			burst=0;
+		}
+	}
+
+	qsort(run->latencies,run->count,sizeof(uint64_t),compareU64);
+	if(run->count>0) {
+		for(int p=0;p<ANALYZE_NUM_PERCENTILES;p++) {
+			run->percentiles[p]=sortedPercentile(run->latencies,run->count,percentileValues[p]);
+		}
+	}
+
+	// Time series: a duration is converted into a number of packets, with the interval and the burst size of the current trace
+	if(window_ns>0) {
+		windowPackets=run->interval_ns>0 ? (window_ns/run->interval_ns)*run->burst_size : 0;
+		if(windowPackets==0) {
+			windowPackets=1;
+		}
+	}
+
+	if(windowPackets>0 && run->expected>0) {
+		analyzeWindows(run,&reader,seen,windowPackets);
+	}
+
+	free(seen);
+	traceFileUnmap(&reader);
+}
+
+static void *analyzeWorker(void *arg) {
+	analyzeJob *job=(analyzeJob *) arg;
+	unsigned int idx;
+
+	while((idx=__atomic_fetch_add(&(job->nextRun),1,__ATOMIC_RELAXED))<job->runCount) {
+		analyzeRun(&(job->runs[idx]),job->windowPackets,job->window_ns);
+	}
+
+	pthread_exit(NULL);
+}
+
+// Heap entry of the k-way merge of the sorted latency arrays of all the traces
+typedef struct mergeHead {
+	uint64_t value;
+	unsigned int run;
+	uint64_t pos;
+} mergeHead;
+
+static void heapSiftDown(mergeHead *heap, unsigned int size, unsigned int i) {
+	unsigned int smallest, l, r;
+	mergeHead tmp;
+
+	while(1) {
+		smallest=i;
+		l=2*i+1;
+		r=2*i+2;
+
+		if(l<size && heap[l].value<heap[smallest].value) {
+			smallest=l;
+		}
+		if(r<size && heap[r].value<heap[smallest].value) {
+			smallest=r;
+		}
+		if(smallest==i) {
+			break;
+		}
+
+		tmp=heap[i];
+		heap[i]=heap[smallest];
+		heap[smallest]=tmp;
+		i=smallest;
+	}
+}
+
+/* Get the values with the given (1-based, increasing) ranks inside the merged data set, without building it: the sorted arrays of
+all the traces are merged on the fly, with a min-heap, stopping as soon as the highest rank is reached.
+Return values:
+0: ok
+-1: memory allocation error
+*/
+static int mergedRanks(runStats *runs, unsigned int runCount, const uint64_t *ranks, uint64_t *values, uint64_t rankCount) {
+	mergeHead *heap;
+	unsigned int size=0;
+	uint64_t current=0;
+	uint64_t r=0;
+	runStats *run;
+
+	heap=malloc((runCount>0 ? runCount : 1)*sizeof(mergeHead));
+	if(heap==NULL) {
+		return -1;
+	}
+
+	for(unsigned int i=0;i<runCount;i++) {
+		if(runs[i].error==0 && runs[i].count>0) {
+			heap[size].value=runs[i].latencies[0];
+			heap[size].run=i;
+			heap[size].pos=0;
+			size++;
+		}
+	}
+
+	for(int i=(int) size/2-1;i>=0;i--) {
+		heapSiftDown(heap,size,i);
+	}
+
+	while(size>0 && r<rankCount) {
+		current++;
+
+		while(r<rankCount && ranks[r]==current) {
+			values[r++]=heap[0].value;
+		}
+
+		run=&(runs[heap[0].run]);
+		heap[0].pos++;
+
+		if(heap[0].pos<run->count) {
+			heap[0].value=run->latencies[heap[0].pos];
+		} else {
+			heap[0]=heap[--size];
+		}
+
+		heapSiftDown(heap,size,0);
+	}
+
+	free(heap);
+
+	return 0;
+}
+
+// The values of a ping-like trace are round-trip times, while the ones of a unidirectional trace are one-way latencies
+static const char *metricName(uint8_t mode_ub) {
+	switch(mode_ub) {
+		case TRACE_MODE_PINGLIKE:
+			return "RTT";
+		case TRACE_MODE_UNIDIR:
+			return "Latency";
+		default:
+			return "Latency/RTT";
+	}
+}
+
+static void printStatsLine(FILE *stream, const char *name, const runStats *run) {
+	uint64_t lost=run->expected-run->received;
+
+	fprintf(stream,"%s: %" PRIu64 "/%" PRIu64 " packets, lost %.3f%% (%" PRIu64 " bursts, max %" PRIu64 "), %" PRIu64 " duplicates, %" PRIu64 " reordered, %" PRIu64 " errors\n",
+		name,run->received,run->expected,run->expected>0 ? ((double) lost)*100/run->expected : 0,run->lossBurstCount,run->maxLossBurst,
+		run->duplicates,run->reordered,run->errors);
+
+	if(run->count>0) {
+		fprintf(stream,"\t%s%s min/avg/max/stdev: %.3f/%.3f/%.3f/%.3f ms - p50/p90/p99/p99.9/p99.99: %.3f/%.3f/%.3f/%.3f/%.3f ms",
+			metricName(run->mode_ub),run->followup ? " (follow-up)" : "",
+			((double) run->min)/ANALYZE_MILLISEC_TO_NANOSEC,run->mean/ANALYZE_MILLISEC_TO_NANOSEC,((double) run->max)/ANALYZE_MILLISEC_TO_NANOSEC,
+			run->count>1 ? sqrt(run->m2/(run->count-1))/ANALYZE_MILLISEC_TO_NANOSEC : 0,
+			((double) run->percentiles[0])/ANALYZE_MILLISEC_TO_NANOSEC,((double) run->percentiles[1])/ANALYZE_MILLISEC_TO_NANOSEC,
+			((double) run->percentiles[2])/ANALYZE_MILLISEC_TO_NANOSEC,((double) run->percentiles[3])/ANALYZE_MILLISEC_TO_NANOSEC,
+			((double) run->percentiles[4])/ANALYZE_MILLISEC_TO_NANOSEC);
+
+		if(run->jitter>=0) {
+			fprintf(stream," - jitter %.3f ms",run->jitter/ANALYZE_MILLISEC_TO_NANOSEC);
+		}
+
+		fprintf(stream,"\n");
+	}
+}
+
+static void printStatsCSVLine(FILE *csv, const char *name, const runStats *run) {
+	uint64_t lost=run->expected-run->received;
+
+	fprintf(csv,"%s,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%.3f,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",",
+		name,run->records,run->expected,run->received,lost,run->expected>0 ? ((double) lost)*100/run->expected : 0,
+		run->duplicates,run->reordered,run->errors,run->lossBurstCount,run->maxLossBurst);
+
+	if(run->count>0) {
+		fprintf(csv,"%.6f,%.6f,%.6f,%.6f",
+			((double) run->min)/ANALYZE_MILLISEC_TO_NANOSEC,run->mean/ANALYZE_MILLISEC_TO_NANOSEC,((double) run->max)/ANALYZE_MILLISEC_TO_NANOSEC,
+			run->count>1 ? sqrt(run->m2/(run->count-1))/ANALYZE_MILLISEC_TO_NANOSEC : 0);
+
+		for(int p=0;p<ANALYZE_NUM_PERCENTILES;p++) {
+			fprintf(csv,",%.6f",((double) run->percentiles[p])/ANALYZE_MILLISEC_TO_NANOSEC);
+		}
+	} else {
+		fprintf(csv,",,,,,,,,");
+	}
+
+	if(run->jitter>=0) {
+		fprintf(csv,",%.6f\n",run->jitter/ANALYZE_MILLISEC_TO_NANOSEC);
+	} else {
+		fprintf(csv,",\n");
+	}
+}
+
+// Same columns as the --interim-csv file of the client, preceded by the trace name
+static void printWindowsCSV(FILE *csv, const runStats *run) {
+	const windowStats *win;
+	uint64_t windowPackets;
+	uint64_t lost;
+
+	if(run->windowCount==0) {
+		return;
+	}
+
+	windowPackets=run->windows[0].expected;
+
+	for(uint64_t w=0;w<run->windowCount;w++) {
+		win=&(run->windows[w]);
+		lost=win->expected>win->received ? win->expected-win->received : 0;
+
+		// Nominal send times: the packets of each burst are sent together, at the beginning of their interval
+		fprintf(csv,"%s,%" PRIu64 ",%.3f,%.3f,%" PRIu64 ",%" PRIu64 ",%.3f,%" PRIu64 ",",run->filename,w+1,
+			((double) (w*windowPackets))/run->burst_size*run->interval_ns/ANALYZE_SEC_TO_NANOSEC,
+			((double) (w*windowPackets+win->expected))/run->burst_size*run->interval_ns/ANALYZE_SEC_TO_NANOSEC,
+			win->received,lost,win->expected>0 ? ((double) lost)*100/win->expected : 0,win->errors);
+
+		if(win->count>0) {
+			fprintf(csv,"%.6f,%.6f,%.6f,%.6f",
+				((double) win->min)/ANALYZE_MILLISEC_TO_NANOSEC,win->mean/ANALYZE_MILLISEC_TO_NANOSEC,((double) win->max)/ANALYZE_MILLISEC_TO_NANOSEC,
+				win->count>1 ? sqrt(win->m2/(win->count-1))/ANALYZE_MILLISEC_TO_NANOSEC : 0);
+
+			for(int p=0;p<ANALYZE_NUM_PERCENTILES;p++) {
+				fprintf(csv,",%.6f",((double) win->percentiles[p])/ANALYZE_MILLISEC_TO_NANOSEC);
+			}
+		} else {
+			fprintf(csv,",,,,,,,,");
+		}
+
+		if(win->jitter>=0) {
+			fprintf(csv,",%.6f\n",win->jitter/ANALYZE_MILLISEC_TO_NANOSEC);
+		} else {
+			fprintf(csv,",\n");
+		}
+	}
+}
+
+// Merge the statistics of all the traces: the counters are summed, mean and variance are combined with Chan et al.'s parallel
+// algorithm and the percentiles are exact. As in reportStructureMerge(), the RFC 3550 jitter, which depends on the order of the packets,
+// is averaged, weighting each trace by its number of latency values.
+static void mergeRuns(runStats *runs, unsigned int runCount, runStats *all) {
+	double delta, jitterWeight=0;
+	uint64_t ranks[ANALYZE_NUM_PERCENTILES];
+	uint8_t firstRun=1;
+
+	memset(all,0,sizeof(runStats));
+	all->min=UINT64_MAX;
+	all->jitter=-1.0;
+	all->followup=1;
+	all->mode_ub=TRACE_MODE_UNSET;
+
+	for(unsigned int i=0;i<runCount;i++) {
+		if(runs[i].error<0) {
+			continue;
+		}
+
+		all->records+=runs[i].records;
+		all->expected+=runs[i].expected;
+		all->received+=runs[i].received;
+		all->duplicates+=runs[i].duplicates;
+		all->reordered+=runs[i].reordered;
+		all->errors+=runs[i].errors;
+		all->lossBurstCount+=runs[i].lossBurstCount;
+		all->followup&=runs[i].followup;
+
+		if(firstRun) {
+			all->mode_ub=runs[i].mode_ub;
+			firstRun=0;
+		} else if(all->mode_ub!=runs[i].mode_ub) {
+			all->mode_ub=TRACE_MODE_UNSET;
+		}
+
+		if(runs[i].maxLossBurst>all->maxLossBurst) {
+			all->maxLossBurst=runs[i].maxLossBurst;
+		}
+
+		if(runs[i].count==0) {
+			continue;
+		}
+
+		if(runs[i].min<all->min) {
+			all->min=runs[i].min;
+		}
+		if(runs[i].max>all->max) {
+			all->max=runs[i].max;
+		}
+
+		delta=runs[i].mean-all->mean;
+		all->m2+=runs[i].m2+delta*delta*((double) all->count)*runs[i].count/(all->count+runs[i].count);
+		all->mean+=delta*runs[i].count/(all->count+runs[i].count);
+		all->count+=runs[i].count;
+
+		if(runs[i].jitter>=0) {
+			all->jitter=(all->jitter<0 ? 0 : all->jitter*jitterWeight)+runs[i].jitter*runs[i].count;
+			jitterWeight+=runs[i].count;
+			all->jitter/=jitterWeight;
+		}
+	}
+
+	if(all->count>0) {
+		for(int p=0;p<ANALYZE_NUM_PERCENTILES;p++) {
+			ranks[p]=(uint64_t) ceil(percentileValues[p]*all->count);
+			if(ranks[p]==0) {
+				ranks[p]=1;
+			}
+		}
+
+		if(mergedRanks(runs,runCount,ranks,all->percentiles,ANALYZE_NUM_PERCENTILES)<0) {
+			fprintf(stderr,"Warning: cannot allocate memory to merge the traces: the merged percentiles are not available.\n");
+		}
+	}
+}
+
+static int writeCDF(runStats *runs, unsigned int runCount, const runStats *all, const char *filename, uint64_t points) {
+	FILE *csv;
+	uint64_t *ranks, *values;
+
+	if(all->count==0) {
+		fprintf(stderr,"Warning: no latency value is available: the CDF will not be written.\n");
+		return 0;
+	}
+
+	if(points>all->count) {
+		points=all->count;
+	}
+
+	ranks=malloc(points*sizeof(uint64_t));
+	values=malloc(points*sizeof(uint64_t));
+	if(ranks==NULL || values==NULL) {
+		free(ranks);
+		free(values);
+		fprintf(stderr,"Error: cannot allocate memory for the CDF.\n");
+		return -1;
+	}
+
+	// Equally spaced cumulative probabilities, from 1/points to 1 (i.e. the maximum value)
+	for(uint64_t i=0;i<points;i++) {
+		ranks[i]=(uint64_t) ceil(((double) (i+1))*all->count/points);
+	}
+
+	if(mergedRanks(runs,runCount,ranks,values,points)<0) {
+		free(ranks);
+		free(values);
+		fprintf(stderr,"Error: cannot allocate memory for the CDF.\n");
+		return -1;
+	}
+
+	csv=fopen(filename,"w");
+	if(csv==NULL) {
+		fprintf(stderr,"Error: cannot open %s for writing: %s.\n",filename,strerror(errno));
+		free(ranks);
+		free(values);
+		return -1;
+	}
+
+	fprintf(csv,"%s-ms,CDF\n",metricName(all->mode_ub));
+	for(uint64_t i=0;i<points;i++) {
+		fprintf(csv,"%.6f,%.6f\n",((double) values[i])/ANALYZE_MILLISEC_TO_NANOSEC,((double) ranks[i])/all->count);
+	}
+
+	free(ranks);
+	free(values);
+
+	if(fclose(csv)!=0) {
+		fprintf(stderr,"Error: cannot write %s: %s.\n",filename,strerror(errno));
+		return -1;
+	}
+
+	return 0;
+}
+
+int main(int argc, char **argv) {
+	analyzeJob job={.runs=NULL,.runCount=0,.nextRun=0,.windowPackets=0,.window_ns=0};
+	runStats all;
+	pthread_t *tids;
+	unsigned int numThreads=0;
+	char *summaryFilename=NULL, *cdfFilename=NULL, *windowsFilename=NULL;
+	uint64_t cdfPoints=ANALYZE_DEF_CDF_POINTS;
+	FILE *csv;
+	char *sPtr;
+	unsigned long long value;
+	int failed=0;
+	int opt;
+
+	while((opt=getopt(argc,argv,"j:o:c:p:w:W:h"))!=-1) {
+		switch(opt) {
+			case 'j':
+				errno=0;
+				value=strtoull(optarg,&sPtr,10);
+				if(errno || sPtr==optarg || *sPtr!='\0' || value==0 || value>1024) {
+					fprintf(stderr,"Error: invalid number of threads: %s.\n",optarg);
+					exit(EXIT_FAILURE);
+				}
+				numThreads=(unsigned int) value;
+				break;
+
+			case 'o':
+				summaryFilename=optarg;
+				break;
+
+			case 'c':
+				cdfFilename=optarg;
+				break;
+
+			case 'p':
+				errno=0;
+				cdfPoints=strtoull(optarg,&sPtr,10);
+				if(errno || sPtr==optarg || *sPtr!='\0' || cdfPoints==0) {
+					fprintf(stderr,"Error: invalid number of CDF points: %s.\n",optarg);
+					exit(EXIT_FAILURE);
+				}
+				break;
+
+			case 'w':
+				errno=0;
+				value=strtoull(optarg,&sPtr,10);
+				if(errno || sPtr==optarg || value==0) {
+					fprintf(stderr,"Error: invalid window: %s.\n",optarg);
+					exit(EXIT_FAILURE);
+				}
+
+				if(strcmp(sPtr,"p")==0) {
+					job.windowPackets=value;
+				} else if(strcmp(sPtr,"s")==0 || *sPtr=='\0') {
+					job.window_ns=value*ANALYZE_SEC_TO_NANOSEC;
+				} else if(strcmp(sPtr,"ms")==0) {
+					job.window_ns=value*ANALYZE_MILLISEC_TO_NANOSEC;
+				} else {
+					fprintf(stderr,"Error: invalid window unit: %s (valid units: s, ms, p).\n",sPtr);
+					exit(EXIT_FAILURE);
+				}
+				break;
+
+			case 'W':
+				windowsFilename=optarg;
+				break;
+
+			default:
+				print_usage(argv[0]);
+				exit(opt=='h' ? EXIT_SUCCESS : EXIT_FAILURE);
+		}
+	}
+
+	if(optind>=argc) {
+		print_usage(argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	if((windowsFilename!=NULL)!=(job.windowPackets>0 || job.window_ns>0)) {
+		fprintf(stderr,"Error: -w and -W must be specified together.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	job.runCount=argc-optind;
+	job.runs=calloc(job.runCount,sizeof(runStats));
+	if(job.runs==NULL) {
+		fprintf(stderr,"Error: cannot allocate memory.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for(unsigned int i=0;i<job.runCount;i++) {
+		job.runs[i].filename=argv[optind+i];
+	}
+
+	if(numThreads==0) {
+		numThreads=sysconf(_SC_NPROCESSORS_ONLN)>0 ? (unsigned int) sysconf(_SC_NPROCESSORS_ONLN) : 1;
+	}
+	if(numThreads>job.runCount) {
+		numThreads=job.runCount;
+	}
+
+	tids=malloc(numThreads*sizeof(pthread_t));
+	if(tids==NULL) {
+		fprintf(stderr,"Error: cannot allocate memory.\n");
+		free(job.runs);
+		exit(EXIT_FAILURE);
+	}
+
+	// If a thread cannot be created, its traces are analyzed by the other ones (or by the main thread, if no thread could be created)
+	for(unsigned int i=0;i<numThreads;i++) {
+		if(pthread_create(&tids[i],NULL,&analyzeWorker,(void *) &job)!=0) {
+			numThreads=i;
+			break;
+		}
+	}
+
+	if(numThreads==0) {
+		for(unsigned int i=0;i<job.runCount;i++) {
+			analyzeRun(&(job.runs[i]),job.windowPackets,job.window_ns);
+		}
+	}
+
+	for(unsigned int i=0;i<numThreads;i++) {
+		pthread_join(tids[i],NULL);
+	}
+
+	free(tids);
+
+	for(unsigned int i=0;i<job.runCount;i++) {
+		if(job.runs[i].error==TRACEFILE_EFORMAT) {
+			fprintf(stderr,"Error: %s is not a supported LaTe binary trace: it will be skipped.\n",job.runs[i].filename);
+			failed=1;
+		} else if(job.runs[i].error<0) {
+			fprintf(stderr,"Error: cannot read %s: it will be skipped.\n",job.runs[i].filename);
+			failed=1;
+		} else {
+			printStatsLine(stdout,job.runs[i].filename,&(job.runs[i]));
+		}
+	}
+
+	mergeRuns(job.runs,job.runCount,&all);
+
+	if(job.runCount>1) {
+		printStatsLine(stdout,"ALL",&all);
+	}
+
+	if(summaryFilename!=NULL) {
+		csv=fopen(summaryFilename,"w");
+		if(csv==NULL) {
+			fprintf(stderr,"Error: cannot open %s for writing: %s.\n",summaryFilename,strerror(errno));
+			failed=1;
+		} else {
+			fprintf(csv,"Trace,Records,Expected,Received,LostPackets,LostPackets-Perc,Duplicates,Reordered,ErrorsCount,LossBursts,MaxLossBurst,"
+				"MinLatency-ms,AvgLatency-ms,MaxLatency-ms,StDev-ms,P50-ms,P90-ms,P99-ms,P99.9-ms,P99.99-ms,Jitter-ms\n");
+
+			for(unsigned int i=0;i<job.runCount;i++) {
+				if(job.runs[i].error==0) {
+					printStatsCSVLine(csv,job.runs[i].filename,&(job.runs[i]));
+				}
+			}
+			printStatsCSVLine(csv,"ALL",&all);
+
+			if(fclose(csv)!=0) {
+				fprintf(stderr,"Error: cannot write %s: %s.\n",summaryFilename,strerror(errno));
+				failed=1;
+			}
+		}
+	}
+
+	if(cdfFilename!=NULL && writeCDF(job.runs,job.runCount,&all,cdfFilename,cdfPoints)<0) {
+		failed=1;
+	}
+
+	if(windowsFilename!=NULL) {
+		csv=fopen(windowsFilename,"w");
+		if(csv==NULL) {
+			fprintf(stderr,"Error: cannot open %s for writing: %s.\n",windowsFilename,strerror(errno));
+			failed=1;
+		} else {
+			fprintf(csv,"Trace,Window,Start-s,End-s,Packets,LostPackets,LostPackets-Perc,ErrorsCount,MinLatency-ms,AvgLatency-ms,MaxLatency-ms,StDev-ms,"
+				"P50-ms,P90-ms,P99-ms,P99.9-ms,P99.99-ms,Jitter-ms\n");
+
+			for(unsigned int i=0;i<job.runCount;i++) {
+				if(job.runs[i].error==0) {
+					printWindowsCSV(csv,&(job.runs[i]));
+				}
+			}
+
+			if(fclose(csv)!=0) {
+				fprintf(stderr,"Error: cannot write %s: %s.\n",windowsFilename,strerror(errno));
+				failed=1;
+			}
+		}
+	}
+
+	for(unsigned int i=0;i<job.runCount;i++) {
+		free(job.runs[i].latencies);
+		free(job.runs[i].windows);
+	}
+	free(job.runs);
+
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,115 @@
+/* lamptrace2csv: convert a binary per-packet trace, written by the LaTe client with --trace, into the same
+CSV format of the '-W' option, or print the session metadata stored inside its header */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <errno.h>
+#include "trace_file.h"
+
+// The same number of decimal digits used by the client for the '-W' CSV file (W_DECIMAL_DIGITS, in options.h)
+#define TRACE2CSV_DECIMAL_DIGITS 6
+
+static const char *latencyTypes[]={"Unknown","User-to-user","KRT","Software (kernel) timestamps","Hardware timestamps"};
+static const char *modes[]={"Unknown (ping-like)","Ping-like","Unidirectional"};
+static const char *clockSources[]={"CLOCK_REALTIME","CLOCK_MONOTONIC_RAW","invariant TSC"};
+
+static void print_usage(const char *progname) {
+	fprintf(stderr,"Usage: %s [-i] <trace file> [<output CSV file>]\n"
+		"Convert a LaTe binary trace (--trace) into the '-W' CSV format (written to stdout, if no output file is specified).\n"
+		"  -i: print only the session information stored inside the trace header.\n",progname);
+}
+
+static void print_header_info(const traceFileReader *reader, FILE *stream) {
+	const traceHeader *header=reader->header;
+
+	fprintf(stream,"Trace format version: %" PRIu16 "\n",header->version);
+	fprintf(stream,"LaMP session id: %" PRIu16 "\n",header->lamp_id);
+	fprintf(stream,"Latency type: %s\n",header->latency_type<sizeof(latencyTypes)/sizeof(latencyTypes[0]) ? latencyTypes[header->latency_type] : "Unknown");
+	fprintf(stream,"Clock source: %s\n",header->clock_source<sizeof(clockSources)/sizeof(clockSources[0]) ? clockSources[header->clock_source] : "Unknown");
+	fprintf(stream,"Mode: %s\n",header->mode_ub<sizeof(modes)/sizeof(modes[0]) ? modes[header->mode_ub] : "Unknown");
+	fprintf(stream,"Follow-up: %s\n",header->followup ? "On" : "Off");
+	fprintf(stream,"Payload length: %" PRIu16 " B\n",header->payload_len);
+	fprintf(stream,"Requested packets: %" PRIu64 "\n",header->total_packets);
+	fprintf(stream,"Interval: %.6f ms\n",((double) header->interval_ns)/1000000);
+	if(header->burst_size>0) {
+		fprintf(stream,"Burst size: %" PRIu32 " packets\n",header->burst_size);
+	}
+	fprintf(stream,"Start time: %" PRIu64 ".%09" PRIu64 " (UNIX epoch)\n",header->start_realtime_ns/1000000000,header->start_realtime_ns%1000000000);
+	fprintf(stream,"Records: %" PRIu64 "%s\n",reader->count,header->record_count==0 && reader->count>0 ? " (the trace was not closed properly)" : "");
+}
+
+int main(int argc, char **argv) {
+	traceFileReader reader;
+	FILE *out=stdout;
+	char line[TFILE_RECORD_MAX_LEN];
+	const traceRecord *record;
+	int info_only=0;
+	int opt;
+	int ret;
+
+	while((opt=getopt(argc,argv,"ih"))!=-1) {
+		switch(opt) {
+			case 'i':
+				info_only=1;
+				break;
+			default:
+				print_usage(argv[0]);
+				exit(opt=='h' ? EXIT_SUCCESS : EXIT_FAILURE);
+		}
+	}
+
+	if(optind>=argc || argc-optind>2) {
+		print_usage(argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	ret=traceFileMap(&reader,argv[optind]);
+	if(ret<0) {
+		if(ret==TRACEFILE_EFORMAT) {
+			fprintf(stderr,"Error: %s is not a supported LaTe binary trace.\n",argv[optind]);
+		} else {
+			fprintf(stderr,"Error: cannot read %s: %s.\n",argv[optind],strerror(errno));
+		}
+		exit(EXIT_FAILURE);
+	}
+
+	if(info_only) {
+		print_header_info(&reader,stdout);
+		traceFileUnmap(&reader);
+		exit(EXIT_SUCCESS);
+	}
+
+	if(argc-optind==2) {
+		out=fopen(argv[optind+1],"w");
+		if(out==NULL) {
+			fprintf(stderr,"Error: cannot open %s for writing: %s.\n",argv[optind+1],strerror(errno));
+			traceFileUnmap(&reader);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	fputs(tFileHeaderLine(reader.header->followup),out);
+
+	for(uint64_t i=0;i<reader.count;i++) {
+		record=&(reader.records[i]);
+
+		ret=sprintTRecord(line,TFILE_RECORD_MAX_LEN,reader.header->followup,TRACE2CSV_DECIMAL_DIGITS,record->seq,traceRecordTripTime(record),
+			(record->flags & TRACE_FLAG_ERROR) ? 0 : record->proc_ns);
+
+		if(ret>0 && ret<TFILE_RECORD_MAX_LEN) {
+			fwrite(line,1,ret,out);
+		}
+	}
+
+	traceFileUnmap(&reader);
+
+	if(out!=stdout && fclose(out)!=0) {
+		fprintf(stderr,"Error: cannot write %s: %s.\n",argv[optind+1],strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	return 0;
+}